@@ -0,0 +1,1366 @@
+// c_db_bench: synthetic workloads over the public api, one result per line as json or csv.
+// every workload runs in its own database named <db>_<workload>, which is removed afterwards
+#include "internal.h"
+
+#include <string.h>
+#include <time.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#endif
+
+#define CD_BENCH_FORMAT_JSON 0
+#define CD_BENCH_FORMAT_CSV 1
+
+#define CD_BENCH_BATCH_ROWS 1024
+#define CD_BENCH_NAME_COUNT 16
+#define CD_BENCH_NOTE_COUNT 48
+
+typedef struct _CD_BenchOptions
+{
+	uint64_t rows; // rows of the batched inserts, of the scanned tables and of the stress table
+	uint64_t single_rows; // rows inserted one at a time
+	uint64_t growth_rows;
+	uint64_t table_count; // most tables of the databases opened by the open workload
+	uint64_t repeat; // runs of the read-only workloads; the fastest is reported
+	uint64_t seed;
+	uint64_t durability;
+	uint64_t format;
+	const char *db_prefix;
+	const char *filter; // substring of the workloads to run, NULL for all
+} _CD_BenchOptions;
+
+typedef struct _CD_BenchDatabase
+{
+	CD_Database *db;
+	char path[CD_NAME_LENGTH];
+} _CD_BenchDatabase;
+
+typedef uint64_t (*_cd_func_bench)(const _CD_BenchOptions *options);
+
+typedef struct _CD_BenchWorkload
+{
+	const char *name;
+	_cd_func_bench function;
+} _CD_BenchWorkload;
+
+static uint64_t _cd_bench_result_count = 0;
+
+// the wide rows: every attribute type the kernels cover plus two text attributes
+static CD_Attribute _cd_bench_attributes[] =
+{
+	{ .name = "id", .type = CD_TYPE_UINT, .count = 1, .constraints = CD_CONSTRAINT_NONE, .encoding = CD_ENCODING_NONE },
+	{ .name = "a", .type = CD_TYPE_UINT, .count = 1, .constraints = CD_CONSTRAINT_NONE, .encoding = CD_ENCODING_NONE },
+	{ .name = "b", .type = CD_TYPE_SINT, .count = 1, .constraints = CD_CONSTRAINT_NONE, .encoding = CD_ENCODING_NONE },
+	{ .name = "c", .type = CD_TYPE_FLOAT, .count = 1, .constraints = CD_CONSTRAINT_NONE, .encoding = CD_ENCODING_NONE },
+	{ .name = "d", .type = CD_TYPE_BYTE, .count = 1, .constraints = CD_CONSTRAINT_NONE, .encoding = CD_ENCODING_NONE },
+	{ .name = "name", .type = CD_TYPE_CHAR, .count = CD_BENCH_NAME_COUNT, .constraints = CD_CONSTRAINT_NONE, .encoding = CD_ENCODING_NONE },
+	{ .name = "note", .type = CD_TYPE_VARCHAR, .count = CD_BENCH_NOTE_COUNT, .constraints = CD_CONSTRAINT_NONE, .encoding = CD_ENCODING_NONE }
+};
+static const char *_cd_bench_attribute_names[] = { "id", "a", "b", "c", "d", "name", "note" };
+
+#define CD_BENCH_ATTRIBUTE_COUNT (sizeof(_cd_bench_attributes) / sizeof(_cd_bench_attributes[0]))
+// offsets of the attributes in a packed row
+#define CD_BENCH_OFFSET_ID 0
+#define CD_BENCH_OFFSET_A 8
+#define CD_BENCH_OFFSET_B 16
+#define CD_BENCH_OFFSET_C 24
+#define CD_BENCH_OFFSET_D 32
+#define CD_BENCH_OFFSET_NAME 33
+#define CD_BENCH_OFFSET_NOTE (CD_BENCH_OFFSET_NAME + CD_BENCH_NAME_COUNT)
+#define CD_BENCH_STRIDE (CD_BENCH_OFFSET_NOTE + CD_BENCH_NOTE_COUNT)
+
+static uint64_t _cd_bench_random(uint64_t *state)
+{
+	// xorshift64*, the same seed gives the same rows on every machine
+	uint64_t x = *state;
+	x ^= x >> 12;
+	x ^= x << 25;
+	x ^= x >> 27;
+	*state = x;
+	return x * 0x2545F4914F6CDD1DULL;
+}
+
+static double _cd_bench_seconds()
+{
+#ifdef _WIN32
+	LARGE_INTEGER frequency, counter;
+	QueryPerformanceFrequency(&frequency);
+	QueryPerformanceCounter(&counter);
+	return (double)counter.QuadPart / (double)frequency.QuadPart;
+#else
+	struct timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return (double)time.tv_sec + (double)time.tv_nsec * 1e-9;
+#endif
+}
+
+// peak resident memory of the process so far
+static uint64_t _cd_bench_peak_rss_kb()
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+	{
+		return 0;
+	}
+	return counters.PeakWorkingSetSize / 1024;
+#else
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0)
+	{
+		return 0;
+	}
+#ifdef __APPLE__
+	return usage.ru_maxrss / 1024; // bytes on macos
+#else
+	return usage.ru_maxrss;
+#endif
+#endif
+}
+
+static void _cd_bench_report(const _CD_BenchOptions *options, const char *name, const char *parameter, uint64_t rows, double seconds)
+{
+	double rows_per_second = seconds > 0 ? (double)rows / seconds : 0;
+	double ns_per_row = rows != 0 ? seconds * 1e9 / (double)rows : 0;
+	uint64_t peak_rss_kb = _cd_bench_peak_rss_kb();
+
+	if (options->format == CD_BENCH_FORMAT_CSV)
+	{
+		printf("%s,%s,%llu,%.6f,%.1f,%.2f,%llu\n", name, parameter, (unsigned long long)rows, seconds, rows_per_second, ns_per_row, (unsigned long long)peak_rss_kb);
+	}
+	else
+	{
+		printf("%s\t{ \"name\": \"%s\", \"parameter\": \"%s\", \"rows\": %llu, \"seconds\": %.6f, \"rows_per_sec\": %.1f, \"ns_per_row\": %.2f, \"peak_rss_kb\": %llu }",
+			_cd_bench_result_count == 0 ? "" : ",\n", name, parameter, (unsigned long long)rows, seconds, rows_per_second, ns_per_row, (unsigned long long)peak_rss_kb);
+	}
+	fflush(stdout);
+	_cd_bench_result_count++;
+}
+
+static uint64_t _cd_bench_fail(const char *what)
+{
+	CD_Error error = cd_get_last_error();
+	fprintf(stderr, "c_db_bench: %s failed: %s\n", what, error.message.data);
+	return 0;
+}
+
+// fills row_count packed rows starting at id
+static void _cd_bench_rows_fill(uint8_t *rows, uint64_t row_count, uint64_t id, uint64_t *state)
+{
+	for (uint64_t i = 0; i < row_count; i++, id++)
+	{
+		uint8_t *row = rows + i * CD_BENCH_STRIDE;
+		uint64_t r = _cd_bench_random(state);
+
+		CD_uint_t a = r % 16;
+		CD_sint_t b = (CD_sint_t)((r >> 8) % 1000) - 500;
+		CD_float_t c = (double)(r >> 11) / (double)(1ULL << 53);
+		CD_byte_t d = (CD_byte_t)((r >> 24) % 4);
+
+		memcpy(row + CD_BENCH_OFFSET_ID, &id, sizeof(id));
+		memcpy(row + CD_BENCH_OFFSET_A, &a, sizeof(a));
+		memcpy(row + CD_BENCH_OFFSET_B, &b, sizeof(b));
+		memcpy(row + CD_BENCH_OFFSET_C, &c, sizeof(c));
+		row[CD_BENCH_OFFSET_D] = d;
+
+		char name[CD_BENCH_NAME_COUNT + 1];
+		snprintf(name, sizeof(name), "name%012llu", (unsigned long long)id);
+		memcpy(row + CD_BENCH_OFFSET_NAME, name, CD_BENCH_NAME_COUNT);
+
+		char *note = (char *)row + CD_BENCH_OFFSET_NOTE;
+		uint64_t note_length = (r >> 32) % CD_BENCH_NOTE_COUNT;
+		for (uint64_t n = 0; n < note_length; n++)
+		{
+			note[n] = 'a' + (char)((r >> (n % 32)) % 26);
+		}
+		memset(note + note_length, 0, CD_BENCH_NOTE_COUNT - note_length);
+	}
+}
+
+static uint64_t _cd_bench_directory_remove(const char *path)
+{
+	char file_path[CD_NAME_LENGTH * 2 + 2];
+
+#ifdef _WIN32
+	snprintf(file_path, sizeof(file_path), "%s/*", path);
+
+	WIN32_FIND_DATAA data;
+	HANDLE find = FindFirstFileA(file_path, &data);
+	if (find != INVALID_HANDLE_VALUE)
+	{
+		do
+		{
+			if (!(data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+			{
+				snprintf(file_path, sizeof(file_path), "%s/%s", path, data.cFileName);
+				DeleteFileA(file_path);
+			}
+		} while (FindNextFileA(find, &data));
+		FindClose(find);
+	}
+	return RemoveDirectoryA(path) != 0;
+#else
+	// a database is one flat directory
+	DIR *directory = opendir(path);
+	if (directory == NULL)
+	{
+		return 0;
+	}
+	for (struct dirent *entry = readdir(directory); entry != NULL; entry = readdir(directory))
+	{
+		if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+		{
+			continue;
+		}
+		snprintf(file_path, sizeof(file_path), "%s/%s", path, entry->d_name);
+		unlink(file_path);
+	}
+	closedir(directory);
+	return rmdir(path) == 0;
+#endif
+}
+
+static uint64_t _cd_bench_database_open(const _CD_BenchOptions *options, const char *workload, _CD_BenchDatabase *database)
+{
+	snprintf(database->path, sizeof(database->path), "%s_%s", options->db_prefix, workload);
+
+	// never removes a directory the bench did not create
+	if (!cd_database_create(database->path))
+	{
+		return _cd_bench_fail("cd_database_create");
+	}
+
+	database->db = cd_database_open(database->path);
+	if (database->db == NULL)
+	{
+		_cd_bench_directory_remove(database->path);
+		return _cd_bench_fail("cd_database_open");
+	}
+
+	if (!cd_database_durability_set(database->db, options->durability))
+	{
+		cd_database_close(database->db);
+		_cd_bench_directory_remove(database->path);
+		return _cd_bench_fail("cd_database_durability_set");
+	}
+	return 1;
+}
+
+static void _cd_bench_database_close(_CD_BenchDatabase *database)
+{
+	cd_database_close(database->db);
+	if (!_cd_bench_directory_remove(database->path))
+	{
+		fprintf(stderr, "c_db_bench: failed to remove '%s'\n", database->path);
+	}
+}
+
+// creates the wide table; id is UNIQUE when is_unique is set
+static CD_Table *_cd_bench_table_create(CD_Database *db, const char *table_name, uint64_t is_unique)
+{
+	CD_Attribute attributes[CD_BENCH_ATTRIBUTE_COUNT];
+	memcpy(attributes, _cd_bench_attributes, sizeof(attributes));
+	if (is_unique)
+	{
+		attributes[0].constraints = CD_CONSTRAINT_UNIQUE;
+	}
+
+	if (!cd_table_create(db, table_name, CD_BENCH_ATTRIBUTE_COUNT, attributes))
+	{
+		_cd_bench_fail("cd_table_create");
+		return NULL;
+	}
+
+	CD_Table *table = cd_table_open(db, table_name);
+	if (table == NULL)
+	{
+		_cd_bench_fail("cd_table_open");
+	}
+	return table;
+}
+
+// appends row_count rows in batches of batch_rows, timing only the inserts
+static uint64_t _cd_bench_table_insert(CD_Table *table, uint64_t row_count, uint64_t batch_rows, uint64_t seed, double *seconds)
+{
+	uint64_t return_value = 0;
+
+	CD_PreparedInsert *insert = cd_table_insert_prepare(table, CD_BENCH_ATTRIBUTE_COUNT, _cd_bench_attribute_names);
+	if (insert == NULL)
+	{
+		return _cd_bench_fail("cd_table_insert_prepare");
+	}
+
+	uint8_t *rows = malloc(batch_rows * CD_BENCH_STRIDE);
+	uint64_t state = seed;
+	uint64_t id = cd_table_count(table);
+
+	*seconds = 0;
+	for (uint64_t inserted = 0; inserted < row_count;)
+	{
+		uint64_t batch_count = row_count - inserted < batch_rows ? row_count - inserted : batch_rows;
+		_cd_bench_rows_fill(rows, batch_count, id + inserted, &state);
+
+		double start = _cd_bench_seconds();
+		if (!cd_prepared_insert(insert, batch_count, rows))
+		{
+			_cd_bench_fail("cd_prepared_insert");
+			goto rows_free;
+		}
+		*seconds += _cd_bench_seconds() - start;
+
+		inserted += batch_count;
+	}
+
+	return_value = 1;
+
+rows_free:
+	free(rows);
+	cd_prepared_insert_destroy(insert);
+	return return_value;
+}
+
+static uint64_t _cd_bench_insert(const _CD_BenchOptions *options, const char *workload, uint64_t is_unique, uint64_t row_count, uint64_t batch_rows)
+{
+	_CD_BenchDatabase database;
+	if (!_cd_bench_database_open(options, workload, &database))
+	{
+		return 0;
+	}
+
+	uint64_t return_value = 0;
+
+	CD_Table *table = _cd_bench_table_create(database.db, "rows", is_unique);
+	if (table == NULL)
+	{
+		goto database_close;
+	}
+
+	double seconds;
+	if (!_cd_bench_table_insert(table, row_count, batch_rows, options->seed, &seconds))
+	{
+		goto table_close;
+	}
+
+	char parameter[64];
+	snprintf(parameter, sizeof(parameter), "batch=%llu", (unsigned long long)batch_rows);
+	_cd_bench_report(options, workload, parameter, row_count, seconds);
+
+	return_value = 1;
+
+table_close:
+	cd_table_close(table);
+database_close:
+	_cd_bench_database_close(&database);
+	return return_value;
+}
+
+static uint64_t _cd_bench_insert_single(const _CD_BenchOptions *options)
+{
+	return _cd_bench_insert(options, "insert_single", 0, options->single_rows, 1);
+}
+
+static uint64_t _cd_bench_insert_batched(const _CD_BenchOptions *options)
+{
+	return _cd_bench_insert(options, "insert_batched", 0, options->rows, CD_BENCH_BATCH_ROWS);
+}
+
+static uint64_t _cd_bench_insert_unique_single(const _CD_BenchOptions *options)
+{
+	return _cd_bench_insert(options, "insert_unique_single", 1, options->single_rows, 1);
+}
+
+static uint64_t _cd_bench_insert_unique_batched(const _CD_BenchOptions *options)
+{
+	return _cd_bench_insert(options, "insert_unique_batched", 1, options->rows, CD_BENCH_BATCH_ROWS);
+}
+
+// values of the scan conditions: a matches 1 row in 16, b skips 1 row in 1000, d matches 1 row in 4
+static const CD_uint_t _cd_bench_condition_a = 3;
+static const CD_sint_t _cd_bench_condition_b = 0;
+static const CD_byte_t _cd_bench_condition_d = 1;
+
+static CD_Condition _cd_bench_conditions[] =
+{
+	{ "a", CD_CONDITION_OPERATOR_EQUALS, &_cd_bench_condition_a },
+	{ "b", CD_CONDITION_OPERATOR_DIFFERENT, &_cd_bench_condition_b },
+	{ "d", CD_CONDITION_OPERATOR_EQUALS, &_cd_bench_condition_d }
+};
+
+// runs select options->repeat times and keeps the fastest; rows is the row count of the table scanned
+static uint64_t _cd_bench_select_time(const _CD_BenchOptions *options, CD_PreparedSelect *select, double *seconds)
+{
+	*seconds = 0;
+	for (uint64_t run = 0; run < options->repeat; run++)
+	{
+		double start = _cd_bench_seconds();
+		CD_TableView *view = cd_prepared_select(select, NULL);
+		double run_seconds = _cd_bench_seconds() - start;
+		if (view == NULL)
+		{
+			return _cd_bench_fail("cd_prepared_select");
+		}
+		cd_table_view_destroy(view);
+
+		if (run == 0 || run_seconds < *seconds)
+		{
+			*seconds = run_seconds;
+		}
+	}
+	return 1;
+}
+
+// opens the database of a scan workload with options->rows wide rows in table "rows"
+static CD_Table *_cd_bench_scan_table_open(const _CD_BenchOptions *options, const char *workload, uint64_t storage, _CD_BenchDatabase *database)
+{
+	if (!_cd_bench_database_open(options, workload, database))
+	{
+		return NULL;
+	}
+
+	CD_Attribute attributes[CD_BENCH_ATTRIBUTE_COUNT];
+	memcpy(attributes, _cd_bench_attributes, sizeof(attributes));
+	if (!cd_table_create_ex(database->db, "rows", CD_BENCH_ATTRIBUTE_COUNT, attributes, storage))
+	{
+		_cd_bench_fail("cd_table_create_ex");
+		goto database_close;
+	}
+
+	CD_Table *table = cd_table_open(database->db, "rows");
+	if (table == NULL)
+	{
+		_cd_bench_fail("cd_table_open");
+		goto database_close;
+	}
+
+	double seconds;
+	if (!_cd_bench_table_insert(table, options->rows, CD_BENCH_BATCH_ROWS, options->seed, &seconds))
+	{
+		cd_table_close(table);
+		goto database_close;
+	}
+	return table;
+
+database_close:
+	_cd_bench_database_close(database);
+	return NULL;
+}
+
+// full scans with 0 to 3 conditions, projecting the id (narrow) or every attribute (wide)
+static uint64_t _cd_bench_scan(const _CD_BenchOptions *options, const char *workload, uint64_t storage)
+{
+	_CD_BenchDatabase database;
+	CD_Table *table = _cd_bench_scan_table_open(options, workload, storage, &database);
+	if (table == NULL)
+	{
+		return 0;
+	}
+
+	uint64_t return_value = 0;
+
+	for (uint64_t is_wide = 0; is_wide < 2; is_wide++)
+	{
+		for (uint64_t condition_count = 0; condition_count <= 3; condition_count++)
+		{
+			CD_PreparedSelect *select = cd_table_select_prepare(table, is_wide ? CD_BENCH_ATTRIBUTE_COUNT : 1, _cd_bench_attribute_names, condition_count, _cd_bench_conditions);
+			if (select == NULL)
+			{
+				_cd_bench_fail("cd_table_select_prepare");
+				goto table_close;
+			}
+
+			double seconds;
+			uint64_t is_timed = _cd_bench_select_time(options, select, &seconds);
+			cd_prepared_select_destroy(select);
+			if (!is_timed)
+			{
+				goto table_close;
+			}
+
+			char parameter[64];
+			snprintf(parameter, sizeof(parameter), "conditions=%llu;projection=%s", (unsigned long long)condition_count, is_wide ? "wide" : "narrow");
+			_cd_bench_report(options, workload, parameter, options->rows, seconds);
+		}
+	}
+
+	return_value = 1;
+
+table_close:
+	cd_table_close(table);
+	_cd_bench_database_close(&database);
+	return return_value;
+}
+
+static uint64_t _cd_bench_scan_rows(const _CD_BenchOptions *options)
+{
+	return _cd_bench_scan(options, "scan_rows", CD_STORAGE_ROWS);
+}
+
+static uint64_t _cd_bench_scan_pax(const _CD_BenchOptions *options)
+{
+	return _cd_bench_scan(options, "scan_pax", CD_STORAGE_PAX);
+}
+
+// the same one-condition scan with each kernel level the cpu supports
+static uint64_t _cd_bench_scan_kernels(const _CD_BenchOptions *options)
+{
+	static const char *level_names[] = { "scalar", "sse2", "avx2" };
+
+	_CD_BenchDatabase database;
+	CD_Table *table = _cd_bench_scan_table_open(options, "scan_kernels", CD_STORAGE_PAX, &database);
+	if (table == NULL)
+	{
+		return 0;
+	}
+
+	uint64_t return_value = 0;
+
+	CD_PreparedSelect *select = NULL;
+	for (uint64_t level = CD_KERNEL_LEVEL_SCALAR; level <= CD_KERNEL_LEVEL_AVX2; level++)
+	{
+		if (_cd_kernel_dispatch(level) != level)
+		{
+			continue;
+		}
+
+		// kernels are picked when preparing
+		select = cd_table_select_prepare(table, 1, _cd_bench_attribute_names, 1, _cd_bench_conditions);
+		if (select == NULL)
+		{
+			_cd_bench_fail("cd_table_select_prepare");
+			goto kernels_reset;
+		}
+
+		double seconds;
+		uint64_t is_timed = _cd_bench_select_time(options, select, &seconds);
+		cd_prepared_select_destroy(select);
+		if (!is_timed)
+		{
+			goto kernels_reset;
+		}
+
+		char parameter[64];
+		snprintf(parameter, sizeof(parameter), "kernel=%s", level_names[level]);
+		_cd_bench_report(options, "scan_kernels", parameter, options->rows, seconds);
+	}
+
+	return_value = 1;
+
+kernels_reset:
+	_cd_kernel_dispatch(CD_KERNEL_LEVEL_AVX2);
+	cd_table_close(table);
+	_cd_bench_database_close(&database);
+	return return_value;
+}
+
+// the same one-condition scan split over 1, 2, 4 ... threads up to the cpu count
+static uint64_t _cd_bench_scan_threads(const _CD_BenchOptions *options)
+{
+	_CD_BenchDatabase database;
+	CD_Table *table = _cd_bench_scan_table_open(options, "scan_threads", CD_STORAGE_ROWS, &database);
+	if (table == NULL)
+	{
+		return 0;
+	}
+
+	uint64_t return_value = 0;
+
+	CD_PreparedSelect *select = cd_table_select_prepare(table, 1, _cd_bench_attribute_names, 1, _cd_bench_conditions);
+	if (select == NULL)
+	{
+		_cd_bench_fail("cd_table_select_prepare");
+		goto table_close;
+	}
+
+	uint64_t cpu_count = _cd_cpu_count();
+	for (uint64_t thread_count = 1;; thread_count *= 2)
+	{
+		if (thread_count > cpu_count)
+		{
+			thread_count = cpu_count;
+		}
+		cd_prepared_select_thread_count_set(select, thread_count);
+
+		double seconds;
+		if (!_cd_bench_select_time(options, select, &seconds))
+		{
+			goto select_destroy;
+		}
+
+		char parameter[64];
+		snprintf(parameter, sizeof(parameter), "threads=%llu", (unsigned long long)thread_count);
+		_cd_bench_report(options, "scan_threads", parameter, options->rows, seconds);
+
+		if (thread_count == cpu_count)
+		{
+			break;
+		}
+	}
+
+	return_value = 1;
+
+select_destroy:
+	cd_prepared_select_destroy(select);
+table_close:
+	cd_table_close(table);
+	_cd_bench_database_close(&database);
+	return return_value;
+}
+
+typedef struct _CD_BenchReader
+{
+	CD_PreparedSelect *select;
+	uint64_t select_count;
+	uint64_t rows; // rows returned by the selects
+	uint64_t is_failed;
+	volatile uint64_t *done_count;
+} _CD_BenchReader;
+
+static void _cd_bench_reader_run(void *argument)
+{
+	_CD_BenchReader *reader = argument;
+
+	for (uint64_t i = 0; i < reader->select_count; i++)
+	{
+		CD_TableView *view = cd_prepared_select(reader->select, NULL);
+		if (view == NULL)
+		{
+			reader->is_failed = 1;
+			break;
+		}
+		reader->rows += view->count_c;
+		cd_table_view_destroy(view);
+	}
+
+	_cd_atomic_fetch_add(reader->done_count, 1);
+}
+
+// 1, 2, 4 ... readers scanning the whole table while one writer appends batches to it
+static uint64_t _cd_bench_readers(const _CD_BenchOptions *options)
+{
+	_CD_BenchDatabase database;
+	CD_Table *table = _cd_bench_scan_table_open(options, "readers", CD_STORAGE_ROWS, &database);
+	if (table == NULL)
+	{
+		return 0;
+	}
+
+	uint64_t return_value = 0;
+
+	uint64_t cpu_count = _cd_cpu_count();
+	uint64_t reader_count_max = cpu_count > 1 ? cpu_count - 1 : 1; // one cpu is left to the writer
+	_CD_BenchReader *readers = malloc(sizeof(*readers) * reader_count_max);
+	CD_Thread **threads = malloc(sizeof(*threads) * reader_count_max);
+	uint8_t *rows = malloc(CD_BENCH_BATCH_ROWS * CD_BENCH_STRIDE);
+	uint64_t state = options->seed ^ 0x9E3779B97F4A7C15ULL;
+
+	CD_PreparedInsert *insert = cd_table_insert_prepare(table, CD_BENCH_ATTRIBUTE_COUNT, _cd_bench_attribute_names);
+	if (insert == NULL)
+	{
+		_cd_bench_fail("cd_table_insert_prepare");
+		goto buffers_free;
+	}
+
+	for (uint64_t reader_count = 1;; reader_count *= 2)
+	{
+		if (reader_count > reader_count_max)
+		{
+			reader_count = reader_count_max;
+		}
+
+		volatile uint64_t done_count = 0;
+		uint64_t prepared_count = 0;
+		uint64_t started_count = 0;
+		uint64_t is_failed = 0;
+
+		for (; prepared_count < reader_count; prepared_count++)
+		{
+			_CD_BenchReader *reader = readers + prepared_count;
+			*reader = (_CD_BenchReader){ .select_count = options->repeat, .done_count = &done_count };
+			reader->select = cd_table_select_prepare(table, 1, _cd_bench_attribute_names, 0, NULL);
+			if (reader->select == NULL)
+			{
+				_cd_bench_fail("cd_table_select_prepare");
+				is_failed = 1;
+				break;
+			}
+		}
+
+		double start = _cd_bench_seconds();
+		for (; !is_failed && started_count < reader_count; started_count++)
+		{
+			threads[started_count] = _cd_thread_start(_cd_bench_reader_run, readers + started_count);
+			if (threads[started_count] == NULL)
+			{
+				fprintf(stderr, "c_db_bench: failed to start a reader thread\n");
+				is_failed = 1;
+				break;
+			}
+		}
+
+		// the writer appends until every reader is done
+		uint64_t inserted = 0;
+		while (_cd_atomic_load_acquire(&done_count) < started_count)
+		{
+			if (is_failed)
+			{
+				continue;
+			}
+			_cd_bench_rows_fill(rows, CD_BENCH_BATCH_ROWS, cd_table_count(table), &state);
+			if (!cd_prepared_insert(insert, CD_BENCH_BATCH_ROWS, rows))
+			{
+				_cd_bench_fail("cd_prepared_insert");
+				is_failed = 1;
+				continue;
+			}
+			inserted += CD_BENCH_BATCH_ROWS;
+		}
+
+		uint64_t rows_read = 0;
+		for (uint64_t i = 0; i < started_count; i++)
+		{
+			_cd_thread_join(threads[i]);
+			rows_read += readers[i].rows;
+			is_failed |= readers[i].is_failed;
+		}
+		for (uint64_t i = 0; i < prepared_count; i++)
+		{
+			cd_prepared_select_destroy(readers[i].select);
+		}
+		double seconds = _cd_bench_seconds() - start;
+
+		if (is_failed)
+		{
+			goto insert_destroy;
+		}
+
+		char parameter[64];
+		snprintf(parameter, sizeof(parameter), "readers=%llu", (unsigned long long)reader_count);
+		_cd_bench_report(options, "readers_select", parameter, rows_read, seconds);
+		_cd_bench_report(options, "readers_insert", parameter, inserted, seconds);
+
+		if (reader_count == reader_count_max)
+		{
+			break;
+		}
+	}
+
+	return_value = 1;
+
+insert_destroy:
+	cd_prepared_insert_destroy(insert);
+buffers_free:
+	free(rows);
+	free(threads);
+	free(readers);
+	cd_table_close(table);
+	_cd_bench_database_close(&database);
+	return return_value;
+}
+
+// rows of the stress workload: every value is derived from id, so a torn row does not match it
+#define CD_BENCH_STRESS_NAME_COUNT 16
+#define CD_BENCH_STRESS_STRIDE (2 * sizeof(CD_uint_t) + CD_BENCH_STRESS_NAME_COUNT)
+// rows added by one growth of the stress table, small so the writer remaps while readers scan
+#define CD_BENCH_STRESS_GROWTH_STEP 4096
+
+static CD_Attribute _cd_bench_stress_attributes[] =
+{
+	{ .name = "id", .type = CD_TYPE_UINT, .count = 1, .constraints = CD_CONSTRAINT_NONE, .encoding = CD_ENCODING_NONE },
+	{ .name = "check", .type = CD_TYPE_UINT, .count = 1, .constraints = CD_CONSTRAINT_NONE, .encoding = CD_ENCODING_NONE },
+	{ .name = "name", .type = CD_TYPE_CHAR, .count = CD_BENCH_STRESS_NAME_COUNT, .constraints = CD_CONSTRAINT_NONE, .encoding = CD_ENCODING_NONE }
+};
+static const char *_cd_bench_stress_attribute_names[] = { "id", "check", "name" };
+
+static void _cd_bench_stress_row(uint8_t *row, CD_uint_t id)
+{
+	CD_uint_t check = id * 0x9E3779B97F4A7C15ULL ^ 0xA5A5A5A5A5A5A5A5ULL;
+	char name[32];
+	snprintf(name, sizeof(name), "row%013llu", (unsigned long long)id);
+
+	memcpy(row, &id, sizeof(id));
+	memcpy(row + sizeof(id), &check, sizeof(check));
+	memcpy(row + 2 * sizeof(id), name, CD_BENCH_STRESS_NAME_COUNT);
+}
+
+// makes an error naming owner the last error of the calling thread
+static void _cd_bench_stress_error_make(CD_Database *db, const char *owner)
+{
+	char table_name[64];
+	snprintf(table_name, sizeof(table_name), "stress_missing_%s", owner);
+	CD_Table *table = cd_table_open(db, table_name);
+	if (table != NULL)
+	{
+		cd_table_close(table);
+	}
+}
+
+// 1 if the last error of the calling thread is still the one _cd_bench_stress_error_make made for owner
+static uint64_t _cd_bench_stress_error_is_own(const char *owner)
+{
+	char table_name[64];
+	snprintf(table_name, sizeof(table_name), "'stress_missing_%s'", owner);
+	CD_Error error = cd_get_last_error();
+	return error.error_type == CD_ERROR_TABLE_DOES_NOT_EXIST && strstr(error.message.data, table_name) != NULL;
+}
+
+typedef struct _CD_BenchStressReader
+{
+	CD_Database *db;
+	CD_PreparedSelect *select;
+	char owner[32];
+	uint64_t row_count; // rows the writer appends in total
+	volatile uint64_t *published; // rows whose insert returned
+	volatile uint64_t *is_writer_done;
+	uint64_t select_count;
+	uint64_t rows; // rows returned by the selects
+	char failure[256]; // empty unless a check failed
+} _CD_BenchStressReader;
+
+static void _cd_bench_stress_reader_run(void *argument)
+{
+	_CD_BenchStressReader *reader = argument;
+	_cd_bench_stress_error_make(reader->db, reader->owner);
+
+	uint8_t expected[CD_BENCH_STRESS_STRIDE];
+	uint64_t count_last = 0;
+	for (uint64_t is_last = 0; !is_last;)
+	{
+		// the select after the writer is done must see every row
+		is_last = _cd_atomic_load_acquire(reader->is_writer_done);
+		uint64_t published = _cd_atomic_load_acquire(reader->published);
+
+		CD_TableView *view = cd_prepared_select(reader->select, NULL);
+		if (view == NULL)
+		{
+			snprintf(reader->failure, sizeof(reader->failure), "select failed: %s", cd_get_last_error().message.data);
+			return;
+		}
+
+		// the rows seen are a prefix of the appended ones that never shrinks
+		uint64_t count = view->count_c;
+		if (count < published || count < count_last || count > reader->row_count || (is_last && count != reader->row_count))
+		{
+			snprintf(reader->failure, sizeof(reader->failure), "saw %llu rows after %llu were published and %llu were seen", (unsigned long long)count, (unsigned long long)published, (unsigned long long)count_last);
+			cd_table_view_destroy(view);
+			return;
+		}
+		for (uint64_t row = 0; row < count; row++)
+		{
+			_cd_bench_stress_row(expected, row);
+			if (memcmp((const uint8_t *)view->data + row * CD_BENCH_STRESS_STRIDE, expected, CD_BENCH_STRESS_STRIDE) != 0)
+			{
+				snprintf(reader->failure, sizeof(reader->failure), "row %llu of %llu is torn", (unsigned long long)row, (unsigned long long)count);
+				cd_table_view_destroy(view);
+				return;
+			}
+		}
+		cd_table_view_destroy(view);
+
+		// errors of the writer and the other readers never replace the own one
+		if (!_cd_bench_stress_error_is_own(reader->owner))
+		{
+			snprintf(reader->failure, sizeof(reader->failure), "last error is '%s'", cd_get_last_error().message.data);
+			return;
+		}
+
+		count_last = count;
+		reader->rows += count;
+		reader->select_count++;
+	}
+}
+
+// readers checking every row of the table while one writer appends options->rows rows and grows it in small steps
+static uint64_t _cd_bench_stress(const _CD_BenchOptions *options)
+{
+	_CD_BenchDatabase database;
+	if (!_cd_bench_database_open(options, "stress", &database))
+	{
+		return 0;
+	}
+
+	uint64_t return_value = 0;
+
+	if (!cd_table_create(database.db, "stress", 3, _cd_bench_stress_attributes))
+	{
+		_cd_bench_fail("cd_table_create");
+		goto database_close;
+	}
+	CD_Table *table = cd_table_open(database.db, "stress");
+	if (table == NULL)
+	{
+		_cd_bench_fail("cd_table_open");
+		goto database_close;
+	}
+	cd_table_growth_policy_set(table, (CD_GrowthPolicy){ .factor = 2.0, .max_step = CD_BENCH_STRESS_GROWTH_STEP, .preallocate = 1 });
+
+	CD_PreparedInsert *insert = cd_table_insert_prepare(table, 3, _cd_bench_stress_attribute_names);
+	if (insert == NULL)
+	{
+		_cd_bench_fail("cd_table_insert_prepare");
+		goto table_close;
+	}
+
+	// the readers share the cpus with the writer, there are always two to race each other
+	uint64_t cpu_count = _cd_cpu_count();
+	uint64_t reader_count = cpu_count > 3 ? cpu_count - 1 : 2;
+	_CD_BenchStressReader *readers = calloc(reader_count, sizeof(*readers));
+	CD_Thread **threads = malloc(sizeof(*threads) * reader_count);
+	uint8_t *rows = malloc(CD_BENCH_BATCH_ROWS * CD_BENCH_STRESS_STRIDE);
+	uint64_t state = options->seed;
+
+	volatile uint64_t published = 0;
+	volatile uint64_t is_writer_done = 0;
+	uint64_t prepared_count = 0;
+	uint64_t started_count = 0;
+	uint64_t is_failed = 0;
+
+	for (; prepared_count < reader_count; prepared_count++)
+	{
+		_CD_BenchStressReader *reader = readers + prepared_count;
+		reader->db = database.db;
+		snprintf(reader->owner, sizeof(reader->owner), "reader%llu", (unsigned long long)prepared_count);
+		reader->row_count = options->rows;
+		reader->published = &published;
+		reader->is_writer_done = &is_writer_done;
+		reader->select = cd_table_select_prepare(table, 3, _cd_bench_stress_attribute_names, 0, NULL);
+		if (reader->select == NULL)
+		{
+			_cd_bench_fail("cd_table_select_prepare");
+			is_failed = 1;
+			break;
+		}
+	}
+
+	double start = _cd_bench_seconds();
+	for (; !is_failed && started_count < reader_count; started_count++)
+	{
+		threads[started_count] = _cd_thread_start(_cd_bench_stress_reader_run, readers + started_count);
+		if (threads[started_count] == NULL)
+		{
+			fprintf(stderr, "c_db_bench: failed to start a reader thread\n");
+			is_failed = 1;
+			break;
+		}
+	}
+
+	// batches of random size, the writer makes an error of its own before each
+	for (uint64_t inserted = 0; !is_failed && inserted < options->rows;)
+	{
+		uint64_t batch_count = 1 + _cd_bench_random(&state) % CD_BENCH_BATCH_ROWS;
+		if (batch_count > options->rows - inserted)
+		{
+			batch_count = options->rows - inserted;
+		}
+		for (uint64_t i = 0; i < batch_count; i++)
+		{
+			_cd_bench_stress_row(rows + i * CD_BENCH_STRESS_STRIDE, inserted + i);
+		}
+
+		_cd_bench_stress_error_make(database.db, "writer");
+		if (!cd_prepared_insert(insert, batch_count, rows))
+		{
+			_cd_bench_fail("cd_prepared_insert");
+			is_failed = 1;
+			break;
+		}
+		if (!_cd_bench_stress_error_is_own("writer"))
+		{
+			fprintf(stderr, "c_db_bench: stress writer: last error is '%s'\n", cd_get_last_error().message.data);
+			is_failed = 1;
+			break;
+		}
+
+		inserted += batch_count;
+		_cd_atomic_store_release(&published, inserted);
+	}
+	_cd_atomic_store_release(&is_writer_done, 1);
+
+	uint64_t rows_read = 0;
+	uint64_t select_count = 0;
+	for (uint64_t i = 0; i < started_count; i++)
+	{
+		_cd_thread_join(threads[i]);
+		if (readers[i].failure[0] != '\0')
+		{
+			fprintf(stderr, "c_db_bench: stress %s: %s\n", readers[i].owner, readers[i].failure);
+			is_failed = 1;
+		}
+		rows_read += readers[i].rows;
+		select_count += readers[i].select_count;
+	}
+	for (uint64_t i = 0; i < prepared_count; i++)
+	{
+		cd_prepared_select_destroy(readers[i].select);
+	}
+	double seconds = _cd_bench_seconds() - start;
+
+	if (is_failed)
+	{
+		goto buffers_free;
+	}
+
+	char parameter[64];
+	snprintf(parameter, sizeof(parameter), "readers=%llu;selects=%llu", (unsigned long long)reader_count, (unsigned long long)select_count);
+	_cd_bench_report(options, "stress", parameter, rows_read, seconds);
+
+	return_value = 1;
+
+buffers_free:
+	free(rows);
+	free(threads);
+	free(readers);
+	cd_prepared_insert_destroy(insert);
+table_close:
+	cd_table_close(table);
+database_close:
+	_cd_bench_database_close(&database);
+	return return_value;
+}
+
+// cd_database_open of databases holding 10, 1000, 100000 ... tables up to options->table_count, and the first
+// cd_table_open after it, which materializes the schema of the table; rows are tables
+static uint64_t _cd_bench_open(const _CD_BenchOptions *options)
+{
+	_CD_BenchDatabase database;
+	if (!_cd_bench_database_open(options, "open", &database))
+	{
+		return 0;
+	}
+
+	uint64_t return_value = 0;
+
+	CD_Attribute attributes[CD_BENCH_ATTRIBUTE_COUNT];
+	memcpy(attributes, _cd_bench_attributes, sizeof(attributes));
+
+	// the tables of a step are added to the ones of the step before
+	uint64_t created = 0;
+	for (uint64_t table_count = 10; table_count <= options->table_count; table_count *= 100)
+	{
+		for (; created < table_count; created++)
+		{
+			char table_name[32];
+			snprintf(table_name, sizeof(table_name), "table%llu", (unsigned long long)created);
+			if (!cd_table_create(database.db, table_name, CD_BENCH_ATTRIBUTE_COUNT, attributes))
+			{
+				_cd_bench_fail("cd_table_create");
+				goto database_close;
+			}
+		}
+		cd_database_close(database.db);
+
+		double seconds = 0;
+		double table_seconds = 0;
+		for (uint64_t run = 0; run < options->repeat; run++)
+		{
+			double start = _cd_bench_seconds();
+			database.db = cd_database_open(database.path);
+			double run_seconds = _cd_bench_seconds() - start;
+			if (database.db == NULL)
+			{
+				_cd_bench_fail("cd_database_open");
+				_cd_bench_directory_remove(database.path);
+				return 0;
+			}
+
+			start = _cd_bench_seconds();
+			CD_Table *table = cd_table_open(database.db, "table0");
+			double run_table_seconds = _cd_bench_seconds() - start;
+			if (table == NULL)
+			{
+				_cd_bench_fail("cd_table_open");
+				goto database_close;
+			}
+			cd_table_close(table);
+
+			if (run + 1 != options->repeat)
+			{
+				cd_database_close(database.db);
+			}
+
+			if (run == 0 || run_seconds < seconds)
+			{
+				seconds = run_seconds;
+			}
+			if (run == 0 || run_table_seconds < table_seconds)
+			{
+				table_seconds = run_table_seconds;
+			}
+		}
+
+		char parameter[64];
+		snprintf(parameter, sizeof(parameter), "tables=%llu", (unsigned long long)table_count);
+		_cd_bench_report(options, "open", parameter, table_count, seconds);
+		_cd_bench_report(options, "open_first_table", parameter, 1, table_seconds);
+	}
+
+	return_value = 1;
+
+database_close:
+	_cd_bench_database_close(&database);
+	return return_value;
+}
+
+// appends options->growth_rows narrow rows through the growth policy, timing each doubling of the row count
+static uint64_t _cd_bench_growth_run(const _CD_BenchOptions *options, CD_Database *db, const char *table_name, CD_GrowthPolicy policy, const char *policy_name)
+{
+	uint64_t return_value = 0;
+
+	CD_Attribute attributes[] =
+	{
+		{ .name = "id", .type = CD_TYPE_UINT, .count = 1, .constraints = CD_CONSTRAINT_NONE, .encoding = CD_ENCODING_NONE },
+		{ .name = "a", .type = CD_TYPE_UINT, .count = 1, .constraints = CD_CONSTRAINT_NONE, .encoding = CD_ENCODING_NONE }
+	};
+	if (!cd_table_create(db, table_name, 2, attributes))
+	{
+		return _cd_bench_fail("cd_table_create");
+	}
+
+	CD_Table *table = cd_table_open(db, table_name);
+	if (table == NULL)
+	{
+		return _cd_bench_fail("cd_table_open");
+	}
+	cd_table_growth_policy_set(table, policy);
+
+	const char *names[] = { "id", "a" };
+	CD_PreparedInsert *insert = cd_table_insert_prepare(table, 2, names);
+	if (insert == NULL)
+	{
+		_cd_bench_fail("cd_table_insert_prepare");
+		goto table_close;
+	}
+
+	uint64_t batch_rows = CD_BENCH_BATCH_ROWS * 4;
+	CD_uint_t *rows = malloc(sizeof(*rows) * 2 * batch_rows);
+	uint64_t state = options->seed;
+
+	double seconds = 0;
+	uint64_t step_rows = 0;
+	double step_seconds = 0;
+	uint64_t step_end = 1 << 16;
+	for (uint64_t inserted = 0; inserted < options->growth_rows;)
+	{
+		uint64_t batch_count = options->growth_rows - inserted < batch_rows ? options->growth_rows - inserted : batch_rows;
+		for (uint64_t i = 0; i < batch_count; i++)
+		{
+			rows[i * 2] = inserted + i;
+			rows[i * 2 + 1] = _cd_bench_random(&state);
+		}
+
+		double start = _cd_bench_seconds();
+		if (!cd_prepared_insert(insert, batch_count, rows))
+		{
+			_cd_bench_fail("cd_prepared_insert");
+			goto rows_free;
+		}
+		double batch_seconds = _cd_bench_seconds() - start;
+
+		inserted += batch_count;
+		seconds += batch_seconds;
+		step_rows += batch_count;
+		step_seconds += batch_seconds;
+
+		// the cost of a row should stay flat as the table grows
+		if (inserted >= step_end || inserted == options->growth_rows)
+		{
+			char parameter[64];
+			snprintf(parameter, sizeof(parameter), "policy=%s;table_rows=%llu", policy_name, (unsigned long long)inserted);
+			_cd_bench_report(options, "growth_step", parameter, step_rows, step_seconds);
+			step_rows = 0;
+			step_seconds = 0;
+			step_end *= 2;
+		}
+	}
+
+	char parameter[64];
+	snprintf(parameter, sizeof(parameter), "policy=%s;capacity=%llu", policy_name, (unsigned long long)cd_table_capacity(table));
+	_cd_bench_report(options, "growth", parameter, options->growth_rows, seconds);
+
+	return_value = 1;
+
+rows_free:
+	free(rows);
+	cd_prepared_insert_destroy(insert);
+table_close:
+	cd_table_close(table);
+	return return_value;
+}
+
+static uint64_t _cd_bench_growth(const _CD_BenchOptions *options)
+{
+	_CD_BenchDatabase database;
+	if (!_cd_bench_database_open(options, "growth", &database))
+	{
+		return 0;
+	}
+
+	uint64_t return_value = 0;
+
+	CD_GrowthPolicy policy = { .factor = 2.0, .max_step = 0, .preallocate = 0 };
+	if (!_cd_bench_growth_run(options, database.db, "default", policy, "double"))
+	{
+		goto database_close;
+	}
+
+	policy.preallocate = 1;
+	if (!_cd_bench_growth_run(options, database.db, "preallocated", policy, "double_preallocate"))
+	{
+		goto database_close;
+	}
+
+	return_value = 1;
+
+database_close:
+	_cd_bench_database_close(&database);
+	return return_value;
+}
+
+static const _CD_BenchWorkload _cd_bench_workloads[] =
+{
+	{ "insert_single", _cd_bench_insert_single },
+	{ "insert_batched", _cd_bench_insert_batched },
+	{ "insert_unique_single", _cd_bench_insert_unique_single },
+	{ "insert_unique_batched", _cd_bench_insert_unique_batched },
+	{ "scan_rows", _cd_bench_scan_rows },
+	{ "scan_pax", _cd_bench_scan_pax },
+	{ "scan_kernels", _cd_bench_scan_kernels },
+	{ "scan_threads", _cd_bench_scan_threads },
+	{ "readers", _cd_bench_readers },
+	{ "stress", _cd_bench_stress },
+	{ "open", _cd_bench_open },
+	{ "growth", _cd_bench_growth }
+};
+
+static void _cd_bench_usage()
+{
+	fprintf(stderr,
+		"usage: c_db_bench [options]\n"
+		"  --rows N          rows of the batched inserts, the scanned tables and the stress table (default 1000000)\n"
+		"  --single-rows N   rows inserted one at a time (default 100000)\n"
+		"  --growth-rows N   rows appended by the growth workload (default 4000000)\n"
+		"  --tables N        most tables opened by the open workload, it opens 10, 1000, ... up to N (default 100000)\n"
+		"  --repeat N        runs of the read workloads, the fastest is reported (default 3)\n"
+		"  --seed N          seed of the generated rows (default 1)\n"
+		"  --durability D    none, batched or commit (default batched)\n"
+		"  --format F        json or csv (default json)\n"
+		"  --filter S        only runs the workloads whose name contains S\n"
+		"  --db PREFIX       databases are created as PREFIX_<workload> (default cd_bench)\n"
+		"workloads:");
+	for (uint64_t i = 0; i < sizeof(_cd_bench_workloads) / sizeof(_cd_bench_workloads[0]); i++)
+	{
+		fprintf(stderr, " %s", _cd_bench_workloads[i].name);
+	}
+	fprintf(stderr, "\n");
+}
+
+static uint64_t _cd_bench_options_parse(int argc, char *argv[], _CD_BenchOptions *options)
+{
+	*options = (_CD_BenchOptions){
+		.rows = 1000000,
+		.single_rows = 100000,
+		.growth_rows = 4000000,
+		.table_count = 100000,
+		.repeat = 3,
+		.seed = 1,
+		.durability = CD_DURABILITY_BATCHED,
+		.format = CD_BENCH_FORMAT_JSON,
+		.db_prefix = "cd_bench",
+		.filter = NULL
+	};
+
+	for (int i = 1; i < argc; i++)
+	{
+		const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+		uint64_t *number = NULL;
+
+		if (strcmp(argv[i], "--rows") == 0) number = &options->rows;
+		else if (strcmp(argv[i], "--single-rows") == 0) number = &options->single_rows;
+		else if (strcmp(argv[i], "--growth-rows") == 0) number = &options->growth_rows;
+		else if (strcmp(argv[i], "--tables") == 0) number = &options->table_count;
+		else if (strcmp(argv[i], "--repeat") == 0) number = &options->repeat;
+		else if (strcmp(argv[i], "--seed") == 0) number = &options->seed;
+		else if (value != NULL && strcmp(argv[i], "--durability") == 0)
+		{
+			if (strcmp(value, "none") == 0) options->durability = CD_DURABILITY_NONE;
+			else if (strcmp(value, "batched") == 0) options->durability = CD_DURABILITY_BATCHED;
+			else if (strcmp(value, "commit") == 0) options->durability = CD_DURABILITY_COMMIT;
+			else return 0;
+		}
+		else if (value != NULL && strcmp(argv[i], "--format") == 0)
+		{
+			if (strcmp(value, "json") == 0) options->format = CD_BENCH_FORMAT_JSON;
+			else if (strcmp(value, "csv") == 0) options->format = CD_BENCH_FORMAT_CSV;
+			else return 0;
+		}
+		else if (value != NULL && strcmp(argv[i], "--filter") == 0) options->filter = value;
+		else if (value != NULL && strcmp(argv[i], "--db") == 0) options->db_prefix = value;
+		else return 0;
+
+		if (number != NULL)
+		{
+			char *end;
+			if (value == NULL || (*number = strtoull(value, &end, 10), *end != '\0'))
+			{
+				return 0;
+			}
+		}
+		i++;
+	}
+
+	// xorshift never leaves 0
+	if (options->seed == 0)
+	{
+		options->seed = 1;
+	}
+	if (options->repeat == 0)
+	{
+		options->repeat = 1;
+	}
+	return 1;
+}
+
+int main(int argc, char *argv[])
+{
+	_CD_BenchOptions options;
+	if (!_cd_bench_options_parse(argc, argv, &options))
+	{
+		_cd_bench_usage();
+		return 2;
+	}
+
+	if (options.format == CD_BENCH_FORMAT_CSV)
+	{
+		printf("name,parameter,rows,seconds,rows_per_sec,ns_per_row,peak_rss_kb\n");
+	}
+	else
+	{
+		printf("{ \"seed\": %llu, \"durability\": %llu, \"results\": [\n", (unsigned long long)options.seed, (unsigned long long)options.durability);
+	}
+
+	int exit_code = 0;
+	for (uint64_t i = 0; i < sizeof(_cd_bench_workloads) / sizeof(_cd_bench_workloads[0]); i++)
+	{
+		const _CD_BenchWorkload *workload = _cd_bench_workloads + i;
+		if (options.filter != NULL && strstr(workload->name, options.filter) == NULL)
+		{
+			continue;
+		}
+		if (!workload->function(&options))
+		{
+			exit_code = 1;
+			break;
+		}
+	}
+
+	if (options.format == CD_BENCH_FORMAT_JSON)
+	{
+		printf("\n] }\n");
+	}
+	return exit_code;
+}
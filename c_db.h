@@ -38,12 +38,20 @@ uint64_t cd_attribute_size(CD_AttributeType type, uint64_t count);
 
 #define CD_NAME_LENGTH 256
 
+typedef enum CD_AttributeEncoding
+{
+	CD_ENCODING_NONE = 0, // values are stored in the rows
+	CD_ENCODING_DICTIONARY, // CHAR/WCHAR/VARCHAR/WVARCHAR only: every distinct value is stored once in a dictionary next to the table, rows hold its 8 byte code
+	CD_ENCODING_HEAP // VARCHAR/WVARCHAR only: rows hold 16 bytes, values up to 15 bytes long in place and longer ones appended to a heap file next to the table
+} CD_AttributeEncoding;
+
 typedef struct CD_Attribute
 {
 	const char *name;
 	uint64_t type;
 	uint64_t count;
 	uint64_t constraints;
+	uint64_t encoding; // one of CD_AttributeEncoding, can not be changed later
 } CD_Attribute;
 
 typedef struct CD_AttributeEx
@@ -54,6 +62,7 @@ typedef struct CD_AttributeEx
 	uint64_t constraints;
 	uint64_t offset;
 	uint64_t size;
+	uint64_t encoding;
 } CD_AttributeEx;
 
 uint64_t cd_database_create(const char *name);
@@ -64,11 +73,53 @@ typedef struct CD_Database CD_Database;
 CD_Database *cd_database_open(const char *name);
 void cd_database_close(CD_Database *db);
 
+// threads used by every scan of the database; 0 uses one thread per cpu. the default is 1
+void cd_database_thread_count_set(CD_Database *db, uint64_t thread_count);
+uint64_t cd_database_thread_count_get(CD_Database *db);
+
+// tables the database keeps open; cd_table_close leaves a handle open and the least recently closed ones are closed
+// once more tables are open. 0 closes a handle with its last cd_table_close. the default is 64. handles still open are
+// closed by cd_database_close
+void cd_database_table_cache_size_set(CD_Database *db, uint64_t table_count);
+uint64_t cd_database_table_cache_size_get(CD_Database *db);
+
+typedef enum CD_Durability
+{
+	CD_DURABILITY_NONE = 0, // inserts are not logged, a crash can lose or tear the last inserts
+	CD_DURABILITY_BATCHED, // the log is synced once a batch of inserts is logged, a crash loses at most the last batch
+	CD_DURABILITY_COMMIT // an insert returns once it is synced; inserts of several threads share one sync
+} CD_Durability;
+
+// inserts are logged to a write-ahead log next to the schema before they are written, cd_database_open replays it after
+// a crash. durability is one of CD_Durability, the default is CD_DURABILITY_BATCHED
+uint64_t cd_database_durability_set(CD_Database *db, uint64_t durability);
+uint64_t cd_database_durability_get(CD_Database *db);
+// syncs every insert logged so far
+uint64_t cd_database_sync(CD_Database *db);
+// syncs the tables written by the logged inserts and empties the log; also done when the log grows large, before a
+// delete, update or vacuum and on close
+uint64_t cd_database_checkpoint(CD_Database *db);
+
+typedef enum CD_TableStorage
+{
+	CD_STORAGE_ROWS = 0, // rows are stored back to back
+	CD_STORAGE_PAX // rows are grouped in pages that keep the values of each attribute together; scans only read the attributes they use
+} CD_TableStorage;
+
 uint64_t cd_table_exists(CD_Database *db, const char *table_name);
 uint64_t cd_table_create(CD_Database *db, const char *table_name, uint64_t attribute_count, CD_Attribute attributes[]);
+// storage is one of CD_TableStorage and can not be changed later
+uint64_t cd_table_create_ex(CD_Database *db, const char *table_name, uint64_t attribute_count, CD_Attribute attributes[], uint64_t storage);
 
 typedef struct CD_Table CD_Table;
 
+// a handle can be shared by threads: any number of them select from it, each with its own prepared select or cursor,
+// while one thread at a time inserts, deletes, updates, vacuums or resizes. a select sees the rows counted when it
+// starts and none appended meanwhile; a writer waits for running selects only to grow the file or to change indices,
+// deleted rows or the count. a cursor fails once a delete, update, vacuum or an insert into deleted rows runs while it
+// is open, rows appended meanwhile do not stop it. a table is opened once per database: opening it again returns the
+// same handle, every cd_table_open needs its cd_table_close. closed handles stay open in the database, see
+// cd_database_table_cache_size_set
 CD_Table *cd_table_open(CD_Database *db, const char *table_name);
 void cd_table_close(CD_Table *table);
 
@@ -76,8 +127,35 @@ const CD_AttributeEx *cd_table_attribute_by_name(CD_Table *table, const char *at
 const CD_AttributeEx *cd_table_attribute_by_index(CD_Table *table, uint64_t index);
 uint64_t cd_table_stride(CD_Table *table);
 uint64_t cd_table_count(CD_Table *table);
+uint64_t cd_table_storage(CD_Table *table);
+
+// controls how the table file grows when an insert runs out of space
+typedef struct CD_GrowthPolicy
+{
+	double factor; // the row capacity is multiplied by factor (>= 1)
+	uint64_t max_step; // upper limit of rows added by one growth; 0 for no limit
+	uint64_t preallocate; // write the new space once when growing so later inserts do not fault into file holes
+} CD_GrowthPolicy;
+
+void cd_table_growth_policy_set(CD_Table *table, CD_GrowthPolicy policy);
+CD_GrowthPolicy cd_table_growth_policy_get(CD_Table *table);
+
+uint64_t cd_table_capacity(CD_Table *table);
+// grows the table so it can hold row_count rows without resizing again
+uint64_t cd_table_reserve(CD_Table *table, uint64_t row_count);
+// shrinks the table file to the rows in use
+uint64_t cd_table_trim(CD_Table *table);
 
 uint64_t cd_table_insert(CD_Table *table, uint64_t attribute_count, const char *attribute_names[], const void *data);
+// data holds row_count rows packed back to back; either all rows are inserted or none
+uint64_t cd_table_insert_many(CD_Table *table, uint64_t attribute_count, const char *attribute_names[], uint64_t row_count, const void *data);
+
+// attribute names are resolved once; the handle must be destroyed before the table is closed
+typedef struct CD_PreparedInsert CD_PreparedInsert;
+
+CD_PreparedInsert *cd_table_insert_prepare(CD_Table *table, uint64_t attribute_count, const char *attribute_names[]);
+void cd_prepared_insert_destroy(CD_PreparedInsert *insert);
+uint64_t cd_prepared_insert(CD_PreparedInsert *insert, uint64_t row_count, const void *data);
 
 typedef struct CD_TableView
 {
@@ -121,6 +199,144 @@ typedef struct CD_Condition
 
 CD_TableView *cd_table_select(CD_Table *table, uint64_t attribute_count, const char *attribute_names[], uint64_t condition_count, CD_Condition *conditions);
 
+// what one select did; the counters of the threads of the scan are summed
+typedef struct CD_QueryTrace
+{
+	uint64_t rows_scanned; // rows of the chunks that were read and filtered
+	uint64_t rows_matched; // rows that passed every condition
+	uint64_t bytes_read; // bytes read from the table file
+	uint64_t rows_skipped; // rows of the chunks the zone maps ruled out without reading them
+	uint64_t index_candidates; // rows the indices narrowed the scan to, 0 when no index was used
+	uint64_t thread_count;
+	uint64_t filter_ns; // reading and filtering chunks, summed over the threads
+	uint64_t materialize_ns; // copying out, aggregating or grouping the matched rows, summed over the threads
+	uint64_t total_ns; // wall time of the select
+} CD_QueryTrace;
+
+// like cd_table_select; fills trace when it is not NULL
+CD_TableView *cd_table_select_ex(CD_Table *table, uint64_t attribute_count, const char *attribute_names[], uint64_t condition_count, CD_Condition *conditions, CD_QueryTrace *trace);
+
+// attribute names and operators are resolved once; the handle must be destroyed before the table is closed
+typedef struct CD_PreparedSelect CD_PreparedSelect;
+
+CD_PreparedSelect *cd_table_select_prepare(CD_Table *table, uint64_t attribute_count, const char *attribute_names[], uint64_t condition_count, CD_Condition *conditions);
+void cd_prepared_select_destroy(CD_PreparedSelect *select);
+// condition_data holds one value per condition; NULL uses the data of the conditions given when preparing
+CD_TableView *cd_prepared_select(CD_PreparedSelect *select, const void *condition_data[]);
+// threads used by the select; 0 uses the thread count of the database
+void cd_prepared_select_thread_count_set(CD_PreparedSelect *select, uint64_t thread_count);
+// the trace of the last select, aggregate or cursor run with select; a cursor adds every batch to it
+CD_QueryTrace cd_prepared_select_trace(CD_PreparedSelect *select);
+
+// streams the rows of a select in batches of at most batch_rows rows (0 for a default) so memory does not grow with the result.
+// the rows of the table when the cursor is opened are scanned; the cursor must be closed before the table is closed.
+// next_batch returns NULL with CD_ERROR_TABLE_MODIFIED once a delete, update, vacuum or an insert into deleted rows
+// changed the table since the cursor was opened
+typedef struct CD_Cursor CD_Cursor;
+
+CD_Cursor *cd_table_cursor_open(CD_Table *table, uint64_t attribute_count, const char *attribute_names[], uint64_t condition_count, CD_Condition *conditions, uint64_t batch_rows);
+// uses the buffers of select, which can not run anything else until the cursor is closed
+CD_Cursor *cd_prepared_select_cursor_open(CD_PreparedSelect *select, const void *condition_data[], uint64_t batch_rows);
+// the batch is owned by the cursor and valid until the next call; an empty batch means every row was returned, NULL an error
+const CD_TableView *cd_table_cursor_next_batch(CD_Cursor *cursor);
+void cd_table_cursor_close(CD_Cursor *cursor);
+
+typedef enum CD_AggregateFunction
+{
+	CD_AGGREGATE_COUNT = 0,
+	CD_AGGREGATE_SUM,
+	CD_AGGREGATE_MIN,
+	CD_AGGREGATE_MAX,
+	CD_AGGREGATE_AVG
+} CD_AggregateFunction;
+
+typedef struct CD_Aggregate
+{
+	const char *name; // a UINT/SINT/FLOAT attribute, may be NULL for COUNT
+	uint64_t function;
+} CD_Aggregate;
+
+typedef struct CD_AggregateResult
+{
+	uint64_t type; // CD_TYPE_UINT for COUNT, CD_TYPE_FLOAT for AVG, the attribute type otherwise
+	uint64_t row_count; // rows that matched the conditions; MIN, MAX and AVG are 0 when there were none
+	union
+	{
+		CD_uint_t uint_value;
+		CD_sint_t sint_value;
+		CD_float_t float_value;
+	};
+} CD_AggregateResult;
+
+// computes the aggregates over the rows matching the conditions inside the scan, without copying any row out.
+// results holds one result per aggregate. integer sums wrap on overflow
+uint64_t cd_table_aggregate(CD_Table *table, uint64_t condition_count, CD_Condition *conditions, uint64_t aggregate_count, CD_Aggregate aggregates[], CD_AggregateResult results[]);
+
+// groups the rows matching the conditions by the key attributes (BYTE/UINT/SINT/CHAR/WCHAR) and computes the aggregates per group.
+// the view has one row per group, in no particular order: the keys, then one 8 byte value per aggregate named like "SUM(bytes)"
+// and typed like CD_AggregateResult. the hash table of the groups stays within memory_budget bytes (0 for a default); rows of
+// the groups that do not fit are partitioned by hash into spill files next to the table and grouped one partition at a time
+CD_TableView *cd_table_group_by(CD_Table *table, uint64_t key_count, const char *key_names[], uint64_t condition_count, CD_Condition *conditions, uint64_t aggregate_count, CD_Aggregate aggregates[], uint64_t memory_budget);
+
+// deleted rows are marked in a bitmap next to the table: scans skip them and inserts fill them before appending.
+// the rows of the table keep their place until cd_table_vacuum moves them
+uint64_t cd_table_delete(CD_Table *table, uint64_t condition_count, CD_Condition *conditions);
+// sets the attributes of every row matching the conditions to the one packed row in data. a UNIQUE attribute can only
+// be set when at most one row matches
+uint64_t cd_table_update(CD_Table *table, uint64_t condition_count, CD_Condition *conditions, uint64_t attribute_count, const char *attribute_names[], const void *data);
+// fills the rows of deleted rows with the last rows of the table, moving at most max_moves rows (0 for no limit), and
+// shrinks the file to the rows left so the work can be spread over several calls. the rows move in logged batches,
+// selects wait for one batch at a time
+uint64_t cd_table_vacuum(CD_Table *table, uint64_t max_moves);
+// rows deleted and not reused or vacuumed yet; cd_table_count does not count them
+uint64_t cd_table_deleted_count(CD_Table *table);
+// values of updated, deleted and vacuumed rows stay in the heap of a table with CD_ENCODING_HEAP attributes; compacting
+// moves the values of the rows left to the start of the heap and shrinks its file. selects wait for the whole compaction
+uint64_t cd_table_heap_compact(CD_Table *table);
+// bytes of values in the heap, 0 for a table without CD_ENCODING_HEAP attributes
+uint64_t cd_table_heap_size(CD_Table *table);
+
+// builds a persistent trigram index over a CHAR/WCHAR/VARCHAR/WVARCHAR attribute that narrows CONTAINS conditions
+// before the rows are checked; the index is kept up to date by inserts and reopened with the table
+uint64_t cd_table_trigram_index_create(CD_Table *table, const char *attribute_name);
+
+// builds a persistent B+tree index over a BYTE/UINT/SINT/FLOAT/CHAR/WCHAR attribute; selects use it for EQUALS, BIGGER
+// and SMALLER conditions that match few rows. the index is registered in the schema and kept up to date by inserts
+uint64_t cd_index_create(CD_Table *table, const char *attribute_name);
+
+// builds a persistent Bloom filter over a BYTE/UINT/SINT/FLOAT/CHAR/WCHAR attribute that answers for most absent values
+// of UNIQUE checks and EQUALS conditions without looking at the rows. false_positive_rate is kept between 0.00001 and 0.5,
+// 0 uses 0.01; a filter that exists is built again when the rate changes. kept up to date by inserts and reopened with the table
+uint64_t cd_table_bloom_filter_create(CD_Table *table, const char *attribute_name, CD_float_t false_positive_rate);
+
+// statistics
+// counters kept by a table and, summed over its tables, by the database. threads add to them once per select or
+// write with relaxed atomics, so they stay on; a snapshot taken while they run may mix counts of the same select
+typedef struct CD_Stats
+{
+	uint64_t selects; // selects, aggregates and cursors run, including the ones of deletes, updates and group bys
+	uint64_t rows_scanned; // rows of the chunks the selects read and filtered
+	uint64_t rows_matched; // rows that passed every condition
+	uint64_t bytes_read; // bytes the selects read from the table file
+	uint64_t rows_skipped; // rows of the chunks the zone maps ruled out without reading them
+	uint64_t filter_ns; // time the selects spent reading and filtering chunks, summed over the threads
+	uint64_t materialize_ns; // time the selects spent copying out, aggregating or grouping the matched rows
+	uint64_t inserts; // rows inserted
+	uint64_t unique_lookups; // values looked up in UNIQUE indices by inserts and updates
+	uint64_t unique_compares; // values of the table compared by those lookups
+	uint64_t resizes; // times the table file was resized and mapped again
+	uint64_t bloom_probes; // values of UNIQUE checks and EQUALS conditions looked up in Bloom filters
+	uint64_t bloom_negatives; // probes the filters answered with absent, skipping the lookup or the scan
+	uint64_t bloom_false_positives; // UNIQUE lookups the filters let through that found no row
+} CD_Stats;
+
+// counters since the table was opened or reset
+CD_Stats cd_table_stats_get(CD_Table *table);
+void cd_table_stats_reset(CD_Table *table);
+// counters of every table of the database since it was opened or reset
+CD_Stats cd_database_stats_get(CD_Database *db);
+void cd_database_stats_reset(CD_Database *db);
+
 // error
 typedef struct CD_Error
 {
@@ -141,9 +357,11 @@ typedef enum CD_ErrorType
 	CD_ERROR_ATTRIBUTE_IS_NOT_NULL,
 	CD_ERROR_ATTRIBUTE_IS_UNIQUE,
 	CD_ERROR_UNKNOWN_OPERATOR,
-	CD_ERROR_UNKNOWN_TYPE
+	CD_ERROR_UNKNOWN_TYPE,
+	CD_ERROR_TABLE_MODIFIED
 } CD_ErrorType;
 
+// the last error of the calling thread
 CD_Error cd_get_last_error();
 
 #endif
\ No newline at end of file
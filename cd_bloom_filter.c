@@ -0,0 +1,427 @@
+#include "internal.h"
+
+#include <math.h>
+
+#define CD_LN2 0.69314718055994530942
+
+// blocked Bloom filter: a value sets hash_count bits inside one block of one cache line, so a probe touches one line.
+// the file holds the header followed by the blocks, which are kept in memory and written through. bits are never
+// cleared, values of deleted and updated rows stay in the filter until it is built again
+
+#define CD_BLOOM_BLOCK_BITS (CD_BLOOM_BLOCK_WORDS * 64)
+
+static CC_String _cd_bloom_filter_path(CD_Table *table, uint64_t attribute_index)
+{
+	CC_StringBuffer *buffer = cc_string_buffer_create(CD_NAME_LENGTH);
+	cc_string_buffer_insert_string(buffer, table->db->name);
+	cc_string_buffer_insert_char(buffer, '/');
+	cc_string_buffer_insert_string(buffer, table->name);
+	cc_string_buffer_insert_char(buffer, '.');
+	CC_String attribute_name = cc_string_create(table->schema->attributes[attribute_index].name, 0);
+	cc_string_buffer_insert_string(buffer, attribute_name);
+	cc_string_destroy(attribute_name);
+	CC_String file_extension = cc_string_create(".bloom", 0);
+	cc_string_buffer_insert_string(buffer, file_extension);
+	cc_string_destroy(file_extension);
+
+	return cc_string_buffer_to_string_and_destroy(buffer);
+}
+
+// values that are equal hash the same; -0.0 equals 0.0, so both are hashed as 0.0
+static uint64_t _cd_bloom_filter_hash(const CD_BloomFilter *filter, const void *value)
+{
+	if (filter->type != CD_TYPE_FLOAT)
+	{
+		return _cd_hash(value, filter->size);
+	}
+
+	const CD_float_t *numbers = value;
+	uint64_t hash = 0;
+	for (uint64_t i = 0; i < filter->count; i++)
+	{
+		CD_float_t number = numbers[i] == 0 ? 0 : numbers[i];
+		hash = hash * 0x9e3779b97f4a7c15 ^ _cd_hash(&number, sizeof(number));
+	}
+	return hash;
+}
+
+// the high half of the hash picks the block, the low half the bits inside it
+static uint64_t _cd_bloom_filter_block(const CD_BloomFilter *filter, uint64_t hash)
+{
+	return ((hash >> 32) * filter->header.block_count) >> 32;
+}
+
+static uint64_t _cd_bloom_filter_map(CD_BloomFilter *filter)
+{
+	filter->header_view = cf_file_view_open(filter->file, 0, sizeof(filter->header));
+	if (filter->header_view == NULL)
+	{
+		_cd_make_error(CD_ERROR_FILE, "Failed to open header view of filter file '%s'", filter->file_path.data);
+		return 0;
+	}
+
+	filter->block_view = cf_file_view_open(filter->file, sizeof(filter->header), filter->header.block_count * CD_BLOOM_BLOCK_WORDS * sizeof(uint64_t));
+	if (filter->block_view == NULL)
+	{
+		_cd_make_error(CD_ERROR_FILE, "Failed to open block view of filter file '%s'", filter->file_path.data);
+		return 0;
+	}
+
+	return 1;
+}
+
+static void _cd_bloom_filter_unmap(CD_BloomFilter *filter)
+{
+	if (filter->block_view != NULL)
+	{
+		cf_file_view_close(filter->block_view);
+		filter->block_view = NULL;
+	}
+	if (filter->header_view != NULL)
+	{
+		cf_file_view_close(filter->header_view);
+		filter->header_view = NULL;
+	}
+}
+
+static void _cd_bloom_filter_add(CD_BloomFilter *filter, const void *value)
+{
+	uint64_t hash = _cd_bloom_filter_hash(filter, value);
+	uint64_t block = _cd_bloom_filter_block(filter, hash);
+	uint64_t *words = filter->words + block * CD_BLOOM_BLOCK_WORDS;
+
+	// double hashing inside the block
+	uint32_t bit = (uint32_t)hash;
+	uint32_t step = (uint32_t)(hash >> 23) | 1;
+	for (uint64_t i = 0; i < filter->header.hash_count; i++, bit += step)
+	{
+		uint64_t block_bit = bit % CD_BLOOM_BLOCK_BITS;
+		words[block_bit / 64] |= (uint64_t)1 << (block_bit % 64);
+	}
+
+	if (block < filter->dirty_begin)
+	{
+		filter->dirty_begin = block;
+	}
+	if (block + 1 > filter->dirty_end)
+	{
+		filter->dirty_end = block + 1;
+	}
+}
+
+uint64_t _cd_bloom_filter_may_contain(const CD_BloomFilter *filter, const void *value)
+{
+	uint64_t hash = _cd_bloom_filter_hash(filter, value);
+	const uint64_t *words = filter->words + _cd_bloom_filter_block(filter, hash) * CD_BLOOM_BLOCK_WORDS;
+
+	uint32_t bit = (uint32_t)hash;
+	uint32_t step = (uint32_t)(hash >> 23) | 1;
+	for (uint64_t i = 0; i < filter->header.hash_count; i++, bit += step)
+	{
+		uint64_t block_bit = bit % CD_BLOOM_BLOCK_BITS;
+		if ((words[block_bit / 64] & ((uint64_t)1 << (block_bit % 64))) == 0)
+		{
+			return 0;
+		}
+	}
+	return 1;
+}
+
+uint64_t _cd_bloom_filter_probe(const CD_BloomFilter *filter, const void *value, CD_Stats *add)
+{
+	add->bloom_probes++;
+	if (_cd_bloom_filter_may_contain(filter, value))
+	{
+		return 1;
+	}
+	add->bloom_negatives++;
+	return 0;
+}
+
+uint64_t _cd_bloom_filter_rebuild(CD_Table *table, CD_BloomFilter *filter, uint64_t row_count)
+{
+	const CD_AttributeEx *attribute = table->schema->attributes + filter->attribute_index;
+
+	// sized for twice the rows so the table can grow before the filter is built again
+	uint64_t capacity = CD_BLOOM_ROWS_START;
+	while (capacity < row_count * 2)
+	{
+		capacity *= 2;
+	}
+
+	CD_float_t bits_per_row = ceil(-log(filter->header.false_positive_rate) / (CD_LN2 * CD_LN2));
+	uint64_t hash_count = (uint64_t)(bits_per_row * CD_LN2 + 0.5);
+	if (hash_count == 0)
+	{
+		hash_count = 1;
+	}
+
+	_cd_bloom_filter_unmap(filter);
+
+	filter->header.row_count = 0;
+	filter->header.capacity = capacity;
+	filter->header.block_count = ((uint64_t)(capacity * bits_per_row) + CD_BLOOM_BLOCK_BITS - 1) / CD_BLOOM_BLOCK_BITS;
+	filter->header.hash_count = hash_count;
+
+	uint64_t block_size = filter->header.block_count * CD_BLOOM_BLOCK_WORDS * sizeof(uint64_t);
+	free(filter->words);
+	filter->words = calloc(1, block_size);
+
+	uint8_t *column = NULL;
+	if (!cf_file_resize(filter->file, sizeof(filter->header) + block_size))
+	{
+		_cd_make_error(CD_ERROR_FILE, "Failed to resize filter file '%s'", filter->file_path.data);
+		goto words_fill;
+	}
+	if (!_cd_bloom_filter_map(filter))
+	{
+		goto words_fill;
+	}
+
+	// one page of values at a time
+	uint64_t column_rows = 4096;
+	column = malloc(column_rows * attribute->size);
+	for (uint64_t row = 0; row < row_count; row += column_rows)
+	{
+		uint64_t rows = row_count - row < column_rows ? row_count - row : column_rows;
+		if (!_cd_table_values_read(table, attribute, row, rows, column))
+		{
+			goto words_fill;
+		}
+		for (uint64_t r = 0; r < rows; r++)
+		{
+			_cd_bloom_filter_add(filter, column + r * attribute->size);
+		}
+	}
+	free(column);
+
+	filter->header.row_count = row_count;
+	filter->dirty_begin = 0;
+	filter->dirty_end = filter->header.block_count;
+	return _cd_bloom_filter_commit(filter);
+
+words_fill:
+	// a filter missing values would turn away values that are there, this one lets every value through
+	memset(filter->words, 0xff, block_size);
+	free(column);
+	return 0;
+}
+
+uint64_t _cd_bloom_filter_insert(CD_Table *table, CD_BloomFilter *filter, const void *value, uint64_t row)
+{
+	// a full filter is built again larger from the rows up to this one, which are all written
+	if (row >= filter->header.capacity && !_cd_bloom_filter_rebuild(table, filter, row + 1 > filter->header.row_count ? row + 1 : filter->header.row_count))
+	{
+		return 0;
+	}
+
+	_cd_bloom_filter_add(filter, value);
+	if (row + 1 > filter->header.row_count)
+	{
+		filter->header.row_count = row + 1;
+	}
+	return 1;
+}
+
+uint64_t _cd_bloom_filter_commit(CD_BloomFilter *filter)
+{
+	if (filter->dirty_begin < filter->dirty_end)
+	{
+		uint64_t offset = filter->dirty_begin * CD_BLOOM_BLOCK_WORDS;
+		uint64_t word_count = (filter->dirty_end - filter->dirty_begin) * CD_BLOOM_BLOCK_WORDS;
+		if (!cf_file_view_write(filter->block_view, offset * sizeof(uint64_t), word_count * sizeof(uint64_t), filter->words + offset))
+		{
+			_cd_make_error(CD_ERROR_FILE, "Failed to write blocks of filter file '%s'", filter->file_path.data);
+			return 0;
+		}
+		filter->dirty_begin = UINT64_MAX;
+		filter->dirty_end = 0;
+	}
+
+	if (!cf_file_view_write(filter->header_view, 0, sizeof(filter->header), &filter->header))
+	{
+		_cd_make_error(CD_ERROR_FILE, "Failed to write header of filter file '%s'", filter->file_path.data);
+		return 0;
+	}
+	return 1;
+}
+
+uint64_t _cd_bloom_filter_exists(CD_Table *table, uint64_t attribute_index)
+{
+	CC_String file_path = _cd_bloom_filter_path(table, attribute_index);
+	uint64_t exists = cf_file_exists(file_path);
+	cc_string_destroy(file_path);
+	return exists;
+}
+
+CD_BloomFilter *_cd_bloom_filter_open(CD_Table *table, uint64_t attribute_index, CD_float_t false_positive_rate)
+{
+	const CD_AttributeEx *attribute = table->schema->attributes + attribute_index;
+
+	CC_String file_path = _cd_bloom_filter_path(table, attribute_index);
+
+	uint64_t rebuild = 0;
+	if (!cf_file_exists(file_path))
+	{
+		if (!cf_file_create(file_path, sizeof(_CD_File_BloomFilter)))
+		{
+			_cd_make_error(CD_ERROR_FILE, "Failed to create filter file '%s'", file_path.data);
+			goto file_path_destroy;
+		}
+		rebuild = 1;
+	}
+
+	CF_File *file = cf_file_open(file_path);
+	if (file == NULL)
+	{
+		_cd_make_error(CD_ERROR_FILE, "Failed to open filter file '%s'", file_path.data);
+		goto file_path_destroy;
+	}
+
+	CD_BloomFilter *filter = malloc(sizeof(*filter));
+
+	filter->file_path = file_path;
+	filter->attribute_index = attribute_index;
+	filter->type = attribute->type;
+	filter->count = attribute->count;
+	filter->size = attribute->size;
+	filter->words = NULL;
+	filter->dirty_begin = UINT64_MAX;
+	filter->dirty_end = 0;
+	filter->file = file;
+	filter->header_view = NULL;
+	filter->block_view = NULL;
+	filter->header.row_count = 0;
+	filter->header.capacity = 0;
+	filter->header.block_count = 0;
+	filter->header.hash_count = 0;
+	filter->header.false_positive_rate = false_positive_rate;
+
+	if (!rebuild)
+	{
+		CF_FileView *header_view = cf_file_view_open(file, 0, sizeof(filter->header));
+		if (header_view == NULL || !cf_file_view_read(header_view, 0, sizeof(filter->header), &filter->header))
+		{
+			_cd_make_error(CD_ERROR_FILE, "Failed to read header of filter file '%s'", file_path.data);
+			if (header_view != NULL)
+			{
+				cf_file_view_close(header_view);
+			}
+			goto filter_close;
+		}
+		cf_file_view_close(header_view);
+
+		// a filter that does not cover exactly the rows of the table is stale (e.g. after a crash)
+		if (!(filter->header.false_positive_rate > 0 && filter->header.false_positive_rate < 1))
+		{
+			filter->header.false_positive_rate = CD_BLOOM_FALSE_POSITIVE_RATE;
+			rebuild = 1;
+		}
+		else if (filter->header.row_count != table->count.count_c || filter->header.row_count > filter->header.capacity || filter->header.block_count == 0 || filter->header.hash_count == 0 || cf_file_size_get(file) < sizeof(filter->header) + filter->header.block_count * CD_BLOOM_BLOCK_WORDS * sizeof(uint64_t))
+		{
+			rebuild = 1;
+		}
+		else if (!_cd_bloom_filter_map(filter))
+		{
+			goto filter_close;
+		}
+		else
+		{
+			uint64_t block_size = filter->header.block_count * CD_BLOOM_BLOCK_WORDS * sizeof(uint64_t);
+			filter->words = malloc(block_size);
+			if (!cf_file_view_read(filter->block_view, 0, block_size, filter->words))
+			{
+				_cd_make_error(CD_ERROR_FILE, "Failed to read blocks of filter file '%s'", file_path.data);
+				goto filter_close;
+			}
+		}
+	}
+
+	if (rebuild && !_cd_bloom_filter_rebuild(table, filter, table->count.count_c))
+	{
+		goto filter_close;
+	}
+
+	return filter;
+
+filter_close:
+	_cd_bloom_filter_close(filter);
+	return NULL;
+file_path_destroy:
+	cc_string_destroy(file_path);
+	return NULL;
+}
+
+void _cd_bloom_filter_close(CD_BloomFilter *filter)
+{
+	if (filter != NULL)
+	{
+		_cd_bloom_filter_unmap(filter);
+		cf_file_close(filter->file);
+		free(filter->words);
+		cc_string_destroy(filter->file_path);
+		free(filter);
+	}
+}
+
+uint64_t cd_table_bloom_filter_create(CD_Table *table, const char *attribute_name, CD_float_t false_positive_rate)
+{
+	CC_String cc_attrib_name = cc_string_create(attribute_name, 0);
+	const uint64_t *index_ptr = cc_hash_map_lookup(table->schema->attribute_indices, cc_attrib_name);
+	cc_string_destroy(cc_attrib_name);
+
+	if (index_ptr == NULL)
+	{
+		_cd_make_error(CD_ERROR_ATTRIBUTE_DOES_NOT_EXIST, "Attribute '%s' does not exist in table '%s'", attribute_name, table->name.data);
+		return 0;
+	}
+
+	uint64_t attribute_index = *index_ptr;
+	const CD_AttributeEx *attribute = table->schema->attributes + attribute_index;
+	if (attribute->type == CD_TYPE_VARCHAR || attribute->type == CD_TYPE_WVARCHAR)
+	{
+		_cd_make_error(CD_ERROR_UNKNOWN_TYPE, "Attribute '%s' of table '%s' has a variable length and can not have a Bloom filter", attribute_name, table->name.data);
+		return 0;
+	}
+
+	if (false_positive_rate == 0)
+	{
+		false_positive_rate = CD_BLOOM_FALSE_POSITIVE_RATE;
+	}
+	else if (false_positive_rate < CD_BLOOM_FALSE_POSITIVE_RATE_MIN)
+	{
+		false_positive_rate = CD_BLOOM_FALSE_POSITIVE_RATE_MIN;
+	}
+	else if (false_positive_rate > CD_BLOOM_FALSE_POSITIVE_RATE_MAX)
+	{
+		false_positive_rate = CD_BLOOM_FALSE_POSITIVE_RATE_MAX;
+	}
+
+	uint64_t return_value = 1;
+
+	_cd_mutex_lock(table->writer_lock);
+	CD_BloomFilter *filter = table->bloom_filters[attribute_index];
+	if (filter == NULL)
+	{
+		// the filter is built next to running selects, they start using it once it is complete
+		filter = _cd_bloom_filter_open(table, attribute_index, false_positive_rate);
+		if (filter != NULL)
+		{
+			_cd_rwlock_write_lock(table->lock);
+			table->bloom_filters[attribute_index] = filter;
+			_cd_rwlock_write_unlock(table->lock);
+		}
+		return_value = filter != NULL;
+	}
+	else if (filter->header.false_positive_rate != false_positive_rate)
+	{
+		// a new rate sizes the filter again, selects wait for it
+		_cd_rwlock_write_lock(table->lock);
+		filter->header.false_positive_rate = false_positive_rate;
+		return_value = _cd_bloom_filter_rebuild(table, filter, table->count.count_c);
+		_cd_rwlock_write_unlock(table->lock);
+	}
+	_cd_mutex_unlock(table->writer_lock);
+
+	return return_value;
+}
@@ -0,0 +1,750 @@
+#include "internal.h"
+
+// page 0 of the file holds the header, every other page is a node.
+// keys are the attribute value followed by the row, so equal values are ordered by row and every key is unique.
+// leaves hold keys, internal nodes hold a leftmost child in link and (key, child) pairs where key is the smallest key of child
+typedef struct _CD_File_BTreeNode
+{
+	uint64_t is_leaf;
+	uint64_t count;
+	uint64_t link; // leaf: next leaf (0 for the last one), internal: leftmost child
+} _CD_File_BTreeNode;
+
+#define CD_BTREE_NODE(page) ((_CD_File_BTreeNode *)(page))
+#define CD_BTREE_LEAF_KEY(index, page, i) ((page) + sizeof(_CD_File_BTreeNode) + (i) * (index)->leaf_entry)
+#define CD_BTREE_NODE_KEY(index, page, i) ((page) + sizeof(_CD_File_BTreeNode) + (i) * (index)->node_entry)
+
+static int64_t _cd_btree_key_compare(const CD_BTreeIndex *index, const uint8_t *key, const void *value, uint64_t row)
+{
+	int64_t compare = _cd_funcs_compare[index->type](key, value, index->count);
+	if (compare != 0)
+	{
+		return compare;
+	}
+
+	uint64_t key_row;
+	memcpy(&key_row, key + index->size, sizeof(key_row));
+	return key_row < row ? -1 : key_row > row;
+}
+
+static uint64_t _cd_btree_key_row(const CD_BTreeIndex *index, const uint8_t *key)
+{
+	uint64_t row;
+	memcpy(&row, key + index->size, sizeof(row));
+	return row;
+}
+
+static uint64_t _cd_btree_child(const CD_BTreeIndex *index, const uint8_t *page, uint64_t i)
+{
+	uint64_t child;
+	if (i == 0)
+	{
+		return CD_BTREE_NODE(page)->link;
+	}
+	memcpy(&child, CD_BTREE_NODE_KEY(index, page, i - 1) + index->size + sizeof(uint64_t), sizeof(child));
+	return child;
+}
+
+// first key of a leaf that is not smaller than (value, row)
+static uint64_t _cd_btree_leaf_lower_bound(const CD_BTreeIndex *index, const uint8_t *page, const void *value, uint64_t row)
+{
+	uint64_t low = 0;
+	uint64_t high = CD_BTREE_NODE(page)->count;
+	while (low < high)
+	{
+		uint64_t middle = (low + high) / 2;
+		if (_cd_btree_key_compare(index, CD_BTREE_LEAF_KEY(index, page, middle), value, row) < 0)
+		{
+			low = middle + 1;
+		}
+		else
+		{
+			high = middle;
+		}
+	}
+	return low;
+}
+
+// number of keys of an internal node that are not bigger than (value, row), which is also the child to descend into
+static uint64_t _cd_btree_node_upper_bound(const CD_BTreeIndex *index, const uint8_t *page, const void *value, uint64_t row)
+{
+	uint64_t low = 0;
+	uint64_t high = CD_BTREE_NODE(page)->count;
+	while (low < high)
+	{
+		uint64_t middle = (low + high) / 2;
+		if (_cd_btree_key_compare(index, CD_BTREE_NODE_KEY(index, page, middle), value, row) <= 0)
+		{
+			low = middle + 1;
+		}
+		else
+		{
+			high = middle;
+		}
+	}
+	return low;
+}
+
+static uint64_t _cd_btree_page_read(CD_BTreeIndex *index, uint64_t page, uint8_t *buffer)
+{
+	if (!cf_file_view_read(index->page_view, page * CD_BTREE_PAGE_SIZE, CD_BTREE_PAGE_SIZE, buffer))
+	{
+		_cd_make_error(CD_ERROR_FILE, "Failed to read page %llu of index file '%s'", page, index->file_path.data);
+		return 0;
+	}
+	return 1;
+}
+
+static uint64_t _cd_btree_page_write(CD_BTreeIndex *index, uint64_t page, const uint8_t *buffer)
+{
+	if (!cf_file_view_write(index->page_view, page * CD_BTREE_PAGE_SIZE, CD_BTREE_PAGE_SIZE, buffer))
+	{
+		_cd_make_error(CD_ERROR_FILE, "Failed to write page %llu of index file '%s'", page, index->file_path.data);
+		return 0;
+	}
+	return 1;
+}
+
+static uint64_t _cd_btree_map(CD_BTreeIndex *index)
+{
+	index->page_view = cf_file_view_open(index->file, 0, index->header.page_count_m * CD_BTREE_PAGE_SIZE);
+	if (index->page_view == NULL)
+	{
+		_cd_make_error(CD_ERROR_FILE, "Failed to open page view of index file '%s'", index->file_path.data);
+		return 0;
+	}
+	return 1;
+}
+
+static void _cd_btree_unmap(CD_BTreeIndex *index)
+{
+	if (index->page_view != NULL)
+	{
+		cf_file_view_close(index->page_view);
+		index->page_view = NULL;
+	}
+}
+
+static uint64_t _cd_btree_resize(CD_BTreeIndex *index, uint64_t page_count_m)
+{
+	_cd_btree_unmap(index);
+
+	if (!cf_file_resize(index->file, page_count_m * CD_BTREE_PAGE_SIZE))
+	{
+		_cd_make_error(CD_ERROR_FILE, "Failed to resize index file '%s'", index->file_path.data);
+		return 0;
+	}
+	index->header.page_count_m = page_count_m;
+
+	return _cd_btree_map(index);
+}
+
+static uint64_t _cd_btree_page_new(CD_BTreeIndex *index, uint64_t *page)
+{
+	if (index->header.page_count_c == index->header.page_count_m && !_cd_btree_resize(index, index->header.page_count_m * 2))
+	{
+		return 0;
+	}
+	*page = index->header.page_count_c++;
+	return 1;
+}
+
+uint64_t _cd_btree_index_commit(CD_BTreeIndex *index)
+{
+	if (!cf_file_view_write(index->page_view, 0, sizeof(index->header), &index->header))
+	{
+		_cd_make_error(CD_ERROR_FILE, "Failed to write header of index file '%s'", index->file_path.data);
+		return 0;
+	}
+	return 1;
+}
+
+uint64_t _cd_btree_index_insert(CD_BTreeIndex *index, const void *value, uint64_t row)
+{
+	uint64_t path[CD_BTREE_HEIGHT_MAX];
+	uint8_t *node = index->node;
+
+	// rows freed by a delete are reused, so row can be below the rows already indexed
+	if (row + 1 > index->header.row_count)
+	{
+		index->header.row_count = row + 1;
+	}
+
+	// find the leaf and remember the way down
+	uint64_t page = index->header.root;
+	for (uint64_t level = 0;; level++)
+	{
+		path[level] = page;
+		if (!_cd_btree_page_read(index, page, node))
+		{
+			return 0;
+		}
+		if (CD_BTREE_NODE(node)->is_leaf)
+		{
+			break;
+		}
+		page = _cd_btree_child(index, node, _cd_btree_node_upper_bound(index, node, value, row));
+	}
+
+	uint64_t level = index->header.height - 1;
+
+	// node has room for one key more than a page holds so it can be split after inserting
+	_CD_File_BTreeNode *header = CD_BTREE_NODE(node);
+	uint64_t position = _cd_btree_leaf_lower_bound(index, node, value, row);
+	uint8_t *key = CD_BTREE_LEAF_KEY(index, node, position);
+
+	// a reused row can get the value it had before it was deleted
+	if (position < header->count && _cd_btree_key_compare(index, key, value, row) == 0)
+	{
+		return 1;
+	}
+	memmove(key + index->leaf_entry, key, (header->count - position) * index->leaf_entry);
+	memcpy(key, value, index->size);
+	memcpy(key + index->size, &row, sizeof(row));
+	header->count++;
+
+	if (header->count <= index->leaf_capacity)
+	{
+		return _cd_btree_page_write(index, path[level], node);
+	}
+
+	uint64_t right;
+	if (!_cd_btree_page_new(index, &right))
+	{
+		return 0;
+	}
+
+	uint8_t *split = index->split;
+	uint64_t left_count = header->count / 2;
+	CD_BTREE_NODE(split)->is_leaf = 1;
+	CD_BTREE_NODE(split)->count = header->count - left_count;
+	CD_BTREE_NODE(split)->link = header->link;
+	memcpy(CD_BTREE_LEAF_KEY(index, split, 0), CD_BTREE_LEAF_KEY(index, node, left_count), (header->count - left_count) * index->leaf_entry);
+	header->count = left_count;
+	header->link = right;
+
+	// the separator is the first key of the new right node
+	uint8_t *separator = index->separator;
+	memcpy(separator, CD_BTREE_LEAF_KEY(index, split, 0), index->leaf_entry);
+
+	if (!_cd_btree_page_write(index, path[level], node) || !_cd_btree_page_write(index, right, split))
+	{
+		return 0;
+	}
+
+	// carry the split up until a node has room
+	while (level > 0)
+	{
+		level--;
+		if (!_cd_btree_page_read(index, path[level], node))
+		{
+			return 0;
+		}
+
+		header = CD_BTREE_NODE(node);
+		position = _cd_btree_node_upper_bound(index, node, separator, _cd_btree_key_row(index, separator));
+		key = CD_BTREE_NODE_KEY(index, node, position);
+		memmove(key + index->node_entry, key, (header->count - position) * index->node_entry);
+		memcpy(key, separator, index->leaf_entry);
+		memcpy(key + index->leaf_entry, &right, sizeof(right));
+		header->count++;
+
+		if (header->count <= index->node_capacity)
+		{
+			return _cd_btree_page_write(index, path[level], node);
+		}
+
+		uint64_t left = path[level];
+		if (!_cd_btree_page_new(index, &right))
+		{
+			return 0;
+		}
+
+		// the middle key moves up, its child becomes the leftmost child of the right node
+		uint64_t middle = header->count / 2;
+		uint8_t *middle_key = CD_BTREE_NODE_KEY(index, node, middle);
+		CD_BTREE_NODE(split)->is_leaf = 0;
+		CD_BTREE_NODE(split)->count = header->count - middle - 1;
+		memcpy(&CD_BTREE_NODE(split)->link, middle_key + index->leaf_entry, sizeof(uint64_t));
+		memcpy(CD_BTREE_NODE_KEY(index, split, 0), CD_BTREE_NODE_KEY(index, node, middle + 1), (header->count - middle - 1) * index->node_entry);
+		memcpy(separator, middle_key, index->leaf_entry);
+		header->count = middle;
+
+		if (!_cd_btree_page_write(index, left, node) || !_cd_btree_page_write(index, right, split))
+		{
+			return 0;
+		}
+	}
+
+	// the root was split, the tree grows by one level
+	if (index->header.height == CD_BTREE_HEIGHT_MAX)
+	{
+		_cd_make_error(CD_ERROR_FILE, "Index file '%s' is too deep", index->file_path.data);
+		return 0;
+	}
+
+	uint64_t root;
+	if (!_cd_btree_page_new(index, &root))
+	{
+		return 0;
+	}
+
+	memset(node, 0, CD_BTREE_PAGE_SIZE);
+	CD_BTREE_NODE(node)->is_leaf = 0;
+	CD_BTREE_NODE(node)->count = 1;
+	CD_BTREE_NODE(node)->link = index->header.root;
+	memcpy(CD_BTREE_NODE_KEY(index, node, 0), separator, index->leaf_entry);
+	memcpy(CD_BTREE_NODE_KEY(index, node, 0) + index->leaf_entry, &right, sizeof(right));
+
+	if (!_cd_btree_page_write(index, root, node))
+	{
+		return 0;
+	}
+
+	index->header.root = root;
+	index->header.height++;
+
+	return 1;
+}
+
+static int _cd_row_compare(const void *row1, const void *row2)
+{
+	uint64_t r1 = *(const uint64_t *)row1;
+	uint64_t r2 = *(const uint64_t *)row2;
+	return r1 < r2 ? -1 : r1 > r2;
+}
+
+uint64_t _cd_btree_index_candidates(CD_BTreeIndex *index, uint64_t operator, const void *value, uint64_t limit, uint64_t **rows, uint64_t *row_count, uint64_t *is_over_limit)
+{
+	// selects look up candidates at the same time, the node buffer of the index belongs to the writer
+	uint8_t *node = malloc(CD_BTREE_PAGE_SIZE);
+	uint64_t *found = NULL;
+	uint64_t return_value = 0;
+
+	*rows = NULL;
+	*row_count = 0;
+	*is_over_limit = 0;
+
+	// BIGGER starts after every key holding value, SMALLER at the first leaf
+	uint64_t seek_row = operator == CD_CONDITION_OPERATOR_BIGGER ? UINT64_MAX : 0;
+
+	uint64_t page = index->header.root;
+	for (;;)
+	{
+		if (!_cd_btree_page_read(index, page, node))
+		{
+			goto node_free;
+		}
+		if (CD_BTREE_NODE(node)->is_leaf)
+		{
+			break;
+		}
+
+		uint64_t child = 0;
+		if (operator != CD_CONDITION_OPERATOR_SMALLER)
+		{
+			child = _cd_btree_node_upper_bound(index, node, value, seek_row);
+		}
+		page = _cd_btree_child(index, node, child);
+	}
+
+	uint64_t position = 0;
+	if (operator != CD_CONDITION_OPERATOR_SMALLER)
+	{
+		position = _cd_btree_leaf_lower_bound(index, node, value, seek_row);
+	}
+
+	uint64_t capacity = 64;
+	found = malloc(sizeof(*found) * capacity);
+	uint64_t count = 0;
+
+	for (;;)
+	{
+		_CD_File_BTreeNode *header = CD_BTREE_NODE(node);
+		for (; position < header->count; position++)
+		{
+			const uint8_t *key = CD_BTREE_LEAF_KEY(index, node, position);
+			if (operator != CD_CONDITION_OPERATOR_BIGGER)
+			{
+				int64_t compare = _cd_funcs_compare[index->type](key, value, index->count);
+				if ((operator == CD_CONDITION_OPERATOR_EQUALS && compare != 0) || (operator == CD_CONDITION_OPERATOR_SMALLER && compare >= 0))
+				{
+					goto leaves_end;
+				}
+			}
+
+			// a scan is cheaper than this many rows
+			if (count == limit)
+			{
+				*is_over_limit = 1;
+				return_value = 1;
+				goto node_free;
+			}
+
+			if (count == capacity)
+			{
+				capacity *= 2;
+				found = realloc(found, sizeof(*found) * capacity);
+			}
+			found[count++] = _cd_btree_key_row(index, key);
+		}
+
+		if (header->link == 0)
+		{
+			break;
+		}
+		if (!_cd_btree_page_read(index, header->link, node))
+		{
+			goto node_free;
+		}
+		position = 0;
+	}
+leaves_end:
+
+	// keys are in value order, the scan wants rows in table order. a row that was reused or updated
+	// keeps its old keys, so it can be found twice
+	qsort(found, count, sizeof(*found), _cd_row_compare);
+	uint64_t unique_count = 0;
+	for (uint64_t i = 0; i < count; i++)
+	{
+		if (unique_count == 0 || found[unique_count - 1] != found[i])
+		{
+			found[unique_count++] = found[i];
+		}
+	}
+	count = unique_count;
+
+	*rows = found;
+	*row_count = count;
+	found = NULL;
+	return_value = 1;
+
+node_free:
+	free(found);
+	free(node);
+	return return_value;
+}
+
+// sorts rows by their value in values, equal values keep the order of their rows
+static void _cd_btree_sort(const CD_BTreeIndex *index, const uint8_t *values, uint64_t *rows, uint64_t *scratch, uint64_t row_count)
+{
+	for (uint64_t width = 1; width < row_count; width *= 2)
+	{
+		for (uint64_t start = 0; start < row_count; start += 2 * width)
+		{
+			uint64_t middle = start + width < row_count ? start + width : row_count;
+			uint64_t end = start + 2 * width < row_count ? start + 2 * width : row_count;
+
+			uint64_t l = start, r = middle, o = start;
+			while (l < middle && r < end)
+			{
+				if (_cd_funcs_compare[index->type](values + rows[r] * index->size, values + rows[l] * index->size, index->count) < 0)
+				{
+					scratch[o++] = rows[r++];
+				}
+				else
+				{
+					scratch[o++] = rows[l++];
+				}
+			}
+			while (l < middle)
+			{
+				scratch[o++] = rows[l++];
+			}
+			while (r < end)
+			{
+				scratch[o++] = rows[r++];
+			}
+		}
+		memcpy(rows, scratch, sizeof(*rows) * row_count);
+	}
+}
+
+uint64_t _cd_btree_index_rebuild(CD_Table *table, CD_BTreeIndex *index)
+{
+	const CD_AttributeEx *attribute = table->schema->attributes + index->attribute_index;
+	uint64_t row_count = table->count.count_c;
+
+	// the whole tree is written bottom up from the sorted keys
+	uint64_t leaf_count = row_count == 0 ? 1 : (row_count + index->leaf_capacity - 1) / index->leaf_capacity;
+	uint64_t page_count = 1 + leaf_count;
+	for (uint64_t level_count = leaf_count; level_count > 1;)
+	{
+		level_count = (level_count + index->node_capacity) / (index->node_capacity + 1);
+		page_count += level_count;
+	}
+
+	uint64_t page_count_m = CD_BTREE_PAGES_START;
+	while (page_count_m < page_count)
+	{
+		page_count_m *= 2;
+	}
+	if (!_cd_btree_resize(index, page_count_m))
+	{
+		return 0;
+	}
+
+	uint64_t return_value = 0;
+
+	uint8_t *values = malloc(row_count * index->size + 1);
+	uint64_t *rows = malloc(sizeof(*rows) * (row_count + 1));
+	uint64_t *scratch = malloc(sizeof(*scratch) * (row_count + 1));
+	// first key of every page of the level below
+	uint8_t *firsts = malloc(leaf_count * index->leaf_entry);
+
+	if (!_cd_table_values_read(table, attribute, 0, row_count, values))
+	{
+		goto buffers_free;
+	}
+
+	for (uint64_t row = 0; row < row_count; row++)
+	{
+		rows[row] = row;
+	}
+	_cd_btree_sort(index, values, rows, scratch, row_count);
+
+	uint8_t *node = index->node;
+	uint64_t page = 1;
+
+	for (uint64_t leaf = 0; leaf < leaf_count; leaf++, page++)
+	{
+		uint64_t first = leaf * index->leaf_capacity;
+		uint64_t count = row_count - first < index->leaf_capacity ? row_count - first : index->leaf_capacity;
+
+		memset(node, 0, CD_BTREE_PAGE_SIZE);
+		CD_BTREE_NODE(node)->is_leaf = 1;
+		CD_BTREE_NODE(node)->count = count;
+		CD_BTREE_NODE(node)->link = leaf + 1 < leaf_count ? page + 1 : 0;
+		for (uint64_t i = 0; i < count; i++)
+		{
+			uint8_t *key = CD_BTREE_LEAF_KEY(index, node, i);
+			memcpy(key, values + rows[first + i] * index->size, index->size);
+			memcpy(key + index->size, rows + first + i, sizeof(uint64_t));
+		}
+		memcpy(firsts + leaf * index->leaf_entry, CD_BTREE_LEAF_KEY(index, node, 0), index->leaf_entry);
+
+		if (!_cd_btree_page_write(index, page, node))
+		{
+			goto buffers_free;
+		}
+	}
+
+	uint64_t level_first = 1;
+	uint64_t level_count = leaf_count;
+	uint64_t height = 1;
+
+	while (level_count > 1)
+	{
+		uint64_t parent_first = page;
+		uint64_t parent_count = 0;
+
+		for (uint64_t child = 0; child < level_count; child += index->node_capacity + 1, page++, parent_count++)
+		{
+			uint64_t count = level_count - child < index->node_capacity + 1 ? level_count - child : index->node_capacity + 1;
+
+			memset(node, 0, CD_BTREE_PAGE_SIZE);
+			CD_BTREE_NODE(node)->is_leaf = 0;
+			CD_BTREE_NODE(node)->count = count - 1;
+			CD_BTREE_NODE(node)->link = level_first + child;
+			for (uint64_t i = 1; i < count; i++)
+			{
+				uint8_t *key = CD_BTREE_NODE_KEY(index, node, i - 1);
+				uint64_t child_page = level_first + child + i;
+				memcpy(key, firsts + (child + i) * index->leaf_entry, index->leaf_entry);
+				memcpy(key + index->leaf_entry, &child_page, sizeof(child_page));
+			}
+			// the parents are written in order so their first keys can replace the ones of the children
+			memmove(firsts + parent_count * index->leaf_entry, firsts + child * index->leaf_entry, index->leaf_entry);
+
+			if (!_cd_btree_page_write(index, page, node))
+			{
+				goto buffers_free;
+			}
+		}
+
+		level_first = parent_first;
+		level_count = parent_count;
+		height++;
+	}
+
+	index->header.row_count = row_count;
+	index->header.root = level_first;
+	index->header.height = height;
+	index->header.page_count_c = page;
+
+	return_value = _cd_btree_index_commit(index);
+
+buffers_free:
+	free(firsts);
+	free(scratch);
+	free(rows);
+	free(values);
+
+	return return_value;
+}
+
+static CC_String _cd_btree_index_path(CD_Table *table, uint64_t attribute_index)
+{
+	CC_StringBuffer *buffer = cc_string_buffer_create(CD_NAME_LENGTH);
+	cc_string_buffer_insert_string(buffer, table->db->name);
+	cc_string_buffer_insert_char(buffer, '/');
+	cc_string_buffer_insert_string(buffer, table->name);
+	cc_string_buffer_insert_char(buffer, '.');
+	CC_String attribute_name = cc_string_create(table->schema->attributes[attribute_index].name, 0);
+	cc_string_buffer_insert_string(buffer, attribute_name);
+	cc_string_destroy(attribute_name);
+	CC_String file_extension = cc_string_create(".btree", 0);
+	cc_string_buffer_insert_string(buffer, file_extension);
+	cc_string_destroy(file_extension);
+
+	return cc_string_buffer_to_string_and_destroy(buffer);
+}
+
+CD_BTreeIndex *_cd_btree_index_open(CD_Table *table, uint64_t attribute_index)
+{
+	const CD_AttributeEx *attribute = table->schema->attributes + attribute_index;
+
+	CC_String file_path = _cd_btree_index_path(table, attribute_index);
+
+	uint64_t rebuild = 0;
+	if (!cf_file_exists(file_path))
+	{
+		if (!cf_file_create(file_path, CD_BTREE_PAGE_SIZE))
+		{
+			_cd_make_error(CD_ERROR_FILE, "Failed to create index file '%s'", file_path.data);
+			goto file_path_destroy;
+		}
+		rebuild = 1;
+	}
+
+	CF_File *file = cf_file_open(file_path);
+	if (file == NULL)
+	{
+		_cd_make_error(CD_ERROR_FILE, "Failed to open index file '%s'", file_path.data);
+		goto file_path_destroy;
+	}
+
+	CD_BTreeIndex *index = malloc(sizeof(*index));
+
+	index->file_path = file_path;
+	index->attribute_index = attribute_index;
+	index->type = attribute->type;
+	index->count = attribute->count;
+	index->size = attribute->size;
+	index->leaf_entry = attribute->size + sizeof(uint64_t);
+	index->node_entry = attribute->size + 2 * sizeof(uint64_t);
+	index->leaf_capacity = (CD_BTREE_PAGE_SIZE - sizeof(_CD_File_BTreeNode)) / index->leaf_entry;
+	index->node_capacity = (CD_BTREE_PAGE_SIZE - sizeof(_CD_File_BTreeNode)) / index->node_entry;
+	index->file = file;
+	index->page_view = NULL;
+	// one key more than a page holds, a full node is split after the insert
+	index->node = calloc(1, CD_BTREE_PAGE_SIZE + index->node_entry);
+	index->split = calloc(1, CD_BTREE_PAGE_SIZE);
+	index->separator = malloc(index->leaf_entry);
+	memset(&index->header, 0, sizeof(index->header));
+
+	if (!rebuild)
+	{
+		CF_FileView *header_view = cf_file_view_open(file, 0, sizeof(index->header));
+		if (header_view == NULL || !cf_file_view_read(header_view, 0, sizeof(index->header), &index->header))
+		{
+			_cd_make_error(CD_ERROR_FILE, "Failed to read header of index file '%s'", file_path.data);
+			if (header_view != NULL)
+			{
+				cf_file_view_close(header_view);
+			}
+			goto index_close;
+		}
+		cf_file_view_close(header_view);
+
+		// an index that does not cover exactly the rows of the table is stale (e.g. after a crash)
+		if (index->header.row_count != table->count.count_c || index->header.root == 0 || index->header.page_count_c > index->header.page_count_m || cf_file_size_get(file) < index->header.page_count_m * CD_BTREE_PAGE_SIZE)
+		{
+			rebuild = 1;
+		}
+		else if (!_cd_btree_map(index))
+		{
+			goto index_close;
+		}
+	}
+
+	if (rebuild && !_cd_btree_index_rebuild(table, index))
+	{
+		goto index_close;
+	}
+
+	return index;
+
+index_close:
+	_cd_btree_index_close(index);
+	return NULL;
+file_path_destroy:
+	cc_string_destroy(file_path);
+	return NULL;
+}
+
+void _cd_btree_index_close(CD_BTreeIndex *index)
+{
+	if (index != NULL)
+	{
+		_cd_btree_unmap(index);
+		cf_file_close(index->file);
+		free(index->separator);
+		free(index->split);
+		free(index->node);
+		cc_string_destroy(index->file_path);
+		free(index);
+	}
+}
+
+uint64_t cd_index_create(CD_Table *table, const char *attribute_name)
+{
+	CC_String cc_attrib_name = cc_string_create(attribute_name, 0);
+	const uint64_t *index_ptr = cc_hash_map_lookup(table->schema->attribute_indices, cc_attrib_name);
+	cc_string_destroy(cc_attrib_name);
+
+	if (index_ptr == NULL)
+	{
+		_cd_make_error(CD_ERROR_ATTRIBUTE_DOES_NOT_EXIST, "Attribute '%s' does not exist in table '%s'", attribute_name, table->name.data);
+		return 0;
+	}
+
+	uint64_t attribute_index = *index_ptr;
+	const CD_AttributeEx *attribute = table->schema->attributes + attribute_index;
+	if (attribute->type == CD_TYPE_VARCHAR || attribute->type == CD_TYPE_WVARCHAR)
+	{
+		_cd_make_error(CD_ERROR_UNKNOWN_TYPE, "Attribute '%s' of table '%s' has a variable length and can not have a B+tree index", attribute_name, table->name.data);
+		return 0;
+	}
+	// internal nodes need room for at least 3 keys to split
+	if ((CD_BTREE_PAGE_SIZE - sizeof(_CD_File_BTreeNode)) / (attribute->size + 2 * sizeof(uint64_t)) < 3)
+	{
+		_cd_make_error(CD_ERROR_UNKNOWN_TYPE, "Attribute '%s' of table '%s' is too big for a B+tree index", attribute_name, table->name.data);
+		return 0;
+	}
+
+	uint64_t return_value = 1;
+
+	// the index is built next to running selects, they start using it once it is complete
+	_cd_mutex_lock(table->writer_lock);
+	if (table->btree_indices[attribute_index] == NULL)
+	{
+		CD_BTreeIndex *index = _cd_btree_index_open(table, attribute_index);
+		if (index != NULL)
+		{
+			_cd_rwlock_write_lock(table->lock);
+			table->btree_indices[attribute_index] = index;
+			_cd_rwlock_write_unlock(table->lock);
+
+			// register the index so it is opened with the table
+			return_value = _cd_table_schema_indices_set(table, attribute_index, table->schema->indices[attribute_index] | CD_INDEX_BTREE);
+		}
+		else
+		{
+			return_value = 0;
+		}
+	}
+	_cd_mutex_unlock(table->writer_lock);
+
+	return return_value;
+}
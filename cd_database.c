@@ -131,99 +131,65 @@ CD_Database *cd_database_open(const char *name)
 		goto schema_count_view_close;
 	}
 
-	uint64_t table_offset = sizeof(uint64_t);
+	// the whole file is read through one view and the tables are parsed from it in place
+	uint64_t schema_size = cf_file_size_get(schema_file);
+	uint8_t *schema_data = malloc(schema_size);
 
-	CC_HashMap *table_schemas = cc_hash_map_create(sizeof(CD_TableSchema), table_count);
+	CF_FileView *schema_view = cf_file_view_open(schema_file, 0, schema_size);
+	if (schema_view == NULL)
+	{
+		_cd_make_error(CD_ERROR_FILE, "Failed to open view of schema file '%s'", schema_file_path.data);
+		goto schema_data_free;
+	}
 
-	// load schemas
-	for (uint64_t table_index = 0; table_index < table_count; table_index++)
+	uint64_t is_read = cf_file_view_read(schema_view, 0, schema_size, schema_data);
+	cf_file_view_close(schema_view);
+	if (!is_read)
 	{
-		uint64_t _error = 0;
+		_cd_make_error(CD_ERROR_FILE, "Failed to read schema file '%s'", schema_file_path.data);
+		goto schema_data_free;
+	}
 
-		_CD_File_TableSchema file_table_schema;
+	CC_HashMap *table_schemas = cc_hash_map_create(sizeof(CD_TableSchema), table_count);
 
-		CF_FileView *table_data_view = cf_file_view_open(schema_file, table_offset, sizeof(file_table_schema));
-		if (table_data_view == NULL)
+	// load schemas, the attributes of a table are only materialized when it is opened
+	uint64_t table_offset = sizeof(uint64_t);
+	for (uint64_t table_index = 0; table_index < table_count; table_index++)
+	{
+		if (schema_size - table_offset < sizeof(_CD_File_TableSchema))
 		{
-			_cd_make_error(CD_ERROR_FILE, "Failed to open table_data_view of schema at index %d for file '%s'", table_index, schema_file_path.data);
-			_error = 1;
+			_cd_make_error(CD_ERROR_FILE, "Schema of table at index %llu is cut off in file '%s'", table_index, schema_file_path.data);
 			goto table_schemas_destroy;
 		}
 
-		if (!cf_file_view_read(table_data_view, 0, sizeof(file_table_schema), &file_table_schema))
+		const _CD_File_TableSchema *file_table_schema = (const _CD_File_TableSchema *)(schema_data + table_offset);
+		uint64_t attributes_offset = table_offset + sizeof(*file_table_schema);
+		if (file_table_schema->attrib_count_c > file_table_schema->attrib_count_m || file_table_schema->attrib_count_m > (schema_size - attributes_offset) / sizeof(_CD_File_Attribute))
 		{
-			_cd_make_error(CD_ERROR_FILE, "Failed to read table_data of schema at index %d for file '%s'", table_index, schema_file_path.data);
-			_error = 1;
-			goto table_data_view_close;
-		}
-
-		CF_FileView *table_attributes_view = cf_file_view_open(schema_file, table_offset + sizeof(file_table_schema), file_table_schema.attrib_count_c * sizeof(_CD_File_Attribute));
-		if (table_attributes_view == NULL)
-		{
-			_cd_make_error(CD_ERROR_FILE, "Failed to open table_attributes_view of schema at index %d for file '%s'", table_index, schema_file_path.data);
-			_error = 1;
-			goto table_data_view_close;
+			_cd_make_error(CD_ERROR_FILE, "Attributes of table at index %llu are cut off in file '%s'", table_index, schema_file_path.data);
+			goto table_schemas_destroy;
 		}
 
-		CD_TableSchema schema = 
+		CD_TableSchema schema =
 		{
-			.attribute_indices = cc_hash_map_create(sizeof(uint64_t), file_table_schema.attrib_count_c),
-			.attributes = malloc(sizeof(CD_AttributeEx) * file_table_schema.attrib_count_c),
-			.stride = 0
+			.stride = 0,
+			.storage = file_table_schema->storage,
+			.page_rows = file_table_schema->page_rows,
+			.file_offset = table_offset,
+			.attribute_count = file_table_schema->attrib_count_c,
+			.attribute_indices = NULL,
+			.attributes = NULL,
+			.indices = NULL
 		};
 
-		for(uint64_t attrib_index = 0; attrib_index < file_table_schema.attrib_count_c; attrib_index++)
-		{
-			_CD_File_Attribute file_attribute;
-
-			if (!cf_file_view_read(table_attributes_view, attrib_index * sizeof(file_attribute), sizeof(file_attribute), &file_attribute))
-			{
-				_cd_make_error(CD_ERROR_FILE, "Failed to read attribute_data of schema at attribute_index %d and at table_index %d for file '%s'", attrib_index, table_index, schema_file_path.data);
-				_error = 1;
-				goto schema_destroy;
-			}
-
-			// insert attrib index into hash map
-			{
-				CC_String attribute_name = cc_string_create(file_attribute.name, 0);
-				cc_hash_map_insert(schema.attribute_indices, attribute_name, &attrib_index);
-				cc_string_destroy(attribute_name);
-			}
-
-			CD_AttributeEx *attribute = schema.attributes + attrib_index;
-
-			memset(attribute->name, 0, CD_NAME_LENGTH);
-			strcpy_s(attribute->name, CD_NAME_LENGTH, file_attribute.name);
-			attribute->type = file_attribute.type;
-			attribute->count = file_attribute.count;
-			attribute->constraints = file_attribute.constraints;
-			attribute->offset = schema.stride;
-			attribute->size = cd_attribute_size(file_attribute.type, file_attribute.count);
-
-			schema.stride += attribute->size;
-		}
-
-		table_offset += sizeof(file_table_schema) + file_table_schema.attrib_count_m * sizeof(_CD_File_Attribute);
-
 		// insert schema into hash map
 		{
-			CC_String table_name = cc_string_create(file_table_schema.name, 0);
+			CC_String table_name = cc_string_create(file_table_schema->name, 0);
 			cc_hash_map_insert(table_schemas, table_name, &schema);
 			cc_string_destroy(table_name);
 		}
 
-	schema_destroy:
-		if(_error)
-		{
-			cc_hash_map_destroy(schema.attribute_indices);
-			free(schema.attributes);
-		}
-	table_data_view_close:
-		cf_file_view_close(table_data_view);
-		if(_error)
-		{
-			goto table_schemas_destroy;
-		}
+		table_offset = attributes_offset + file_table_schema->attrib_count_m * sizeof(_CD_File_Attribute);
 	}
 
 	CD_Database *db = malloc(sizeof(*db));
@@ -233,20 +199,38 @@ CD_Database *cd_database_open(const char *name)
 
 	db->table_schemas = table_schemas;
 
+	db->table_lock = _cd_mutex_create();
+	db->open_tables = cc_hash_map_create(sizeof(CD_Table *), CD_TABLE_CACHE_SIZE_DEFAULT);
+	db->idle_first = NULL;
+	db->idle_last = NULL;
+	db->table_cache_size = CD_TABLE_CACHE_SIZE_DEFAULT;
+
 	db->schema_file = schema_file;
 	db->schema_count_view = schema_count_view;
+	db->schema_data = schema_data;
 
-	return db;
+	db->thread_count = 1;
 
-table_schemas_destroy:
-	for (CC_HashMap_Element *element = cc_hash_map_iterator_begin(table_schemas); element != cc_hash_map_iterator_end(table_schemas); element = cc_hash_map_iterator_next(table_schemas, element))
-	{
-		CD_TableSchema *schema = (CD_TableSchema *)element->data;
+	db->stats = (CD_Stats){ 0 };
 
-		cc_hash_map_destroy(schema->attribute_indices);
-		free(schema->attributes);
+	// the kernels are picked before threads of the database scan with them
+	_cd_kernel_init();
+
+	// inserts logged before a crash are put back before any table is used
+	db->wal = NULL;
+	db->wal = _cd_wal_open(db);
+	if (db->wal == NULL)
+	{
+		cd_database_close(db);
+		return NULL;
 	}
+
+	return db;
+
+table_schemas_destroy:
 	cc_hash_map_destroy(table_schemas);
+schema_data_free:
+	free(schema_data);
 schema_count_view_close:
 	cf_file_view_close(schema_count_view);
 schema_file_close:
@@ -260,17 +244,139 @@ schema_file_path_destroy:
 
 void cd_database_close(CD_Database *db)
 {
+	// the log is checkpointed before the tables it wrote are closed
+	_cd_wal_close(db->wal);
+
+	for (CC_HashMap_Element *element = cc_hash_map_iterator_begin(db->open_tables); element != cc_hash_map_iterator_end(db->open_tables); element = cc_hash_map_iterator_next(db->open_tables, element))
+	{
+		_cd_table_destroy(*(CD_Table **)element->data);
+	}
+	cc_hash_map_destroy(db->open_tables);
+	_cd_mutex_destroy(db->table_lock);
+
 	for (CC_HashMap_Element *element = cc_hash_map_iterator_begin(db->table_schemas); element != cc_hash_map_iterator_end(db->table_schemas); element = cc_hash_map_iterator_next(db->table_schemas, element))
 	{
 		CD_TableSchema *schema = (CD_TableSchema *)element->data;
 
-		cc_hash_map_destroy(schema->attribute_indices);
+		if (schema->attribute_indices != NULL)
+		{
+			cc_hash_map_destroy(schema->attribute_indices);
+		}
 		free(schema->attributes);
+		free(schema->indices);
 	}
 	cc_hash_map_destroy(db->table_schemas);
 
+	free(db->schema_data);
 	cf_file_view_close(db->schema_count_view);
 	cf_file_close(db->schema_file);
 
+	cc_string_destroy(db->schema_file_path);
+	cc_string_destroy(db->name);
+
 	free(db);
 }
+
+void _cd_table_schema_materialize(CD_Database *db, CD_TableSchema *schema)
+{
+	if (schema->attribute_indices != NULL)
+	{
+		return;
+	}
+
+	// tables created after the database was opened were materialized by cd_table_create_ex, the others are in schema_data
+	const _CD_File_Attribute *file_attributes = (const _CD_File_Attribute *)(db->schema_data + schema->file_offset + sizeof(_CD_File_TableSchema));
+
+	CD_AttributeEx *attributes = malloc(sizeof(CD_AttributeEx) * schema->attribute_count);
+	uint64_t *indices = malloc(sizeof(uint64_t) * schema->attribute_count);
+	CC_HashMap *attribute_indices = cc_hash_map_create(sizeof(uint64_t), schema->attribute_count);
+
+	uint64_t stride = 0;
+	for (uint64_t attrib_index = 0; attrib_index < schema->attribute_count; attrib_index++)
+	{
+		const _CD_File_Attribute *file_attribute = file_attributes + attrib_index;
+
+		// insert attrib index into hash map
+		{
+			CC_String attribute_name = cc_string_create(file_attribute->name, 0);
+			cc_hash_map_insert(attribute_indices, attribute_name, &attrib_index);
+			cc_string_destroy(attribute_name);
+		}
+
+		CD_AttributeEx *attribute = attributes + attrib_index;
+
+		memset(attribute->name, 0, CD_NAME_LENGTH);
+		strcpy_s(attribute->name, CD_NAME_LENGTH, file_attribute->name);
+		attribute->type = file_attribute->type;
+		attribute->count = file_attribute->count;
+		attribute->constraints = file_attribute->constraints;
+		attribute->offset = stride;
+		attribute->size = cd_attribute_size(file_attribute->type, file_attribute->count);
+		attribute->encoding = file_attribute->encoding;
+
+		indices[attrib_index] = file_attribute->indices;
+		stride += _cd_attribute_stored_size(attribute);
+	}
+
+	schema->stride = stride;
+	schema->attributes = attributes;
+	schema->indices = indices;
+	schema->attribute_indices = attribute_indices;
+}
+
+void cd_database_thread_count_set(CD_Database *db, uint64_t thread_count)
+{
+	if (thread_count == 0)
+	{
+		thread_count = _cd_cpu_count();
+	}
+	db->thread_count = thread_count;
+}
+
+uint64_t cd_database_thread_count_get(CD_Database *db)
+{
+	return db->thread_count;
+}
+
+void cd_database_table_cache_size_set(CD_Database *db, uint64_t table_count)
+{
+	_cd_mutex_lock(db->table_lock);
+	db->table_cache_size = table_count;
+	_cd_table_cache_trim(db);
+	_cd_mutex_unlock(db->table_lock);
+}
+
+uint64_t cd_database_table_cache_size_get(CD_Database *db)
+{
+	return db->table_cache_size;
+}
+
+uint64_t cd_database_durability_set(CD_Database *db, uint64_t durability)
+{
+	return _cd_wal_durability_set(db->wal, durability);
+}
+
+uint64_t cd_database_durability_get(CD_Database *db)
+{
+	return db->wal->durability;
+}
+
+uint64_t cd_database_sync(CD_Database *db)
+{
+	return _cd_wal_sync(db->wal);
+}
+
+uint64_t cd_database_checkpoint(CD_Database *db)
+{
+	return _cd_wal_checkpoint(db->wal);
+}
+
+CD_Stats cd_database_stats_get(CD_Database *db)
+{
+	return _cd_stats_load(&db->stats);
+}
+
+void cd_database_stats_reset(CD_Database *db)
+{
+	_cd_stats_clear(&db->stats);
+}
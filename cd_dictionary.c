@@ -0,0 +1,299 @@
+#include "internal.h"
+
+// the file holds the header followed by the values in code order. values are only ever added: the writer writes a new
+// value and then the header before the rows that use its code, so every code stored in the table is in the file. the
+// values are kept in memory, selects decode from them while they hold the lock of the table shared
+
+static CC_String _cd_dictionary_path(CD_Table *table, uint64_t attribute_index)
+{
+	CC_StringBuffer *buffer = cc_string_buffer_create(CD_NAME_LENGTH);
+	cc_string_buffer_insert_string(buffer, table->db->name);
+	cc_string_buffer_insert_char(buffer, '/');
+	cc_string_buffer_insert_string(buffer, table->name);
+	cc_string_buffer_insert_char(buffer, '.');
+	CC_String attribute_name = cc_string_create(table->schema->attributes[attribute_index].name, 0);
+	cc_string_buffer_insert_string(buffer, attribute_name);
+	cc_string_destroy(attribute_name);
+	CC_String file_extension = cc_string_create(".dict", 0);
+	cc_string_buffer_insert_string(buffer, file_extension);
+	cc_string_destroy(file_extension);
+
+	return cc_string_buffer_to_string_and_destroy(buffer);
+}
+
+static uint64_t _cd_dictionary_map(CD_Dictionary *dictionary)
+{
+	dictionary->header_view = cf_file_view_open(dictionary->file, 0, sizeof(dictionary->header));
+	if (dictionary->header_view == NULL)
+	{
+		_cd_make_error(CD_ERROR_FILE, "Failed to open header view of dictionary file '%s'", dictionary->file_path.data);
+		return 0;
+	}
+
+	dictionary->value_view = cf_file_view_open(dictionary->file, sizeof(dictionary->header), dictionary->value_capacity * dictionary->size);
+	if (dictionary->value_view == NULL)
+	{
+		_cd_make_error(CD_ERROR_FILE, "Failed to open value view of dictionary file '%s'", dictionary->file_path.data);
+		return 0;
+	}
+
+	return 1;
+}
+
+static void _cd_dictionary_unmap(CD_Dictionary *dictionary)
+{
+	if (dictionary->value_view != NULL)
+	{
+		cf_file_view_close(dictionary->value_view);
+		dictionary->value_view = NULL;
+	}
+	if (dictionary->header_view != NULL)
+	{
+		cf_file_view_close(dictionary->header_view);
+		dictionary->header_view = NULL;
+	}
+}
+
+// the bytes after the null termination of VARCHAR/WVARCHAR values are cleared so equal values get one code
+static const void *_cd_dictionary_canonical(CD_Dictionary *dictionary, const void *value)
+{
+	uint64_t length = _cd_text_size(dictionary->type, value, dictionary->size);
+	if (length == dictionary->size)
+	{
+		return value;
+	}
+
+	memcpy(dictionary->scratch, value, length);
+	memset(dictionary->scratch + length, 0, dictionary->size - length);
+	return dictionary->scratch;
+}
+
+// puts every value in the slots, which are sized to stay at most half full
+static void _cd_dictionary_slots_build(CD_Dictionary *dictionary)
+{
+	uint64_t slot_count = 16;
+	while (slot_count < dictionary->header.value_count * 2)
+	{
+		slot_count *= 2;
+	}
+
+	free(dictionary->slots);
+	dictionary->slot_count = slot_count;
+	dictionary->slots = calloc(slot_count, sizeof(*dictionary->slots));
+
+	uint64_t mask = slot_count - 1;
+	for (uint64_t code = 0; code < dictionary->header.value_count; code++)
+	{
+		uint64_t slot = _cd_hash(dictionary->values + code * dictionary->size, dictionary->size) & mask;
+		while (dictionary->slots[slot] != 0)
+		{
+			slot = (slot + 1) & mask;
+		}
+		dictionary->slots[slot] = code + 1;
+	}
+}
+
+// makes room for value_capacity values in memory and in the file
+static uint64_t _cd_dictionary_reserve(CD_Table *table, CD_Dictionary *dictionary, uint64_t value_capacity)
+{
+	_cd_dictionary_unmap(dictionary);
+
+	if (!cf_file_resize(dictionary->file, sizeof(dictionary->header) + value_capacity * dictionary->size))
+	{
+		_cd_make_error(CD_ERROR_FILE, "Failed to resize dictionary file '%s'", dictionary->file_path.data);
+		return 0;
+	}
+
+	// selects decode from the values, they must not use the old ones meanwhile
+	_cd_rwlock_write_lock(table->lock);
+	dictionary->values = realloc(dictionary->values, value_capacity * dictionary->size);
+	dictionary->value_capacity = value_capacity;
+	_cd_rwlock_write_unlock(table->lock);
+
+	return _cd_dictionary_map(dictionary);
+}
+
+CD_Dictionary *_cd_dictionary_open(CD_Table *table, uint64_t attribute_index)
+{
+	const CD_AttributeEx *attribute = table->schema->attributes + attribute_index;
+
+	CD_Dictionary *dictionary = malloc(sizeof(*dictionary));
+
+	dictionary->file_path = _cd_dictionary_path(table, attribute_index);
+	dictionary->attribute_index = attribute_index;
+	dictionary->type = attribute->type;
+	dictionary->count = attribute->count;
+	dictionary->size = attribute->size;
+	dictionary->header.value_count = 1;
+	dictionary->header.value_size = attribute->size;
+	dictionary->value_capacity = CD_DICTIONARY_VALUES_START;
+	dictionary->values = NULL;
+	dictionary->slot_count = 0;
+	dictionary->slots = NULL;
+	dictionary->scratch = malloc(attribute->size);
+	dictionary->file = NULL;
+	dictionary->header_view = NULL;
+	dictionary->value_view = NULL;
+
+	// a new dictionary holds the zero value as code 0
+	uint64_t is_new = 0;
+	if (!cf_file_exists(dictionary->file_path))
+	{
+		if (!cf_file_create(dictionary->file_path, sizeof(dictionary->header) + dictionary->value_capacity * dictionary->size))
+		{
+			_cd_make_error(CD_ERROR_FILE, "Failed to create dictionary file '%s'", dictionary->file_path.data);
+			goto dictionary_close;
+		}
+		is_new = 1;
+	}
+
+	dictionary->file = cf_file_open(dictionary->file_path);
+	if (dictionary->file == NULL)
+	{
+		_cd_make_error(CD_ERROR_FILE, "Failed to open dictionary file '%s'", dictionary->file_path.data);
+		goto dictionary_close;
+	}
+
+	if (!is_new)
+	{
+		CF_FileView *header_view = cf_file_view_open(dictionary->file, 0, sizeof(dictionary->header));
+		if (header_view == NULL || !cf_file_view_read(header_view, 0, sizeof(dictionary->header), &dictionary->header))
+		{
+			_cd_make_error(CD_ERROR_FILE, "Failed to read header of dictionary file '%s'", dictionary->file_path.data);
+			if (header_view != NULL)
+			{
+				cf_file_view_close(header_view);
+			}
+			goto dictionary_close;
+		}
+		cf_file_view_close(header_view);
+
+		// the codes in the table can not be decoded with any other dictionary, it is not built again
+		uint64_t file_size = cf_file_size_get(dictionary->file);
+		if (dictionary->header.value_size != attribute->size || dictionary->header.value_count == 0 || file_size < sizeof(dictionary->header) + dictionary->header.value_count * dictionary->size)
+		{
+			_cd_make_error(CD_ERROR_FILE, "Dictionary file '%s' does not match attribute '%s' of table '%s'", dictionary->file_path.data, attribute->name, table->name.data);
+			goto dictionary_close;
+		}
+
+		dictionary->value_capacity = (file_size - sizeof(dictionary->header)) / dictionary->size;
+	}
+
+	dictionary->values = calloc(dictionary->value_capacity, dictionary->size);
+	if (!_cd_dictionary_map(dictionary))
+	{
+		goto dictionary_close;
+	}
+
+	if (is_new)
+	{
+		if (!cf_file_view_write(dictionary->value_view, 0, dictionary->size, dictionary->values) || !cf_file_view_write(dictionary->header_view, 0, sizeof(dictionary->header), &dictionary->header))
+		{
+			_cd_make_error(CD_ERROR_FILE, "Failed to write dictionary file '%s'", dictionary->file_path.data);
+			goto dictionary_close;
+		}
+	}
+	else if (!cf_file_view_read(dictionary->value_view, 0, dictionary->header.value_count * dictionary->size, dictionary->values))
+	{
+		_cd_make_error(CD_ERROR_FILE, "Failed to read values of dictionary file '%s'", dictionary->file_path.data);
+		goto dictionary_close;
+	}
+
+	_cd_dictionary_slots_build(dictionary);
+
+	return dictionary;
+
+dictionary_close:
+	_cd_dictionary_close(dictionary);
+	return NULL;
+}
+
+void _cd_dictionary_close(CD_Dictionary *dictionary)
+{
+	if (dictionary != NULL)
+	{
+		_cd_dictionary_unmap(dictionary);
+		if (dictionary->file != NULL)
+		{
+			cf_file_close(dictionary->file);
+		}
+		free(dictionary->scratch);
+		free(dictionary->slots);
+		free(dictionary->values);
+		cc_string_destroy(dictionary->file_path);
+		free(dictionary);
+	}
+}
+
+uint64_t _cd_dictionary_encode(CD_Table *table, CD_Dictionary *dictionary, const void *value, uint64_t *code)
+{
+	value = _cd_dictionary_canonical(dictionary, value);
+
+	uint64_t mask = dictionary->slot_count - 1;
+	uint64_t slot = _cd_hash(value, dictionary->size) & mask;
+	for (; dictionary->slots[slot] != 0; slot = (slot + 1) & mask)
+	{
+		uint64_t slot_code = dictionary->slots[slot] - 1;
+		if (memcmp(dictionary->values + slot_code * dictionary->size, value, dictionary->size) == 0)
+		{
+			*code = slot_code;
+			return 1;
+		}
+	}
+
+	uint64_t new_code = dictionary->header.value_count;
+	if (new_code == dictionary->value_capacity && !_cd_dictionary_reserve(table, dictionary, dictionary->value_capacity * 2))
+	{
+		return 0;
+	}
+
+	// the value is in the file before the header counts it, and both before any row holds its code
+	memcpy(dictionary->values + new_code * dictionary->size, value, dictionary->size);
+	_CD_File_Dictionary header = { .value_count = new_code + 1, .value_size = dictionary->size };
+	if (!cf_file_view_write(dictionary->value_view, new_code * dictionary->size, dictionary->size, value) || !cf_file_view_write(dictionary->header_view, 0, sizeof(header), &header))
+	{
+		_cd_make_error(CD_ERROR_FILE, "Failed to write value %llu of dictionary file '%s'", new_code, dictionary->file_path.data);
+		return 0;
+	}
+	_cd_atomic_store_release(&dictionary->header.value_count, new_code + 1);
+
+	dictionary->slots[slot] = new_code + 1;
+	if (dictionary->header.value_count * 2 > dictionary->slot_count)
+	{
+		_cd_dictionary_slots_build(dictionary);
+	}
+
+	*code = new_code;
+	return 1;
+}
+
+const void *_cd_dictionary_decode(const CD_Dictionary *dictionary, uint64_t code)
+{
+	if (code >= _cd_atomic_load_acquire(&dictionary->header.value_count))
+	{
+		return dictionary->values;
+	}
+	return dictionary->values + code * dictionary->size;
+}
+
+uint64_t _cd_dictionary_find(const CD_Dictionary *dictionary, const void *value)
+{
+	// the slots belong to the writer, selects go through the values; a dictionary holds few of them. the values are
+	// canonical, value is compared like it was made canonical
+	uint64_t length = _cd_text_size(dictionary->type, value, dictionary->size);
+	uint64_t value_count = _cd_atomic_load_acquire(&dictionary->header.value_count);
+	for (uint64_t code = 0; code < value_count; code++)
+	{
+		const uint8_t *code_value = dictionary->values + code * dictionary->size;
+		if (memcmp(code_value, value, length) == 0 && (length == dictionary->size || _cd_text_size(dictionary->type, code_value, dictionary->size) == length))
+		{
+			return code;
+		}
+	}
+	return UINT64_MAX;
+}
+
+uint64_t _cd_dictionary_count(const CD_Dictionary *dictionary)
+{
+	return _cd_atomic_load_acquire(&dictionary->header.value_count);
+}
@@ -0,0 +1,555 @@
+#include "internal.h"
+
+#include <stdio.h>
+
+// entry words before the accumulators: row count and hash
+#define CD_GROUP_ENTRY_HEADER 2
+
+static const char *_cd_aggregate_function_names[] = { "COUNT", "SUM", "MIN", "MAX", "AVG" };
+
+static volatile uint64_t _cd_group_by_next_id = 0;
+
+static CC_String _cd_spill_path(CD_Table *table, uint64_t id, uint64_t level, uint64_t partition)
+{
+	char suffix[96];
+	snprintf(suffix, sizeof(suffix), ".group%llu_%llu_%llu", (unsigned long long)id, (unsigned long long)level, (unsigned long long)partition);
+
+	CC_StringBuffer *buffer = cc_string_buffer_create(CD_NAME_LENGTH);
+	cc_string_buffer_insert_string(buffer, table->db->name);
+	cc_string_buffer_insert_char(buffer, '/');
+	cc_string_buffer_insert_string(buffer, table->name);
+	CC_String file_extension = cc_string_create(suffix, 0);
+	cc_string_buffer_insert_string(buffer, file_extension);
+	cc_string_destroy(file_extension);
+
+	return cc_string_buffer_to_string_and_destroy(buffer);
+}
+
+// closes and deletes the file of partition, it can be spilled to again afterwards
+static void _cd_spill_partition_close(_CD_SpillPartition *partition)
+{
+	if (partition->file != NULL)
+	{
+		cf_file_close(partition->file);
+		cf_file_delete(partition->file_path);
+		partition->file = NULL;
+	}
+	free(partition->buffer);
+	partition->buffer = NULL;
+	partition->row_count = 0;
+	partition->buffered_count = 0;
+}
+
+// appends the buffered rows of partition to its file
+static uint64_t _cd_spill_flush(_CD_GroupBy *group_by, _CD_SpillPartition *partition)
+{
+	if (partition->buffered_count == 0)
+	{
+		return 1;
+	}
+
+	uint64_t offset = partition->row_count * group_by->stride;
+	uint64_t size = partition->buffered_count * group_by->stride;
+
+	uint64_t file_size = cf_file_size_get(partition->file);
+	if (file_size < offset + size)
+	{
+		// grow geometrically so a long spill does not resize the file on every flush
+		while (file_size < offset + size)
+		{
+			file_size *= 2;
+		}
+		if (!cf_file_resize(partition->file, file_size))
+		{
+			_cd_make_error(CD_ERROR_FILE, "Failed to resize spill file '%s'", partition->file_path.data);
+			return 0;
+		}
+	}
+
+	CF_FileView *view = cf_file_view_open(partition->file, offset, size);
+	if (view == NULL || !cf_file_view_write(view, 0, size, partition->buffer))
+	{
+		_cd_make_error(CD_ERROR_FILE, "Failed to write %llu rows to spill file '%s'", partition->buffered_count, partition->file_path.data);
+		if (view != NULL)
+		{
+			cf_file_view_close(view);
+		}
+		return 0;
+	}
+	cf_file_view_close(view);
+
+	partition->row_count += partition->buffered_count;
+	partition->buffered_count = 0;
+
+	return 1;
+}
+
+// moves a staged row to the partition of the current level picked by the next bits of its hash
+static uint64_t _cd_spill_row(_CD_GroupBy *group_by, uint64_t hash, const uint8_t *row)
+{
+	uint64_t level = group_by->level;
+
+	if (group_by->partitions[level] == NULL)
+	{
+		group_by->partitions[level] = malloc(sizeof(*group_by->partitions[level]) * CD_GROUP_BY_PARTITIONS);
+		for (uint64_t p = 0; p < CD_GROUP_BY_PARTITIONS; p++)
+		{
+			_CD_SpillPartition *partition = group_by->partitions[level] + p;
+
+			partition->file_path = _cd_spill_path(group_by->table, group_by->id, level, p);
+			partition->file = NULL;
+			partition->row_count = 0;
+			partition->buffered_count = 0;
+			partition->buffer = NULL;
+		}
+	}
+
+	uint64_t shift = 64 - CD_GROUP_BY_PARTITION_BITS * (level + 1);
+	_CD_SpillPartition *partition = group_by->partitions[level] + ((hash >> shift) & (CD_GROUP_BY_PARTITIONS - 1));
+
+	if (partition->file == NULL)
+	{
+		// a file left by a GROUP BY that did not finish is overwritten
+		if (cf_file_exists(partition->file_path))
+		{
+			cf_file_delete(partition->file_path);
+		}
+		if (!cf_file_create(partition->file_path, group_by->spill_rows * group_by->stride))
+		{
+			_cd_make_error(CD_ERROR_FILE, "Failed to create spill file '%s'", partition->file_path.data);
+			return 0;
+		}
+		partition->file = cf_file_open(partition->file_path);
+		if (partition->file == NULL)
+		{
+			_cd_make_error(CD_ERROR_FILE, "Failed to open spill file '%s'", partition->file_path.data);
+			return 0;
+		}
+		partition->buffer = malloc(group_by->spill_rows * group_by->stride);
+	}
+
+	memcpy(partition->buffer + partition->buffered_count * group_by->stride, row, group_by->stride);
+	partition->buffered_count++;
+
+	if (partition->buffered_count == group_by->spill_rows)
+	{
+		return _cd_spill_flush(group_by, partition);
+	}
+	return 1;
+}
+
+// entry of the group of key, or the empty entry it would be inserted at
+static uint64_t *_cd_group_by_find(_CD_GroupBy *group_by, uint64_t hash, const uint8_t *key)
+{
+	uint64_t mask = group_by->capacity - 1;
+	uint64_t key_word = CD_GROUP_ENTRY_HEADER + group_by->aggregate_count;
+
+	for (uint64_t slot = hash & mask;; slot = (slot + 1) & mask)
+	{
+		uint64_t *entry = group_by->entries + slot * group_by->entry_words;
+		if (entry[0] == 0 || (entry[1] == hash && memcmp(entry + key_word, key, group_by->key_size) == 0))
+		{
+			return entry;
+		}
+	}
+}
+
+static void _cd_group_by_grow(_CD_GroupBy *group_by)
+{
+	uint64_t old_capacity = group_by->capacity;
+	uint64_t *old_entries = group_by->entries;
+
+	group_by->capacity *= 2;
+	group_by->entries = calloc(group_by->capacity, group_by->entry_words * sizeof(uint64_t));
+
+	uint64_t mask = group_by->capacity - 1;
+	for (uint64_t i = 0; i < old_capacity; i++)
+	{
+		const uint64_t *old_entry = old_entries + i * group_by->entry_words;
+		if (old_entry[0] == 0)
+		{
+			continue;
+		}
+
+		uint64_t slot = old_entry[1] & mask;
+		while (group_by->entries[slot * group_by->entry_words] != 0)
+		{
+			slot = (slot + 1) & mask;
+		}
+		memcpy(group_by->entries + slot * group_by->entry_words, old_entry, group_by->entry_words * sizeof(uint64_t));
+	}
+
+	free(old_entries);
+}
+
+// adds the value of a row to the accumulator of its group, which started as the value of the first row
+static void _cd_group_accumulate(const _CD_PreparedAggregate *aggregate, uint64_t *accumulator, const uint8_t *value)
+{
+	CD_uint_t uint_value, uint_accumulator;
+	CD_sint_t sint_value, sint_accumulator;
+	CD_float_t float_value, float_accumulator;
+
+	memcpy(&uint_value, value, sizeof(uint_value));
+	memcpy(&sint_value, value, sizeof(sint_value));
+	memcpy(&float_value, value, sizeof(float_value));
+	memcpy(&uint_accumulator, accumulator, sizeof(uint_accumulator));
+	memcpy(&sint_accumulator, accumulator, sizeof(sint_accumulator));
+	memcpy(&float_accumulator, accumulator, sizeof(float_accumulator));
+
+	uint64_t type = aggregate->attribute->type;
+	uint64_t is_picked = 0;
+
+	switch (aggregate->function)
+	{
+	case CD_AGGREGATE_SUM:
+	case CD_AGGREGATE_AVG:
+	{
+		// integer sums wrap, SINT sums are added as UINT
+		if (type == CD_TYPE_FLOAT)
+		{
+			float_accumulator += float_value;
+			memcpy(accumulator, &float_accumulator, sizeof(float_accumulator));
+		}
+		else
+		{
+			*accumulator = uint_accumulator + uint_value;
+		}
+		return;
+	}
+	case CD_AGGREGATE_MIN:
+	{
+		is_picked = type == CD_TYPE_UINT ? uint_value < uint_accumulator : type == CD_TYPE_SINT ? sint_value < sint_accumulator : float_value < float_accumulator;
+		break;
+	}
+	case CD_AGGREGATE_MAX:
+	{
+		is_picked = type == CD_TYPE_UINT ? uint_value > uint_accumulator : type == CD_TYPE_SINT ? sint_value > sint_accumulator : float_value > float_accumulator;
+		break;
+	}
+	}
+
+	if (is_picked)
+	{
+		*accumulator = uint_value;
+	}
+}
+
+uint64_t _cd_group_by_rows(_CD_GroupBy *group_by, const uint8_t *rows, uint64_t row_count)
+{
+	uint64_t key_word = CD_GROUP_ENTRY_HEADER + group_by->aggregate_count;
+
+	for (uint64_t r = 0; r < row_count; r++)
+	{
+		const uint8_t *row = rows + r * group_by->stride;
+		uint64_t hash = _cd_hash(row, group_by->key_size);
+
+		uint64_t *entry = _cd_group_by_find(group_by, hash, row);
+		uint64_t *accumulators = entry + CD_GROUP_ENTRY_HEADER;
+
+		if (entry[0] != 0)
+		{
+			entry[0]++;
+			for (uint64_t i = 0; i < group_by->aggregate_count; i++)
+			{
+				if (group_by->aggregates[i].attribute != NULL)
+				{
+					_cd_group_accumulate(group_by->aggregates + i, accumulators + i, row + group_by->value_offsets[i]);
+				}
+			}
+			continue;
+		}
+
+		// a new group; once the table is at its budget the rows of new groups wait in the spill files
+		if ((group_by->group_count + 1) * 2 > group_by->capacity)
+		{
+			if (group_by->capacity >= group_by->capacity_max && group_by->level < CD_GROUP_BY_SPILL_LEVELS)
+			{
+				if (!_cd_spill_row(group_by, hash, row))
+				{
+					return 0;
+				}
+				continue;
+			}
+
+			_cd_group_by_grow(group_by);
+			entry = _cd_group_by_find(group_by, hash, row);
+			accumulators = entry + CD_GROUP_ENTRY_HEADER;
+		}
+
+		entry[0] = 1;
+		entry[1] = hash;
+		memcpy(entry + key_word, row, group_by->key_size);
+		for (uint64_t i = 0; i < group_by->aggregate_count; i++)
+		{
+			accumulators[i] = 0;
+			if (group_by->aggregates[i].attribute != NULL)
+			{
+				memcpy(accumulators + i, row + group_by->value_offsets[i], sizeof(*accumulators));
+			}
+		}
+		group_by->group_count++;
+	}
+
+	return 1;
+}
+
+// appends the groups of the table to the view and empties the table
+static void _cd_group_by_emit(_CD_GroupBy *group_by)
+{
+	uint64_t key_word = CD_GROUP_ENTRY_HEADER + group_by->aggregate_count;
+	uint8_t *view_row = _cd_table_view_get_next_rows(group_by->view, group_by->group_count);
+
+	for (uint64_t i = 0; i < group_by->capacity; i++)
+	{
+		const uint64_t *entry = group_by->entries + i * group_by->entry_words;
+		if (entry[0] == 0)
+		{
+			continue;
+		}
+
+		memcpy(view_row, entry + key_word, group_by->key_size);
+		for (uint64_t a = 0; a < group_by->aggregate_count; a++)
+		{
+			CD_AggregateResult result;
+			_cd_aggregate_result(group_by->aggregates + a, entry[CD_GROUP_ENTRY_HEADER + a], entry[0], &result);
+			memcpy(view_row + group_by->key_size + a * sizeof(uint64_t), &result.uint_value, sizeof(uint64_t));
+		}
+		view_row += group_by->view->stride;
+	}
+
+	memset(group_by->entries, 0, group_by->capacity * group_by->entry_words * sizeof(uint64_t));
+	group_by->group_count = 0;
+}
+
+// groups the rows spilled at level one partition at a time; every group is in exactly one partition
+static uint64_t _cd_group_by_drain(_CD_GroupBy *group_by, uint64_t level)
+{
+	_CD_SpillPartition *partitions = group_by->partitions[level];
+	if (partitions == NULL)
+	{
+		return 1;
+	}
+
+	for (uint64_t p = 0; p < CD_GROUP_BY_PARTITIONS; p++)
+	{
+		_CD_SpillPartition *partition = partitions + p;
+		if (partition->file == NULL)
+		{
+			continue;
+		}
+
+		if (!_cd_spill_flush(group_by, partition))
+		{
+			return 0;
+		}
+
+		CF_FileView *view = cf_file_view_open(partition->file, 0, partition->row_count * group_by->stride);
+		if (view == NULL)
+		{
+			_cd_make_error(CD_ERROR_FILE, "Failed to open view of spill file '%s'", partition->file_path.data);
+			return 0;
+		}
+
+		// rows that still do not fit spill to the next level
+		group_by->level = level + 1;
+		for (uint64_t row = 0; row < partition->row_count; row += group_by->spill_rows)
+		{
+			uint64_t rows = partition->row_count - row < group_by->spill_rows ? partition->row_count - row : group_by->spill_rows;
+			if (!cf_file_view_read(view, row * group_by->stride, rows * group_by->stride, group_by->spill_read))
+			{
+				_cd_make_error(CD_ERROR_FILE, "Failed to read %llu rows at row %llu from spill file '%s'", rows, row, partition->file_path.data);
+				cf_file_view_close(view);
+				return 0;
+			}
+			if (!_cd_group_by_rows(group_by, group_by->spill_read, rows))
+			{
+				cf_file_view_close(view);
+				return 0;
+			}
+		}
+		cf_file_view_close(view);
+
+		_cd_spill_partition_close(partition);
+		_cd_group_by_emit(group_by);
+
+		if (!_cd_group_by_drain(group_by, level + 1))
+		{
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+CD_TableView *cd_table_group_by(CD_Table *table, uint64_t key_count, const char *key_names[], uint64_t condition_count, CD_Condition *conditions, uint64_t aggregate_count, CD_Aggregate aggregates[], uint64_t memory_budget)
+{
+	CD_TableView *table_view = NULL;
+	CD_PreparedSelect *select = NULL;
+
+	if (memory_budget == 0)
+	{
+		memory_budget = CD_GROUP_BY_MEMORY_BUDGET_DEFAULT;
+	}
+
+	_CD_GroupBy group_by =
+	{
+		.table = table,
+		.id = _cd_atomic_fetch_add(&_cd_group_by_next_id, 1),
+		.key_size = 0,
+		.stride = 0,
+		.aggregate_count = aggregate_count,
+		.aggregates = malloc(sizeof(*group_by.aggregates) * aggregate_count),
+		.value_offsets = malloc(sizeof(*group_by.value_offsets) * aggregate_count),
+		.entries = NULL,
+		.level = 0,
+		.partitions = { NULL },
+		.spill_read = NULL,
+		.view = NULL
+	};
+
+	// the select stages the keys followed by the value of every aggregate with an attribute
+	uint64_t staged_count = 0;
+	const char **staged_names = malloc(sizeof(*staged_names) * (key_count + aggregate_count));
+	uint64_t *staged_indices = malloc(sizeof(*staged_indices) * aggregate_count);
+	CD_AttributeEx *view_attributes = malloc(sizeof(*view_attributes) * (key_count + aggregate_count));
+
+	if (key_count == 0)
+	{
+		_cd_make_error(CD_ERROR_ATTRIBUTE_DOES_NOT_EXIST, "GROUP BY needs at least one key attribute. table: '%s'", table->name.data);
+		goto group_by_destroy;
+	}
+
+	for (uint64_t i = 0; i < key_count; i++)
+	{
+		const CD_AttributeEx *attribute = cd_table_attribute_by_name(table, key_names[i]);
+		if (attribute == NULL)
+		{
+			goto group_by_destroy;
+		}
+
+		// keys are compared byte by byte, which VARCHAR/WVARCHAR (bytes after the terminator) and FLOAT (-0.0, NaN) can not be
+		if (attribute->type != CD_TYPE_BYTE && attribute->type != CD_TYPE_UINT && attribute->type != CD_TYPE_SINT && attribute->type != CD_TYPE_CHAR && attribute->type != CD_TYPE_WCHAR)
+		{
+			_cd_make_error(CD_ERROR_UNKNOWN_TYPE, "Attribute '%s' can not be a GROUP BY key, it needs to be BYTE, UINT, SINT, CHAR or WCHAR. table: '%s'", key_names[i], table->name.data);
+			goto group_by_destroy;
+		}
+
+		staged_names[staged_count++] = key_names[i];
+		view_attributes[i] = *attribute;
+		view_attributes[i].offset = group_by.key_size;
+		view_attributes[i].encoding = CD_ENCODING_NONE;
+		group_by.key_size += attribute->size;
+	}
+
+	for (uint64_t i = 0; i < aggregate_count; i++)
+	{
+		_CD_PreparedAggregate *prepared = group_by.aggregates + i;
+		if (!_cd_aggregate_prepare(table, aggregates + i, prepared))
+		{
+			goto group_by_destroy;
+		}
+
+		CD_AttributeEx *view_attribute = view_attributes + key_count + i;
+		if (prepared->attribute != NULL)
+		{
+			staged_indices[i] = staged_count;
+			staged_names[staged_count++] = prepared->attribute->name;
+			// long attribute names are cut so the function and the parentheses fit
+			const char *function_name = _cd_aggregate_function_names[prepared->function];
+			int name_length = (int)(CD_NAME_LENGTH - strlen(function_name) - 3);
+			snprintf(view_attribute->name, sizeof(view_attribute->name), "%s(%.*s)", function_name, name_length, prepared->attribute->name);
+		}
+		else
+		{
+			snprintf(view_attribute->name, sizeof(view_attribute->name), "%s", _cd_aggregate_function_names[prepared->function]);
+		}
+		view_attribute->type = prepared->function == CD_AGGREGATE_COUNT ? CD_TYPE_UINT : prepared->function == CD_AGGREGATE_AVG ? CD_TYPE_FLOAT : prepared->attribute->type;
+		view_attribute->count = 1;
+		view_attribute->constraints = 0;
+		view_attribute->offset = group_by.key_size + i * sizeof(uint64_t);
+		view_attribute->size = sizeof(uint64_t);
+		view_attribute->encoding = CD_ENCODING_NONE;
+	}
+
+	select = cd_table_select_prepare(table, staged_count, staged_names, condition_count, conditions);
+	if (select == NULL)
+	{
+		goto group_by_destroy;
+	}
+
+	group_by.stride = select->data_stride;
+	for (uint64_t i = 0; i < aggregate_count; i++)
+	{
+		if (group_by.aggregates[i].attribute != NULL)
+		{
+			group_by.value_offsets[i] = select->attributes[staged_indices[i]].data_offset;
+		}
+	}
+
+	// the table grows from a size estimated from the rows towards the largest one the budget holds
+	group_by.entry_words = CD_GROUP_ENTRY_HEADER + aggregate_count + (group_by.key_size + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+	group_by.capacity_max = 16;
+	while (group_by.capacity_max * 2 * group_by.entry_words * sizeof(uint64_t) <= memory_budget)
+	{
+		group_by.capacity_max *= 2;
+	}
+	uint64_t row_count = _cd_atomic_load_acquire(&table->count.count_c);
+	uint64_t estimated_groups = row_count < CD_GROUP_BY_GROUPS_INITIAL ? row_count : CD_GROUP_BY_GROUPS_INITIAL;
+	group_by.capacity = 16;
+	while (group_by.capacity < estimated_groups * 2 && group_by.capacity < group_by.capacity_max)
+	{
+		group_by.capacity *= 2;
+	}
+	group_by.group_count = 0;
+	group_by.entries = calloc(group_by.capacity, group_by.entry_words * sizeof(uint64_t));
+
+	group_by.spill_rows = CD_GROUP_BY_SPILL_BUFFER_SIZE / group_by.stride + 1;
+	group_by.spill_read = malloc(group_by.spill_rows * group_by.stride);
+
+	group_by.view = _cd_table_view_create_from(key_count + aggregate_count, view_attributes, group_by.key_size + aggregate_count * sizeof(uint64_t));
+
+	// the groups are built on the calling thread, the staged rows of a chunk are dropped once they are grouped
+	cd_prepared_select_thread_count_set(select, 1);
+	select->group_by = &group_by;
+
+	CD_TableView *staged_view = cd_prepared_select(select, NULL);
+	if (staged_view == NULL)
+	{
+		goto group_by_destroy;
+	}
+	cd_table_view_destroy(staged_view);
+
+	_cd_group_by_emit(&group_by);
+	if (!_cd_group_by_drain(&group_by, 0))
+	{
+		goto group_by_destroy;
+	}
+
+	table_view = group_by.view;
+	group_by.view = NULL;
+
+group_by_destroy:
+	for (uint64_t level = 0; level < CD_GROUP_BY_SPILL_LEVELS; level++)
+	{
+		if (group_by.partitions[level] != NULL)
+		{
+			for (uint64_t p = 0; p < CD_GROUP_BY_PARTITIONS; p++)
+			{
+				_cd_spill_partition_close(group_by.partitions[level] + p);
+				cc_string_destroy(group_by.partitions[level][p].file_path);
+			}
+			free(group_by.partitions[level]);
+		}
+	}
+	cd_table_view_destroy(group_by.view);
+	free(group_by.spill_read);
+	free(group_by.entries);
+	cd_prepared_select_destroy(select);
+	free(view_attributes);
+	free(staged_indices);
+	free(staged_names);
+	free(group_by.value_offsets);
+	free(group_by.aggregates);
+
+	return table_view;
+}
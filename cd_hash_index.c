@@ -0,0 +1,431 @@
+#include "internal.h"
+
+// bucket layout in the file: hash and row + 1 (0 means the bucket is empty)
+typedef struct _CD_File_HashBucket
+{
+	uint64_t hash;
+	uint64_t row;
+} _CD_File_HashBucket;
+
+uint64_t _cd_hash(const void *data, uint64_t size)
+{
+	// FNV-1a followed by a final avalanche so the low bits can be used as bucket index
+	const uint8_t *bytes = data;
+	uint64_t hash = 0xcbf29ce484222325;
+	for (uint64_t i = 0; i < size; i++)
+	{
+		hash ^= bytes[i];
+		hash *= 0x100000001b3;
+	}
+	hash ^= hash >> 33;
+	hash *= 0xff51afd7ed558ccd;
+	hash ^= hash >> 33;
+	return hash;
+}
+
+static uint64_t _cd_hash_index_map(CD_HashIndex *index)
+{
+	index->header_view = cf_file_view_open(index->file, 0, sizeof(index->header));
+	if (index->header_view == NULL)
+	{
+		_cd_make_error(CD_ERROR_FILE, "Failed to open header view of index file '%s'", index->file_path.data);
+		return 0;
+	}
+
+	index->bucket_view = cf_file_view_open(index->file, sizeof(index->header), index->header.bucket_count * sizeof(_CD_File_HashBucket));
+	if (index->bucket_view == NULL)
+	{
+		_cd_make_error(CD_ERROR_FILE, "Failed to open bucket view of index file '%s'", index->file_path.data);
+		cf_file_view_close(index->header_view);
+		index->header_view = NULL;
+		return 0;
+	}
+
+	return 1;
+}
+
+static void _cd_hash_index_unmap(CD_HashIndex *index)
+{
+	if (index->bucket_view != NULL)
+	{
+		cf_file_view_close(index->bucket_view);
+		index->bucket_view = NULL;
+	}
+	if (index->header_view != NULL)
+	{
+		cf_file_view_close(index->header_view);
+		index->header_view = NULL;
+	}
+}
+
+static uint64_t _cd_hash_index_place(CD_HashIndex *index, _CD_File_HashBucket bucket)
+{
+	uint64_t mask = index->header.bucket_count - 1;
+	for (uint64_t slot = bucket.hash & mask;; slot = (slot + 1) & mask)
+	{
+		_CD_File_HashBucket current;
+		if (!cf_file_view_read(index->bucket_view, slot * sizeof(current), sizeof(current), &current))
+		{
+			_cd_make_error(CD_ERROR_FILE, "Failed to read bucket %llu of index file '%s'", slot, index->file_path.data);
+			return 0;
+		}
+		if (current.row == 0)
+		{
+			if (!cf_file_view_write(index->bucket_view, slot * sizeof(bucket), sizeof(bucket), &bucket))
+			{
+				_cd_make_error(CD_ERROR_FILE, "Failed to write bucket %llu of index file '%s'", slot, index->file_path.data);
+				return 0;
+			}
+			return 1;
+		}
+	}
+}
+
+// resizes the file to bucket_count buckets, clears them and resets the entry count
+static uint64_t _cd_hash_index_reset(CD_HashIndex *index, uint64_t bucket_count)
+{
+	_cd_hash_index_unmap(index);
+
+	index->header.bucket_count = bucket_count;
+	index->header.entry_count = 0;
+
+	uint64_t bucket_size = bucket_count * sizeof(_CD_File_HashBucket);
+	// shrink to the header first so the resize hands back zeroed buckets
+	if (!cf_file_resize(index->file, sizeof(index->header)) || !cf_file_resize(index->file, sizeof(index->header) + bucket_size))
+	{
+		_cd_make_error(CD_ERROR_FILE, "Failed to resize index file '%s'", index->file_path.data);
+		return 0;
+	}
+
+	if (!_cd_hash_index_map(index))
+	{
+		return 0;
+	}
+
+	if (!cf_file_view_write(index->header_view, 0, sizeof(index->header), &index->header))
+	{
+		_cd_make_error(CD_ERROR_FILE, "Failed to write header of index file '%s'", index->file_path.data);
+		return 0;
+	}
+
+	return 1;
+}
+
+static uint64_t _cd_hash_index_grow(CD_HashIndex *index)
+{
+	uint64_t return_value = 0;
+
+	uint64_t old_bucket_count = index->header.bucket_count;
+	uint64_t entry_count = index->header.entry_count;
+
+	_CD_File_HashBucket *buckets = malloc(old_bucket_count * sizeof(*buckets));
+	if (!cf_file_view_read(index->bucket_view, 0, old_bucket_count * sizeof(*buckets), buckets))
+	{
+		_cd_make_error(CD_ERROR_FILE, "Failed to read buckets of index file '%s'", index->file_path.data);
+		goto buckets_free;
+	}
+
+	if (!_cd_hash_index_reset(index, old_bucket_count * 2))
+	{
+		goto buckets_free;
+	}
+
+	// the stored hashes make rehashing possible without touching the table
+	for (uint64_t i = 0; i < old_bucket_count; i++)
+	{
+		if (buckets[i].row != 0 && !_cd_hash_index_place(index, buckets[i]))
+		{
+			goto buckets_free;
+		}
+	}
+
+	index->header.entry_count = entry_count;
+	if (!cf_file_view_write(index->header_view, 0, sizeof(index->header), &index->header))
+	{
+		_cd_make_error(CD_ERROR_FILE, "Failed to write header of index file '%s'", index->file_path.data);
+		goto buckets_free;
+	}
+
+	return_value = 1;
+
+buckets_free:
+	free(buckets);
+
+	return return_value;
+}
+
+uint64_t _cd_hash_index_find(CD_Table *table, CD_HashIndex *index, const void *value, uint64_t *row, uint64_t *compare_count)
+{
+	const CD_AttributeEx *attribute = table->schema->attributes + index->attribute_index;
+
+	uint64_t hash = _cd_hash(value, attribute->size);
+	uint64_t mask = index->header.bucket_count - 1;
+
+	for (uint64_t slot = hash & mask;; slot = (slot + 1) & mask)
+	{
+		_CD_File_HashBucket bucket;
+		if (!cf_file_view_read(index->bucket_view, slot * sizeof(bucket), sizeof(bucket), &bucket))
+		{
+			_cd_make_error(CD_ERROR_FILE, "Failed to read bucket %llu of index file '%s'", slot, index->file_path.data);
+			return 0;
+		}
+
+		if (bucket.row == 0)
+		{
+			return 0;
+		}
+
+		// entries of deleted rows and of rows a vacuum dropped are left behind
+		uint64_t bucket_row = bucket.row - 1;
+		if (bucket.hash == hash && bucket_row < table->count.count_c && !_cd_table_row_is_deleted(table, bucket_row))
+		{
+			if (!_cd_table_values_read(table, attribute, bucket_row, 1, index->buffer))
+			{
+				return 0;
+			}
+			(*compare_count)++;
+			if (memcmp(value, index->buffer, attribute->size) == 0)
+			{
+				if (row != NULL)
+				{
+					*row = bucket_row;
+				}
+				return 1;
+			}
+		}
+	}
+}
+
+uint64_t _cd_hash_index_insert(CD_HashIndex *index, const void *value, uint64_t size, uint64_t row)
+{
+	// keep the load factor at or below one half
+	if ((index->header.entry_count + 1) * 2 > index->header.bucket_count)
+	{
+		if (!_cd_hash_index_grow(index))
+		{
+			return 0;
+		}
+	}
+
+	_CD_File_HashBucket bucket =
+	{
+		.hash = _cd_hash(value, size),
+		.row = row + 1
+	};
+
+	if (!_cd_hash_index_place(index, bucket))
+	{
+		return 0;
+	}
+
+	index->header.entry_count++;
+	// rows freed by a delete are reused, so row can be below the rows already indexed
+	if (row + 1 > index->header.row_count)
+	{
+		index->header.row_count = row + 1;
+	}
+	if (!cf_file_view_write(index->header_view, 0, sizeof(index->header), &index->header))
+	{
+		_cd_make_error(CD_ERROR_FILE, "Failed to write header of index file '%s'", index->file_path.data);
+		return 0;
+	}
+
+	return 1;
+}
+
+uint64_t _cd_hash_index_commit(CD_HashIndex *index)
+{
+	if (!cf_file_view_write(index->header_view, 0, sizeof(index->header), &index->header))
+	{
+		_cd_make_error(CD_ERROR_FILE, "Failed to write header of index file '%s'", index->file_path.data);
+		return 0;
+	}
+	return 1;
+}
+
+uint64_t _cd_hash_index_build(CD_Table *table, const CD_HashIndex *index, _CD_HashIndexBuild *build)
+{
+	const CD_AttributeEx *attribute = table->schema->attributes + index->attribute_index;
+	uint64_t count_c = table->count.count_c;
+
+	uint64_t bucket_count = CD_HASH_INDEX_BUCKETS_START;
+	while (bucket_count < count_c * 2)
+	{
+		bucket_count *= 2;
+	}
+
+	_CD_File_HashBucket *buckets = calloc(bucket_count, sizeof(*buckets));
+	void *value = malloc(attribute->size);
+	uint64_t mask = bucket_count - 1;
+	for (uint64_t row = 0; row < count_c; row++)
+	{
+		if (!_cd_table_values_read(table, attribute, row, 1, value))
+		{
+			free(value);
+			free(buckets);
+			return 0;
+		}
+
+		_CD_File_HashBucket bucket =
+		{
+			.hash = _cd_hash(value, attribute->size),
+			.row = row + 1
+		};
+
+		uint64_t slot = bucket.hash & mask;
+		while (buckets[slot].row != 0)
+		{
+			slot = (slot + 1) & mask;
+		}
+		buckets[slot] = bucket;
+	}
+	free(value);
+
+	build->header.bucket_count = bucket_count;
+	build->header.entry_count = count_c;
+	build->header.row_count = count_c;
+	build->buckets = buckets;
+
+	return 1;
+}
+
+uint64_t _cd_hash_index_swap(CD_HashIndex *index, _CD_HashIndexBuild *build)
+{
+	uint64_t return_value = 0;
+
+	if (!_cd_hash_index_reset(index, build->header.bucket_count))
+	{
+		goto buckets_free;
+	}
+
+	if (!cf_file_view_write(index->bucket_view, 0, build->header.bucket_count * sizeof(_CD_File_HashBucket), build->buckets))
+	{
+		_cd_make_error(CD_ERROR_FILE, "Failed to write buckets of index file '%s'", index->file_path.data);
+		goto buckets_free;
+	}
+
+	index->header = build->header;
+	if (!cf_file_view_write(index->header_view, 0, sizeof(index->header), &index->header))
+	{
+		_cd_make_error(CD_ERROR_FILE, "Failed to write header of index file '%s'", index->file_path.data);
+		goto buckets_free;
+	}
+
+	return_value = 1;
+
+buckets_free:
+	free(build->buckets);
+	build->buckets = NULL;
+
+	return return_value;
+}
+
+uint64_t _cd_hash_index_rebuild(CD_Table *table, CD_HashIndex *index)
+{
+	_CD_HashIndexBuild build;
+	return _cd_hash_index_build(table, index, &build) && _cd_hash_index_swap(index, &build);
+}
+
+CD_HashIndex *_cd_hash_index_open(CD_Table *table, uint64_t attribute_index)
+{
+	const CD_AttributeEx *attribute = table->schema->attributes + attribute_index;
+
+	CC_String file_path;
+	{
+		CC_StringBuffer *buffer = cc_string_buffer_create(CD_NAME_LENGTH);
+		cc_string_buffer_insert_string(buffer, table->db->name);
+		cc_string_buffer_insert_char(buffer, '/');
+		cc_string_buffer_insert_string(buffer, table->name);
+		cc_string_buffer_insert_char(buffer, '.');
+		CC_String attribute_name = cc_string_create(attribute->name, 0);
+		cc_string_buffer_insert_string(buffer, attribute_name);
+		cc_string_destroy(attribute_name);
+		CC_String file_extension = cc_string_create(".hash", 0);
+		cc_string_buffer_insert_string(buffer, file_extension);
+		cc_string_destroy(file_extension);
+
+		file_path = cc_string_buffer_to_string_and_destroy(buffer);
+	}
+
+	uint64_t rebuild = 0;
+	if (!cf_file_exists(file_path))
+	{
+		if (!cf_file_create(file_path, sizeof(_CD_File_HashIndex)))
+		{
+			_cd_make_error(CD_ERROR_FILE, "Failed to create index file '%s'", file_path.data);
+			goto file_path_destroy;
+		}
+		rebuild = 1;
+	}
+
+	CF_File *file = cf_file_open(file_path);
+	if (file == NULL)
+	{
+		_cd_make_error(CD_ERROR_FILE, "Failed to open index file '%s'", file_path.data);
+		goto file_path_destroy;
+	}
+
+	CD_HashIndex *index = malloc(sizeof(*index));
+
+	index->file_path = file_path;
+	index->attribute_index = attribute_index;
+	index->buffer = malloc(attribute->size);
+	index->file = file;
+	index->header_view = NULL;
+	index->bucket_view = NULL;
+	index->header.bucket_count = 0;
+	index->header.entry_count = 0;
+	index->header.row_count = 0;
+
+	if (!rebuild)
+	{
+		CF_FileView *header_view = cf_file_view_open(file, 0, sizeof(index->header));
+		if (header_view == NULL || !cf_file_view_read(header_view, 0, sizeof(index->header), &index->header))
+		{
+			_cd_make_error(CD_ERROR_FILE, "Failed to read header of index file '%s'", file_path.data);
+			if (header_view != NULL)
+			{
+				cf_file_view_close(header_view);
+			}
+			goto index_close;
+		}
+		cf_file_view_close(header_view);
+
+		// an index that does not cover exactly the rows of the table is stale (e.g. after a crash)
+		uint64_t file_size = sizeof(index->header) + index->header.bucket_count * sizeof(_CD_File_HashBucket);
+		if (index->header.row_count != table->count.count_c || index->header.bucket_count == 0 || (index->header.bucket_count & (index->header.bucket_count - 1)) != 0 || cf_file_size_get(file) < file_size)
+		{
+			rebuild = 1;
+		}
+		else if (!_cd_hash_index_map(index))
+		{
+			goto index_close;
+		}
+	}
+
+	if (rebuild && !_cd_hash_index_rebuild(table, index))
+	{
+		goto index_close;
+	}
+
+	return index;
+
+index_close:
+	_cd_hash_index_close(index);
+	return NULL;
+file_path_destroy:
+	cc_string_destroy(file_path);
+	return NULL;
+}
+
+void _cd_hash_index_close(CD_HashIndex *index)
+{
+	if (index != NULL)
+	{
+		_cd_hash_index_unmap(index);
+		cf_file_close(index->file);
+		free(index->buffer);
+		cc_string_destroy(index->file_path);
+		free(index);
+	}
+}
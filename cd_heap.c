@@ -0,0 +1,424 @@
+#include "internal.h"
+
+// the file holds the header followed by the values of the heap encoded attributes of the table back to back, without
+// their null termination. values are only appended: the writer writes a value and then the header before the row that
+// refers to it. values no row refers to any more stay until the heap is compacted
+
+static CC_String _cd_heap_path(CD_Table *table)
+{
+	CC_StringBuffer *buffer = cc_string_buffer_create(CD_NAME_LENGTH);
+	cc_string_buffer_insert_string(buffer, table->db->name);
+	cc_string_buffer_insert_char(buffer, '/');
+	cc_string_buffer_insert_string(buffer, table->name);
+	CC_String file_extension = cc_string_create(".heap", 0);
+	cc_string_buffer_insert_string(buffer, file_extension);
+	cc_string_destroy(file_extension);
+
+	return cc_string_buffer_to_string_and_destroy(buffer);
+}
+
+static uint64_t _cd_heap_map(CD_Heap *heap)
+{
+	heap->header_view = cf_file_view_open(heap->file, 0, sizeof(heap->header));
+	if (heap->header_view == NULL)
+	{
+		_cd_make_error(CD_ERROR_FILE, "Failed to open header view of heap file '%s'", heap->file_path.data);
+		return 0;
+	}
+
+	heap->value_view = cf_file_view_open(heap->file, sizeof(heap->header), heap->capacity);
+	if (heap->value_view == NULL)
+	{
+		_cd_make_error(CD_ERROR_FILE, "Failed to open value view of heap file '%s'", heap->file_path.data);
+		return 0;
+	}
+
+	return 1;
+}
+
+static void _cd_heap_unmap(CD_Heap *heap)
+{
+	if (heap->value_view != NULL)
+	{
+		cf_file_view_close(heap->value_view);
+		heap->value_view = NULL;
+	}
+	if (heap->header_view != NULL)
+	{
+		cf_file_view_close(heap->header_view);
+		heap->header_view = NULL;
+	}
+}
+
+// gives the file room for capacity bytes of values, selects must not read the old mapping meanwhile
+static uint64_t _cd_heap_resize(CD_Heap *heap, uint64_t capacity)
+{
+	_cd_heap_unmap(heap);
+
+	if (!cf_file_resize(heap->file, sizeof(heap->header) + capacity))
+	{
+		_cd_make_error(CD_ERROR_FILE, "Failed to resize heap file '%s'", heap->file_path.data);
+		return 0;
+	}
+	heap->capacity = capacity;
+
+	return _cd_heap_map(heap);
+}
+
+// the smallest capacity doubled from CD_HEAP_START that holds size bytes
+static uint64_t _cd_heap_capacity_next(uint64_t size)
+{
+	uint64_t capacity = CD_HEAP_START;
+	while (capacity < size)
+	{
+		capacity *= 2;
+	}
+	return capacity;
+}
+
+static void _cd_heap_reference_get(const _CD_HeapValue *heap_value, uint64_t *offset, uint32_t *length)
+{
+	memcpy(offset, heap_value->bytes, sizeof(*offset));
+	memcpy(length, heap_value->bytes + sizeof(*offset), sizeof(*length));
+}
+
+static void _cd_heap_reference_set(_CD_HeapValue *heap_value, uint64_t offset, uint32_t length)
+{
+	memcpy(heap_value->bytes, &offset, sizeof(offset));
+	memcpy(heap_value->bytes + sizeof(offset), &length, sizeof(length));
+	heap_value->is_reference = 1;
+}
+
+CD_Heap *_cd_heap_open(CD_Table *table)
+{
+	CD_Heap *heap = malloc(sizeof(*heap));
+
+	heap->file_path = _cd_heap_path(table);
+	heap->header.size = 0;
+	heap->capacity = CD_HEAP_START;
+	heap->file = NULL;
+	heap->header_view = NULL;
+	heap->value_view = NULL;
+
+	uint64_t is_new = 0;
+	if (!cf_file_exists(heap->file_path))
+	{
+		if (!cf_file_create(heap->file_path, sizeof(heap->header) + heap->capacity))
+		{
+			_cd_make_error(CD_ERROR_FILE, "Failed to create heap file '%s'", heap->file_path.data);
+			goto heap_close;
+		}
+		is_new = 1;
+	}
+
+	heap->file = cf_file_open(heap->file_path);
+	if (heap->file == NULL)
+	{
+		_cd_make_error(CD_ERROR_FILE, "Failed to open heap file '%s'", heap->file_path.data);
+		goto heap_close;
+	}
+
+	if (!is_new)
+	{
+		CF_FileView *header_view = cf_file_view_open(heap->file, 0, sizeof(heap->header));
+		if (header_view == NULL || !cf_file_view_read(header_view, 0, sizeof(heap->header), &heap->header))
+		{
+			_cd_make_error(CD_ERROR_FILE, "Failed to read header of heap file '%s'", heap->file_path.data);
+			if (header_view != NULL)
+			{
+				cf_file_view_close(header_view);
+			}
+			goto heap_close;
+		}
+		cf_file_view_close(header_view);
+
+		// the rows refer to the values, a heap that lost some can not be built again
+		uint64_t file_size = cf_file_size_get(heap->file);
+		if (file_size < sizeof(heap->header) || heap->header.size > file_size - sizeof(heap->header))
+		{
+			_cd_make_error(CD_ERROR_FILE, "Heap file '%s' is shorter than its %llu bytes of values", heap->file_path.data, heap->header.size);
+			goto heap_close;
+		}
+
+		heap->capacity = file_size - sizeof(heap->header);
+	}
+
+	if (!_cd_heap_map(heap))
+	{
+		goto heap_close;
+	}
+
+	if (is_new && !cf_file_view_write(heap->header_view, 0, sizeof(heap->header), &heap->header))
+	{
+		_cd_make_error(CD_ERROR_FILE, "Failed to write header of heap file '%s'", heap->file_path.data);
+		goto heap_close;
+	}
+
+	return heap;
+
+heap_close:
+	_cd_heap_close(heap);
+	return NULL;
+}
+
+void _cd_heap_close(CD_Heap *heap)
+{
+	if (heap != NULL)
+	{
+		_cd_heap_unmap(heap);
+		if (heap->file != NULL)
+		{
+			cf_file_close(heap->file);
+		}
+		cc_string_destroy(heap->file_path);
+		free(heap);
+	}
+}
+
+uint64_t _cd_heap_encode(CD_Table *table, CD_Heap *heap, const CD_AttributeEx *attribute, const void *value, void *stored_value)
+{
+	_CD_HeapValue heap_value = { 0 };
+
+	uint64_t length = _cd_text_size(attribute->type, value, attribute->size);
+	if (length <= CD_HEAP_INLINE_SIZE)
+	{
+		memcpy(heap_value.bytes, value, length);
+		memcpy(stored_value, &heap_value, sizeof(heap_value));
+		return 1;
+	}
+
+	uint64_t offset = heap->header.size;
+	if (offset + length > heap->capacity)
+	{
+		// selects read the values through the mapping that is replaced
+		_cd_rwlock_write_lock(table->lock);
+		uint64_t is_grown = _cd_heap_resize(heap, _cd_heap_capacity_next(offset + length));
+		_cd_rwlock_write_unlock(table->lock);
+		if (!is_grown)
+		{
+			return 0;
+		}
+	}
+
+	// the value is in the file before the header counts it, and both before any row refers to it
+	_CD_File_Heap header = { .size = offset + length };
+	if (!cf_file_view_write(heap->value_view, offset, length, value) || !cf_file_view_write(heap->header_view, 0, sizeof(header), &header))
+	{
+		_cd_make_error(CD_ERROR_FILE, "Failed to write %llu bytes at offset %llu of heap file '%s'", length, offset, heap->file_path.data);
+		return 0;
+	}
+	_cd_atomic_store_release(&heap->header.size, offset + length);
+
+	_cd_heap_reference_set(&heap_value, offset, (uint32_t)length);
+	memcpy(stored_value, &heap_value, sizeof(heap_value));
+	return 1;
+}
+
+uint64_t _cd_heap_decode(const CD_Heap *heap, uint64_t size, const void *stored_value, void *value)
+{
+	const _CD_HeapValue *heap_value = stored_value;
+
+	if (!heap_value->is_reference)
+	{
+		uint64_t inline_size = size < CD_HEAP_INLINE_SIZE ? size : CD_HEAP_INLINE_SIZE;
+		memcpy(value, heap_value->bytes, inline_size);
+		memset((uint8_t *)value + inline_size, 0, size - inline_size);
+		return 1;
+	}
+
+	uint64_t offset;
+	uint32_t length;
+	_cd_heap_reference_get(heap_value, &offset, &length);
+	if (length > size || offset + length > _cd_atomic_load_acquire(&heap->header.size) || !cf_file_view_read(heap->value_view, offset, length, value))
+	{
+		_cd_make_error(CD_ERROR_FILE, "Failed to read %u bytes at offset %llu of heap file '%s'", length, offset, heap->file_path.data);
+		return 0;
+	}
+	memset((uint8_t *)value + length, 0, size - length);
+	return 1;
+}
+
+uint64_t _cd_heap_value_length(const void *stored_value)
+{
+	const _CD_HeapValue *heap_value = stored_value;
+	if (!heap_value->is_reference)
+	{
+		return 0;
+	}
+
+	uint64_t offset;
+	uint32_t length;
+	_cd_heap_reference_get(heap_value, &offset, &length);
+	return length;
+}
+
+// a value of a row in the heap, compaction moves them in the order of their offsets
+typedef struct _CD_HeapReference
+{
+	uint64_t offset;
+	uint64_t length;
+	uint64_t row;
+	const CD_AttributeEx *attribute;
+} _CD_HeapReference;
+
+static int _cd_heap_reference_compare(const void *reference1, const void *reference2)
+{
+	uint64_t offset1 = ((const _CD_HeapReference *)reference1)->offset;
+	uint64_t offset2 = ((const _CD_HeapReference *)reference2)->offset;
+	return offset1 < offset2 ? -1 : offset1 > offset2;
+}
+
+// collects the references of the rows that are not deleted, the writer and the lock of the table must be held. the
+// values of deleted rows are dropped, their references become empty inline values so every row still decodes
+static uint64_t _cd_heap_references_collect(CD_Table *table, _CD_HeapReference **references, uint64_t *reference_count)
+{
+	uint64_t attribute_count = cc_hash_map_count(table->schema->attribute_indices);
+	uint64_t count_c = table->count.count_c;
+
+	uint64_t reference_capacity = 0;
+	_CD_HeapValue heap_values[256];
+	for (uint64_t attrib_index = 0; attrib_index < attribute_count; attrib_index++)
+	{
+		const CD_AttributeEx *attribute = table->schema->attributes + attrib_index;
+		if (attribute->encoding != CD_ENCODING_HEAP)
+		{
+			continue;
+		}
+
+		for (uint64_t row = 0; row < count_c;)
+		{
+			uint64_t rows = count_c - row < sizeof(heap_values) / sizeof(*heap_values) ? count_c - row : sizeof(heap_values) / sizeof(*heap_values);
+			if (!_cd_table_column_read(table, attribute, row, rows, heap_values))
+			{
+				return 0;
+			}
+
+			for (uint64_t i = 0; i < rows; i++)
+			{
+				if (!heap_values[i].is_reference)
+				{
+					continue;
+				}
+				if (_cd_table_row_is_deleted(table, row + i))
+				{
+					_CD_HeapValue empty_value = { 0 };
+					if (!_cd_table_column_write(table, attribute, row + i, 1, &empty_value))
+					{
+						return 0;
+					}
+					continue;
+				}
+
+				if (*reference_count == reference_capacity)
+				{
+					reference_capacity = reference_capacity == 0 ? 1024 : reference_capacity * 2;
+					*references = realloc(*references, sizeof(**references) * reference_capacity);
+				}
+
+				_CD_HeapReference *reference = *references + (*reference_count)++;
+				uint32_t length;
+				_cd_heap_reference_get(heap_values + i, &reference->offset, &length);
+				reference->length = length;
+				reference->row = row + i;
+				reference->attribute = attribute;
+			}
+
+			row += rows;
+		}
+	}
+
+	return 1;
+}
+
+uint64_t cd_table_heap_compact(CD_Table *table)
+{
+	CD_Heap *heap = table->heap;
+	if (heap == NULL)
+	{
+		return 1;
+	}
+
+	uint64_t return_value = 0;
+
+	_cd_mutex_lock(table->writer_lock);
+
+	// replaying inserts logged before would write rows that refer to values at their old offsets
+	if (!_cd_wal_checkpoint(table->db->wal))
+	{
+		goto writer_unlock;
+	}
+
+	// values move, selects wait for the whole compaction
+	_cd_rwlock_write_lock(table->lock);
+
+	_CD_HeapReference *references = NULL;
+	uint64_t reference_count = 0;
+	uint8_t *buffer = NULL;
+	if (!_cd_heap_references_collect(table, &references, &reference_count))
+	{
+		goto references_free;
+	}
+
+	qsort(references, reference_count, sizeof(*references), _cd_heap_reference_compare);
+
+	// every value moves to the end of the ones before it, never past where it was. rows updated together refer to
+	// the same value
+	uint64_t size = 0;
+	uint64_t new_offset = 0;
+	uint64_t buffer_size = 0;
+	for (uint64_t i = 0; i < reference_count; i++)
+	{
+		const _CD_HeapReference *reference = references + i;
+
+		if (i == 0 || reference->offset != references[i - 1].offset)
+		{
+			new_offset = size;
+			if (reference->offset != new_offset)
+			{
+				if (reference->length > buffer_size)
+				{
+					buffer_size = reference->length;
+					buffer = realloc(buffer, buffer_size);
+				}
+				if (!cf_file_view_read(heap->value_view, reference->offset, reference->length, buffer) || !cf_file_view_write(heap->value_view, new_offset, reference->length, buffer))
+				{
+					_cd_make_error(CD_ERROR_FILE, "Failed to move %llu bytes from offset %llu of heap file '%s'", reference->length, reference->offset, heap->file_path.data);
+					goto references_free;
+				}
+			}
+			size += reference->length;
+		}
+
+		if (reference->offset != new_offset)
+		{
+			_CD_HeapValue heap_value = { 0 };
+			_cd_heap_reference_set(&heap_value, new_offset, (uint32_t)reference->length);
+			if (!_cd_table_column_write(table, reference->attribute, reference->row, 1, &heap_value))
+			{
+				goto references_free;
+			}
+		}
+	}
+
+	heap->header.size = size;
+	if (!cf_file_view_write(heap->header_view, 0, sizeof(heap->header), &heap->header))
+	{
+		_cd_make_error(CD_ERROR_FILE, "Failed to write header of heap file '%s'", heap->file_path.data);
+		goto references_free;
+	}
+
+	return_value = _cd_heap_resize(heap, _cd_heap_capacity_next(size));
+
+references_free:
+	free(buffer);
+	free(references);
+	_cd_rwlock_write_unlock(table->lock);
+writer_unlock:
+	_cd_mutex_unlock(table->writer_lock);
+	return return_value;
+}
+
+uint64_t cd_table_heap_size(CD_Table *table)
+{
+	return table->heap != NULL ? _cd_atomic_load_acquire(&table->heap->header.size) : 0;
+}
@@ -0,0 +1,706 @@
+#include "internal.h"
+
+#include <math.h>
+
+// predicate kernels over a contiguous column of count 1 attributes.
+// every kernel does selection[row] &= (column[row] <operator> value) for a block of rows
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define CD_KERNEL_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define CD_TARGET_AVX2
+#else
+#define CD_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#else
+#define CD_KERNEL_X86 0
+#endif
+
+// scalar
+
+#define CD_KERNEL_SCALAR(type_name, op_name, type, op)                                                                       \
+	static void _cd_kernel_##type_name##_##op_name##_scalar(const void *column, uint64_t row_count, const void *value, uint8_t *selection) \
+	{                                                                                                                        \
+		const type *values = column;                                                                                         \
+		type compare;                                                                                                        \
+		memcpy(&compare, value, sizeof(compare));                                                                            \
+		for (uint64_t row = 0; row < row_count; row++)                                                                       \
+		{                                                                                                                    \
+			selection[row] &= (values[row] op compare);                                                                      \
+		}                                                                                                                    \
+	}
+
+#define CD_KERNELS_SCALAR(type_name, type)          \
+	CD_KERNEL_SCALAR(type_name, EQUALS, type, ==)    \
+	CD_KERNEL_SCALAR(type_name, DIFFERENT, type, !=) \
+	CD_KERNEL_SCALAR(type_name, BIGGER, type, >)     \
+	CD_KERNEL_SCALAR(type_name, SMALLER, type, <)
+
+CD_KERNELS_SCALAR(BYTE, CD_byte_t)
+CD_KERNELS_SCALAR(UINT, CD_uint_t)
+CD_KERNELS_SCALAR(SINT, CD_sint_t)
+CD_KERNELS_SCALAR(FLOAT, CD_float_t)
+
+#if CD_KERNEL_X86
+
+// byte k of entry m is bit k of m, used to apply a compare mask of up to 4 rows to the selection
+static const uint32_t _cd_mask_bytes[16] =
+{
+	0x00000000, 0x00000001, 0x00000100, 0x00000101,
+	0x00010000, 0x00010001, 0x00010100, 0x00010101,
+	0x01000000, 0x01000001, 0x01000100, 0x01000101,
+	0x01010000, 0x01010001, 0x01010100, 0x01010101
+};
+
+static inline void _cd_selection_and4(uint8_t *selection, int mask)
+{
+	uint32_t bytes;
+	memcpy(&bytes, selection, sizeof(bytes));
+	bytes &= _cd_mask_bytes[mask];
+	memcpy(selection, &bytes, sizeof(bytes));
+}
+
+static inline void _cd_selection_and2(uint8_t *selection, int mask)
+{
+	uint16_t bytes;
+	memcpy(&bytes, selection, sizeof(bytes));
+	bytes &= (uint16_t)_cd_mask_bytes[mask];
+	memcpy(selection, &bytes, sizeof(bytes));
+}
+
+// sse2
+
+// byte lanes compare to 0xFF or 0x00, so and-ing them into the selection keeps it 0 or 1
+#define CD_KERNEL_SSE2_BYTE(op_name, compute)                                                                               \
+	static void _cd_kernel_BYTE_##op_name##_sse2(const void *column, uint64_t row_count, const void *value, uint8_t *selection) \
+	{                                                                                                                       \
+		const uint8_t *values = column;                                                                                     \
+		__m128i sign = _mm_set1_epi8((char)0x80);                                                                           \
+		__m128i c = _mm_set1_epi8((char)*(const uint8_t *)value);                                                           \
+		__m128i c_signed = _mm_xor_si128(c, sign);                                                                          \
+		uint64_t row = 0;                                                                                                   \
+		for (; row + 16 <= row_count; row += 16)                                                                            \
+		{                                                                                                                   \
+			__m128i v = _mm_loadu_si128((const __m128i *)(values + row));                                                   \
+			__m128i v_signed = _mm_xor_si128(v, sign);                                                                      \
+			__m128i s = _mm_loadu_si128((const __m128i *)(selection + row));                                                \
+			(void)c_signed;                                                                                                 \
+			(void)v_signed;                                                                                                 \
+			_mm_storeu_si128((__m128i *)(selection + row), compute);                                                        \
+		}                                                                                                                   \
+		_cd_kernel_BYTE_##op_name##_scalar(values + row, row_count - row, value, selection + row);                          \
+	}
+
+CD_KERNEL_SSE2_BYTE(EQUALS, _mm_and_si128(s, _mm_cmpeq_epi8(v, c)))
+CD_KERNEL_SSE2_BYTE(DIFFERENT, _mm_andnot_si128(_mm_cmpeq_epi8(v, c), s))
+CD_KERNEL_SSE2_BYTE(BIGGER, _mm_and_si128(s, _mm_cmpgt_epi8(v_signed, c_signed)))
+CD_KERNEL_SSE2_BYTE(SMALLER, _mm_and_si128(s, _mm_cmpgt_epi8(c_signed, v_signed)))
+
+// sse2 has no 64 bit integer compare, equality is two 32 bit compares of the halves
+#define CD_KERNEL_SSE2_INT64(type_name, op_name, invert)                                                                       \
+	static void _cd_kernel_##type_name##_##op_name##_sse2(const void *column, uint64_t row_count, const void *value, uint8_t *selection) \
+	{                                                                                                                          \
+		const uint64_t *values = column;                                                                                       \
+		__m128i c = _mm_set1_epi64x(*(const int64_t *)value);                                                                  \
+		uint64_t row = 0;                                                                                                      \
+		for (; row + 2 <= row_count; row += 2)                                                                                 \
+		{                                                                                                                      \
+			__m128i e = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i *)(values + row)), c);                                  \
+			e = _mm_and_si128(e, _mm_shuffle_epi32(e, _MM_SHUFFLE(2, 3, 0, 1)));                                               \
+			_cd_selection_and2(selection + row, _mm_movemask_pd(_mm_castsi128_pd(e)) ^ (invert));                              \
+		}                                                                                                                      \
+		_cd_kernel_##type_name##_##op_name##_scalar(values + row, row_count - row, value, selection + row);                     \
+	}
+
+CD_KERNEL_SSE2_INT64(UINT, EQUALS, 0)
+CD_KERNEL_SSE2_INT64(UINT, DIFFERENT, 0x3)
+CD_KERNEL_SSE2_INT64(SINT, EQUALS, 0)
+CD_KERNEL_SSE2_INT64(SINT, DIFFERENT, 0x3)
+
+#define CD_KERNEL_SSE2_FLOAT(op_name, compare)                                                                               \
+	static void _cd_kernel_FLOAT_##op_name##_sse2(const void *column, uint64_t row_count, const void *value, uint8_t *selection) \
+	{                                                                                                                        \
+		const double *values = column;                                                                                       \
+		__m128d c = _mm_set1_pd(*(const double *)value);                                                                     \
+		uint64_t row = 0;                                                                                                    \
+		for (; row + 2 <= row_count; row += 2)                                                                               \
+		{                                                                                                                    \
+			__m128d v = _mm_loadu_pd(values + row);                                                                          \
+			_cd_selection_and2(selection + row, _mm_movemask_pd(compare(v, c)));                                             \
+		}                                                                                                                    \
+		_cd_kernel_FLOAT_##op_name##_scalar(values + row, row_count - row, value, selection + row);                          \
+	}
+
+CD_KERNEL_SSE2_FLOAT(EQUALS, _mm_cmpeq_pd)
+CD_KERNEL_SSE2_FLOAT(DIFFERENT, _mm_cmpneq_pd)
+CD_KERNEL_SSE2_FLOAT(BIGGER, _mm_cmpgt_pd)
+CD_KERNEL_SSE2_FLOAT(SMALLER, _mm_cmplt_pd)
+
+// avx2
+
+#define CD_KERNEL_AVX2_BYTE(op_name, compute)                                                                               \
+	CD_TARGET_AVX2 static void _cd_kernel_BYTE_##op_name##_avx2(const void *column, uint64_t row_count, const void *value, uint8_t *selection) \
+	{                                                                                                                       \
+		const uint8_t *values = column;                                                                                     \
+		__m256i sign = _mm256_set1_epi8((char)0x80);                                                                        \
+		__m256i c = _mm256_set1_epi8((char)*(const uint8_t *)value);                                                        \
+		__m256i c_signed = _mm256_xor_si256(c, sign);                                                                       \
+		uint64_t row = 0;                                                                                                   \
+		for (; row + 32 <= row_count; row += 32)                                                                            \
+		{                                                                                                                   \
+			__m256i v = _mm256_loadu_si256((const __m256i *)(values + row));                                                \
+			__m256i v_signed = _mm256_xor_si256(v, sign);                                                                   \
+			__m256i s = _mm256_loadu_si256((const __m256i *)(selection + row));                                             \
+			(void)c_signed;                                                                                                 \
+			(void)v_signed;                                                                                                 \
+			_mm256_storeu_si256((__m256i *)(selection + row), compute);                                                     \
+		}                                                                                                                   \
+		_cd_kernel_BYTE_##op_name##_scalar(values + row, row_count - row, value, selection + row);                          \
+	}
+
+CD_KERNEL_AVX2_BYTE(EQUALS, _mm256_and_si256(s, _mm256_cmpeq_epi8(v, c)))
+CD_KERNEL_AVX2_BYTE(DIFFERENT, _mm256_andnot_si256(_mm256_cmpeq_epi8(v, c), s))
+CD_KERNEL_AVX2_BYTE(BIGGER, _mm256_and_si256(s, _mm256_cmpgt_epi8(v_signed, c_signed)))
+CD_KERNEL_AVX2_BYTE(SMALLER, _mm256_and_si256(s, _mm256_cmpgt_epi8(c_signed, v_signed)))
+
+// unsigned values are compared as signed after flipping the sign bit (bias)
+#define CD_KERNEL_AVX2_INT64(type_name, op_name, bias, compare, a, b, invert)                                                  \
+	CD_TARGET_AVX2 static void _cd_kernel_##type_name##_##op_name##_avx2(const void *column, uint64_t row_count, const void *value, uint8_t *selection) \
+	{                                                                                                                          \
+		const uint64_t *values = column;                                                                                       \
+		__m256i sign = _mm256_set1_epi64x(bias);                                                                               \
+		__m256i c = _mm256_xor_si256(_mm256_set1_epi64x(*(const int64_t *)value), sign);                                      \
+		uint64_t row = 0;                                                                                                      \
+		for (; row + 4 <= row_count; row += 4)                                                                                 \
+		{                                                                                                                      \
+			__m256i v = _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)(values + row)), sign);                           \
+			_cd_selection_and4(selection + row, _mm256_movemask_pd(_mm256_castsi256_pd(compare(a, b))) ^ (invert));            \
+		}                                                                                                                      \
+		_cd_kernel_##type_name##_##op_name##_scalar(values + row, row_count - row, value, selection + row);                     \
+	}
+
+#define CD_KERNELS_AVX2_INT64(type_name, bias)                                                  \
+	CD_KERNEL_AVX2_INT64(type_name, EQUALS, bias, _mm256_cmpeq_epi64, v, c, 0)                 \
+	CD_KERNEL_AVX2_INT64(type_name, DIFFERENT, bias, _mm256_cmpeq_epi64, v, c, 0xF)            \
+	CD_KERNEL_AVX2_INT64(type_name, BIGGER, bias, _mm256_cmpgt_epi64, v, c, 0)                 \
+	CD_KERNEL_AVX2_INT64(type_name, SMALLER, bias, _mm256_cmpgt_epi64, c, v, 0)
+
+CD_KERNELS_AVX2_INT64(UINT, (int64_t)0x8000000000000000ULL)
+CD_KERNELS_AVX2_INT64(SINT, 0)
+
+#define CD_KERNEL_AVX2_FLOAT(op_name, predicate)                                                                             \
+	CD_TARGET_AVX2 static void _cd_kernel_FLOAT_##op_name##_avx2(const void *column, uint64_t row_count, const void *value, uint8_t *selection) \
+	{                                                                                                                        \
+		const double *values = column;                                                                                       \
+		__m256d c = _mm256_set1_pd(*(const double *)value);                                                                  \
+		uint64_t row = 0;                                                                                                    \
+		for (; row + 4 <= row_count; row += 4)                                                                               \
+		{                                                                                                                    \
+			__m256d v = _mm256_loadu_pd(values + row);                                                                       \
+			_cd_selection_and4(selection + row, _mm256_movemask_pd(_mm256_cmp_pd(v, c, predicate)));                         \
+		}                                                                                                                    \
+		_cd_kernel_FLOAT_##op_name##_scalar(values + row, row_count - row, value, selection + row);                          \
+	}
+
+CD_KERNEL_AVX2_FLOAT(EQUALS, _CMP_EQ_OQ)
+CD_KERNEL_AVX2_FLOAT(DIFFERENT, _CMP_NEQ_UQ)
+CD_KERNEL_AVX2_FLOAT(BIGGER, _CMP_GT_OQ)
+CD_KERNEL_AVX2_FLOAT(SMALLER, _CMP_LT_OQ)
+
+#endif
+
+// reductions over the selected rows of a column: *accumulator = accumulator <function> column[row] for every row with selection[row].
+// integer sums wrap, so SINT sums use the UINT ones
+
+#define CD_REDUCE_SCALAR_SUM(type_name, type)                                                                                \
+	static void _cd_reduce_##type_name##_SUM_scalar(const void *column, uint64_t row_count, const uint8_t *selection, void *accumulator) \
+	{                                                                                                                        \
+		const type *values = column;                                                                                         \
+		type sum;                                                                                                            \
+		memcpy(&sum, accumulator, sizeof(sum));                                                                              \
+		for (uint64_t row = 0; row < row_count; row++)                                                                       \
+		{                                                                                                                    \
+			if (selection[row])                                                                                              \
+			{                                                                                                                \
+				sum += values[row];                                                                                          \
+			}                                                                                                                \
+		}                                                                                                                    \
+		memcpy(accumulator, &sum, sizeof(sum));                                                                              \
+	}
+
+#define CD_REDUCE_SCALAR_PICK(type_name, function_name, type, op)                                                            \
+	static void _cd_reduce_##type_name##_##function_name##_scalar(const void *column, uint64_t row_count, const uint8_t *selection, void *accumulator) \
+	{                                                                                                                        \
+		const type *values = column;                                                                                         \
+		type pick;                                                                                                           \
+		memcpy(&pick, accumulator, sizeof(pick));                                                                            \
+		for (uint64_t row = 0; row < row_count; row++)                                                                       \
+		{                                                                                                                    \
+			if (selection[row] && values[row] op pick)                                                                       \
+			{                                                                                                                \
+				pick = values[row];                                                                                          \
+			}                                                                                                                \
+		}                                                                                                                    \
+		memcpy(accumulator, &pick, sizeof(pick));                                                                            \
+	}
+
+#define CD_REDUCES_SCALAR(type_name, type)          \
+	CD_REDUCE_SCALAR_PICK(type_name, MIN, type, <)  \
+	CD_REDUCE_SCALAR_PICK(type_name, MAX, type, >)
+
+CD_REDUCE_SCALAR_SUM(UINT, CD_uint_t)
+CD_REDUCE_SCALAR_SUM(FLOAT, CD_float_t)
+CD_REDUCES_SCALAR(UINT, CD_uint_t)
+CD_REDUCES_SCALAR(SINT, CD_sint_t)
+CD_REDUCES_SCALAR(FLOAT, CD_float_t)
+
+#if CD_KERNEL_X86
+
+// sse2: 2 rows at a time, unselected rows are masked to the identity of the function.
+// NaN values are skipped by min and max like the scalar compares do
+
+static inline __m128i _cd_selection_mask2(const uint8_t *selection)
+{
+	uint16_t bytes;
+	memcpy(&bytes, selection, sizeof(bytes));
+	__m128i zero = _mm_setzero_si128();
+	__m128i lanes = _mm_unpacklo_epi32(_mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(bytes), zero), zero), zero);
+	return _mm_sub_epi64(zero, lanes);
+}
+
+static void _cd_reduce_UINT_SUM_sse2(const void *column, uint64_t row_count, const uint8_t *selection, void *accumulator)
+{
+	const uint64_t *values = column;
+	__m128i sum = _mm_setzero_si128();
+	uint64_t row = 0;
+	for (; row + 2 <= row_count; row += 2)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i *)(values + row));
+		sum = _mm_add_epi64(sum, _mm_and_si128(v, _cd_selection_mask2(selection + row)));
+	}
+	uint64_t lanes[2];
+	_mm_storeu_si128((__m128i *)lanes, sum);
+	*(uint64_t *)accumulator += lanes[0] + lanes[1];
+	_cd_reduce_UINT_SUM_scalar(values + row, row_count - row, selection + row, accumulator);
+}
+
+static void _cd_reduce_FLOAT_SUM_sse2(const void *column, uint64_t row_count, const uint8_t *selection, void *accumulator)
+{
+	const double *values = column;
+	__m128d sum = _mm_setzero_pd();
+	uint64_t row = 0;
+	for (; row + 2 <= row_count; row += 2)
+	{
+		__m128d v = _mm_loadu_pd(values + row);
+		sum = _mm_add_pd(sum, _mm_and_pd(v, _mm_castsi128_pd(_cd_selection_mask2(selection + row))));
+	}
+	double lanes[2];
+	_mm_storeu_pd(lanes, sum);
+	*(double *)accumulator += lanes[0] + lanes[1];
+	_cd_reduce_FLOAT_SUM_scalar(values + row, row_count - row, selection + row, accumulator);
+}
+
+#define CD_REDUCE_SSE2_FLOAT(function_name, pick, identity)                                                                  \
+	static void _cd_reduce_FLOAT_##function_name##_sse2(const void *column, uint64_t row_count, const uint8_t *selection, void *accumulator) \
+	{                                                                                                                        \
+		const double *values = column;                                                                                       \
+		__m128d fill = _mm_set1_pd(identity);                                                                                \
+		__m128d result = _mm_set1_pd(*(const double *)accumulator);                                                          \
+		uint64_t row = 0;                                                                                                    \
+		for (; row + 2 <= row_count; row += 2)                                                                               \
+		{                                                                                                                    \
+			__m128d mask = _mm_castsi128_pd(_cd_selection_mask2(selection + row));                                           \
+			__m128d v = _mm_or_pd(_mm_and_pd(mask, _mm_loadu_pd(values + row)), _mm_andnot_pd(mask, fill));                  \
+			result = pick(v, result);                                                                                        \
+		}                                                                                                                    \
+		double lanes[2];                                                                                                     \
+		_mm_storeu_pd(lanes, result);                                                                                        \
+		uint8_t lane_selection[2] = { 1, 1 };                                                                                \
+		_cd_reduce_FLOAT_##function_name##_scalar(lanes, 2, lane_selection, accumulator);                                    \
+		_cd_reduce_FLOAT_##function_name##_scalar(values + row, row_count - row, selection + row, accumulator);               \
+	}
+
+CD_REDUCE_SSE2_FLOAT(MIN, _mm_min_pd, INFINITY)
+CD_REDUCE_SSE2_FLOAT(MAX, _mm_max_pd, -INFINITY)
+
+// avx2: 4 rows at a time
+
+CD_TARGET_AVX2 static inline __m256i _cd_selection_mask4(const uint8_t *selection)
+{
+	uint32_t bytes;
+	memcpy(&bytes, selection, sizeof(bytes));
+	return _mm256_sub_epi64(_mm256_setzero_si256(), _mm256_cvtepu8_epi64(_mm_cvtsi32_si128((int)bytes)));
+}
+
+CD_TARGET_AVX2 static void _cd_reduce_UINT_SUM_avx2(const void *column, uint64_t row_count, const uint8_t *selection, void *accumulator)
+{
+	const uint64_t *values = column;
+	__m256i sum = _mm256_setzero_si256();
+	uint64_t row = 0;
+	for (; row + 4 <= row_count; row += 4)
+	{
+		__m256i v = _mm256_loadu_si256((const __m256i *)(values + row));
+		sum = _mm256_add_epi64(sum, _mm256_and_si256(v, _cd_selection_mask4(selection + row)));
+	}
+	uint64_t lanes[4];
+	_mm256_storeu_si256((__m256i *)lanes, sum);
+	*(uint64_t *)accumulator += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+	_cd_reduce_UINT_SUM_scalar(values + row, row_count - row, selection + row, accumulator);
+}
+
+CD_TARGET_AVX2 static void _cd_reduce_FLOAT_SUM_avx2(const void *column, uint64_t row_count, const uint8_t *selection, void *accumulator)
+{
+	const double *values = column;
+	__m256d sum = _mm256_setzero_pd();
+	uint64_t row = 0;
+	for (; row + 4 <= row_count; row += 4)
+	{
+		__m256d v = _mm256_loadu_pd(values + row);
+		sum = _mm256_add_pd(sum, _mm256_and_pd(v, _mm256_castsi256_pd(_cd_selection_mask4(selection + row))));
+	}
+	double lanes[4];
+	_mm256_storeu_pd(lanes, sum);
+	*(double *)accumulator += (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+	_cd_reduce_FLOAT_SUM_scalar(values + row, row_count - row, selection + row, accumulator);
+}
+
+// unsigned values are compared as signed after flipping the sign bit (bias); the result lanes keep the bias
+#define CD_REDUCE_AVX2_INT64(type_name, function_name, bias, identity, a, b)                                                   \
+	CD_TARGET_AVX2 static void _cd_reduce_##type_name##_##function_name##_avx2(const void *column, uint64_t row_count, const uint8_t *selection, void *accumulator) \
+	{                                                                                                                          \
+		const uint64_t *values = column;                                                                                       \
+		__m256i sign = _mm256_set1_epi64x(bias);                                                                               \
+		__m256i fill = _mm256_set1_epi64x(identity);                                                                           \
+		__m256i result = _mm256_xor_si256(_mm256_set1_epi64x(*(const int64_t *)accumulator), sign);                           \
+		uint64_t row = 0;                                                                                                      \
+		for (; row + 4 <= row_count; row += 4)                                                                                 \
+		{                                                                                                                      \
+			__m256i v = _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)(values + row)), sign);                           \
+			v = _mm256_blendv_epi8(fill, v, _cd_selection_mask4(selection + row));                                             \
+			result = _mm256_blendv_epi8(result, v, _mm256_cmpgt_epi64(a, b));                                                 \
+		}                                                                                                                      \
+		uint64_t lanes[4];                                                                                                     \
+		_mm256_storeu_si256((__m256i *)lanes, _mm256_xor_si256(result, sign));                                                 \
+		uint8_t lane_selection[4] = { 1, 1, 1, 1 };                                                                            \
+		_cd_reduce_##type_name##_##function_name##_scalar(lanes, 4, lane_selection, accumulator);                              \
+		_cd_reduce_##type_name##_##function_name##_scalar(values + row, row_count - row, selection + row, accumulator);         \
+	}
+
+CD_REDUCE_AVX2_INT64(UINT, MIN, (int64_t)0x8000000000000000ULL, INT64_MAX, result, v)
+CD_REDUCE_AVX2_INT64(UINT, MAX, (int64_t)0x8000000000000000ULL, INT64_MIN, v, result)
+CD_REDUCE_AVX2_INT64(SINT, MIN, 0, INT64_MAX, result, v)
+CD_REDUCE_AVX2_INT64(SINT, MAX, 0, INT64_MIN, v, result)
+
+#define CD_REDUCE_AVX2_FLOAT(function_name, pick, identity)                                                                  \
+	CD_TARGET_AVX2 static void _cd_reduce_FLOAT_##function_name##_avx2(const void *column, uint64_t row_count, const uint8_t *selection, void *accumulator) \
+	{                                                                                                                        \
+		const double *values = column;                                                                                       \
+		__m256d fill = _mm256_set1_pd(identity);                                                                             \
+		__m256d result = _mm256_set1_pd(*(const double *)accumulator);                                                       \
+		uint64_t row = 0;                                                                                                    \
+		for (; row + 4 <= row_count; row += 4)                                                                               \
+		{                                                                                                                    \
+			__m256d mask = _mm256_castsi256_pd(_cd_selection_mask4(selection + row));                                        \
+			__m256d v = _mm256_blendv_pd(fill, _mm256_loadu_pd(values + row), mask);                                         \
+			result = pick(v, result);                                                                                        \
+		}                                                                                                                    \
+		double lanes[4];                                                                                                     \
+		_mm256_storeu_pd(lanes, result);                                                                                     \
+		uint8_t lane_selection[4] = { 1, 1, 1, 1 };                                                                          \
+		_cd_reduce_FLOAT_##function_name##_scalar(lanes, 4, lane_selection, accumulator);                                    \
+		_cd_reduce_FLOAT_##function_name##_scalar(values + row, row_count - row, selection + row, accumulator);               \
+	}
+
+CD_REDUCE_AVX2_FLOAT(MIN, _mm256_min_pd, INFINITY)
+CD_REDUCE_AVX2_FLOAT(MAX, _mm256_max_pd, -INFINITY)
+
+#endif
+
+// dispatch
+
+#define CD_KERNEL_TYPE_COUNT (CD_TYPE_FLOAT + 1)
+#define CD_KERNEL_OPERATOR_COUNT (CD_CONDITION_OPERATOR_SMALLER + 1)
+
+#define CD_KERNEL_ROW(type_name, level)                     \
+	{                                                       \
+		_cd_kernel_##type_name##_EQUALS_##level,            \
+		_cd_kernel_##type_name##_DIFFERENT_##level,         \
+		_cd_kernel_##type_name##_BIGGER_##level,            \
+		_cd_kernel_##type_name##_SMALLER_##level            \
+	}
+
+static const _cd_func_kernel _cd_kernels_scalar[CD_KERNEL_TYPE_COUNT][CD_KERNEL_OPERATOR_COUNT] =
+{
+	CD_KERNEL_ROW(BYTE, scalar),
+	CD_KERNEL_ROW(UINT, scalar),
+	CD_KERNEL_ROW(SINT, scalar),
+	CD_KERNEL_ROW(FLOAT, scalar)
+};
+
+#if CD_KERNEL_X86
+static const _cd_func_kernel _cd_kernels_sse2[CD_KERNEL_TYPE_COUNT][CD_KERNEL_OPERATOR_COUNT] =
+{
+	CD_KERNEL_ROW(BYTE, sse2),
+	{ _cd_kernel_UINT_EQUALS_sse2, _cd_kernel_UINT_DIFFERENT_sse2, _cd_kernel_UINT_BIGGER_scalar, _cd_kernel_UINT_SMALLER_scalar },
+	{ _cd_kernel_SINT_EQUALS_sse2, _cd_kernel_SINT_DIFFERENT_sse2, _cd_kernel_SINT_BIGGER_scalar, _cd_kernel_SINT_SMALLER_scalar },
+	CD_KERNEL_ROW(FLOAT, sse2)
+};
+
+static const _cd_func_kernel _cd_kernels_avx2[CD_KERNEL_TYPE_COUNT][CD_KERNEL_OPERATOR_COUNT] =
+{
+	CD_KERNEL_ROW(BYTE, avx2),
+	CD_KERNEL_ROW(UINT, avx2),
+	CD_KERNEL_ROW(SINT, avx2),
+	CD_KERNEL_ROW(FLOAT, avx2)
+};
+#endif
+
+// indexed by CD_KERNEL_LEVEL_*, only the levels the cpu supports are ever picked
+static const _cd_func_kernel (*const _cd_kernels[])[CD_KERNEL_OPERATOR_COUNT] =
+{
+	_cd_kernels_scalar,
+#if CD_KERNEL_X86
+	_cd_kernels_sse2,
+	_cd_kernels_avx2
+#endif
+};
+
+// reductions of SUM, MIN and MAX, BYTE has none
+#define CD_REDUCE_FUNCTION_COUNT 3
+
+#define CD_REDUCE_ROW(type_name, sum_type_name, level)      \
+	{                                                       \
+		_cd_reduce_##sum_type_name##_SUM_##level,           \
+		_cd_reduce_##type_name##_MIN_##level,               \
+		_cd_reduce_##type_name##_MAX_##level                \
+	}
+
+static const _cd_func_reduce _cd_reduces_scalar[CD_KERNEL_TYPE_COUNT][CD_REDUCE_FUNCTION_COUNT] =
+{
+	{ NULL, NULL, NULL },
+	CD_REDUCE_ROW(UINT, UINT, scalar),
+	CD_REDUCE_ROW(SINT, UINT, scalar),
+	CD_REDUCE_ROW(FLOAT, FLOAT, scalar)
+};
+
+#if CD_KERNEL_X86
+static const _cd_func_reduce _cd_reduces_sse2[CD_KERNEL_TYPE_COUNT][CD_REDUCE_FUNCTION_COUNT] =
+{
+	{ NULL, NULL, NULL },
+	{ _cd_reduce_UINT_SUM_sse2, _cd_reduce_UINT_MIN_scalar, _cd_reduce_UINT_MAX_scalar },
+	{ _cd_reduce_UINT_SUM_sse2, _cd_reduce_SINT_MIN_scalar, _cd_reduce_SINT_MAX_scalar },
+	CD_REDUCE_ROW(FLOAT, FLOAT, sse2)
+};
+
+static const _cd_func_reduce _cd_reduces_avx2[CD_KERNEL_TYPE_COUNT][CD_REDUCE_FUNCTION_COUNT] =
+{
+	{ NULL, NULL, NULL },
+	CD_REDUCE_ROW(UINT, UINT, avx2),
+	CD_REDUCE_ROW(SINT, UINT, avx2),
+	CD_REDUCE_ROW(FLOAT, FLOAT, avx2)
+};
+#endif
+
+static const _cd_func_reduce (*const _cd_reduces[])[CD_REDUCE_FUNCTION_COUNT] =
+{
+	_cd_reduces_scalar,
+#if CD_KERNEL_X86
+	_cd_reduces_sse2,
+	_cd_reduces_avx2
+#endif
+};
+
+// the level picked, CD_KERNEL_LEVEL_NONE until the first pick; threads may pick at once, so it is published with a
+// release store and read with an acquire load
+#define CD_KERNEL_LEVEL_NONE UINT64_MAX
+static volatile uint64_t _cd_kernel_level = CD_KERNEL_LEVEL_NONE;
+
+static uint64_t _cd_kernel_level_detect()
+{
+#if CD_KERNEL_X86
+#if defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] >= 7)
+	{
+		int has_avx2, has_os_support;
+		__cpuidex(info, 7, 0);
+		has_avx2 = (info[1] & (1 << 5)) != 0;
+		__cpuid(info, 1);
+		// the os has to save the ymm registers (osxsave, avx and xcr0 bits 1-2)
+		has_os_support = (info[2] & (1 << 27)) && (info[2] & (1 << 28)) && (_xgetbv(0) & 6) == 6;
+		if (has_avx2 && has_os_support)
+		{
+			return CD_KERNEL_LEVEL_AVX2;
+		}
+	}
+	return CD_KERNEL_LEVEL_SSE2;
+#else
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+	{
+		return CD_KERNEL_LEVEL_AVX2;
+	}
+	return CD_KERNEL_LEVEL_SSE2;
+#endif
+#else
+	return CD_KERNEL_LEVEL_SCALAR;
+#endif
+}
+
+uint64_t _cd_kernel_dispatch(uint64_t level)
+{
+	uint64_t supported = _cd_kernel_level_detect();
+	if (level > supported)
+	{
+		level = supported;
+	}
+
+	_cd_atomic_store_release(&_cd_kernel_level, level);
+	return level;
+}
+
+// the level of the kernels to use, the best one is picked on first use
+static uint64_t _cd_kernel_level_get()
+{
+	uint64_t level = _cd_atomic_load_acquire(&_cd_kernel_level);
+	if (level == CD_KERNEL_LEVEL_NONE)
+	{
+		level = _cd_kernel_dispatch(CD_KERNEL_LEVEL_AVX2);
+	}
+	return level;
+}
+
+void _cd_kernel_init()
+{
+	_cd_kernel_level_get();
+}
+
+_cd_func_kernel _cd_kernel_get(const CD_AttributeEx *attribute, uint64_t operator)
+{
+	if (attribute->count != 1 || attribute->type >= CD_KERNEL_TYPE_COUNT || operator >= CD_KERNEL_OPERATOR_COUNT)
+	{
+		return NULL;
+	}
+
+	return _cd_kernels[_cd_kernel_level_get()][attribute->type][operator];
+}
+
+_cd_func_reduce _cd_reduce_get(uint64_t type, uint64_t function)
+{
+	if (type >= CD_KERNEL_TYPE_COUNT)
+	{
+		return NULL;
+	}
+
+	const _cd_func_reduce *reduces = _cd_reduces[_cd_kernel_level_get()][type];
+
+	switch (function)
+	{
+	case CD_AGGREGATE_SUM:
+	case CD_AGGREGATE_AVG:
+		return reduces[0];
+	case CD_AGGREGATE_MIN:
+		return reduces[1];
+	case CD_AGGREGATE_MAX:
+		return reduces[2];
+	default:
+		return NULL;
+	}
+}
+
+void _cd_column_gather(const uint8_t *rows, uint64_t row_count, uint64_t stride, uint64_t size, uint8_t *column)
+{
+	switch (size)
+	{
+	case 1:
+	{
+		for (uint64_t row = 0; row < row_count; row++)
+		{
+			column[row] = rows[row * stride];
+		}
+		break;
+	}
+	case 8:
+	{
+		uint64_t *values = (uint64_t *)column;
+		for (uint64_t row = 0; row < row_count; row++)
+		{
+			memcpy(values + row, rows + row * stride, sizeof(*values));
+		}
+		break;
+	}
+	default:
+	{
+		for (uint64_t row = 0; row < row_count; row++)
+		{
+			memcpy(column + row * size, rows + row * stride, size);
+		}
+		break;
+	}
+	}
+}
+
+#if CD_KERNEL_X86
+static inline uint64_t _cd_lowest_bit(uint32_t mask)
+{
+#if defined(_MSC_VER)
+	unsigned long index;
+	_BitScanForward(&index, mask);
+	return index;
+#else
+	return __builtin_ctz(mask);
+#endif
+}
+#endif
+
+uint64_t _cd_find_bytes(const uint8_t *text, uint64_t text_length, const uint8_t *needle, uint64_t needle_length)
+{
+	if (needle_length == 0)
+	{
+		return 1;
+	}
+	if (needle_length > text_length)
+	{
+		return 0;
+	}
+
+	uint64_t last = text_length - needle_length; // last position the needle can start at
+	uint64_t position = 0;
+
+#if CD_KERNEL_X86
+	// compare 16 positions at once against the first and the last byte of the needle,
+	// only positions where both match are checked in full
+	__m128i first = _mm_set1_epi8((char)needle[0]);
+	__m128i end = _mm_set1_epi8((char)needle[needle_length - 1]);
+
+	for (; position + 16 <= last + 1; position += 16)
+	{
+		__m128i block_first = _mm_loadu_si128((const __m128i *)(text + position));
+		__m128i block_end = _mm_loadu_si128((const __m128i *)(text + position + needle_length - 1));
+
+		uint32_t mask = (uint32_t)_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(block_first, first), _mm_cmpeq_epi8(block_end, end)));
+		while (mask != 0)
+		{
+			uint64_t bit = _cd_lowest_bit(mask);
+			if (memcmp(text + position + bit + 1, needle + 1, needle_length - 1) == 0)
+			{
+				return 1;
+			}
+			mask &= mask - 1;
+		}
+	}
+#endif
+
+	for (; position <= last; position++)
+	{
+		if (text[position] == needle[0] && memcmp(text + position + 1, needle + 1, needle_length - 1) == 0)
+		{
+			return 1;
+		}
+	}
+
+	return 0;
+}
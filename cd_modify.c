@@ -0,0 +1,553 @@
+#include "internal.h"
+
+// rows (a uint64_t each, in table order) matching the conditions
+static CD_TableView *_cd_table_select_row_numbers(CD_Table *table, uint64_t condition_count, CD_Condition *conditions)
+{
+	CD_PreparedSelect *select = cd_table_select_prepare(table, 0, NULL, condition_count, conditions);
+	if (select == NULL)
+	{
+		return NULL;
+	}
+
+	select->is_row_numbers = 1;
+	select->is_full_row = 0;
+	select->data_stride = sizeof(uint64_t);
+
+	CD_TableView *rows = cd_prepared_select(select, NULL);
+
+	cd_prepared_select_destroy(select);
+
+	return rows;
+}
+
+// adds value of the attribute at attribute_index for row to the indices of that attribute
+static uint64_t _cd_table_value_index(CD_Table *table, uint64_t attribute_index, const void *value, uint64_t row)
+{
+	if (table->unique_indices[attribute_index] != NULL && !_cd_hash_index_insert(table->unique_indices[attribute_index], value, table->schema->attributes[attribute_index].size, row))
+	{
+		return 0;
+	}
+	if (table->trigram_indices[attribute_index] != NULL && !_cd_trigram_index_insert(table->trigram_indices[attribute_index], value, row))
+	{
+		return 0;
+	}
+	if (table->btree_indices[attribute_index] != NULL && !_cd_btree_index_insert(table->btree_indices[attribute_index], value, row))
+	{
+		return 0;
+	}
+	if (table->bloom_filters[attribute_index] != NULL && !_cd_bloom_filter_insert(table, table->bloom_filters[attribute_index], value, row))
+	{
+		return 0;
+	}
+	if (table->zone_map != NULL && !_cd_zone_map_insert(table->zone_map, attribute_index, value, 0, row, 1))
+	{
+		return 0;
+	}
+	return 1;
+}
+
+// writes the headers of the indices so they are known to cover exactly the rows of the table
+static uint64_t _cd_table_indices_commit(CD_Table *table)
+{
+	uint64_t attribute_count = cc_hash_map_count(table->schema->attribute_indices);
+	for (uint64_t attrib_index = 0; attrib_index < attribute_count; attrib_index++)
+	{
+		CD_HashIndex *unique_index = table->unique_indices[attrib_index];
+		if (unique_index != NULL)
+		{
+			unique_index->header.row_count = table->count.count_c;
+			if (!_cd_hash_index_commit(unique_index))
+			{
+				return 0;
+			}
+		}
+
+		CD_TrigramIndex *trigram_index = table->trigram_indices[attrib_index];
+		if (trigram_index != NULL)
+		{
+			trigram_index->header.row_count = table->count.count_c;
+			if (!_cd_trigram_index_commit(trigram_index))
+			{
+				return 0;
+			}
+		}
+
+		CD_BTreeIndex *btree_index = table->btree_indices[attrib_index];
+		if (btree_index != NULL)
+		{
+			btree_index->header.row_count = table->count.count_c;
+			if (!_cd_btree_index_commit(btree_index))
+			{
+				return 0;
+			}
+		}
+
+		CD_BloomFilter *bloom_filter = table->bloom_filters[attrib_index];
+		if (bloom_filter != NULL)
+		{
+			bloom_filter->header.row_count = table->count.count_c;
+			if (!_cd_bloom_filter_commit(bloom_filter))
+			{
+				return 0;
+			}
+		}
+	}
+
+	if (table->zone_map != NULL)
+	{
+		_cd_zone_map_truncate(table->zone_map, table->count.count_c);
+		if (!_cd_zone_map_commit(table->zone_map))
+		{
+			return 0;
+		}
+	}
+	return 1;
+}
+
+// reads row into buffer with the layout of a row of the table
+static uint64_t _cd_table_row_read(CD_Table *table, uint64_t row, uint8_t *buffer)
+{
+	if (table->schema->page_rows == 0)
+	{
+		if (!cf_file_view_read(table->data_view, row * table->schema->stride, table->schema->stride, buffer))
+		{
+			_cd_make_error(CD_ERROR_FILE, "Failed to read row %llu from table '%s'", row, table->name.data);
+			return 0;
+		}
+		return 1;
+	}
+
+	uint64_t attribute_count = cc_hash_map_count(table->schema->attribute_indices);
+	for (uint64_t attrib_index = 0; attrib_index < attribute_count; attrib_index++)
+	{
+		const CD_AttributeEx *attribute = table->schema->attributes + attrib_index;
+		if (!_cd_table_column_read(table, attribute, row, 1, buffer + attribute->offset))
+		{
+			return 0;
+		}
+	}
+	return 1;
+}
+
+static uint64_t _cd_table_row_write(CD_Table *table, uint64_t row, const uint8_t *buffer)
+{
+	if (table->schema->page_rows == 0)
+	{
+		if (!cf_file_view_write(table->data_view, row * table->schema->stride, table->schema->stride, buffer))
+		{
+			_cd_make_error(CD_ERROR_FILE, "Failed to write row %llu to table '%s'", row, table->name.data);
+			return 0;
+		}
+		return 1;
+	}
+
+	uint64_t attribute_count = cc_hash_map_count(table->schema->attribute_indices);
+	for (uint64_t attrib_index = 0; attrib_index < attribute_count; attrib_index++)
+	{
+		const CD_AttributeEx *attribute = table->schema->attributes + attrib_index;
+		if (!_cd_table_column_write(table, attribute, row, 1, buffer + attribute->offset))
+		{
+			return 0;
+		}
+	}
+	return 1;
+}
+
+uint64_t cd_table_delete(CD_Table *table, uint64_t condition_count, CD_Condition *conditions)
+{
+	uint64_t return_value = 0;
+
+	// the rows found stay valid while no other writer gets in, selects only wait for the tombstones to be set
+	_cd_mutex_lock(table->writer_lock);
+
+	// replaying inserts logged before would bring the deleted rows back
+	if (!_cd_wal_checkpoint(table->db->wal))
+	{
+		goto writer_unlock;
+	}
+
+	CD_TableView *rows = _cd_table_select_row_numbers(table, condition_count, conditions);
+	if (rows == NULL)
+	{
+		goto writer_unlock;
+	}
+
+	_cd_rwlock_write_lock(table->lock);
+
+	if (rows->count_c != 0 && table->tombstones == NULL)
+	{
+		table->tombstones = _cd_tombstones_open(table);
+		if (table->tombstones == NULL)
+		{
+			goto table_unlock;
+		}
+	}
+
+	table->modification_count += rows->count_c != 0;
+
+	const uint64_t *row_numbers = rows->data;
+	for (uint64_t i = 0; i < rows->count_c; i++)
+	{
+		if (!_cd_tombstones_set(table->tombstones, row_numbers[i], 1))
+		{
+			goto table_unlock;
+		}
+	}
+
+	if (rows->count_c != 0 && !_cd_tombstones_commit(table->tombstones))
+	{
+		goto table_unlock;
+	}
+
+	return_value = 1;
+
+table_unlock:
+	_cd_rwlock_write_unlock(table->lock);
+	cd_table_view_destroy(rows);
+writer_unlock:
+	_cd_mutex_unlock(table->writer_lock);
+	return return_value;
+}
+
+uint64_t cd_table_update(CD_Table *table, uint64_t condition_count, CD_Condition *conditions, uint64_t attribute_count, const char *attribute_names[], const void *data)
+{
+	uint64_t return_value = 0;
+
+	_CD_ProjectedAttribute *attributes = malloc(sizeof(*attributes) * attribute_count);
+	uint64_t data_stride;
+	CD_TableView *rows = NULL;
+
+	if (!_cd_projection_resolve(table, attribute_count, attribute_names, attributes, &data_stride))
+	{
+		goto attributes_free;
+	}
+
+	_cd_mutex_lock(table->writer_lock);
+
+	// replaying inserts logged before would undo the update
+	if (!_cd_wal_checkpoint(table->db->wal))
+	{
+		goto writer_unlock;
+	}
+
+	rows = _cd_table_select_row_numbers(table, condition_count, conditions);
+	if (rows == NULL)
+	{
+		goto writer_unlock;
+	}
+
+	const uint64_t *row_numbers = rows->data;
+
+	// a unique value can be given to one row, which may already have it
+	for (uint64_t i = 0; i < attribute_count; i++)
+	{
+		CD_HashIndex *index = table->unique_indices[attributes[i].table_index];
+		if (index == NULL || rows->count_c == 0)
+		{
+			continue;
+		}
+
+		const char *name = table->schema->attributes[attributes[i].table_index].name;
+		if (rows->count_c > 1)
+		{
+			_cd_make_error(CD_ERROR_ATTRIBUTE_IS_UNIQUE, "Attribute '%s' is UNIQUE but %llu rows would be set to the same value. table: '%s'", name, rows->count_c, table->name.data);
+			goto rows_destroy;
+		}
+
+		const void *value = (const uint8_t *)data + attributes[i].data_offset;
+		CD_BloomFilter *filter = table->bloom_filters[attributes[i].table_index];
+		CD_Stats add = { 0 };
+		if (filter != NULL && !_cd_bloom_filter_probe(filter, value, &add))
+		{
+			_cd_table_stats_add(table, &add);
+			continue;
+		}
+
+		uint64_t table_row;
+		add.unique_lookups = 1;
+		uint64_t is_found = _cd_hash_index_find(table, index, value, &table_row, &add.unique_compares);
+		if (!is_found && filter != NULL)
+		{
+			add.bloom_false_positives = 1;
+		}
+		_cd_table_stats_add(table, &add);
+		if (is_found && table_row != row_numbers[0])
+		{
+			_cd_make_error(CD_ERROR_ATTRIBUTE_IS_UNIQUE, "Attribute '%s' is UNIQUE and is already in the table '%s' at row %llu", name, table->name.data, table_row);
+			goto rows_destroy;
+		}
+	}
+
+	// dictionary encoded values are stored as their codes and heap encoded ones as a _CD_HeapValue (which a code fits in),
+	// new values are added before selects are made to wait
+	_CD_HeapValue *stored_values = malloc(sizeof(*stored_values) * attribute_count);
+	for (uint64_t i = 0; i < attribute_count; i++)
+	{
+		const void *value = (const uint8_t *)data + attributes[i].data_offset;
+		if (attributes[i].dictionary != NULL)
+		{
+			uint64_t code;
+			if (!_cd_dictionary_encode(table, attributes[i].dictionary, value, &code))
+			{
+				goto stored_values_free;
+			}
+			memcpy(stored_values + i, &code, sizeof(code));
+		}
+		if (attributes[i].heap != NULL && !_cd_heap_encode(table, attributes[i].heap, table->schema->attributes + attributes[i].table_index, value, stored_values + i))
+		{
+			goto stored_values_free;
+		}
+	}
+
+	// the old values stay in the indices, lookups check the rows they find. selects wait so they see no row half updated
+	_cd_rwlock_write_lock(table->lock);
+	table->modification_count += rows->count_c != 0;
+	for (uint64_t i = 0; i < attribute_count; i++)
+	{
+		const CD_AttributeEx *attribute = table->schema->attributes + attributes[i].table_index;
+		const uint8_t *value = (const uint8_t *)data + attributes[i].data_offset;
+		const void *stored_value = attribute->encoding != CD_ENCODING_NONE ? (const void *)(stored_values + i) : value;
+
+		for (uint64_t r = 0; r < rows->count_c; r++)
+		{
+			if (!cf_file_view_write(table->data_view, _cd_table_value_offset(table->schema, row_numbers[r], attribute), _cd_attribute_stored_size(attribute), stored_value))
+			{
+				_cd_make_error(CD_ERROR_FILE, "Failed to write attribute '%s' at row %llu to table '%s'", attribute->name, row_numbers[r], table->name.data);
+				goto table_unlock;
+			}
+			if (!_cd_table_value_index(table, attributes[i].table_index, value, row_numbers[r]))
+			{
+				goto table_unlock;
+			}
+		}
+	}
+
+	if (!_cd_table_indices_commit(table))
+	{
+		goto table_unlock;
+	}
+
+	return_value = 1;
+
+table_unlock:
+	_cd_rwlock_write_unlock(table->lock);
+stored_values_free:
+	free(stored_values);
+rows_destroy:
+	cd_table_view_destroy(rows);
+writer_unlock:
+	_cd_mutex_unlock(table->writer_lock);
+attributes_free:
+	free(attributes);
+	return return_value;
+}
+
+// makes the rows written to holes live and drops the rows from count_c on: their tombstones are cleared and the new
+// count is published. selects must not run meanwhile
+static uint64_t _cd_table_moves_publish(CD_Table *table, uint64_t move_count, const uint64_t *holes, uint64_t count_c)
+{
+	CD_Tombstones *tombstones = table->tombstones;
+	for (uint64_t m = 0; m < move_count; m++)
+	{
+		if (!_cd_tombstones_set(tombstones, holes[m], 0))
+		{
+			return 0;
+		}
+	}
+	for (uint64_t row = count_c; row < table->count.count_c; row++)
+	{
+		if (_cd_tombstones_is_deleted(tombstones, row) && !_cd_tombstones_set(tombstones, row, 0))
+		{
+			return 0;
+		}
+	}
+
+	_cd_atomic_store_release(&table->count.count_c, count_c);
+	if (!cf_file_view_write(table->count_view, 0, sizeof(table->count), &table->count))
+	{
+		_cd_make_error(CD_ERROR_FILE, "Failed to write count_c %llu for table %s", table->count.count_c, table->name.data);
+		return 0;
+	}
+	return 1;
+}
+
+uint64_t _cd_table_vacuum_redo(CD_Table *table, uint64_t move_count, const uint64_t *holes, const uint8_t *rows, uint64_t count_c)
+{
+	if (table->tombstones == NULL)
+	{
+		_cd_make_error(CD_ERROR_FILE, "Table '%s' has no deleted rows for a logged vacuum to fill", table->name.data);
+		return 0;
+	}
+	if (count_c > table->count.count_m && !_cd_table_capacity_set(table, count_c))
+	{
+		return 0;
+	}
+
+	for (uint64_t m = 0; m < move_count; m++)
+	{
+		if (holes[m] >= count_c)
+		{
+			_cd_make_error(CD_ERROR_FILE, "Logged vacuum of table '%s' fills row %llu past its %llu rows", table->name.data, holes[m], count_c);
+			return 0;
+		}
+		if (!_cd_table_row_write(table, holes[m], rows + m * table->schema->stride))
+		{
+			return 0;
+		}
+	}
+
+	return _cd_table_moves_publish(table, move_count, holes, count_c) && _cd_tombstones_commit(table->tombstones);
+}
+
+uint64_t cd_table_vacuum(CD_Table *table, uint64_t max_moves)
+{
+	_cd_mutex_lock(table->writer_lock);
+
+	uint64_t return_value = 1;
+
+	CD_Tombstones *tombstones = table->tombstones;
+	if (tombstones == NULL || tombstones->header.deleted_count == 0)
+	{
+		goto writer_unlock;
+	}
+
+	return_value = 0;
+
+	// the moves are logged from here on, the log holds nothing older of the table
+	CD_Wal *wal = table->db->wal;
+	if (!_cd_wal_checkpoint(wal))
+	{
+		goto writer_unlock;
+	}
+
+	uint64_t stride = table->schema->stride;
+	uint64_t attribute_count = cc_hash_map_count(table->schema->attribute_indices);
+	uint64_t *holes = malloc(sizeof(*holes) * CD_VACUUM_BATCH_MOVES);
+	uint8_t *rows = malloc(stride * CD_VACUUM_BATCH_MOVES);
+	// one decoded value of a dictionary or heap encoded attribute
+	uint64_t value_size = 0;
+	for (uint64_t attrib_index = 0; attrib_index < attribute_count; attrib_index++)
+	{
+		if (table->schema->attributes[attrib_index].size > value_size)
+		{
+			value_size = table->schema->attributes[attrib_index].size;
+		}
+	}
+	uint8_t *value_buffer = malloc(value_size);
+
+	// holes before first_hole are filled. selects only wait while a batch of moves is published
+	uint64_t count_c = table->count.count_c;
+	uint64_t first_hole = 0;
+	for (uint64_t moves = 0;;)
+	{
+		// the batch is gathered while selects run, only the writer changes the rows
+		uint64_t batch_count_c = count_c;
+		uint64_t move_count = 0;
+		for (;;)
+		{
+			// deleted rows at the end are dropped without moving anything, the holes of the batch are still marked
+			while (batch_count_c > first_hole && _cd_tombstones_is_deleted(tombstones, batch_count_c - 1))
+			{
+				batch_count_c--;
+			}
+
+			uint64_t hole = _cd_tombstones_next(tombstones, first_hole, batch_count_c);
+			if (hole == batch_count_c || move_count == CD_VACUUM_BATCH_MOVES || (max_moves != 0 && moves + move_count == max_moves))
+			{
+				break;
+			}
+
+			// the last row fills the first hole
+			if (!_cd_table_row_read(table, batch_count_c - 1, rows + move_count * stride))
+			{
+				goto buffers_free;
+			}
+			holes[move_count++] = hole;
+			first_hole = hole + 1;
+			batch_count_c--;
+		}
+		if (batch_count_c == count_c)
+		{
+			break;
+		}
+
+		// the batch is synced to the log before the table changes, a crash then leaves every moved row in one place
+		if (!_cd_wal_log_vacuum(wal, table, move_count, holes, rows, batch_count_c))
+		{
+			goto buffers_free;
+		}
+		uint64_t is_moved = _cd_wal_sync(wal);
+
+		// selects skip the holes while the rows are written to them
+		for (uint64_t m = 0; m < move_count && is_moved; m++)
+		{
+			is_moved = _cd_table_row_write(table, holes[m], rows + m * stride);
+		}
+
+		_cd_rwlock_write_lock(table->lock);
+		table->modification_count++;
+		for (uint64_t m = 0; m < move_count && is_moved; m++)
+		{
+			const uint8_t *row = rows + m * stride;
+			for (uint64_t attrib_index = 0; attrib_index < attribute_count && is_moved; attrib_index++)
+			{
+				const CD_AttributeEx *attribute = table->schema->attributes + attrib_index;
+				const void *value = row + attribute->offset;
+				if (attribute->encoding != CD_ENCODING_NONE)
+				{
+					is_moved = _cd_table_value_decode(table, attribute, value, value_buffer);
+					value = value_buffer;
+				}
+				is_moved = is_moved && _cd_table_value_index(table, attrib_index, value, holes[m]);
+			}
+		}
+		is_moved = is_moved && _cd_table_moves_publish(table, move_count, holes, batch_count_c) && _cd_table_indices_commit(table);
+		_cd_rwlock_write_unlock(table->lock);
+
+		is_moved = _cd_wal_commit(wal) && is_moved;
+		if (!is_moved || !_cd_tombstones_commit(tombstones))
+		{
+			goto buffers_free;
+		}
+
+		count_c = batch_count_c;
+		moves += move_count;
+	}
+
+	// once every hole is gone the entries left behind in the unique indices are dropped. the new buckets are built while
+	// selects run and swapped in while they wait
+	for (uint64_t attrib_index = 0; attrib_index < attribute_count && tombstones->header.deleted_count == 0; attrib_index++)
+	{
+		CD_HashIndex *index = table->unique_indices[attrib_index];
+		if (index == NULL || index->header.entry_count <= count_c)
+		{
+			continue;
+		}
+
+		_CD_HashIndexBuild build;
+		if (!_cd_hash_index_build(table, index, &build))
+		{
+			goto buffers_free;
+		}
+		_cd_rwlock_write_lock(table->lock);
+		uint64_t is_swapped = _cd_hash_index_swap(index, &build);
+		_cd_rwlock_write_unlock(table->lock);
+		if (!is_swapped)
+		{
+			goto buffers_free;
+		}
+	}
+
+	// the file shrinks to the rows left, the moved rows are in the log until the next checkpoint
+	_cd_rwlock_write_lock(table->lock);
+	return_value = _cd_table_capacity_set(table, count_c);
+	_cd_rwlock_write_unlock(table->lock);
+
+buffers_free:
+	free(value_buffer);
+	free(rows);
+	free(holes);
+writer_unlock:
+	_cd_mutex_unlock(table->writer_lock);
+	return return_value;
+}
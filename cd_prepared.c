@@ -0,0 +1,2297 @@
+#include "internal.h"
+
+#include <math.h>
+
+uint64_t _cd_projection_resolve(CD_Table *table, uint64_t attribute_count, const char *attribute_names[], _CD_ProjectedAttribute *attributes, uint64_t *data_stride)
+{
+	*data_stride = 0;
+
+	for (uint64_t i = 0; i < attribute_count; i++)
+	{
+		CC_String attrib_name = cc_string_create(attribute_names[i], 0);
+		const uint64_t *index_ptr = (const uint64_t *)cc_hash_map_lookup(table->schema->attribute_indices, attrib_name);
+		cc_string_destroy(attrib_name);
+
+		if (index_ptr == NULL)
+		{
+			_cd_make_error(CD_ERROR_ATTRIBUTE_DOES_NOT_EXIST, "Attribute '%s' does not exist in table '%s'", attribute_names[i], table->name.data);
+			return 0;
+		}
+
+		const CD_AttributeEx *attribute = table->schema->attributes + *index_ptr;
+
+		attributes[i].data_offset = *data_stride;
+		attributes[i].file_offset = attribute->offset;
+		attributes[i].size = attribute->size;
+		attributes[i].table_index = *index_ptr;
+		attributes[i].dictionary = table->dictionaries[*index_ptr];
+		attributes[i].heap = attribute->encoding == CD_ENCODING_HEAP ? table->heap : NULL;
+
+		*data_stride += attribute->size;
+	}
+
+	return 1;
+}
+
+// the packed caller data has exactly the layout of a table row
+static uint64_t _cd_projection_is_full_row(CD_Table *table, uint64_t attribute_count, const _CD_ProjectedAttribute *attributes, uint64_t data_stride)
+{
+	if (data_stride != table->schema->stride)
+	{
+		return 0;
+	}
+	for (uint64_t i = 0; i < attribute_count; i++)
+	{
+		if (attributes[i].data_offset != attributes[i].file_offset)
+		{
+			return 0;
+		}
+	}
+	// stored values of attributes left out would take the place of other values
+	uint64_t table_attribute_count = cc_hash_map_count(table->schema->attribute_indices);
+	for (uint64_t table_attrib_index = 0; table_attrib_index < table_attribute_count; table_attrib_index++)
+	{
+		if (table->schema->attributes[table_attrib_index].encoding != CD_ENCODING_NONE)
+		{
+			return 0;
+		}
+	}
+	return 1;
+}
+
+// insert
+
+CD_PreparedInsert *cd_table_insert_prepare(CD_Table *table, uint64_t attribute_count, const char *attribute_names[])
+{
+	uint64_t table_attribute_count = cc_hash_map_count(table->schema->attribute_indices);
+
+	CD_PreparedInsert *insert = malloc(sizeof(*insert));
+
+	insert->table = table;
+	insert->attribute_count = attribute_count;
+	insert->attributes = malloc(sizeof(*insert->attributes) * attribute_count);
+	insert->unique_attributes = malloc(sizeof(*insert->unique_attributes) * attribute_count);
+	insert->unique_count = 0;
+	insert->missing_unique = malloc(sizeof(*insert->missing_unique) * table_attribute_count);
+	insert->missing_unique_count = 0;
+	insert->zero = NULL;
+	insert->projection = malloc(sizeof(*insert->projection) * table_attribute_count);
+	insert->chunk = NULL;
+	insert->chunk_rows = 0;
+
+	if (!_cd_projection_resolve(table, attribute_count, attribute_names, insert->attributes, &insert->data_stride))
+	{
+		goto insert_destroy;
+	}
+
+	for (uint64_t table_attrib_index = 0; table_attrib_index < table_attribute_count; table_attrib_index++)
+	{
+		insert->projection[table_attrib_index] = attribute_count;
+	}
+	for (uint64_t i = 0; i < attribute_count; i++)
+	{
+		insert->projection[insert->attributes[i].table_index] = i;
+
+		if (table->unique_indices[insert->attributes[i].table_index] != NULL)
+		{
+			insert->unique_attributes[insert->unique_count++] = i;
+		}
+	}
+
+	// check not null
+	uint64_t zero_size = 0;
+	for (uint64_t table_attrib_index = 0; table_attrib_index < table_attribute_count; table_attrib_index++)
+	{
+		const CD_AttributeEx *attrib = table->schema->attributes + table_attrib_index;
+		if (insert->projection[table_attrib_index] != attribute_count)
+		{
+			continue;
+		}
+
+		if (attrib->constraints & CD_CONSTRAINT_NOT_NULL)
+		{
+			_cd_make_error(CD_ERROR_ATTRIBUTE_IS_NOT_NULL, "Attribute '%s' is NOT NULL and so needs to have a value when inserting a record. table: '%s'", attrib->name, table->name.data);
+			goto insert_destroy;
+		}
+
+		// attributes left out are stored zeroed, their unique index still needs an entry
+		if (table->unique_indices[table_attrib_index] != NULL)
+		{
+			insert->missing_unique[insert->missing_unique_count++] = table_attrib_index;
+			if (attrib->size > zero_size)
+			{
+				zero_size = attrib->size;
+			}
+		}
+	}
+
+	if (zero_size != 0)
+	{
+		insert->zero = calloc(1, zero_size);
+	}
+
+	insert->is_full_row = _cd_projection_is_full_row(table, attribute_count, insert->attributes, insert->data_stride);
+	if (table->schema->page_rows != 0)
+	{
+		// PAX tables are written one attribute of one page at a time
+		uint64_t size = 0;
+		for (uint64_t table_attrib_index = 0; table_attrib_index < table_attribute_count; table_attrib_index++)
+		{
+			const CD_AttributeEx *attribute = table->schema->attributes + table_attrib_index;
+			uint64_t attribute_size = _cd_attribute_stored_size(attribute) > attribute->size ? _cd_attribute_stored_size(attribute) : attribute->size;
+			if (attribute_size > size)
+			{
+				size = attribute_size;
+			}
+		}
+
+		insert->is_full_row = 0;
+		insert->chunk_rows = table->schema->page_rows;
+		insert->chunk = malloc(insert->chunk_rows * size);
+	}
+	else if (!insert->is_full_row)
+	{
+		insert->chunk_rows = CD_INSERT_CHUNK_SIZE / table->schema->stride + 1;
+		insert->chunk = malloc(insert->chunk_rows * table->schema->stride);
+	}
+
+	return insert;
+
+insert_destroy:
+	cd_prepared_insert_destroy(insert);
+	return NULL;
+}
+
+void cd_prepared_insert_destroy(CD_PreparedInsert *insert)
+{
+	if (insert != NULL)
+	{
+		free(insert->chunk);
+		free(insert->projection);
+		free(insert->zero);
+		free(insert->missing_unique);
+		free(insert->unique_attributes);
+		free(insert->attributes);
+		free(insert);
+	}
+}
+
+// checks that no two rows of the batch share a value of the attribute at data_offset
+static uint64_t _cd_batch_is_unique(uint64_t row_count, uint64_t data_stride, uint64_t data_offset, uint64_t size, const uint8_t *data, uint64_t *duplicate_row)
+{
+	uint64_t slot_count = 1;
+	while (slot_count < row_count * 2)
+	{
+		slot_count *= 2;
+	}
+	uint64_t mask = slot_count - 1;
+
+	// slots hold row + 1, 0 means empty
+	uint64_t *slots = calloc(slot_count, sizeof(*slots));
+
+	uint64_t is_unique = 1;
+	for (uint64_t row = 0; row < row_count && is_unique; row++)
+	{
+		const uint8_t *value = data + row * data_stride + data_offset;
+		for (uint64_t slot = _cd_hash(value, size) & mask;; slot = (slot + 1) & mask)
+		{
+			if (slots[slot] == 0)
+			{
+				slots[slot] = row + 1;
+				break;
+			}
+			if (memcmp(data + (slots[slot] - 1) * data_stride + data_offset, value, size) == 0)
+			{
+				*duplicate_row = row;
+				is_unique = 0;
+				break;
+			}
+		}
+	}
+
+	free(slots);
+
+	return is_unique;
+}
+
+// writes the stored values of the values of the dictionary or heap encoded attribute of row_count rows of data to
+// stored_values, stride bytes apart. values new to the dictionary or too long for the row are added to it or to the heap
+static uint64_t _cd_prepared_insert_encode(CD_PreparedInsert *insert, const _CD_ProjectedAttribute *attribute, uint64_t row_count, const uint8_t *data, uint8_t *stored_values, uint64_t stride)
+{
+	const CD_AttributeEx *table_attribute = insert->table->schema->attributes + attribute->table_index;
+
+	for (uint64_t row = 0; row < row_count; row++)
+	{
+		const void *value = data + row * insert->data_stride + attribute->data_offset;
+		if (attribute->heap != NULL)
+		{
+			if (!_cd_heap_encode(insert->table, attribute->heap, table_attribute, value, stored_values + row * stride))
+			{
+				return 0;
+			}
+			continue;
+		}
+
+		uint64_t code;
+		if (!_cd_dictionary_encode(insert->table, attribute->dictionary, value, &code))
+		{
+			return 0;
+		}
+		memcpy(stored_values + row * stride, &code, sizeof(code));
+	}
+	return 1;
+}
+
+// writes row_count rows of data to the rows of the table starting at first_row, the file must already hold them
+static uint64_t _cd_prepared_insert_write(CD_PreparedInsert *insert, uint64_t first_row, uint64_t row_count, const void *data)
+{
+	CD_Table *table = insert->table;
+	uint64_t stride = table->schema->stride;
+	uint64_t data_stride = insert->data_stride;
+
+	if (table->schema->page_rows != 0)
+	{
+		uint64_t table_attribute_count = cc_hash_map_count(table->schema->attribute_indices);
+		uint64_t page_rows = table->schema->page_rows;
+
+		for (uint64_t chunk_row = 0; chunk_row < row_count;)
+		{
+			// never cross a page so every attribute is one write
+			uint64_t rows = page_rows - (first_row + chunk_row) % page_rows;
+			if (rows > row_count - chunk_row)
+			{
+				rows = row_count - chunk_row;
+			}
+
+			for (uint64_t table_attrib_index = 0; table_attrib_index < table_attribute_count; table_attrib_index++)
+			{
+				const CD_AttributeEx *attribute = table->schema->attributes + table_attrib_index;
+				uint64_t attrib_index = insert->projection[table_attrib_index];
+
+				if (attrib_index == insert->attribute_count)
+				{
+					// code 0 and the zeroed _CD_HeapValue are the zero value
+					memset(insert->chunk, 0, rows * _cd_attribute_stored_size(attribute));
+				}
+				else if (attribute->encoding != CD_ENCODING_NONE)
+				{
+					if (!_cd_prepared_insert_encode(insert, insert->attributes + attrib_index, rows, (const uint8_t *)data + chunk_row * data_stride, insert->chunk, _cd_attribute_stored_size(attribute)))
+					{
+						return 0;
+					}
+				}
+				else
+				{
+					const uint8_t *values = (const uint8_t *)data + chunk_row * data_stride + insert->attributes[attrib_index].data_offset;
+					_cd_column_gather(values, rows, data_stride, attribute->size, insert->chunk);
+				}
+
+				if (!_cd_table_column_write(table, attribute, first_row + chunk_row, rows, insert->chunk))
+				{
+					return 0;
+				}
+			}
+
+			chunk_row += rows;
+		}
+	}
+	else if (insert->is_full_row)
+	{
+		// the input already has the layout of the table
+		if (!cf_file_view_write(table->data_view, first_row * stride, row_count * stride, data))
+		{
+			_cd_make_error(CD_ERROR_FILE, "Failed to write %llu records at index %llu for table %s", row_count, first_row, table->name.data);
+			return 0;
+		}
+	}
+	else
+	{
+		for (uint64_t chunk_row = 0; chunk_row < row_count; chunk_row += insert->chunk_rows)
+		{
+			uint64_t rows = row_count - chunk_row < insert->chunk_rows ? row_count - chunk_row : insert->chunk_rows;
+
+			memset(insert->chunk, 0, rows * stride);
+			for (uint64_t row = 0; row < rows; row++)
+			{
+				const uint8_t *row_data = (const uint8_t *)data + (chunk_row + row) * data_stride;
+				for (uint64_t i = 0; i < insert->attribute_count; i++)
+				{
+					if (insert->attributes[i].dictionary == NULL && insert->attributes[i].heap == NULL)
+					{
+						memcpy(insert->chunk + row * stride + insert->attributes[i].file_offset, row_data + insert->attributes[i].data_offset, insert->attributes[i].size);
+					}
+				}
+			}
+			for (uint64_t i = 0; i < insert->attribute_count; i++)
+			{
+				const _CD_ProjectedAttribute *attribute = insert->attributes + i;
+				if ((attribute->dictionary != NULL || attribute->heap != NULL) && !_cd_prepared_insert_encode(insert, attribute, rows, (const uint8_t *)data + chunk_row * data_stride, insert->chunk + attribute->file_offset, stride))
+				{
+					return 0;
+				}
+			}
+
+			if (!cf_file_view_write(table->data_view, (first_row + chunk_row) * stride, rows * stride, insert->chunk))
+			{
+				_cd_make_error(CD_ERROR_FILE, "Failed to write records at index %llu for table %s", first_row + chunk_row, table->name.data);
+				return 0;
+			}
+		}
+	}
+
+	return 1;
+}
+
+// adds rows [first_row, first_row + row_count) of the table, written from data, to every index of the table
+static uint64_t _cd_prepared_insert_index(CD_PreparedInsert *insert, uint64_t first_row, uint64_t row_count, const void *data)
+{
+	CD_Table *table = insert->table;
+	uint64_t data_stride = insert->data_stride;
+
+	// keep the unique indices in step with the table
+	for (uint64_t u = 0; u < insert->unique_count; u++)
+	{
+		const _CD_ProjectedAttribute *attribute = insert->attributes + insert->unique_attributes[u];
+		CD_HashIndex *index = table->unique_indices[attribute->table_index];
+
+		for (uint64_t row = 0; row < row_count; row++)
+		{
+			const void *value = (const uint8_t *)data + row * data_stride + attribute->data_offset;
+			if (!_cd_hash_index_insert(index, value, attribute->size, first_row + row))
+			{
+				return 0;
+			}
+		}
+	}
+	for (uint64_t m = 0; m < insert->missing_unique_count; m++)
+	{
+		uint64_t table_attrib_index = insert->missing_unique[m];
+		CD_HashIndex *index = table->unique_indices[table_attrib_index];
+
+		for (uint64_t row = 0; row < row_count; row++)
+		{
+			if (!_cd_hash_index_insert(index, insert->zero, table->schema->attributes[table_attrib_index].size, first_row + row))
+			{
+				return 0;
+			}
+		}
+	}
+
+	// trigram indices can be created after the insert was prepared, so they are looked up here
+	uint64_t table_attribute_count = cc_hash_map_count(table->schema->attribute_indices);
+	for (uint64_t table_attrib_index = 0; table_attrib_index < table_attribute_count; table_attrib_index++)
+	{
+		CD_TrigramIndex *index = table->trigram_indices[table_attrib_index];
+		if (index == NULL)
+		{
+			continue;
+		}
+
+		uint64_t attrib_index = insert->projection[table_attrib_index];
+		for (uint64_t row = 0; row < row_count; row++)
+		{
+			const void *value = NULL;
+			if (attrib_index != insert->attribute_count)
+			{
+				value = (const uint8_t *)data + row * data_stride + insert->attributes[attrib_index].data_offset;
+			}
+
+			if (!_cd_trigram_index_insert(index, value, first_row + row))
+			{
+				return 0;
+			}
+		}
+
+		if (!_cd_trigram_index_commit(index))
+		{
+			return 0;
+		}
+	}
+
+	for (uint64_t table_attrib_index = 0; table_attrib_index < table_attribute_count; table_attrib_index++)
+	{
+		CD_BTreeIndex *index = table->btree_indices[table_attrib_index];
+		if (index == NULL)
+		{
+			continue;
+		}
+
+		// attributes left out are stored zeroed
+		uint64_t attrib_index = insert->projection[table_attrib_index];
+		uint64_t value_stride = 0;
+		const uint8_t *value = NULL;
+		void *zero = NULL;
+		if (attrib_index != insert->attribute_count)
+		{
+			value_stride = data_stride;
+			value = (const uint8_t *)data + insert->attributes[attrib_index].data_offset;
+		}
+		else
+		{
+			zero = calloc(1, index->size);
+			value = zero;
+		}
+
+		for (uint64_t row = 0; row < row_count; row++, value += value_stride)
+		{
+			if (!_cd_btree_index_insert(index, value, first_row + row))
+			{
+				free(zero);
+				return 0;
+			}
+		}
+
+		free(zero);
+
+		if (!_cd_btree_index_commit(index))
+		{
+			return 0;
+		}
+	}
+
+	for (uint64_t table_attrib_index = 0; table_attrib_index < table_attribute_count; table_attrib_index++)
+	{
+		CD_BloomFilter *filter = table->bloom_filters[table_attrib_index];
+		if (filter == NULL)
+		{
+			continue;
+		}
+
+		// attributes left out are stored zeroed
+		uint64_t attrib_index = insert->projection[table_attrib_index];
+		uint64_t value_stride = 0;
+		const uint8_t *value = NULL;
+		void *zero = NULL;
+		if (attrib_index != insert->attribute_count)
+		{
+			value_stride = data_stride;
+			value = (const uint8_t *)data + insert->attributes[attrib_index].data_offset;
+		}
+		else
+		{
+			zero = calloc(1, filter->size);
+			value = zero;
+		}
+
+		for (uint64_t row = 0; row < row_count; row++, value += value_stride)
+		{
+			if (!_cd_bloom_filter_insert(table, filter, value, first_row + row))
+			{
+				free(zero);
+				return 0;
+			}
+		}
+
+		free(zero);
+
+		if (!_cd_bloom_filter_commit(filter))
+		{
+			return 0;
+		}
+	}
+
+	CD_ZoneMap *zone_map = table->zone_map;
+	if (zone_map != NULL)
+	{
+		for (uint64_t table_attrib_index = 0; table_attrib_index < table_attribute_count; table_attrib_index++)
+		{
+			// attributes left out are stored zeroed
+			uint64_t attrib_index = insert->projection[table_attrib_index];
+			if (attrib_index != insert->attribute_count)
+			{
+				const uint8_t *values = (const uint8_t *)data + insert->attributes[attrib_index].data_offset;
+				if (!_cd_zone_map_insert(zone_map, table_attrib_index, values, data_stride, first_row, row_count))
+				{
+					return 0;
+				}
+				continue;
+			}
+
+			void *zero = calloc(1, table->schema->attributes[table_attrib_index].size);
+			uint64_t is_inserted = _cd_zone_map_insert(zone_map, table_attrib_index, zero, 0, first_row, row_count);
+			free(zero);
+			if (!is_inserted)
+			{
+				return 0;
+			}
+		}
+
+		if (!_cd_zone_map_commit(zone_map))
+		{
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+// writer_lock of the table must be locked
+// counts the unique lookups into add
+static uint64_t _cd_prepared_insert_rows(CD_PreparedInsert *insert, uint64_t row_count, const void *data, CD_Stats *add)
+{
+	CD_Table *table = insert->table;
+	CD_Wal *wal = table->db->wal;
+	uint64_t data_stride = insert->data_stride;
+
+	// check unique against the table and inside the batch
+	for (uint64_t u = 0; u < insert->unique_count; u++)
+	{
+		const _CD_ProjectedAttribute *attribute = insert->attributes + insert->unique_attributes[u];
+		CD_HashIndex *index = table->unique_indices[attribute->table_index];
+		CD_BloomFilter *filter = table->bloom_filters[attribute->table_index];
+
+		for (uint64_t row = 0; row < row_count; row++)
+		{
+			const void *value = (const uint8_t *)data + row * data_stride + attribute->data_offset;
+
+			// most new values are answered by the filter without looking at the table
+			if (filter != NULL && !_cd_bloom_filter_probe(filter, value, add))
+			{
+				continue;
+			}
+
+			uint64_t table_row;
+			add->unique_lookups++;
+			if (_cd_hash_index_find(table, index, value, &table_row, &add->unique_compares))
+			{
+				_cd_make_error(CD_ERROR_ATTRIBUTE_IS_UNIQUE, "Attribute '%s' is UNIQUE and is already in the table '%s' at row %llu", table->schema->attributes[attribute->table_index].name, table->name.data, table_row);
+				return 0;
+			}
+			add->bloom_false_positives += filter != NULL;
+		}
+
+		uint64_t duplicate_row;
+		if (row_count > 1 && !_cd_batch_is_unique(row_count, data_stride, attribute->data_offset, attribute->size, data, &duplicate_row))
+		{
+			_cd_make_error(CD_ERROR_ATTRIBUTE_IS_UNIQUE, "Attribute '%s' is UNIQUE but row %llu of the inserted rows repeats an earlier value. table: '%s'", table->schema->attributes[attribute->table_index].name, duplicate_row, table->name.data);
+			return 0;
+		}
+	}
+
+	// rows freed by a delete are filled before any row is appended
+	CD_Tombstones *tombstones = table->tombstones;
+	uint64_t count_c = table->count.count_c;
+	_CD_InsertRun *runs = NULL;
+	uint64_t run_count = 0;
+	uint64_t reused_count = 0;
+	if (tombstones != NULL && tombstones->header.deleted_count != 0)
+	{
+		for (uint64_t row = _cd_tombstones_next(tombstones, 0, count_c); row < count_c && reused_count < row_count; row = _cd_tombstones_next(tombstones, row, count_c))
+		{
+			uint64_t run = 1;
+			while (reused_count + run < row_count && row + run < count_c && _cd_tombstones_is_deleted(tombstones, row + run))
+			{
+				run++;
+			}
+
+			runs = realloc(runs, sizeof(*runs) * (run_count + 1));
+			runs[run_count++] = (_CD_InsertRun){ .first_row = row, .row_count = run };
+			reused_count += run;
+			row += run;
+		}
+	}
+
+	uint64_t return_value = 0;
+
+	// the rest is appended; the file grows once for the whole batch, before anything is logged
+	uint64_t append_count = row_count - reused_count;
+	const uint8_t *append_data = (const uint8_t *)data + reused_count * data_stride;
+	if (count_c + append_count > table->count.count_m)
+	{
+		uint64_t old_count_m = table->count.count_m;
+		_cd_rwlock_write_lock(table->lock);
+		uint64_t is_grown = _cd_table_capacity_set(table, _cd_table_capacity_next(table, count_c + append_count));
+		_cd_rwlock_write_unlock(table->lock);
+		if (!is_grown || !_cd_table_preallocate(table, old_count_m))
+		{
+			goto runs_free;
+		}
+	}
+
+	// every row is written first, selects skip deleted rows and rows past count_c meanwhile
+	uint64_t logged_count = 0;
+	uint64_t is_written = 1;
+	const uint8_t *run_data = data;
+	for (uint64_t r = 0; r < run_count && is_written; r++)
+	{
+		is_written = _cd_wal_log_insert(wal, table, insert->attribute_count, insert->attributes, data_stride, runs[r].first_row, runs[r].row_count, run_data);
+		logged_count += is_written;
+		is_written = is_written && _cd_prepared_insert_write(insert, runs[r].first_row, runs[r].row_count, run_data);
+		run_data += runs[r].row_count * data_stride;
+	}
+	if (is_written && append_count != 0)
+	{
+		is_written = _cd_wal_log_insert(wal, table, insert->attribute_count, insert->attributes, data_stride, count_c, append_count, append_data);
+		logged_count += is_written;
+		is_written = is_written && _cd_prepared_insert_write(insert, count_c, append_count, append_data);
+	}
+
+	// every logged record is ended, also when writing its rows failed
+	uint64_t is_committed = 1;
+	for (uint64_t l = 0; l < logged_count; l++)
+	{
+		is_committed = _cd_wal_commit(wal) && is_committed;
+	}
+	if (!is_committed || !is_written)
+	{
+		goto runs_free;
+	}
+
+	// then the whole batch becomes live at once: it is indexed, the tombstones of the reused rows are cleared and the
+	// new count is published
+	_cd_rwlock_write_lock(table->lock);
+	table->modification_count += run_count != 0;
+	uint64_t is_live = 1;
+	run_data = data;
+	for (uint64_t r = 0; r < run_count && is_live; r++)
+	{
+		is_live = _cd_prepared_insert_index(insert, runs[r].first_row, runs[r].row_count, run_data);
+		run_data += runs[r].row_count * data_stride;
+	}
+	if (is_live && append_count != 0)
+	{
+		is_live = _cd_prepared_insert_index(insert, count_c, append_count, append_data);
+	}
+	for (uint64_t r = 0; r < run_count && is_live; r++)
+	{
+		for (uint64_t row = 0; row < runs[r].row_count && is_live; row++)
+		{
+			is_live = _cd_tombstones_set(tombstones, runs[r].first_row + row, 0);
+		}
+	}
+	if (is_live && append_count != 0)
+	{
+		_cd_atomic_store_release(&table->count.count_c, count_c + append_count);
+	}
+	_cd_rwlock_write_unlock(table->lock);
+
+	if (!is_live || (run_count != 0 && !_cd_tombstones_commit(tombstones)) || (append_count != 0 && !_cd_wal_count_write(wal, table)))
+	{
+		goto runs_free;
+	}
+
+	return_value = _cd_wal_checkpoint_if_full(wal);
+
+runs_free:
+	free(runs);
+	return return_value;
+}
+
+uint64_t cd_prepared_insert(CD_PreparedInsert *insert, uint64_t row_count, const void *data)
+{
+	if (row_count == 0)
+	{
+		return 1;
+	}
+
+	CD_Table *table = insert->table;
+
+	CD_Stats add = { 0 };
+
+	_cd_mutex_lock(table->writer_lock);
+	uint64_t return_value = _cd_prepared_insert_rows(insert, row_count, data, &add);
+	_cd_mutex_unlock(table->writer_lock);
+
+	if (return_value)
+	{
+		add.inserts = row_count;
+	}
+	_cd_table_stats_add(table, &add);
+
+	return return_value;
+}
+
+uint64_t _cd_prepared_insert_redo(CD_PreparedInsert *insert, uint64_t first_row, uint64_t row_count, const void *data)
+{
+	CD_Table *table = insert->table;
+	uint64_t end_row = first_row + row_count;
+
+	if (end_row > table->count.count_m)
+	{
+		uint64_t old_count_m = table->count.count_m;
+		if (!_cd_table_capacity_set(table, _cd_table_capacity_next(table, end_row)) || !_cd_table_preallocate(table, old_count_m))
+		{
+			return 0;
+		}
+	}
+
+	if (!_cd_prepared_insert_write(insert, first_row, row_count, data))
+	{
+		return 0;
+	}
+
+	// the rows may have been deleted rows that the insert reused
+	CD_Tombstones *tombstones = table->tombstones;
+	if (tombstones != NULL && tombstones->header.deleted_count != 0)
+	{
+		for (uint64_t row = first_row; row < end_row; row++)
+		{
+			if (_cd_tombstones_is_deleted(tombstones, row) && !_cd_tombstones_set(tombstones, row, 0))
+			{
+				return 0;
+			}
+		}
+		if (!_cd_tombstones_commit(tombstones))
+		{
+			return 0;
+		}
+	}
+
+	if (end_row > table->count.count_c)
+	{
+		_cd_atomic_store_release(&table->count.count_c, end_row);
+		if (!cf_file_view_write(table->count_view, 0, sizeof(table->count), &table->count))
+		{
+			_cd_make_error(CD_ERROR_FILE, "Failed to write count_c %llu for table %s", table->count.count_c, table->name.data);
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+// select
+
+// codes of dictionary encoded attributes are compared like UINT values
+static const CD_AttributeEx _cd_code_attribute = { .type = CD_TYPE_UINT, .count = 1, .size = sizeof(uint64_t) };
+
+CD_PreparedSelect *cd_table_select_prepare(CD_Table *table, uint64_t attribute_count, const char *attribute_names[], uint64_t condition_count, CD_Condition *conditions)
+{
+	if (conditions == NULL)
+	{
+		condition_count = 0;
+	}
+
+	CD_PreparedSelect *select = malloc(sizeof(*select));
+
+	select->table = table;
+	select->attribute_count = attribute_count;
+	select->attributes = malloc(sizeof(*select->attributes) * attribute_count);
+	select->view_attributes = malloc(sizeof(*select->view_attributes) * attribute_count);
+	select->condition_count = condition_count;
+	select->conditions = malloc(sizeof(*select->conditions) * condition_count);
+	select->scans = malloc(sizeof(*select->scans) * condition_count);
+	select->chunk_rows = CD_SCAN_CHUNK_SIZE / table->schema->stride + 1;
+	if (table->schema->page_rows != 0)
+	{
+		select->chunk_rows = table->schema->page_rows;
+	}
+	select->column_size = 0;
+	select->value_size = 0;
+	select->aggregate_count = 0;
+	select->aggregates = NULL;
+	select->group_by = NULL;
+	select->is_row_numbers = 0;
+	select->thread_count = 0;
+	select->worker_count = 0;
+	select->workers = NULL;
+
+	select->trace = (CD_QueryTrace){ 0 };
+
+	if (!_cd_projection_resolve(table, attribute_count, attribute_names, select->attributes, &select->data_stride))
+	{
+		goto select_destroy;
+	}
+
+	for (uint64_t i = 0; i < attribute_count; i++)
+	{
+		CD_AttributeEx *view_attribute = select->view_attributes + i;
+
+		*view_attribute = table->schema->attributes[select->attributes[i].table_index];
+		view_attribute->offset = select->attributes[i].data_offset;
+		view_attribute->encoding = CD_ENCODING_NONE;
+	}
+
+	select->is_full_row = _cd_projection_is_full_row(table, attribute_count, select->attributes, select->data_stride);
+
+	for (uint64_t condition_index = 0; condition_index < condition_count; condition_index++)
+	{
+		CD_Condition *condition = conditions + condition_index;
+		_CD_PreparedCondition *prepared = select->conditions + condition_index;
+
+		CC_String condition_name = cc_string_create(condition->name, 0);
+		const uint64_t *condition_attribute_index_ptr = (const uint64_t *)cc_hash_map_lookup(table->schema->attribute_indices, condition_name);
+		cc_string_destroy(condition_name);
+
+		if (condition_attribute_index_ptr == NULL)
+		{
+			_cd_make_error(CD_ERROR_ATTRIBUTE_DOES_NOT_EXIST, "Attribute '%s' does not exist in table '%s'", condition->name, table->name.data);
+			goto select_destroy;
+		}
+
+		prepared->attribute = table->schema->attributes + *condition_attribute_index_ptr;
+		prepared->operator = condition->operator;
+		prepared->func_equal = _cd_funcs_equal[prepared->attribute->type];
+		prepared->func_compare = _cd_funcs_compare[prepared->attribute->type];
+		prepared->func_contains = _cd_funcs_contains[prepared->attribute->type];
+		prepared->kernel = NULL;
+		prepared->heap = prepared->attribute->encoding == CD_ENCODING_HEAP ? table->heap : NULL;
+		prepared->data = condition->data;
+
+		if (prepared->heap != NULL && select->value_size < prepared->attribute->size)
+		{
+			select->value_size = prepared->attribute->size;
+		}
+
+		switch (condition->operator)
+		{
+		case CD_CONDITION_OPERATOR_EQUALS:
+		case CD_CONDITION_OPERATOR_DIFFERENT:
+		case CD_CONDITION_OPERATOR_BIGGER:
+		case CD_CONDITION_OPERATOR_SMALLER:
+		{
+			// EQUALS of a dictionary encoded attribute compares codes, the other operators look the codes up in a
+			// table of the matching ones
+			if (prepared->attribute->encoding != CD_ENCODING_DICTIONARY)
+			{
+				prepared->kernel = _cd_kernel_get(prepared->attribute, condition->operator);
+			}
+			else if (condition->operator == CD_CONDITION_OPERATOR_EQUALS)
+			{
+				prepared->kernel = _cd_kernel_get(&_cd_code_attribute, condition->operator);
+			}
+			break;
+		}
+		case CD_CONDITION_OPERATOR_CONTAINS:
+		{
+			if (prepared->func_contains == NULL)
+			{
+				_cd_make_error(CD_ERROR_UNKNOWN_OPERATOR, "Operator %llu needs a text attribute but '%s' is not one. table: '%s'", condition->operator, prepared->attribute->name, table->name.data);
+				goto select_destroy;
+			}
+			break;
+		}
+		default:
+		{
+			_cd_make_error(CD_ERROR_UNKNOWN_OPERATOR, "Operator %llu is not recognized. table: '%s'", condition->operator, table->name.data);
+			goto select_destroy;
+		}
+		}
+
+		// kernel attributes are at most 8 bytes
+		if (prepared->kernel != NULL && select->column_size < sizeof(uint64_t))
+		{
+			select->column_size = sizeof(uint64_t);
+		}
+	}
+
+	// PAX tables read every condition and projected attribute into the column buffer
+	if (table->schema->page_rows != 0)
+	{
+		for (uint64_t i = 0; i < attribute_count; i++)
+		{
+			uint64_t size = _cd_attribute_stored_size(table->schema->attributes + select->attributes[i].table_index);
+			if (size > select->column_size)
+			{
+				select->column_size = size;
+			}
+		}
+		for (uint64_t i = 0; i < condition_count; i++)
+		{
+			uint64_t size = _cd_attribute_stored_size(select->conditions[i].attribute);
+			if (size > select->column_size)
+			{
+				select->column_size = size;
+			}
+		}
+	}
+
+	return select;
+
+select_destroy:
+	cd_prepared_select_destroy(select);
+	return NULL;
+}
+
+void cd_prepared_select_destroy(CD_PreparedSelect *select)
+{
+	if (select != NULL)
+	{
+		for (uint64_t w = 0; w < select->worker_count; w++)
+		{
+			free(select->workers[w].accumulators);
+			free(select->workers[w].cursors);
+			free(select->workers[w].selection);
+			free(select->workers[w].value);
+			free(select->workers[w].column);
+			free(select->workers[w].chunk);
+		}
+		free(select->workers);
+		free(select->aggregates);
+		free(select->scans);
+		free(select->conditions);
+		free(select->view_attributes);
+		free(select->attributes);
+		free(select);
+	}
+}
+
+// reads rows [row, row + row_count) of the table into buffer with one read of the data view
+static uint64_t _cd_table_read_rows(CD_Table *table, uint64_t row, uint64_t row_count, void *buffer)
+{
+	if (!cf_file_view_read(table->data_view, row * table->schema->stride, row_count * table->schema->stride, buffer))
+	{
+		_cd_make_error(CD_ERROR_FILE, "Failed to read %llu rows at row %llu from table '%s'", row_count, row, table->name.data);
+		return 0;
+	}
+	return 1;
+}
+
+// characters of the null terminated condition value of a CONTAINS condition
+static uint64_t _cd_needle_length(uint64_t type, const void *needle)
+{
+	if (type == CD_TYPE_WCHAR || type == CD_TYPE_WVARCHAR)
+	{
+		return wcslen(needle);
+	}
+	return strlen(needle);
+}
+
+static uint64_t _cd_condition_is_true(const _CD_PreparedCondition *condition, const void *value, const void *data)
+{
+	switch (condition->operator)
+	{
+	case CD_CONDITION_OPERATOR_EQUALS:
+		return condition->func_equal(value, data, condition->attribute->count);
+	case CD_CONDITION_OPERATOR_DIFFERENT:
+		return !condition->func_equal(value, data, condition->attribute->count);
+	case CD_CONDITION_OPERATOR_BIGGER:
+		return condition->func_compare(value, data, condition->attribute->count) > 0;
+	case CD_CONDITION_OPERATOR_SMALLER:
+		return condition->func_compare(value, data, condition->attribute->count) < 0;
+	default:
+		return 0;
+	}
+}
+
+void cd_prepared_select_thread_count_set(CD_PreparedSelect *select, uint64_t thread_count)
+{
+	select->thread_count = thread_count;
+}
+
+CD_QueryTrace cd_prepared_select_trace(CD_PreparedSelect *select)
+{
+	return select->trace;
+}
+
+// moves the counters of the first worker_count workers to the trace of select and to the stats of the table, once per
+// scan so the threads never share a counter while they run. start_ns is when the scan started
+static void _cd_prepared_select_trace_add(CD_PreparedSelect *select, uint64_t worker_count, uint64_t start_ns)
+{
+	CD_QueryTrace *trace = &select->trace;
+	CD_Stats add = { 0 };
+
+	for (uint64_t w = 0; w < worker_count; w++)
+	{
+		CD_QueryTrace *worker_trace = &select->workers[w].trace;
+
+		add.rows_scanned += worker_trace->rows_scanned;
+		add.rows_matched += worker_trace->rows_matched;
+		add.bytes_read += worker_trace->bytes_read;
+		add.rows_skipped += worker_trace->rows_skipped;
+		add.filter_ns += worker_trace->filter_ns;
+		add.materialize_ns += worker_trace->materialize_ns;
+
+		*worker_trace = (CD_QueryTrace){ 0 };
+	}
+
+	trace->rows_scanned += add.rows_scanned;
+	trace->rows_matched += add.rows_matched;
+	trace->bytes_read += add.bytes_read;
+	trace->rows_skipped += add.rows_skipped;
+	trace->filter_ns += add.filter_ns;
+	trace->materialize_ns += add.materialize_ns;
+	trace->total_ns += _cd_time_ns() - start_ns;
+	if (trace->thread_count < worker_count)
+	{
+		trace->thread_count = worker_count;
+	}
+
+	_cd_table_stats_add(select->table, &add);
+}
+
+// makes sure there are buffers for worker_count workers
+static void _cd_prepared_select_workers_reserve(CD_PreparedSelect *select, uint64_t worker_count)
+{
+	if (worker_count <= select->worker_count)
+	{
+		return;
+	}
+
+	CD_Table *table = select->table;
+
+	select->workers = realloc(select->workers, sizeof(*select->workers) * worker_count);
+	for (uint64_t w = select->worker_count; w < worker_count; w++)
+	{
+		_CD_ScanWorker *worker = select->workers + w;
+
+		worker->chunk = NULL;
+		if (table->schema->page_rows == 0)
+		{
+			worker->chunk = malloc(select->chunk_rows * table->schema->stride);
+		}
+		worker->column = malloc(select->chunk_rows * select->column_size);
+		worker->value = malloc(select->value_size);
+		worker->selection = malloc(select->chunk_rows);
+		worker->cursors = malloc(sizeof(*worker->cursors) * select->condition_count);
+		worker->view = NULL;
+		worker->aggregate_rows = 0;
+		worker->accumulators = malloc(sizeof(*worker->accumulators) * select->aggregate_count);
+		worker->trace = (CD_QueryTrace){ 0 };
+	}
+	select->worker_count = worker_count;
+}
+
+// clears the flags of the rows in [chunk_row, chunk_row + rows) that are not candidates, cursor is moved past them
+static void _cd_condition_scan_apply_candidates(const _CD_ConditionScan *scan, uint64_t *cursor, uint64_t chunk_row, uint64_t rows, uint8_t *selection)
+{
+	// candidates of chunks that were skipped
+	while (*cursor < scan->candidate_count && scan->candidates[*cursor] < chunk_row)
+	{
+		(*cursor)++;
+	}
+
+	uint64_t row = 0;
+	while (*cursor < scan->candidate_count && scan->candidates[*cursor] < chunk_row + rows)
+	{
+		uint64_t candidate = scan->candidates[*cursor] - chunk_row;
+		memset(selection + row, 0, candidate - row);
+		row = candidate + 1;
+		(*cursor)++;
+	}
+	memset(selection + row, 0, rows - row);
+}
+
+// applies one condition to the rows of a chunk that are still selected; the values of the condition attribute are stride bytes apart
+static uint64_t _cd_condition_apply(_CD_ScanWorker *worker, const _CD_PreparedCondition *condition, const _CD_ConditionScan *scan, const uint8_t *values, uint64_t stride, uint64_t rows)
+{
+	uint8_t *selection = worker->selection;
+
+	if (scan->code_matches != NULL)
+	{
+		const uint8_t *code = values;
+		for (uint64_t row = 0; row < rows; row++, code += stride)
+		{
+			uint64_t value_code;
+			memcpy(&value_code, code, sizeof(value_code));
+			selection[row] &= value_code < scan->code_count && scan->code_matches[value_code];
+		}
+		return 1;
+	}
+
+	if (condition->heap != NULL)
+	{
+		// values are read from the heap one selected row at a time. the ones whose length differs from the one of the
+		// value an EQUALS or DIFFERENT compares to are told apart without reading them
+		uint64_t is_equality = condition->operator == CD_CONDITION_OPERATOR_EQUALS || condition->operator == CD_CONDITION_OPERATOR_DIFFERENT;
+		uint64_t data_length = 0;
+		if (is_equality)
+		{
+			data_length = _cd_text_size(condition->attribute->type, scan->data, condition->attribute->size);
+			data_length = data_length > CD_HEAP_INLINE_SIZE ? data_length : 0;
+		}
+
+		const uint8_t *value = values;
+		for (uint64_t row = 0; row < rows; row++, value += stride)
+		{
+			if (!selection[row])
+				continue;
+
+			if (is_equality && _cd_heap_value_length(value) != data_length)
+			{
+				selection[row] = condition->operator == CD_CONDITION_OPERATOR_DIFFERENT;
+				continue;
+			}
+			if (!_cd_heap_decode(condition->heap, condition->attribute->size, value, worker->value))
+			{
+				return 0;
+			}
+			if (condition->operator == CD_CONDITION_OPERATOR_CONTAINS)
+			{
+				selection[row] = (uint8_t)condition->func_contains(worker->value, condition->attribute->count, scan->data, scan->needle_length);
+			}
+			else
+			{
+				selection[row] = (uint8_t)_cd_condition_is_true(condition, worker->value, scan->data);
+			}
+		}
+		return 1;
+	}
+
+	if (condition->kernel != NULL)
+	{
+		// kernels run over the values of the chunk stored back to back
+		uint64_t size = _cd_attribute_stored_size(condition->attribute);
+		const void *column = values;
+		if (size != stride)
+		{
+			_cd_column_gather(values, rows, stride, size, worker->column);
+			column = worker->column;
+		}
+		condition->kernel(column, rows, condition->attribute->encoding == CD_ENCODING_DICTIONARY ? &scan->code : scan->data, selection);
+		return 1;
+	}
+
+	const uint8_t *value = values;
+	if (condition->operator == CD_CONDITION_OPERATOR_CONTAINS)
+	{
+		for (uint64_t row = 0; row < rows; row++, value += stride)
+		{
+			if (selection[row] && !condition->func_contains(value, condition->attribute->count, scan->data, scan->needle_length))
+			{
+				selection[row] = 0;
+			}
+		}
+		return 1;
+	}
+
+	for (uint64_t row = 0; row < rows; row++, value += stride)
+	{
+		if (selection[row] && !_cd_condition_is_true(condition, value, scan->data))
+		{
+			selection[row] = 0;
+		}
+	}
+
+	return 1;
+}
+
+// reduces the selected rows [chunk_row, chunk_row + rows) into the accumulators of worker. chunk holds the rows,
+// or is NULL for PAX tables whose aggregated attributes are read one at a time
+static uint64_t _cd_aggregate_chunk(CD_PreparedSelect *select, _CD_ScanWorker *worker, const uint8_t *chunk, uint64_t chunk_row, uint64_t rows)
+{
+	const uint8_t *selection = worker->selection;
+
+	uint64_t selected_count = 0;
+	for (uint64_t row = 0; row < rows; row++)
+	{
+		selected_count += selection[row];
+	}
+	worker->aggregate_rows += selected_count;
+
+	// aggregates of the same attribute one after the other share the column
+	const CD_AttributeEx *column_attribute = NULL;
+	for (uint64_t i = 0; i < select->aggregate_count; i++)
+	{
+		const _CD_PreparedAggregate *aggregate = select->aggregates + i;
+		if (aggregate->attribute == NULL)
+		{
+			continue;
+		}
+
+		if (aggregate->attribute != column_attribute)
+		{
+			if (chunk == NULL)
+			{
+				if (!_cd_table_column_read(select->table, aggregate->attribute, chunk_row, rows, worker->column))
+				{
+					return 0;
+				}
+				worker->trace.bytes_read += rows * aggregate->attribute->size;
+			}
+			else
+			{
+				_cd_column_gather(chunk + aggregate->attribute->offset, rows, select->table->schema->stride, aggregate->attribute->size, worker->column);
+			}
+			column_attribute = aggregate->attribute;
+		}
+
+		aggregate->func_reduce(worker->column, rows, selection, worker->accumulators + i);
+	}
+
+	return 1;
+}
+
+// adds the table row of every selected row of the chunk at chunk_row to the view of worker
+static void _cd_select_row_numbers(_CD_ScanWorker *worker, uint64_t chunk_row, uint64_t rows)
+{
+	const uint8_t *selection = worker->selection;
+
+	uint64_t selected_count = 0;
+	for (uint64_t row = 0; row < rows; row++)
+	{
+		selected_count += selection[row];
+	}
+
+	uint64_t *view_rows = _cd_table_view_get_next_rows(worker->view, selected_count);
+	for (uint64_t row = 0; row < rows; row++)
+	{
+		if (selection[row])
+		{
+			*view_rows++ = chunk_row + row;
+		}
+	}
+}
+
+// filters the rows [chunk_row, chunk_row + rows) of one page of a PAX table, only the attributes of the conditions are read
+static uint64_t _cd_pax_filter_chunk(CD_PreparedSelect *select, _CD_ScanWorker *worker, uint64_t chunk_row, uint64_t rows)
+{
+	CD_Table *table = select->table;
+
+	for (uint64_t i = 0; i < select->condition_count; i++)
+	{
+		const _CD_PreparedCondition *condition = select->conditions + i;
+
+		uint64_t size = _cd_attribute_stored_size(condition->attribute);
+		if (!_cd_table_column_read(table, condition->attribute, chunk_row, rows, worker->column))
+		{
+			return 0;
+		}
+		worker->trace.bytes_read += rows * size;
+
+		if (!_cd_condition_apply(worker, condition, select->scans + i, worker->column, size, rows))
+		{
+			return 0;
+		}
+		if (memchr(worker->selection, 1, rows) == NULL)
+		{
+			return 1;
+		}
+	}
+
+	return 1;
+}
+
+// copies the selected_count selected rows of a filtered page of a PAX table out, only the attributes of the projection are read
+static uint64_t _cd_pax_copy_chunk(CD_PreparedSelect *select, _CD_ScanWorker *worker, uint64_t chunk_row, uint64_t rows, uint64_t selected_count)
+{
+	CD_Table *table = select->table;
+	const uint8_t *selection = worker->selection;
+
+	uint8_t *view_rows = _cd_table_view_get_next_rows(worker->view, selected_count);
+
+	for (uint64_t attrib_index = 0; attrib_index < select->attribute_count; attrib_index++)
+	{
+		const _CD_ProjectedAttribute *attribute = select->attributes + attrib_index;
+		const CD_AttributeEx *table_attribute = table->schema->attributes + attribute->table_index;
+
+		if (!_cd_table_column_read(table, table_attribute, chunk_row, rows, worker->column))
+		{
+			return 0;
+		}
+		uint64_t size = _cd_attribute_stored_size(table_attribute);
+		worker->trace.bytes_read += rows * size;
+
+		uint8_t *view_value = view_rows + attribute->data_offset;
+		for (uint64_t row = 0; row < rows; row++)
+		{
+			if (selection[row])
+			{
+				if (!_cd_table_value_decode(table, table_attribute, worker->column + row * size, view_value))
+				{
+					return 0;
+				}
+				view_value += select->data_stride;
+			}
+		}
+	}
+
+	return 1;
+}
+
+// copies the selected rows of a filtered chunk of rows out
+static uint64_t _cd_rows_copy_chunk(CD_PreparedSelect *select, _CD_ScanWorker *worker, const uint8_t *chunk, uint64_t rows)
+{
+	CD_Table *table = select->table;
+	uint64_t stride = table->schema->stride;
+	const uint8_t *selection = worker->selection;
+
+	for (uint64_t row = 0; row < rows; row++)
+	{
+		if (!selection[row])
+			continue;
+
+		const uint8_t *chunk_ptr = chunk + row * stride;
+
+		if (select->is_full_row)
+		{
+			// copy every consecutive selected row in one go
+			uint64_t run = 1;
+			while (row + run < rows && selection[row + run])
+			{
+				run++;
+			}
+
+			uint8_t *row_ptr = _cd_table_view_get_next_rows(worker->view, run);
+			memcpy(row_ptr, chunk_ptr, run * stride);
+
+			row += run - 1;
+		}
+		else
+		{
+			uint8_t *row_ptr = cd_table_view_get_next_row(worker->view);
+			for (uint64_t attrib_index = 0; attrib_index < select->attribute_count; attrib_index++)
+			{
+				const _CD_ProjectedAttribute *attribute = select->attributes + attrib_index;
+				if (!_cd_table_value_decode(table, table->schema->attributes + attribute->table_index, chunk_ptr + attribute->file_offset, row_ptr + attribute->data_offset))
+				{
+					return 0;
+				}
+			}
+		}
+	}
+
+	return 1;
+}
+
+// hands the rows a chunk added to the view of worker to the group by of select, which keeps only the groups
+static uint64_t _cd_select_chunk_group(CD_PreparedSelect *select, _CD_ScanWorker *worker)
+{
+	if (select->group_by == NULL || worker->view->count_c == 0)
+	{
+		return 1;
+	}
+
+	uint64_t is_grouped = _cd_group_by_rows(select->group_by, worker->view->data, worker->view->count_c);
+	worker->view->count_c = 0;
+	return is_grouped;
+}
+
+// first candidate of scan that is not smaller than row
+static uint64_t _cd_condition_scan_lower_bound(const _CD_ConditionScan *scan, uint64_t row)
+{
+	uint64_t low = 0;
+	uint64_t high = scan->candidate_count;
+	while (low < high)
+	{
+		uint64_t middle = (low + high) / 2;
+		if (scan->candidates[middle] < row)
+		{
+			low = middle + 1;
+		}
+		else
+		{
+			high = middle;
+		}
+	}
+	return low;
+}
+
+// 1 when the zones of a condition rule out every row in [row, row + row_count)
+static uint64_t _cd_select_chunk_is_ruled_out(const CD_PreparedSelect *select, uint64_t row, uint64_t row_count)
+{
+	const CD_ZoneMap *zone_map = select->table->zone_map;
+	if (zone_map == NULL)
+	{
+		return 0;
+	}
+
+	for (uint64_t i = 0; i < select->condition_count; i++)
+	{
+		const _CD_PreparedCondition *condition = select->conditions + i;
+		uint64_t attribute_index = condition->attribute - select->table->schema->attributes;
+		if (_cd_zone_map_rules_out(zone_map, attribute_index, condition->operator, select->scans[i].data, row, row_count))
+		{
+			return 1;
+		}
+	}
+	return 0;
+}
+
+// filters the rows [*row, end_row) into the view of worker; *row is at the start of a chunk and is moved past the chunks done.
+// stops early once the view holds view_limit rows. every chunk is read once, filtered by all conditions and its selected
+// rows copied out, or reduced when the select has aggregates, before the next one
+static uint64_t _cd_select_rows(CD_PreparedSelect *select, _CD_ScanWorker *worker, uint64_t *row, uint64_t end_row, uint64_t view_limit)
+{
+	uint64_t begin_row = *row;
+	CD_Table *table = select->table;
+	uint64_t stride = table->schema->stride;
+	uint64_t chunk_rows = select->chunk_rows;
+	uint8_t *chunk = worker->chunk;
+	uint8_t *selection = worker->selection;
+
+	for (uint64_t i = 0; i < select->condition_count; i++)
+	{
+		if (select->scans[i].has_candidates)
+		{
+			worker->cursors[i] = _cd_condition_scan_lower_bound(select->scans + i, begin_row);
+		}
+	}
+
+	*row = end_row;
+
+	for (uint64_t chunk_row = begin_row; chunk_row < end_row; chunk_row += chunk_rows)
+	{
+		if (worker->view != NULL && worker->view->count_c >= view_limit)
+		{
+			*row = chunk_row;
+			break;
+		}
+
+		// go straight to the chunk of the first row every candidate list still holds
+		uint64_t next_row = chunk_row;
+		for (uint64_t i = 0; i < select->condition_count; i++)
+		{
+			const _CD_ConditionScan *scan = select->scans + i;
+			if (!scan->has_candidates)
+			{
+				continue;
+			}
+
+			uint64_t c = worker->cursors[i];
+			while (c < scan->candidate_count && scan->candidates[c] < chunk_row)
+			{
+				c++;
+			}
+			if (c == scan->candidate_count)
+			{
+				next_row = end_row;
+				break;
+			}
+			if (scan->candidates[c] > next_row)
+			{
+				next_row = scan->candidates[c];
+			}
+		}
+		if (next_row >= end_row)
+		{
+			break;
+		}
+		chunk_row += (next_row - chunk_row) / chunk_rows * chunk_rows;
+
+		uint64_t rows = end_row - chunk_row < chunk_rows ? end_row - chunk_row : chunk_rows;
+
+		// chunks whose zones can not match a condition are not read
+		if (_cd_select_chunk_is_ruled_out(select, chunk_row, rows))
+		{
+			worker->trace.rows_skipped += rows;
+			continue;
+		}
+
+		memset(selection, 1, rows);
+
+		uint64_t is_empty = 0;
+		if (table->tombstones != NULL && table->tombstones->header.deleted_count != 0)
+		{
+			_cd_tombstones_apply(table->tombstones, chunk_row, rows, selection);
+			is_empty = memchr(selection, 1, rows) == NULL;
+		}
+		for (uint64_t i = 0; i < select->condition_count && !is_empty; i++)
+		{
+			if (select->scans[i].has_candidates)
+			{
+				_cd_condition_scan_apply_candidates(select->scans + i, worker->cursors + i, chunk_row, rows, selection);
+				is_empty = memchr(selection, 1, rows) == NULL;
+			}
+		}
+		if (is_empty)
+		{
+			continue;
+		}
+
+		// the time of a chunk goes to filtering until its rows are selected, then to materializing them
+		uint64_t filter_start_ns = _cd_time_ns();
+
+		if (chunk == NULL)
+		{
+			if (!_cd_pax_filter_chunk(select, worker, chunk_row, rows))
+			{
+				return 0;
+			}
+			is_empty = memchr(selection, 1, rows) == NULL;
+		}
+		else
+		{
+			if (!_cd_table_read_rows(table, chunk_row, rows, chunk))
+			{
+				return 0;
+			}
+			worker->trace.bytes_read += rows * stride;
+
+			for (uint64_t i = 0; i < select->condition_count && !is_empty; i++)
+			{
+				const _CD_PreparedCondition *condition = select->conditions + i;
+				if (!_cd_condition_apply(worker, condition, select->scans + i, chunk + condition->attribute->offset, stride, rows))
+				{
+					return 0;
+				}
+				is_empty = memchr(selection, 1, rows) == NULL;
+			}
+		}
+
+		uint64_t filter_end_ns = _cd_time_ns();
+		worker->trace.filter_ns += filter_end_ns - filter_start_ns;
+		worker->trace.rows_scanned += rows;
+		if (is_empty)
+		{
+			continue;
+		}
+
+		uint64_t selected_count = 0;
+		for (uint64_t row = 0; row < rows; row++)
+		{
+			selected_count += selection[row];
+		}
+		worker->trace.rows_matched += selected_count;
+
+		uint64_t is_materialized = 1;
+		if (select->aggregate_count != 0)
+		{
+			is_materialized = _cd_aggregate_chunk(select, worker, chunk, chunk_row, rows);
+		}
+		else if (select->is_row_numbers)
+		{
+			_cd_select_row_numbers(worker, chunk_row, rows);
+		}
+		else
+		{
+			if (chunk == NULL)
+			{
+				is_materialized = _cd_pax_copy_chunk(select, worker, chunk_row, rows, selected_count);
+			}
+			else
+			{
+				is_materialized = _cd_rows_copy_chunk(select, worker, chunk, rows);
+			}
+			is_materialized = is_materialized && _cd_select_chunk_group(select, worker);
+		}
+
+		worker->trace.materialize_ns += _cd_time_ns() - filter_end_ns;
+		if (!is_materialized)
+		{
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+// rows of the table are split in morsels of CD_MORSEL_CHUNKS chunks that the threads take one at a time,
+// a thread that is done early keeps taking the morsels left so no thread idles while others work
+typedef struct _CD_ScanJob
+{
+	CD_PreparedSelect *select;
+	uint64_t count_c;
+	uint64_t morsel_rows;
+	uint64_t morsel_count;
+	volatile uint64_t next_morsel;
+	volatile uint64_t is_failed;
+	_CD_ErrorState error; // of the first thread that failed
+
+	// for every morsel: the worker that filtered it and where its rows are in the view of that worker; NULL when aggregating
+	uint64_t *morsel_worker;
+	uint64_t *morsel_first;
+	uint64_t *morsel_selected;
+} _CD_ScanJob;
+
+typedef struct _CD_ScanThread
+{
+	_CD_ScanJob *job;
+	uint64_t worker;
+	CD_Thread *thread;
+} _CD_ScanThread;
+
+static void _cd_scan_thread_run(void *argument)
+{
+	_CD_ScanThread *scan_thread = argument;
+	_CD_ScanJob *job = scan_thread->job;
+	_CD_ScanWorker *worker = job->select->workers + scan_thread->worker;
+
+	while (!job->is_failed)
+	{
+		uint64_t morsel = _cd_atomic_fetch_add(&job->next_morsel, 1);
+		if (morsel >= job->morsel_count)
+		{
+			break;
+		}
+
+		uint64_t begin_row = morsel * job->morsel_rows;
+		uint64_t end_row = begin_row + job->morsel_rows < job->count_c ? begin_row + job->morsel_rows : job->count_c;
+
+		if (job->morsel_worker != NULL)
+		{
+			job->morsel_worker[morsel] = scan_thread->worker;
+			job->morsel_first[morsel] = worker->view->count_c;
+		}
+		if (!_cd_select_rows(job->select, worker, &begin_row, end_row, UINT64_MAX))
+		{
+			if (_cd_atomic_fetch_add(&job->is_failed, 1) == 0)
+			{
+				_cd_error_save(&job->error);
+			}
+			break;
+		}
+		if (job->morsel_worker != NULL)
+		{
+			job->morsel_selected[morsel] = worker->view->count_c - job->morsel_first[morsel];
+		}
+	}
+}
+
+// runs the morsels of job on thread_count threads, thread t uses worker t of the select
+static uint64_t _cd_scan_parallel(_CD_ScanJob *job, uint64_t thread_count)
+{
+	_CD_ScanThread *threads = malloc(sizeof(*threads) * thread_count);
+	for (uint64_t t = 0; t < thread_count; t++)
+	{
+		threads[t].job = job;
+		threads[t].worker = t;
+		threads[t].thread = NULL;
+	}
+
+	// a thread that fails to start just leaves its morsels to the others
+	for (uint64_t t = 1; t < thread_count; t++)
+	{
+		threads[t].thread = _cd_thread_start(_cd_scan_thread_run, threads + t);
+	}
+	_cd_scan_thread_run(threads + 0);
+	for (uint64_t t = 1; t < thread_count; t++)
+	{
+		if (threads[t].thread != NULL)
+		{
+			_cd_thread_join(threads[t].thread);
+		}
+	}
+
+	free(threads);
+
+	// errors are per thread, the caller gets the one of the thread that failed
+	if (job->is_failed)
+	{
+		_cd_error_restore(&job->error);
+		return 0;
+	}
+	return 1;
+}
+
+// runs the scan on thread_count threads and stitches the rows of the workers together in row order
+static CD_TableView *_cd_select_parallel(CD_PreparedSelect *select, uint64_t count_c, uint64_t morsel_rows, uint64_t morsel_count, uint64_t thread_count)
+{
+	_CD_ScanJob job =
+	{
+		.select = select,
+		.count_c = count_c,
+		.morsel_rows = morsel_rows,
+		.morsel_count = morsel_count,
+		.next_morsel = 0,
+		.is_failed = 0,
+		.morsel_worker = malloc(sizeof(uint64_t) * morsel_count),
+		.morsel_first = malloc(sizeof(uint64_t) * morsel_count),
+		.morsel_selected = malloc(sizeof(uint64_t) * morsel_count)
+	};
+
+	for (uint64_t t = 0; t < thread_count; t++)
+	{
+		select->workers[t].view = _cd_table_view_create_from(select->attribute_count, select->view_attributes, select->data_stride);
+	}
+
+	CD_TableView *table_view = NULL;
+	if (_cd_scan_parallel(&job, thread_count))
+	{
+		uint64_t selected_count = 0;
+		for (uint64_t morsel = 0; morsel < morsel_count; morsel++)
+		{
+			selected_count += job.morsel_selected[morsel];
+		}
+
+		table_view = _cd_table_view_create_from(select->attribute_count, select->view_attributes, select->data_stride);
+		uint8_t *view_rows = _cd_table_view_get_next_rows(table_view, selected_count);
+
+		for (uint64_t morsel = 0; morsel < morsel_count; morsel++)
+		{
+			const CD_TableView *worker_view = select->workers[job.morsel_worker[morsel]].view;
+			uint64_t size = job.morsel_selected[morsel] * select->data_stride;
+
+			memcpy(view_rows, (const uint8_t *)worker_view->data + job.morsel_first[morsel] * select->data_stride, size);
+			view_rows += size;
+		}
+	}
+
+	for (uint64_t t = 0; t < thread_count; t++)
+	{
+		cd_table_view_destroy(select->workers[t].view);
+		select->workers[t].view = NULL;
+	}
+	free(job.morsel_selected);
+	free(job.morsel_first);
+	free(job.morsel_worker);
+
+	return table_view;
+}
+
+// turns the condition value of a dictionary encoded attribute into the code an EQUALS compares to, or for the other
+// operators into whether the value of every code matches. the lock of the table must be held shared
+static void _cd_condition_scan_codes(const _CD_PreparedCondition *condition, _CD_ConditionScan *scan, const CD_Dictionary *dictionary)
+{
+	if (condition->operator == CD_CONDITION_OPERATOR_EQUALS)
+	{
+		// a value the dictionary does not have matches no row, the scan is left with no candidates
+		scan->code = _cd_dictionary_find(dictionary, scan->data);
+		if (scan->code == UINT64_MAX)
+		{
+			free(scan->candidates);
+			scan->candidates = NULL;
+			scan->candidate_count = 0;
+			scan->has_candidates = 1;
+		}
+		return;
+	}
+
+	// the codes of the rows of the snapshot were added before the rows were counted
+	scan->code_count = _cd_dictionary_count(dictionary);
+	scan->code_matches = malloc(scan->code_count);
+	for (uint64_t code = 0; code < scan->code_count; code++)
+	{
+		const void *value = _cd_dictionary_decode(dictionary, code);
+		if (condition->operator == CD_CONDITION_OPERATOR_CONTAINS)
+		{
+			scan->code_matches[code] = (uint8_t)condition->func_contains(value, condition->attribute->count, scan->data, scan->needle_length);
+		}
+		else
+		{
+			scan->code_matches[code] = (uint8_t)_cd_condition_is_true(condition, value, scan->data);
+		}
+	}
+}
+
+// resolves the condition values of one execution and looks up the index candidates of the conditions.
+// the lock of the table must be held shared
+static uint64_t _cd_prepared_select_begin(CD_PreparedSelect *select, const void *condition_data[], uint64_t count_c)
+{
+	CD_Table *table = select->table;
+
+	select->trace = (CD_QueryTrace){ 0 };
+
+	CD_Stats add = { .selects = 1 };
+
+	uint64_t scan_count = 0;
+	for (; scan_count < select->condition_count; scan_count++)
+	{
+		const _CD_PreparedCondition *condition = select->conditions + scan_count;
+		_CD_ConditionScan *scan = select->scans + scan_count;
+
+		scan->data = condition_data != NULL ? condition_data[scan_count] : condition->data;
+		scan->needle_length = 0;
+		scan->candidates = NULL;
+		scan->candidate_count = 0;
+		scan->has_candidates = 0;
+		scan->code = 0;
+		scan->code_matches = NULL;
+		scan->code_count = 0;
+
+		uint64_t table_attrib_index = condition->attribute - table->schema->attributes;
+
+		// a B+tree narrows the scan to the rows it finds, unless too many match
+		CD_BTreeIndex *btree_index = table->btree_indices[table_attrib_index];
+		if (btree_index != NULL && (condition->operator == CD_CONDITION_OPERATOR_EQUALS || condition->operator == CD_CONDITION_OPERATOR_BIGGER || condition->operator == CD_CONDITION_OPERATOR_SMALLER))
+		{
+			uint64_t is_over_limit;
+			if (!_cd_btree_index_candidates(btree_index, condition->operator, scan->data, count_c / CD_BTREE_SCAN_FRACTION, &scan->candidates, &scan->candidate_count, &is_over_limit))
+			{
+				goto scans_destroy;
+			}
+			scan->has_candidates = !is_over_limit;
+		}
+
+		// a value the Bloom filter does not have matches no row, the scan is left with no candidates
+		CD_BloomFilter *bloom_filter = table->bloom_filters[table_attrib_index];
+		if (bloom_filter != NULL && condition->operator == CD_CONDITION_OPERATOR_EQUALS && !_cd_bloom_filter_probe(bloom_filter, scan->data, &add))
+		{
+			free(scan->candidates);
+			scan->candidates = NULL;
+			scan->candidate_count = 0;
+			scan->has_candidates = 1;
+		}
+
+		if (condition->operator == CD_CONDITION_OPERATOR_CONTAINS)
+		{
+			scan->needle_length = _cd_needle_length(condition->attribute->type, scan->data);
+
+			// rows the trigram index rules out are dropped before their chunk is read
+			CD_TrigramIndex *index = table->trigram_indices[table_attrib_index];
+			if (index != NULL && scan->needle_length >= 3)
+			{
+				if (!_cd_trigram_index_candidates(index, scan->data, scan->needle_length, &scan->candidates, &scan->candidate_count))
+				{
+					goto scans_destroy;
+				}
+				scan->has_candidates = 1;
+			}
+		}
+
+		CD_Dictionary *dictionary = table->dictionaries[table_attrib_index];
+		if (dictionary != NULL)
+		{
+			_cd_condition_scan_codes(condition, scan, dictionary);
+		}
+
+		if (scan->has_candidates)
+		{
+			select->trace.index_candidates += scan->candidate_count;
+		}
+	}
+
+	_cd_table_stats_add(table, &add);
+	return 1;
+
+scans_destroy:
+	_cd_table_stats_add(table, &add);
+	for (uint64_t i = 0; i < scan_count; i++)
+	{
+		free(select->scans[i].candidates);
+		select->scans[i].candidates = NULL;
+		free(select->scans[i].code_matches);
+		select->scans[i].code_matches = NULL;
+	}
+	return 0;
+}
+
+static void _cd_prepared_select_end(CD_PreparedSelect *select)
+{
+	for (uint64_t i = 0; i < select->condition_count; i++)
+	{
+		free(select->scans[i].candidates);
+		select->scans[i].candidates = NULL;
+		free(select->scans[i].code_matches);
+		select->scans[i].code_matches = NULL;
+	}
+}
+
+// threads a scan of morsel_count morsels runs on, there is no use for more threads than morsels
+static uint64_t _cd_select_thread_count(CD_PreparedSelect *select, uint64_t morsel_count)
+{
+	uint64_t thread_count = select->thread_count != 0 ? select->thread_count : select->table->db->thread_count;
+	if (thread_count > morsel_count)
+	{
+		thread_count = morsel_count;
+	}
+	return thread_count;
+}
+
+CD_TableView *cd_prepared_select(CD_PreparedSelect *select, const void *condition_data[])
+{
+	CD_TableView *table_view = NULL;
+	uint64_t start_ns = _cd_time_ns();
+
+	// the rows counted now are the snapshot of the select, the writer can not remap them until it is done
+	_cd_rwlock_read_lock(select->table->lock);
+	uint64_t count_c = _cd_atomic_load_acquire(&select->table->count.count_c);
+
+	if (!_cd_prepared_select_begin(select, condition_data, count_c))
+	{
+		goto table_unlock;
+	}
+
+	uint64_t morsel_rows = select->chunk_rows * CD_MORSEL_CHUNKS;
+	uint64_t morsel_count = (count_c + morsel_rows - 1) / morsel_rows;
+	uint64_t thread_count = _cd_select_thread_count(select, morsel_count);
+
+	if (thread_count <= 1)
+	{
+		_cd_prepared_select_workers_reserve(select, 1);
+
+		table_view = _cd_table_view_create_from(select->attribute_count, select->view_attributes, select->data_stride);
+		select->workers[0].view = table_view;
+		uint64_t row = 0;
+		uint64_t is_done = _cd_select_rows(select, select->workers + 0, &row, count_c, UINT64_MAX);
+		select->workers[0].view = NULL;
+
+		if (!is_done)
+		{
+			cd_table_view_destroy(table_view);
+			table_view = NULL;
+		}
+	}
+	else
+	{
+		_cd_prepared_select_workers_reserve(select, thread_count);
+		table_view = _cd_select_parallel(select, count_c, morsel_rows, morsel_count, thread_count);
+	}
+
+	_cd_prepared_select_trace_add(select, thread_count > 1 ? thread_count : 1, start_ns);
+	_cd_prepared_select_end(select);
+
+table_unlock:
+	_cd_rwlock_read_unlock(select->table->lock);
+	return table_view;
+}
+
+// cursor
+
+CD_Cursor *cd_prepared_select_cursor_open(CD_PreparedSelect *select, const void *condition_data[], uint64_t batch_rows)
+{
+	if (batch_rows == 0)
+	{
+		batch_rows = CD_CURSOR_BATCH_ROWS_DEFAULT;
+	}
+
+	// rows appended after the cursor is opened are not returned
+	_cd_rwlock_read_lock(select->table->lock);
+	uint64_t count_c = _cd_atomic_load_acquire(&select->table->count.count_c);
+	uint64_t modification_count = select->table->modification_count;
+	uint64_t is_begun = _cd_prepared_select_begin(select, condition_data, count_c);
+	_cd_rwlock_read_unlock(select->table->lock);
+	if (!is_begun)
+	{
+		return NULL;
+	}
+
+	_cd_prepared_select_workers_reserve(select, 1);
+
+	CD_Cursor *cursor = malloc(sizeof(*cursor));
+
+	cursor->select = select;
+	cursor->is_select_owned = 0;
+	cursor->count_c = count_c;
+	cursor->modification_count = modification_count;
+	cursor->row = 0;
+	cursor->batch_rows = batch_rows;
+	cursor->pending = 0;
+	cursor->view = _cd_table_view_create_from(select->attribute_count, select->view_attributes, select->data_stride);
+
+	return cursor;
+}
+
+CD_Cursor *cd_table_cursor_open(CD_Table *table, uint64_t attribute_count, const char *attribute_names[], uint64_t condition_count, CD_Condition *conditions, uint64_t batch_rows)
+{
+	CD_PreparedSelect *select = cd_table_select_prepare(table, attribute_count, attribute_names, condition_count, conditions);
+	if (select == NULL)
+	{
+		return NULL;
+	}
+
+	CD_Cursor *cursor = cd_prepared_select_cursor_open(select, NULL, batch_rows);
+	if (cursor == NULL)
+	{
+		cd_prepared_select_destroy(select);
+		return NULL;
+	}
+
+	cursor->is_select_owned = 1;
+
+	return cursor;
+}
+
+const CD_TableView *cd_table_cursor_next_batch(CD_Cursor *cursor)
+{
+	CD_PreparedSelect *select = cursor->select;
+	CD_TableView *view = cursor->view;
+
+	// rows filtered past the end of the last batch start the next one
+	if (cursor->pending != 0)
+	{
+		memmove(view->data, (uint8_t *)view->data + view->count_c * view->stride, cursor->pending * view->stride);
+	}
+	view->count_c = cursor->pending;
+	cursor->pending = 0;
+
+	// a chunk can add more rows than are missing, so the view holds at most batch_rows plus one chunk
+	_CD_ScanWorker *worker = select->workers + 0;
+	worker->view = view;
+	uint64_t start_ns = _cd_time_ns();
+	_cd_rwlock_read_lock(select->table->lock);
+	// the rows left to scan may have moved, been deleted or reused, or lie past a smaller count_c
+	uint64_t is_done = 0;
+	if (select->table->modification_count != cursor->modification_count)
+	{
+		_cd_make_error(CD_ERROR_TABLE_MODIFIED, "Table '%s' was modified while a cursor was open", select->table->name.data);
+	}
+	else
+	{
+		is_done = _cd_select_rows(select, worker, &cursor->row, cursor->count_c, cursor->batch_rows);
+	}
+	_cd_rwlock_read_unlock(select->table->lock);
+	worker->view = NULL;
+	_cd_prepared_select_trace_add(select, 1, start_ns);
+
+	if (!is_done)
+	{
+		return NULL;
+	}
+
+	if (view->count_c > cursor->batch_rows)
+	{
+		cursor->pending = view->count_c - cursor->batch_rows;
+		view->count_c = cursor->batch_rows;
+	}
+
+	return view;
+}
+
+void cd_table_cursor_close(CD_Cursor *cursor)
+{
+	if (cursor != NULL)
+	{
+		_cd_prepared_select_end(cursor->select);
+		if (cursor->is_select_owned)
+		{
+			cd_prepared_select_destroy(cursor->select);
+		}
+		cd_table_view_destroy(cursor->view);
+		free(cursor);
+	}
+}
+
+// aggregate
+
+uint64_t _cd_aggregate_prepare(CD_Table *table, const CD_Aggregate *aggregate, _CD_PreparedAggregate *prepared)
+{
+	prepared->attribute = NULL;
+	prepared->function = aggregate->function;
+	prepared->func_reduce = NULL;
+
+	if (aggregate->function > CD_AGGREGATE_AVG)
+	{
+		_cd_make_error(CD_ERROR_UNKNOWN_OPERATOR, "Aggregate function %llu is not recognized. table: '%s'", aggregate->function, table->name.data);
+		return 0;
+	}
+
+	// rows are never NULL, so COUNT of an attribute counts the rows as well
+	if (aggregate->function == CD_AGGREGATE_COUNT)
+	{
+		return 1;
+	}
+
+	if (aggregate->name == NULL)
+	{
+		_cd_make_error(CD_ERROR_ATTRIBUTE_DOES_NOT_EXIST, "Aggregate function %llu needs an attribute. table: '%s'", aggregate->function, table->name.data);
+		return 0;
+	}
+
+	prepared->attribute = cd_table_attribute_by_name(table, aggregate->name);
+	if (prepared->attribute == NULL)
+	{
+		return 0;
+	}
+
+	if (prepared->attribute->count == 1)
+	{
+		prepared->func_reduce = _cd_reduce_get(prepared->attribute->type, aggregate->function);
+	}
+	if (prepared->func_reduce == NULL)
+	{
+		_cd_make_error(CD_ERROR_UNKNOWN_TYPE, "Aggregate function %llu needs a UINT, SINT or FLOAT attribute but '%s' is not one. table: '%s'", aggregate->function, aggregate->name, table->name.data);
+		return 0;
+	}
+
+	return 1;
+}
+
+// the accumulator an aggregate starts from, as the bits of a value of the attribute type
+static uint64_t _cd_aggregate_identity(const _CD_PreparedAggregate *aggregate)
+{
+	CD_sint_t sint_value;
+	CD_float_t float_value;
+	uint64_t bits = 0;
+
+	switch (aggregate->function)
+	{
+	case CD_AGGREGATE_MIN:
+	{
+		switch (aggregate->attribute->type)
+		{
+		case CD_TYPE_UINT:
+			bits = UINT64_MAX;
+			break;
+		case CD_TYPE_SINT:
+			sint_value = INT64_MAX;
+			memcpy(&bits, &sint_value, sizeof(bits));
+			break;
+		case CD_TYPE_FLOAT:
+			float_value = INFINITY;
+			memcpy(&bits, &float_value, sizeof(bits));
+			break;
+		}
+		break;
+	}
+	case CD_AGGREGATE_MAX:
+	{
+		switch (aggregate->attribute->type)
+		{
+		case CD_TYPE_SINT:
+			sint_value = INT64_MIN;
+			memcpy(&bits, &sint_value, sizeof(bits));
+			break;
+		case CD_TYPE_FLOAT:
+			float_value = -INFINITY;
+			memcpy(&bits, &float_value, sizeof(bits));
+			break;
+		}
+		break;
+	}
+	}
+
+	return bits;
+}
+
+void _cd_aggregate_result(const _CD_PreparedAggregate *aggregate, uint64_t accumulator, uint64_t row_count, CD_AggregateResult *result)
+{
+	result->row_count = row_count;
+	result->uint_value = 0;
+
+	switch (aggregate->function)
+	{
+	case CD_AGGREGATE_COUNT:
+	{
+		result->type = CD_TYPE_UINT;
+		result->uint_value = row_count;
+		break;
+	}
+	case CD_AGGREGATE_AVG:
+	{
+		result->type = CD_TYPE_FLOAT;
+		if (row_count == 0)
+		{
+			result->float_value = 0.0;
+			break;
+		}
+
+		CD_sint_t sint_sum;
+		CD_float_t float_sum;
+		switch (aggregate->attribute->type)
+		{
+		case CD_TYPE_UINT:
+			result->float_value = (CD_float_t)accumulator / (CD_float_t)row_count;
+			break;
+		case CD_TYPE_SINT:
+			memcpy(&sint_sum, &accumulator, sizeof(sint_sum));
+			result->float_value = (CD_float_t)sint_sum / (CD_float_t)row_count;
+			break;
+		case CD_TYPE_FLOAT:
+			memcpy(&float_sum, &accumulator, sizeof(float_sum));
+			result->float_value = float_sum / (CD_float_t)row_count;
+			break;
+		}
+		break;
+	}
+	default:
+	{
+		result->type = aggregate->attribute->type;
+		// MIN and MAX of no rows are 0 rather than the identity
+		if (row_count != 0 || aggregate->function == CD_AGGREGATE_SUM)
+		{
+			result->uint_value = accumulator;
+		}
+		break;
+	}
+	}
+}
+
+// runs a select with aggregates and merges the accumulators of its workers into results
+static uint64_t _cd_select_aggregate(CD_PreparedSelect *select, CD_AggregateResult results[])
+{
+	uint64_t start_ns = _cd_time_ns();
+	_cd_rwlock_read_lock(select->table->lock);
+	uint64_t count_c = _cd_atomic_load_acquire(&select->table->count.count_c);
+
+	if (!_cd_prepared_select_begin(select, NULL, count_c))
+	{
+		_cd_rwlock_read_unlock(select->table->lock);
+		return 0;
+	}
+
+	uint64_t morsel_rows = select->chunk_rows * CD_MORSEL_CHUNKS;
+	uint64_t morsel_count = (count_c + morsel_rows - 1) / morsel_rows;
+	uint64_t thread_count = _cd_select_thread_count(select, morsel_count);
+	if (thread_count == 0)
+	{
+		thread_count = 1;
+	}
+
+	_cd_prepared_select_workers_reserve(select, thread_count);
+	for (uint64_t t = 0; t < thread_count; t++)
+	{
+		_CD_ScanWorker *worker = select->workers + t;
+
+		worker->aggregate_rows = 0;
+		for (uint64_t i = 0; i < select->aggregate_count; i++)
+		{
+			if (select->aggregates[i].attribute != NULL)
+			{
+				worker->accumulators[i] = _cd_aggregate_identity(select->aggregates + i);
+			}
+		}
+	}
+
+	uint64_t is_done;
+	if (thread_count == 1)
+	{
+		uint64_t row = 0;
+		is_done = _cd_select_rows(select, select->workers + 0, &row, count_c, UINT64_MAX);
+	}
+	else
+	{
+		_CD_ScanJob job =
+		{
+			.select = select,
+			.count_c = count_c,
+			.morsel_rows = morsel_rows,
+			.morsel_count = morsel_count,
+			.next_morsel = 0,
+			.is_failed = 0,
+			.morsel_worker = NULL,
+			.morsel_first = NULL,
+			.morsel_selected = NULL
+		};
+		is_done = _cd_scan_parallel(&job, thread_count);
+	}
+
+	_cd_prepared_select_trace_add(select, thread_count, start_ns);
+	_cd_prepared_select_end(select);
+	_cd_rwlock_read_unlock(select->table->lock);
+
+	if (!is_done)
+	{
+		return 0;
+	}
+
+	// the accumulators of the other workers are reduced into the one of worker 0 like one more value
+	const uint8_t is_selected = 1;
+	_CD_ScanWorker *first = select->workers + 0;
+	for (uint64_t t = 1; t < thread_count; t++)
+	{
+		const _CD_ScanWorker *worker = select->workers + t;
+
+		first->aggregate_rows += worker->aggregate_rows;
+		for (uint64_t i = 0; i < select->aggregate_count; i++)
+		{
+			const _CD_PreparedAggregate *aggregate = select->aggregates + i;
+			if (aggregate->attribute != NULL)
+			{
+				aggregate->func_reduce(worker->accumulators + i, 1, &is_selected, first->accumulators + i);
+			}
+		}
+	}
+
+	for (uint64_t i = 0; i < select->aggregate_count; i++)
+	{
+		_cd_aggregate_result(select->aggregates + i, first->accumulators[i], first->aggregate_rows, results + i);
+	}
+
+	return 1;
+}
+
+uint64_t cd_table_aggregate(CD_Table *table, uint64_t condition_count, CD_Condition *conditions, uint64_t aggregate_count, CD_Aggregate aggregates[], CD_AggregateResult results[])
+{
+	uint64_t is_done = 0;
+
+	CD_PreparedSelect *select = cd_table_select_prepare(table, 0, NULL, condition_count, conditions);
+	if (select == NULL)
+	{
+		return 0;
+	}
+
+	select->aggregate_count = aggregate_count;
+	select->aggregates = malloc(sizeof(*select->aggregates) * aggregate_count);
+
+	for (uint64_t i = 0; i < aggregate_count; i++)
+	{
+		_CD_PreparedAggregate *prepared = select->aggregates + i;
+		if (!_cd_aggregate_prepare(table, aggregates + i, prepared))
+		{
+			goto select_destroy;
+		}
+
+		// the values of aggregated attributes are reduced from the column buffer
+		if (prepared->attribute != NULL && select->column_size < prepared->attribute->size)
+		{
+			select->column_size = prepared->attribute->size;
+		}
+	}
+
+	is_done = _cd_select_aggregate(select, results);
+
+select_destroy:
+	cd_prepared_select_destroy(select);
+	return is_done;
+}
@@ -10,6 +10,17 @@ uint64_t cd_table_exists(CD_Database *db, const char *_table_name)
 
 uint64_t cd_table_create(CD_Database *db, const char *_table_name, uint64_t attribute_count, CD_Attribute attributes[])
 {
+	return cd_table_create_ex(db, _table_name, attribute_count, attributes, CD_STORAGE_ROWS);
+}
+
+uint64_t cd_table_create_ex(CD_Database *db, const char *_table_name, uint64_t attribute_count, CD_Attribute attributes[], uint64_t storage)
+{
+	if (storage != CD_STORAGE_ROWS && storage != CD_STORAGE_PAX)
+	{
+		_cd_make_error(CD_ERROR_UNKNOWN_TYPE, "Storage %llu is not recognized. table: '%s'", storage, _table_name);
+		return 0;
+	}
+
 	CC_String table_name = cc_string_create(_table_name, 0);
 
 	if (cc_hash_map_lookup(db->table_schemas, table_name) != NULL)
@@ -18,6 +29,30 @@ uint64_t cd_table_create(CD_Database *db, const char *_table_name, uint64_t attr
 		goto table_name_destroy;
 	}
 
+	uint64_t stride = 0;
+	for (uint64_t attrib_index = 0; attrib_index < attribute_count; attrib_index++)
+	{
+		uint64_t type = attributes[attrib_index].type;
+		uint64_t encoding = attributes[attrib_index].encoding;
+		uint64_t is_text = _cd_text_unit_size(type) != 0;
+		uint64_t is_varchar = type == CD_TYPE_VARCHAR || type == CD_TYPE_WVARCHAR;
+		if (encoding != CD_ENCODING_NONE && !(encoding == CD_ENCODING_DICTIONARY && is_text) && !(encoding == CD_ENCODING_HEAP && is_varchar))
+		{
+			_cd_make_error(CD_ERROR_UNKNOWN_TYPE, "Encoding %llu can not be used for attribute '%s'. table: '%s'", encoding, attributes[attrib_index].name, _table_name);
+			goto table_name_destroy;
+		}
+
+		CD_AttributeEx attribute = { .size = cd_attribute_size(type, attributes[attrib_index].count), .encoding = encoding };
+		stride += _cd_attribute_stored_size(&attribute);
+	}
+
+	// a page holds at least one row
+	uint64_t page_rows = 0;
+	if (storage == CD_STORAGE_PAX)
+	{
+		page_rows = stride != 0 && stride < CD_PAX_PAGE_SIZE ? CD_PAX_PAGE_SIZE / stride : 1;
+	}
+
 	CC_String file_path;
 	{
 		CC_StringBuffer *buffer = cc_string_buffer_create(256);
@@ -52,7 +87,9 @@ uint64_t cd_table_create(CD_Database *db, const char *_table_name, uint64_t attr
 	_CD_File_TableSchema table_schema_data =
 		{
 			.attrib_count_c = attribute_count,
-			.attrib_count_m = attribute_count};
+			.attrib_count_m = attribute_count,
+			.storage = storage,
+			.page_rows = page_rows};
 	memset(table_schema_data.name, 0, CD_NAME_LENGTH);
 	strcpy_s(table_schema_data.name, CD_NAME_LENGTH, _table_name);
 
@@ -69,6 +106,8 @@ uint64_t cd_table_create(CD_Database *db, const char *_table_name, uint64_t attr
 		file_attributes[attrib_index].type = attributes[attrib_index].type;
 		file_attributes[attrib_index].count = attributes[attrib_index].count;
 		file_attributes[attrib_index].constraints = attributes[attrib_index].constraints;
+		file_attributes[attrib_index].indices = 0;
+		file_attributes[attrib_index].encoding = attributes[attrib_index].encoding;
 		memset(file_attributes[attrib_index].name, 0, CD_NAME_LENGTH);
 		strcpy_s(file_attributes[attrib_index].name, CD_NAME_LENGTH, attributes[attrib_index].name);
 	}
@@ -93,7 +132,12 @@ uint64_t cd_table_create(CD_Database *db, const char *_table_name, uint64_t attr
 		{
 			.attribute_indices = cc_hash_map_create(sizeof(uint64_t), attribute_count),
 			.attributes = malloc(sizeof(CD_AttributeEx) * attribute_count),
-			.stride = 0};
+			.stride = 0,
+			.storage = storage,
+			.page_rows = page_rows,
+			.file_offset = file_size,
+			.attribute_count = attribute_count,
+			.indices = calloc(attribute_count, sizeof(uint64_t))};
 
 	for (uint64_t attrib_index = 0; attrib_index < attribute_count; attrib_index++)
 	{
@@ -114,19 +158,24 @@ uint64_t cd_table_create(CD_Database *db, const char *_table_name, uint64_t attr
 		attribute->constraints = in_attribute->constraints;
 		attribute->offset = schema.stride;
 		attribute->size = cd_attribute_size(in_attribute->type, in_attribute->count);
+		attribute->encoding = in_attribute->encoding;
 
-		schema.stride += attribute->size;
+		schema.stride += _cd_attribute_stored_size(attribute);
 	}
 
 	cc_hash_map_insert(db->table_schemas, table_name, &schema);
 
-	// create table file
+	// create table file, PAX tables always hold whole pages
 	_CD_File_RowCount row_count =
 		{
 			.count_c = 0,
 			.count_m = CD_ROW_COUNT_START};
+	if (page_rows != 0)
+	{
+		row_count.count_m = (CD_ROW_COUNT_START + page_rows - 1) / page_rows * page_rows;
+	}
 
-	if (!cf_file_create(file_path, sizeof(_CD_File_RowCount) + schema.stride * CD_ROW_COUNT_START))
+	if (!cf_file_create(file_path, sizeof(_CD_File_RowCount) + schema.stride * row_count.count_m))
 	{
 		_cd_make_error(CD_ERROR_FILE, "Failed to create file '%s'", file_path.data);
 		goto schema_destroy;
@@ -165,6 +214,7 @@ uint64_t cd_table_create(CD_Database *db, const char *_table_name, uint64_t attr
 table_file_close:
 	cf_file_close(table_file);
 schema_destroy:
+	free(schema.indices);
 	free(schema.attributes);
 	cc_hash_map_destroy(schema.attribute_indices);
 file_attributes_free:
@@ -178,16 +228,18 @@ table_name_destroy:
 	return 0;
 }
 
-CD_Table *cd_table_open(CD_Database *db, const char *_table_name)
+// opens the files of a table that is not open in the database yet
+static CD_Table *_cd_table_load(CD_Database *db, const char *_table_name)
 {
 	CC_String table_name = cc_string_create(_table_name, 0);
 
-	const CD_TableSchema *schema = cc_hash_map_lookup(db->table_schemas, table_name);
+	CD_TableSchema *schema = cc_hash_map_lookup(db->table_schemas, table_name);
 	if (schema == NULL)
 	{
 		_cd_make_error(CD_ERROR_TABLE_DOES_NOT_EXIST, "Table '%s' does not exist.", _table_name);
 		goto table_name_destroy;
 	}
+	_cd_table_schema_materialize(db, schema);
 
 	CC_String file_path;
 	{
@@ -232,6 +284,7 @@ CD_Table *cd_table_open(CD_Database *db, const char *_table_name)
 
 	CD_Table *table = malloc(sizeof(*table));
 
+	table->db = db;
 	table->name = table_name;
 	table->file_path = file_path;
 
@@ -242,9 +295,153 @@ CD_Table *cd_table_open(CD_Database *db, const char *_table_name)
 	table->count_view = count_view;
 	table->data_view = data_view;
 
+	table->growth.factor = CD_GROWTH_FACTOR_DEFAULT;
+	table->growth.max_step = CD_GROWTH_MAX_STEP_DEFAULT;
+	table->growth.preallocate = 1;
+
+	table->lock = _cd_rwlock_create();
+	table->writer_lock = _cd_mutex_create();
+	table->modification_count = 0;
+
+	table->stats = (CD_Stats){ 0 };
+
+	table->reference_count = 1;
+	table->idle_previous = NULL;
+	table->idle_next = NULL;
+
+	uint64_t attribute_count = cc_hash_map_count(schema->attribute_indices);
+	table->unique_indices = malloc(sizeof(*table->unique_indices) * attribute_count);
+	table->trigram_indices = malloc(sizeof(*table->trigram_indices) * attribute_count);
+	table->btree_indices = malloc(sizeof(*table->btree_indices) * attribute_count);
+	table->bloom_filters = malloc(sizeof(*table->bloom_filters) * attribute_count);
+	table->dictionaries = malloc(sizeof(*table->dictionaries) * attribute_count);
+	table->heap = NULL;
+	table->tombstones = NULL;
+	table->zone_map = NULL;
+	for (uint64_t attrib_index = 0; attrib_index < attribute_count; attrib_index++)
+	{
+		table->unique_indices[attrib_index] = NULL;
+		table->trigram_indices[attrib_index] = NULL;
+		table->btree_indices[attrib_index] = NULL;
+		table->bloom_filters[attrib_index] = NULL;
+		table->dictionaries[attrib_index] = NULL;
+	}
+
+	// the dictionaries and the heap come first, indices built from the rows decode their values
+	for (uint64_t attrib_index = 0; attrib_index < attribute_count; attrib_index++)
+	{
+		if (schema->attributes[attrib_index].encoding == CD_ENCODING_DICTIONARY)
+		{
+			table->dictionaries[attrib_index] = _cd_dictionary_open(table, attrib_index);
+			if (table->dictionaries[attrib_index] == NULL)
+			{
+				goto unique_indices_close;
+			}
+		}
+		if (schema->attributes[attrib_index].encoding == CD_ENCODING_HEAP && table->heap == NULL)
+		{
+			table->heap = _cd_heap_open(table);
+			if (table->heap == NULL)
+			{
+				goto unique_indices_close;
+			}
+		}
+	}
+
+	// tombstones only exist once a row was deleted
+	if (_cd_tombstones_exists(table))
+	{
+		table->tombstones = _cd_tombstones_open(table);
+		if (table->tombstones == NULL)
+		{
+			goto unique_indices_close;
+		}
+	}
+
+	// open (or build, if missing) the hash index of every UNIQUE attribute
+	for (uint64_t attrib_index = 0; attrib_index < attribute_count; attrib_index++)
+	{
+		if (schema->attributes[attrib_index].constraints & CD_CONSTRAINT_UNIQUE)
+		{
+			table->unique_indices[attrib_index] = _cd_hash_index_open(table, attrib_index);
+			if (table->unique_indices[attrib_index] == NULL)
+			{
+				goto unique_indices_close;
+			}
+		}
+	}
+
+	// trigram indices are optional, only the ones created before are opened
+	for (uint64_t attrib_index = 0; attrib_index < attribute_count; attrib_index++)
+	{
+		if (_cd_text_unit_size(schema->attributes[attrib_index].type) != 0 && _cd_trigram_index_exists(table, attrib_index))
+		{
+			table->trigram_indices[attrib_index] = _cd_trigram_index_open(table, attrib_index);
+			if (table->trigram_indices[attrib_index] == NULL)
+			{
+				goto unique_indices_close;
+			}
+		}
+	}
+
+	// B+tree indices registered in the schema
+	for (uint64_t attrib_index = 0; attrib_index < attribute_count; attrib_index++)
+	{
+		if (schema->indices[attrib_index] & CD_INDEX_BTREE)
+		{
+			table->btree_indices[attrib_index] = _cd_btree_index_open(table, attrib_index);
+			if (table->btree_indices[attrib_index] == NULL)
+			{
+				goto unique_indices_close;
+			}
+		}
+	}
+
+	// Bloom filters are optional, only the ones created before are opened
+	for (uint64_t attrib_index = 0; attrib_index < attribute_count; attrib_index++)
+	{
+		if (_cd_bloom_filter_exists(table, attrib_index))
+		{
+			table->bloom_filters[attrib_index] = _cd_bloom_filter_open(table, attrib_index, CD_BLOOM_FALSE_POSITIVE_RATE);
+			if (table->bloom_filters[attrib_index] == NULL)
+			{
+				goto unique_indices_close;
+			}
+		}
+	}
+
+	if (_cd_zone_map_has_attributes(schema))
+	{
+		table->zone_map = _cd_zone_map_open(table);
+		if (table->zone_map == NULL)
+		{
+			goto unique_indices_close;
+		}
+	}
+
 	return table;
 
-	// data_view_close:
+unique_indices_close:
+	for (uint64_t attrib_index = 0; attrib_index < attribute_count; attrib_index++)
+	{
+		_cd_hash_index_close(table->unique_indices[attrib_index]);
+		_cd_trigram_index_close(table->trigram_indices[attrib_index]);
+		_cd_btree_index_close(table->btree_indices[attrib_index]);
+		_cd_bloom_filter_close(table->bloom_filters[attrib_index]);
+		_cd_dictionary_close(table->dictionaries[attrib_index]);
+	}
+	_cd_zone_map_close(table->zone_map);
+	_cd_tombstones_close(table->tombstones);
+	_cd_heap_close(table->heap);
+	free(table->dictionaries);
+	free(table->bloom_filters);
+	free(table->btree_indices);
+	free(table->trigram_indices);
+	free(table->unique_indices);
+	_cd_mutex_destroy(table->writer_lock);
+	_cd_rwlock_destroy(table->lock);
+	free(table);
+// data_view_close:
 	cf_file_view_close(data_view);
 count_view_close:
 	cf_file_view_close(count_view);
@@ -258,14 +455,134 @@ table_name_destroy:
 	return NULL;
 }
 
+// takes a handle nobody holds out of the idle handles of its database
+static void _cd_table_idle_remove(CD_Table *table)
+{
+	CD_Database *db = table->db;
+	if (table->idle_previous != NULL)
+	{
+		table->idle_previous->idle_next = table->idle_next;
+	}
+	else
+	{
+		db->idle_first = table->idle_next;
+	}
+	if (table->idle_next != NULL)
+	{
+		table->idle_next->idle_previous = table->idle_previous;
+	}
+	else
+	{
+		db->idle_last = table->idle_previous;
+	}
+	table->idle_previous = NULL;
+	table->idle_next = NULL;
+}
+
+void _cd_table_cache_trim(CD_Database *db)
+{
+	while (db->idle_first != NULL && cc_hash_map_count(db->open_tables) > db->table_cache_size)
+	{
+		CD_Table *table = db->idle_first;
+		_cd_table_idle_remove(table);
+		cc_hash_map_remove(db->open_tables, table->name);
+		if (db->wal != NULL)
+		{
+			_cd_wal_table_release(db->wal, table);
+		}
+		_cd_table_destroy(table);
+	}
+}
+
+CD_Table *cd_table_open(CD_Database *db, const char *_table_name)
+{
+	CC_String table_name = cc_string_create(_table_name, 0);
+
+	_cd_mutex_lock(db->table_lock);
+
+	CD_Table *table;
+	CD_Table **open_table = cc_hash_map_lookup(db->open_tables, table_name);
+	if (open_table != NULL)
+	{
+		table = *open_table;
+		if (table->reference_count == 0)
+		{
+			_cd_table_idle_remove(table);
+		}
+		table->reference_count++;
+	}
+	else
+	{
+		table = _cd_table_load(db, _table_name);
+		if (table != NULL)
+		{
+			cc_hash_map_insert(db->open_tables, table_name, &table);
+			_cd_table_cache_trim(db);
+		}
+	}
+
+	_cd_mutex_unlock(db->table_lock);
+
+	cc_string_destroy(table_name);
+	return table;
+}
+
 void cd_table_close(CD_Table *table)
 {
+	CD_Database *db = table->db;
+
+	_cd_mutex_lock(db->table_lock);
+
+	table->reference_count--;
+	if (table->reference_count == 0)
+	{
+		table->idle_previous = db->idle_last;
+		table->idle_next = NULL;
+		if (db->idle_last != NULL)
+		{
+			db->idle_last->idle_next = table;
+		}
+		else
+		{
+			db->idle_first = table;
+		}
+		db->idle_last = table;
+
+		_cd_table_cache_trim(db);
+	}
+
+	_cd_mutex_unlock(db->table_lock);
+}
+
+void _cd_table_destroy(CD_Table *table)
+{
+	for (uint64_t attrib_index = 0; attrib_index < cc_hash_map_count(table->schema->attribute_indices); attrib_index++)
+	{
+		_cd_hash_index_close(table->unique_indices[attrib_index]);
+		_cd_trigram_index_close(table->trigram_indices[attrib_index]);
+		_cd_btree_index_close(table->btree_indices[attrib_index]);
+		_cd_bloom_filter_close(table->bloom_filters[attrib_index]);
+		_cd_dictionary_close(table->dictionaries[attrib_index]);
+	}
+	_cd_zone_map_close(table->zone_map);
+	_cd_tombstones_close(table->tombstones);
+	_cd_heap_close(table->heap);
+	free(table->dictionaries);
+	free(table->bloom_filters);
+	free(table->btree_indices);
+	free(table->trigram_indices);
+	free(table->unique_indices);
+	_cd_mutex_destroy(table->writer_lock);
+	_cd_rwlock_destroy(table->lock);
+
 	cf_file_view_close(table->data_view);
 	cf_file_view_close(table->count_view);
 	cf_file_close(table->file);
 
 	cc_string_destroy(table->file_path);
 	cc_string_destroy(table->name);
+
+	free(table);
 }
 
 const CD_AttributeEx *cd_table_attribute_by_name(CD_Table *table, const char *attrib_name)
@@ -304,354 +621,454 @@ uint64_t cd_table_stride(CD_Table *table)
 
 uint64_t cd_table_count(CD_Table *table)
 {
-	return table->count.count_c;
+	_cd_rwlock_read_lock(table->lock);
+	uint64_t count = table->count.count_c - (table->tombstones != NULL ? table->tombstones->header.deleted_count : 0);
+	_cd_rwlock_read_unlock(table->lock);
+	return count;
 }
 
-uint64_t cd_table_insert(CD_Table *table, uint64_t attribute_count, const char *attribute_names[], const void *data)
+uint64_t cd_table_deleted_count(CD_Table *table)
 {
-	uint64_t return_value = 0;
+	_cd_rwlock_read_lock(table->lock);
+	uint64_t deleted_count = table->tombstones != NULL ? table->tombstones->header.deleted_count : 0;
+	_cd_rwlock_read_unlock(table->lock);
+	return deleted_count;
+}
 
-	CC_String table_name = cc_string_copy(table->name);
+uint64_t _cd_table_row_is_deleted(const CD_Table *table, uint64_t row)
+{
+	return table->tombstones != NULL && _cd_tombstones_is_deleted(table->tombstones, row);
+}
 
-	struct
-	{
-		uint64_t data_offset;
-		uint64_t file_offset;
-		uint64_t size;
-	} *attribute_data = malloc(sizeof(attribute_data[0]) * attribute_count);
+uint64_t cd_table_storage(CD_Table *table)
+{
+	return table->schema->storage;
+}
 
-	uint64_t data_stride = 0;
+CD_Stats _cd_stats_load(const CD_Stats *stats)
+{
+	CD_Stats snapshot;
+	const volatile uint64_t *counters = (const volatile uint64_t *)stats;
+	uint64_t *snapshot_counters = (uint64_t *)&snapshot;
+	for (uint64_t i = 0; i < sizeof(*stats) / sizeof(uint64_t); i++)
+	{
+		snapshot_counters[i] = _cd_atomic_load_acquire(counters + i);
+	}
+	return snapshot;
+}
 
-	for (uint64_t i = 0; i < attribute_count; i++)
+void _cd_stats_clear(CD_Stats *stats)
+{
+	volatile uint64_t *counters = (volatile uint64_t *)stats;
+	for (uint64_t i = 0; i < sizeof(*stats) / sizeof(uint64_t); i++)
 	{
-		CC_String attrib_name = cc_string_create(attribute_names[i], 0);
-		const uint64_t *index_ptr = (const uint64_t *)cc_hash_map_lookup(table->schema->attribute_indices, attrib_name);
-		cc_string_destroy(attrib_name);
+		_cd_atomic_store_release(counters + i, 0);
+	}
+}
 
-		if (index_ptr == NULL)
+void _cd_stats_add(CD_Stats *stats, const CD_Stats *add)
+{
+	volatile uint64_t *counters = (volatile uint64_t *)stats;
+	const uint64_t *add_counters = (const uint64_t *)add;
+	for (uint64_t i = 0; i < sizeof(*stats) / sizeof(uint64_t); i++)
+	{
+		// most adds touch one or two counters
+		if (add_counters[i] != 0)
 		{
-			_cd_make_error(CD_ERROR_ATTRIBUTE_DOES_NOT_EXIST, "Attribute '%s' does not exist in table '%s'", attribute_names[i], table->name.data);
-			goto attribute_data_free;
+			_cd_atomic_fetch_add(counters + i, add_counters[i]);
 		}
+	}
+}
 
-		uint64_t index = *index_ptr;
+void _cd_table_stats_add(CD_Table *table, const CD_Stats *add)
+{
+	_cd_stats_add(&table->stats, add);
+	_cd_stats_add(&table->db->stats, add);
+}
 
-		CD_AttributeEx *attribute = table->schema->attributes + index;
+CD_Stats cd_table_stats_get(CD_Table *table)
+{
+	return _cd_stats_load(&table->stats);
+}
 
-		attribute_data[i].data_offset = data_stride;
-		attribute_data[i].file_offset = attribute->offset;
-		attribute_data[i].size = attribute->size;
+void cd_table_stats_reset(CD_Table *table)
+{
+	_cd_stats_clear(&table->stats);
+}
 
-		data_stride += attribute_data[i].size;
+uint64_t _cd_table_value_offset(const CD_TableSchema *schema, uint64_t row, const CD_AttributeEx *attribute)
+{
+	if (schema->page_rows == 0)
+	{
+		return row * schema->stride + attribute->offset;
 	}
 
-	// check constrains
-	for (uint64_t table_attrib_index = 0; table_attrib_index < cc_hash_map_count(table->schema->attribute_indices); table_attrib_index++)
-	{
-		CD_AttributeEx *attrib = table->schema->attributes + table_attrib_index;
+	// the values of an attribute start at page_rows * offset inside the page
+	uint64_t page = row / schema->page_rows;
+	uint64_t page_row = row % schema->page_rows;
+	return page * schema->page_rows * schema->stride + attribute->offset * schema->page_rows + page_row * _cd_attribute_stored_size(attribute);
+}
 
-		// check not null
-		uint64_t not_null = attrib->constraints & CD_CONSTRAINT_NOT_NULL;
-		if (not_null)
+uint64_t _cd_table_column_read(CD_Table *table, const CD_AttributeEx *attribute, uint64_t row, uint64_t row_count, void *column)
+{
+	uint8_t *value = column;
+	uint64_t size = _cd_attribute_stored_size(attribute);
+
+	if (table->schema->page_rows == 0)
+	{
+		for (uint64_t r = row; r < row + row_count; r++, value += size)
 		{
-			uint64_t attrib_index = attribute_count;
-			for (uint64_t i = 0; i < attribute_count; i++)
+			if (!cf_file_view_read(table->data_view, _cd_table_value_offset(table->schema, r, attribute), size, value))
 			{
-				if (strcmp(attribute_names[i], table->schema->attributes[table_attrib_index].name) == 0)
-				{
-					attrib_index = i;
-					break;
-				}
-			}
-			if (attrib_index == attribute_count)
-			{
-				_cd_make_error(CD_ERROR_ATTRIBUTE_IS_NOT_NULL, "Attribute '%s' is NOT NULL and so needs to have a value when inserting a record. table: '%s'", table->schema->attributes[table_attrib_index].name, table->name.data);
-				goto attribute_data_free;
+				_cd_make_error(CD_ERROR_FILE, "Failed to read attribute '%s' at row %llu from table '%s'", attribute->name, r, table->name.data);
+				return 0;
 			}
 		}
+		return 1;
 	}
 
-	// check unique
-	for (uint64_t attrib_index = 0; attrib_index < attribute_count; attrib_index++)
+	// one read per page
+	uint64_t page_rows = table->schema->page_rows;
+	for (uint64_t r = row; r < row + row_count;)
 	{
-		CC_String attrib_name = cc_string_create(attribute_names[attrib_index], 0);
-		const uint64_t *table_attrib_index = cc_hash_map_lookup(table->schema->attribute_indices, attrib_name);
-		cc_string_destroy(attrib_name);
-
-		if (table_attrib_index == NULL)
+		uint64_t rows = page_rows - r % page_rows;
+		if (rows > row + row_count - r)
 		{
-			_cd_make_error(CD_ERROR_ATTRIBUTE_DOES_NOT_EXIST, "Attribute '%s' does not exist in table '%s'", attribute_names[attrib_index], table->name.data);
-			goto attribute_data_free;
+			rows = row + row_count - r;
 		}
 
-		CD_AttributeEx *attrib = table->schema->attributes + (*table_attrib_index);
-		uint64_t unique = attrib->constraints & CD_CONSTRAINT_UNIQUE;
-
-		if (unique)
+		if (!cf_file_view_read(table->data_view, _cd_table_value_offset(table->schema, r, attribute), rows * size, value))
 		{
-			uint64_t _error = 0;
+			_cd_make_error(CD_ERROR_FILE, "Failed to read attribute '%s' of %llu rows at row %llu from table '%s'", attribute->name, rows, r, table->name.data);
+			return 0;
+		}
 
-			void *buffer = malloc(attribute_data[attrib_index].size);
+		r += rows;
+		value += rows * size;
+	}
+	return 1;
+}
 
-			for (uint64_t row = 0; row < table->count.count_c; row++)
-			{
-				if (!cf_file_view_read(table->data_view, attribute_data[attrib_index].file_offset + row * table->schema->stride, attribute_data[attrib_index].size, buffer))
-				{
-					_cd_make_error(CD_ERROR_FILE, "Failed to read primary key at row %llu from table '%s'", row, table->name.data);
-					_error = 1;
-					goto buffer_free;
-				}
-
-				if (memcmp((uint8_t *)data + attribute_data[attrib_index].data_offset, buffer, attribute_data[attrib_index].size) == 0)
-				{
-					_cd_make_error(CD_ERROR_ATTRIBUTE_IS_UNIQUE, "Attribute '%s' is UNIQUE and is already in the table '%s' at row %llu", attribute_names[attrib_index], table->name.data, row);
-					_error = 1;
-					goto buffer_free;
-				}
-			}
+uint64_t _cd_table_column_write(CD_Table *table, const CD_AttributeEx *attribute, uint64_t row, uint64_t row_count, const void *column)
+{
+	const uint8_t *value = column;
+	uint64_t size = _cd_attribute_stored_size(attribute);
 
-		buffer_free:
-			free(buffer);
-			if (_error)
+	if (table->schema->page_rows == 0)
+	{
+		for (uint64_t r = row; r < row + row_count; r++, value += size)
+		{
+			if (!cf_file_view_write(table->data_view, _cd_table_value_offset(table->schema, r, attribute), size, value))
 			{
-				goto attribute_data_free;
+				_cd_make_error(CD_ERROR_FILE, "Failed to write attribute '%s' at row %llu to table '%s'", attribute->name, r, table->name.data);
+				return 0;
 			}
 		}
+		return 1;
 	}
 
-	if (table->count.count_c == table->count.count_m)
+	uint64_t page_rows = table->schema->page_rows;
+	for (uint64_t r = row; r < row + row_count;)
 	{
-		// increase size
-		table->count.count_m += 32;
+		uint64_t rows = page_rows - r % page_rows;
+		if (rows > row + row_count - r)
+		{
+			rows = row + row_count - r;
+		}
 
-		if (!cf_file_resize(table->file, cf_file_size_get(table->file) + 32 * table->schema->stride))
+		if (!cf_file_view_write(table->data_view, _cd_table_value_offset(table->schema, r, attribute), rows * size, value))
 		{
-			_cd_make_error(CD_ERROR_FILE, "Failed to resize data file '%s'.", table->file_path);
-			goto attribute_data_free;
+			_cd_make_error(CD_ERROR_FILE, "Failed to write attribute '%s' of %llu rows at row %llu to table '%s'", attribute->name, rows, r, table->name.data);
+			return 0;
 		}
 
-		cf_file_view_close(table->data_view);
+		r += rows;
+		value += rows * size;
+	}
+	return 1;
+}
 
-		table->data_view = cf_file_view_open(table->file, sizeof(table->count), table->count.count_m * table->schema->stride);
-		if (table->data_view == NULL)
+uint64_t _cd_table_values_read(CD_Table *table, const CD_AttributeEx *attribute, uint64_t row, uint64_t row_count, void *values)
+{
+	if (attribute->encoding == CD_ENCODING_NONE)
+	{
+		return _cd_table_column_read(table, attribute, row, row_count, values);
+	}
+
+	// the stored values are read a batch at a time and decoded into place
+	_CD_HeapValue stored_values[256];
+	uint64_t stored_size = _cd_attribute_stored_size(attribute);
+	uint64_t batch_rows = sizeof(stored_values) / stored_size;
+	uint8_t *value = values;
+	for (uint64_t r = row; r < row + row_count;)
+	{
+		uint64_t rows = row + row_count - r < batch_rows ? row + row_count - r : batch_rows;
+		if (!_cd_table_column_read(table, attribute, r, rows, stored_values))
 		{
-			_cd_make_error(CD_ERROR_FILE, "Failed to reopen data view of file '%s'.", table->file_path);
-			goto attribute_data_free;
+			return 0;
 		}
+		for (uint64_t i = 0; i < rows; i++, value += attribute->size)
+		{
+			if (!_cd_table_value_decode(table, attribute, (const uint8_t *)stored_values + i * stored_size, value))
+			{
+				return 0;
+			}
+		}
+		r += rows;
 	}
+	return 1;
+}
 
-	uint8_t *file_data = malloc(table->schema->stride);
-	memset(file_data, 0, table->schema->stride);
-
-	for (uint64_t i = 0; i < attribute_count; i++)
+uint64_t _cd_table_value_decode(const CD_Table *table, const CD_AttributeEx *attribute, const void *stored_value, void *value)
+{
+	switch (attribute->encoding)
 	{
-		memcpy(file_data + attribute_data[i].file_offset, (uint8_t *)data + attribute_data[i].data_offset, attribute_data[i].size);
+	case CD_ENCODING_DICTIONARY:
+	{
+		uint64_t code;
+		memcpy(&code, stored_value, sizeof(code));
+		memcpy(value, _cd_dictionary_decode(table->dictionaries[attribute - table->schema->attributes], code), attribute->size);
+		return 1;
+	}
+	case CD_ENCODING_HEAP:
+		return _cd_heap_decode(table->heap, attribute->size, stored_value, value);
+	default:
+		memcpy(value, stored_value, attribute->size);
+		return 1;
 	}
+}
+
+uint64_t _cd_table_schema_indices_set(CD_Table *table, uint64_t attribute_index, uint64_t indices)
+{
+	CD_Database *db = table->db;
+	CD_TableSchema *schema = (CD_TableSchema *)cc_hash_map_lookup(db->table_schemas, table->name);
 
-	if (!cf_file_view_write(table->data_view, table->count.count_c * table->schema->stride, table->schema->stride, file_data))
+	uint64_t offset = schema->file_offset + sizeof(_CD_File_TableSchema) + attribute_index * sizeof(_CD_File_Attribute) + offsetof(_CD_File_Attribute, indices);
+
+	CF_FileView *view = cf_file_view_open(db->schema_file, offset, sizeof(indices));
+	if (view == NULL)
 	{
-		_cd_make_error(CD_ERROR_FILE, "Failed to write record at index %llu for table %s", table->count.count_c, table->name);
-		goto file_data_free;
+		_cd_make_error(CD_ERROR_FILE, "Failed to open schema view of table '%s'", table->name.data);
+		return 0;
 	}
 
-	table->count.count_c++;
-	if (!cf_file_view_write(table->count_view, 0, sizeof(table->count), &table->count))
+	uint64_t is_written = cf_file_view_write(view, 0, sizeof(indices), &indices);
+	cf_file_view_close(view);
+	if (!is_written)
 	{
-		_cd_make_error(CD_ERROR_FILE, "Failed to write count_c at index %llu for table %s", table->count.count_c - 1, table->name);
-		goto file_data_free;
+		_cd_make_error(CD_ERROR_FILE, "Failed to write indices of attribute '%s' of table '%s' to the schema", schema->attributes[attribute_index].name, table->name.data);
+		return 0;
 	}
 
-	return_value = 1;
+	schema->indices[attribute_index] = indices;
 
-file_data_free:
-	free(file_data);
-attribute_data_free:
-	free(attribute_data);
-	// table_name_destroy:
-	cc_string_destroy(table_name);
+	return 1;
+}
 
-	return return_value;
+// rows the table should hold after growing to fit at least required rows
+uint64_t _cd_table_capacity_next(CD_Table *table, uint64_t required)
+{
+	uint64_t count_m = (uint64_t)((double)table->count.count_m * table->growth.factor);
+	if (table->growth.max_step != 0 && count_m > table->count.count_m + table->growth.max_step)
+	{
+		count_m = table->count.count_m + table->growth.max_step;
+	}
+	if (count_m <= table->count.count_m)
+	{
+		count_m = table->count.count_m + 1;
+	}
+	if (count_m < required)
+	{
+		count_m = required;
+	}
+	return count_m;
 }
 
-CD_TableView *cd_table_select(CD_Table *table, uint64_t attribute_count, const char *attribute_names[], uint64_t condition_count, CD_Condition *conditions)
+// resizes the file to hold exactly count_m rows and remaps the data view
+uint64_t _cd_table_capacity_set(CD_Table *table, uint64_t count_m)
 {
-	struct
+	uint64_t stride = table->schema->stride;
+	uint64_t old_count_m = table->count.count_m;
+
+	// the data view can not be empty
+	if (count_m == 0)
+	{
+		count_m = 1;
+	}
+	// pages of PAX tables are never split
+	if (table->schema->page_rows != 0)
 	{
-		uint64_t data_offset;
-		uint64_t file_offset;
-		uint64_t size;
-	} *attribute_data = malloc(sizeof(attribute_data[0]) * attribute_count);
+		count_m = (count_m + table->schema->page_rows - 1) / table->schema->page_rows * table->schema->page_rows;
+	}
+	if (count_m == old_count_m)
+	{
+		return 1;
+	}
 
-	CD_TableView *table_view = cd_table_view_create(table, attribute_count, attribute_names);
+	cf_file_view_close(table->data_view);
+	table->data_view = NULL;
 
-	uint64_t offset = 0;
+	uint64_t is_resized = cf_file_resize(table->file, sizeof(table->count) + count_m * stride);
+	if (!is_resized)
+	{
+		_cd_make_error(CD_ERROR_FILE, "Failed to resize data file '%s'.", table->file_path.data);
+		count_m = old_count_m;
+	}
 
-	for (uint64_t i = 0; i < attribute_count; i++)
+	// the old view is gone either way, map whatever size the file has now
+	table->data_view = cf_file_view_open(table->file, sizeof(table->count), count_m * stride);
+	if (table->data_view == NULL)
+	{
+		_cd_make_error(CD_ERROR_FILE, "Failed to reopen data view of file '%s'.", table->file_path.data);
+		return 0;
+	}
+	if (!is_resized)
 	{
-		CC_String attrib_name = cc_string_create(attribute_names[i], 0);
-		const uint64_t *index_ptr = (const uint64_t *)cc_hash_map_lookup(table->schema->attribute_indices, attrib_name);
-		cc_string_destroy(attrib_name);
+		return 0;
+	}
 
-		if (index_ptr == NULL)
-		{
-			_cd_make_error(CD_ERROR_ATTRIBUTE_DOES_NOT_EXIST, "Attribute '%s' does not exist in table '%s'", attribute_names[i], table->name.data);
-			goto table_view_attributes_free;
-		}
+	table->count.count_m = count_m;
 
-		uint64_t index = *index_ptr;
+	CD_Stats add = { .resizes = 1 };
+	_cd_table_stats_add(table, &add);
 
-		CD_AttributeEx *attribute = table->schema->attributes + index;
+	// count_c in the file is left to the inserts, it may lag behind the published one
+	if (!cf_file_view_write(table->count_view, offsetof(_CD_File_RowCount, count_m), sizeof(table->count.count_m), &table->count.count_m))
+	{
+		_cd_make_error(CD_ERROR_FILE, "Failed to write count_m %llu for table %s", table->count.count_m, table->name.data);
+		return 0;
+	}
 
-		attribute_data[i].data_offset = offset;
-		attribute_data[i].file_offset = attribute->offset;
-		attribute_data[i].size = cd_attribute_size(attribute->type, attribute->count);
+	return 1;
+}
 
-		offset += attribute_data[i].size;
+uint64_t _cd_table_preallocate(CD_Table *table, uint64_t first_row)
+{
+	uint64_t stride = table->schema->stride;
+	uint64_t count_m = table->count.count_m;
+	if (!table->growth.preallocate || first_row >= count_m)
+	{
+		return 1;
 	}
 
-	uint8_t *should_add_row = malloc(sizeof(*should_add_row) * table->count.count_c);
-	for (uint64_t row = 0; row < table->count.count_c; row++)
+	uint64_t chunk_size = CD_INSERT_CHUNK_SIZE;
+	uint8_t *zero = calloc(1, chunk_size);
+
+	uint64_t end = count_m * stride;
+	for (uint64_t offset = first_row * stride; offset < end; offset += chunk_size)
 	{
-		should_add_row[row] = 1;
+		uint64_t size = end - offset < chunk_size ? end - offset : chunk_size;
+		if (!cf_file_view_write(table->data_view, offset, size, zero))
+		{
+			_cd_make_error(CD_ERROR_FILE, "Failed to preallocate data file '%s'.", table->file_path.data);
+			free(zero);
+			return 0;
+		}
 	}
 
-	if (conditions != NULL)
+	free(zero);
+	return 1;
+}
+
+void cd_table_growth_policy_set(CD_Table *table, CD_GrowthPolicy policy)
+{
+	if (policy.factor < 1.0)
 	{
-		// find comparison attribute
-		for (uint64_t condition_index = 0; condition_index < condition_count; condition_index++)
-		{
-			CD_Condition *condition = conditions + condition_index;
+		policy.factor = 1.0;
+	}
+	_cd_mutex_lock(table->writer_lock);
+	table->growth = policy;
+	_cd_mutex_unlock(table->writer_lock);
+}
 
-			CC_String condition_name = cc_string_create(condition->name, 0);
-			const uint64_t *condition_attribute_index_ptr = (const uint64_t *)cc_hash_map_lookup(table->schema->attribute_indices, condition_name);
-			cc_string_destroy(condition_name);
+CD_GrowthPolicy cd_table_growth_policy_get(CD_Table *table)
+{
+	_cd_mutex_lock(table->writer_lock);
+	CD_GrowthPolicy policy = table->growth;
+	_cd_mutex_unlock(table->writer_lock);
+	return policy;
+}
 
-			if (condition_attribute_index_ptr == NULL)
-			{
-				_cd_make_error(CD_ERROR_ATTRIBUTE_DOES_NOT_EXIST, "Attribute '%s' does not exist in table '%s'", condition->name, table->name.data);
-				goto table_view_data_free;
-			}
+uint64_t cd_table_capacity(CD_Table *table)
+{
+	_cd_rwlock_read_lock(table->lock);
+	uint64_t count_m = table->count.count_m;
+	_cd_rwlock_read_unlock(table->lock);
+	return count_m;
+}
 
-			uint64_t _error = 0;
+uint64_t cd_table_reserve(CD_Table *table, uint64_t row_count)
+{
+	uint64_t return_value = 1;
 
-			uint64_t condition_attribute_index = *condition_attribute_index_ptr;
+	_cd_mutex_lock(table->writer_lock);
+	if (row_count > table->count.count_m)
+	{
+		uint64_t old_count_m = table->count.count_m;
+		_cd_rwlock_write_lock(table->lock);
+		return_value = _cd_table_capacity_set(table, row_count);
+		_cd_rwlock_write_unlock(table->lock);
+		if (return_value)
+		{
+			return_value = _cd_table_preallocate(table, old_count_m);
+		}
+	}
+	_cd_mutex_unlock(table->writer_lock);
 
-			CD_AttributeEx *condition_attribute = table->schema->attributes + condition_attribute_index;
+	return return_value;
+}
 
-			uint64_t condition_attribute_size = cd_attribute_size(condition_attribute->type, condition_attribute->count);
-			void *condition_attribute_buffer = malloc(condition_attribute_size);
+uint64_t cd_table_trim(CD_Table *table)
+{
+	_cd_mutex_lock(table->writer_lock);
+	_cd_rwlock_write_lock(table->lock);
+	uint64_t return_value = _cd_table_capacity_set(table, table->count.count_c);
+	_cd_rwlock_write_unlock(table->lock);
+	_cd_mutex_unlock(table->writer_lock);
 
-			switch (condition->operator)
-			{
-			case CD_CONDITION_OPERATOR_EQUALS:
-			{
-				for (uint64_t row = 0; row < table->count.count_c; row++)
-				{
-					if (!should_add_row[row])
-						continue;
-
-					if (!cf_file_view_read(table->data_view, row * table->schema->stride + condition_attribute->offset, condition_attribute_size, condition_attribute_buffer))
-					{
-						_cd_make_error(CD_ERROR_FILE, "Failed to read condition attribute '%s' at row %llu from table '%s'", condition_attribute->name, row, table->name.data);
-						_error = 1;
-						goto condition_attribute_buffer_free;
-					}
-
-					if (!_cd_funcs_equal[condition_attribute->type](condition_attribute_buffer, condition->data, condition_attribute->count))
-					{
-						should_add_row[row] = 0;
-					}
-				}
-				break;
-			}
-			case CD_CONDITION_OPERATOR_DIFFERENT:
-			{
-				for (uint64_t row = 0; row < table->count.count_c; row++)
-				{
-					if (!should_add_row[row])
-						continue;
-
-					if (!cf_file_view_read(table->data_view, row * table->schema->stride + condition_attribute->offset, condition_attribute_size, condition_attribute_buffer))
-					{
-						_cd_make_error(CD_ERROR_FILE, "Failed to read condition attribute '%s' at row %llu from table '%s'", condition_attribute->name, row, table->name.data);
-						_error = 1;
-						goto condition_attribute_buffer_free;
-					}
-
-					if (_cd_funcs_equal[condition_attribute->type](condition_attribute_buffer, condition->data, condition_attribute->count))
-					{
-						should_add_row[row] = 0;
-					}
-				}
-				break;
-			}
-			case CD_CONDITION_OPERATOR_BIGGER:
-			{
-				_cd_make_error(CD_ERROR_UNKNOWN_OPERATOR, "Operator %llu is not implemented yet. table: '%s'", condition->operator, table->name.data);
-				_error = 1;
-				goto condition_attribute_buffer_free;
-			}
-			case CD_CONDITION_OPERATOR_SMALLER:
-			{
-				_cd_make_error(CD_ERROR_UNKNOWN_OPERATOR, "Operator %llu is not implemented yet. table: '%s'", condition->operator, table->name.data);
-				_error = 1;
-				goto condition_attribute_buffer_free;
-			}
-			case CD_CONDITION_OPERATOR_CONTAINS:
-			{
-				_cd_make_error(CD_ERROR_UNKNOWN_OPERATOR, "Operator %llu is not implemented yet. table: '%s'", condition->operator, table->name.data);
-				_error = 1;
-				goto condition_attribute_buffer_free;
-			}
-			default:
-			{
-				_cd_make_error(CD_ERROR_UNKNOWN_OPERATOR, "Operator %llu is not recognized. table: '%s'", condition->operator, table->name.data);
-				_error = 1;
-				goto condition_attribute_buffer_free;
-			}
-			}
+	return return_value;
+}
 
-		condition_attribute_buffer_free:
-			free(condition_attribute_buffer);
-			if (_error)
-			{
-				goto should_add_row_free;
-			}
-		}
-	}
+uint64_t cd_table_insert(CD_Table *table, uint64_t attribute_count, const char *attribute_names[], const void *data)
+{
+	return cd_table_insert_many(table, attribute_count, attribute_names, 1, data);
+}
 
-	for (uint64_t row = 0; row < table->count.count_c; row++)
+uint64_t cd_table_insert_many(CD_Table *table, uint64_t attribute_count, const char *attribute_names[], uint64_t row_count, const void *data)
+{
+	CD_PreparedInsert *insert = cd_table_insert_prepare(table, attribute_count, attribute_names);
+	if (insert == NULL)
 	{
-		if (!should_add_row[row])
-			continue;
+		return 0;
+	}
 
-		uint8_t *row_ptr = cd_table_view_get_next_row(table_view);
-		for (uint64_t attrib_index = 0; attrib_index < attribute_count; attrib_index++)
-		{
-			if (!cf_file_view_read(table->data_view, row * table->schema->stride + attribute_data[attrib_index].file_offset, attribute_data[attrib_index].size, row_ptr + attribute_data[attrib_index].data_offset))
-			{
-				_cd_make_error(CD_ERROR_FILE, "Failed to read attribute '%s' at row %llu from table '%s'", attribute_names[attrib_index], row, table->name.data);
-				goto should_add_row_free;
-			}
-		}
+	uint64_t return_value = cd_prepared_insert(insert, row_count, data);
+
+	cd_prepared_insert_destroy(insert);
+
+	return return_value;
+}
+
+CD_TableView *cd_table_select(CD_Table *table, uint64_t attribute_count, const char *attribute_names[], uint64_t condition_count, CD_Condition *conditions)
+{
+	return cd_table_select_ex(table, attribute_count, attribute_names, condition_count, conditions, NULL);
+}
+
+CD_TableView *cd_table_select_ex(CD_Table *table, uint64_t attribute_count, const char *attribute_names[], uint64_t condition_count, CD_Condition *conditions, CD_QueryTrace *trace)
+{
+	CD_PreparedSelect *select = cd_table_select_prepare(table, attribute_count, attribute_names, condition_count, conditions);
+	if (select == NULL)
+	{
+		return NULL;
 	}
 
-	free(should_add_row);
+	CD_TableView *table_view = cd_prepared_select(select, NULL);
+	if (trace != NULL)
+	{
+		*trace = select->trace;
+	}
 
-	free(attribute_data);
+	cd_prepared_select_destroy(select);
 
 	return table_view;
-
-should_add_row_free:
-	free(should_add_row);
-table_view_data_free:
-	free(table_view->data);
-table_view_attributes_free:
-	free(table_view->attributes);
-// table_view_free:
-	free(table_view);
-// attribute_data_free:
-	free(attribute_data);
-//_return:
-	return NULL;
 }
@@ -34,6 +34,7 @@ CD_TableView *cd_table_view_create(CD_Table *table, uint64_t attribute_count, co
 		table_view->attributes[attrib_index].constraints = table_attribute->constraints;
 		table_view->attributes[attrib_index].offset = table_view->stride;
 		table_view->attributes[attrib_index].size = table_attribute->size;
+		table_view->attributes[attrib_index].encoding = CD_ENCODING_NONE;
 
 		table_view->stride += cd_attribute_size(table_attribute->type, table_attribute->count);
 	}
@@ -49,6 +50,21 @@ table_destroy:
 	return NULL;
 }
 
+CD_TableView *_cd_table_view_create_from(uint64_t attribute_count, const CD_AttributeEx *attributes, uint64_t stride)
+{
+	CD_TableView *table_view = malloc(sizeof(*table_view));
+
+	table_view->count_c = 0;
+	table_view->count_m = 32;
+	table_view->stride = stride;
+	table_view->attribute_count = attribute_count;
+	table_view->attributes = malloc(sizeof(table_view->attributes[0]) * attribute_count);
+	memcpy(table_view->attributes, attributes, sizeof(table_view->attributes[0]) * attribute_count);
+	table_view->data = malloc(table_view->count_m * table_view->stride);
+
+	return table_view;
+}
+
 void cd_table_view_destroy(CD_TableView *view)
 {
 	if (view != NULL)
@@ -67,13 +83,22 @@ void cd_table_view_destroy(CD_TableView *view)
 
 void *cd_table_view_get_next_row(CD_TableView *table_view)
 {
-	if (table_view->count_c == table_view->count_m)
+	return _cd_table_view_get_next_rows(table_view, 1);
+}
+
+void *_cd_table_view_get_next_rows(CD_TableView *table_view, uint64_t row_count)
+{
+	if (table_view->count_c + row_count > table_view->count_m)
 	{
-		table_view->count_m += 32;
+		// grow geometrically so filling a large view does not copy it over and over
+		while (table_view->count_c + row_count > table_view->count_m)
+		{
+			table_view->count_m *= 2;
+		}
 		table_view->data = realloc(table_view->data, table_view->count_m * table_view->stride);
 	}
 	void *ptr = (uint8_t *)table_view->data + table_view->count_c * table_view->stride;
-	table_view->count_c++;
+	table_view->count_c += row_count;
 	return ptr;
 }
 
@@ -0,0 +1,291 @@
+#include "internal.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+typedef struct CD_Thread
+{
+#ifdef _WIN32
+	HANDLE handle;
+#else
+	pthread_t handle;
+#endif
+	_cd_func_thread function;
+	void *argument;
+} CD_Thread;
+
+#ifdef _WIN32
+static DWORD WINAPI _cd_thread_main(LPVOID argument)
+{
+	CD_Thread *thread = argument;
+	thread->function(thread->argument);
+	return 0;
+}
+#else
+static void *_cd_thread_main(void *argument)
+{
+	CD_Thread *thread = argument;
+	thread->function(thread->argument);
+	return NULL;
+}
+#endif
+
+CD_Thread *_cd_thread_start(_cd_func_thread function, void *argument)
+{
+	CD_Thread *thread = malloc(sizeof(*thread));
+	thread->function = function;
+	thread->argument = argument;
+
+#ifdef _WIN32
+	thread->handle = CreateThread(NULL, 0, _cd_thread_main, thread, 0, NULL);
+	if (thread->handle == NULL)
+	{
+		free(thread);
+		return NULL;
+	}
+#else
+	if (pthread_create(&thread->handle, NULL, _cd_thread_main, thread) != 0)
+	{
+		free(thread);
+		return NULL;
+	}
+#endif
+
+	return thread;
+}
+
+void _cd_thread_join(CD_Thread *thread)
+{
+#ifdef _WIN32
+	WaitForSingleObject(thread->handle, INFINITE);
+	CloseHandle(thread->handle);
+#else
+	pthread_join(thread->handle, NULL);
+#endif
+	free(thread);
+}
+
+typedef struct CD_Mutex
+{
+#ifdef _WIN32
+	SRWLOCK lock;
+#else
+	pthread_mutex_t lock;
+#endif
+} CD_Mutex;
+
+typedef struct CD_ConditionVariable
+{
+#ifdef _WIN32
+	CONDITION_VARIABLE condition;
+#else
+	pthread_cond_t condition;
+#endif
+} CD_ConditionVariable;
+
+CD_Mutex *_cd_mutex_create()
+{
+	CD_Mutex *mutex = malloc(sizeof(*mutex));
+#ifdef _WIN32
+	InitializeSRWLock(&mutex->lock);
+#else
+	pthread_mutex_init(&mutex->lock, NULL);
+#endif
+	return mutex;
+}
+
+void _cd_mutex_destroy(CD_Mutex *mutex)
+{
+#ifndef _WIN32
+	pthread_mutex_destroy(&mutex->lock);
+#endif
+	free(mutex);
+}
+
+void _cd_mutex_lock(CD_Mutex *mutex)
+{
+#ifdef _WIN32
+	AcquireSRWLockExclusive(&mutex->lock);
+#else
+	pthread_mutex_lock(&mutex->lock);
+#endif
+}
+
+void _cd_mutex_unlock(CD_Mutex *mutex)
+{
+#ifdef _WIN32
+	ReleaseSRWLockExclusive(&mutex->lock);
+#else
+	pthread_mutex_unlock(&mutex->lock);
+#endif
+}
+
+CD_ConditionVariable *_cd_condition_create()
+{
+	CD_ConditionVariable *condition = malloc(sizeof(*condition));
+#ifdef _WIN32
+	InitializeConditionVariable(&condition->condition);
+#else
+	pthread_cond_init(&condition->condition, NULL);
+#endif
+	return condition;
+}
+
+void _cd_condition_destroy(CD_ConditionVariable *condition)
+{
+#ifndef _WIN32
+	pthread_cond_destroy(&condition->condition);
+#endif
+	free(condition);
+}
+
+void _cd_condition_wait(CD_ConditionVariable *condition, CD_Mutex *mutex)
+{
+#ifdef _WIN32
+	SleepConditionVariableSRW(&condition->condition, &mutex->lock, INFINITE, 0);
+#else
+	pthread_cond_wait(&condition->condition, &mutex->lock);
+#endif
+}
+
+void _cd_condition_broadcast(CD_ConditionVariable *condition)
+{
+#ifdef _WIN32
+	WakeAllConditionVariable(&condition->condition);
+#else
+	pthread_cond_broadcast(&condition->condition);
+#endif
+}
+
+typedef struct CD_RwLock
+{
+#ifdef _WIN32
+	SRWLOCK lock;
+#else
+	pthread_rwlock_t lock;
+#endif
+} CD_RwLock;
+
+CD_RwLock *_cd_rwlock_create()
+{
+	CD_RwLock *lock = malloc(sizeof(*lock));
+#ifdef _WIN32
+	InitializeSRWLock(&lock->lock);
+#elif defined(__GLIBC__)
+	// readers are preferred by default, a steady stream of selects would keep the writer out
+	pthread_rwlockattr_t attributes;
+	pthread_rwlockattr_init(&attributes);
+	pthread_rwlockattr_setkind_np(&attributes, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+	pthread_rwlock_init(&lock->lock, &attributes);
+	pthread_rwlockattr_destroy(&attributes);
+#else
+	pthread_rwlock_init(&lock->lock, NULL);
+#endif
+	return lock;
+}
+
+void _cd_rwlock_destroy(CD_RwLock *lock)
+{
+#ifndef _WIN32
+	pthread_rwlock_destroy(&lock->lock);
+#endif
+	free(lock);
+}
+
+void _cd_rwlock_read_lock(CD_RwLock *lock)
+{
+#ifdef _WIN32
+	AcquireSRWLockShared(&lock->lock);
+#else
+	pthread_rwlock_rdlock(&lock->lock);
+#endif
+}
+
+void _cd_rwlock_read_unlock(CD_RwLock *lock)
+{
+#ifdef _WIN32
+	ReleaseSRWLockShared(&lock->lock);
+#else
+	pthread_rwlock_unlock(&lock->lock);
+#endif
+}
+
+void _cd_rwlock_write_lock(CD_RwLock *lock)
+{
+#ifdef _WIN32
+	AcquireSRWLockExclusive(&lock->lock);
+#else
+	pthread_rwlock_wrlock(&lock->lock);
+#endif
+}
+
+void _cd_rwlock_write_unlock(CD_RwLock *lock)
+{
+#ifdef _WIN32
+	ReleaseSRWLockExclusive(&lock->lock);
+#else
+	pthread_rwlock_unlock(&lock->lock);
+#endif
+}
+
+uint64_t _cd_atomic_fetch_add(volatile uint64_t *value, uint64_t add)
+{
+#ifdef _MSC_VER
+	return (uint64_t)_InterlockedExchangeAdd64((volatile long long *)value, (long long)add);
+#else
+	return __atomic_fetch_add(value, add, __ATOMIC_RELAXED);
+#endif
+}
+
+uint64_t _cd_atomic_load_acquire(const volatile uint64_t *value)
+{
+#ifdef _MSC_VER
+	// plain volatile accesses have acquire and release semantics with the default /volatile:ms
+	return *value;
+#else
+	return __atomic_load_n(value, __ATOMIC_ACQUIRE);
+#endif
+}
+
+void _cd_atomic_store_release(volatile uint64_t *value, uint64_t new_value)
+{
+#ifdef _MSC_VER
+	*value = new_value;
+#else
+	__atomic_store_n(value, new_value, __ATOMIC_RELEASE);
+#endif
+}
+
+uint64_t _cd_cpu_count()
+{
+#ifdef _WIN32
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return info.dwNumberOfProcessors;
+#else
+	long count = sysconf(_SC_NPROCESSORS_ONLN);
+	return count > 0 ? (uint64_t)count : 1;
+#endif
+}
+
+uint64_t _cd_time_ns()
+{
+#ifdef _WIN32
+	LARGE_INTEGER frequency, counter;
+	QueryPerformanceFrequency(&frequency);
+	QueryPerformanceCounter(&counter);
+	// split so the multiplication does not overflow
+	uint64_t seconds = counter.QuadPart / frequency.QuadPart;
+	uint64_t rest = counter.QuadPart % frequency.QuadPart;
+	return seconds * 1000000000ULL + rest * 1000000000ULL / frequency.QuadPart;
+#else
+	struct timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return (uint64_t)time.tv_sec * 1000000000ULL + (uint64_t)time.tv_nsec;
+#endif
+}
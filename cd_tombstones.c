@@ -0,0 +1,338 @@
+#include "internal.h"
+
+// the file holds the header followed by one bit per row, set while the row is deleted.
+// the bitmap is kept in memory and every changed word is written through
+
+#define CD_TOMBSTONE_WORDS_START 64
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+static inline uint64_t _cd_lowest_bit64(uint64_t bits)
+{
+#if defined(_MSC_VER)
+	unsigned long index;
+	_BitScanForward64(&index, bits);
+	return index;
+#else
+	return __builtin_ctzll(bits);
+#endif
+}
+
+static CC_String _cd_tombstones_path(CD_Table *table)
+{
+	CC_StringBuffer *buffer = cc_string_buffer_create(CD_NAME_LENGTH);
+	cc_string_buffer_insert_string(buffer, table->db->name);
+	cc_string_buffer_insert_char(buffer, '/');
+	cc_string_buffer_insert_string(buffer, table->name);
+	CC_String file_extension = cc_string_create(".deleted", 0);
+	cc_string_buffer_insert_string(buffer, file_extension);
+	cc_string_destroy(file_extension);
+
+	return cc_string_buffer_to_string_and_destroy(buffer);
+}
+
+static uint64_t _cd_tombstones_map(CD_Tombstones *tombstones)
+{
+	tombstones->header_view = cf_file_view_open(tombstones->file, 0, sizeof(tombstones->header));
+	if (tombstones->header_view == NULL)
+	{
+		_cd_make_error(CD_ERROR_FILE, "Failed to open header view of file '%s'", tombstones->file_path.data);
+		return 0;
+	}
+
+	tombstones->word_view = cf_file_view_open(tombstones->file, sizeof(tombstones->header), tombstones->header.word_count * sizeof(uint64_t));
+	if (tombstones->word_view == NULL)
+	{
+		_cd_make_error(CD_ERROR_FILE, "Failed to open bitmap view of file '%s'", tombstones->file_path.data);
+		return 0;
+	}
+
+	return 1;
+}
+
+static void _cd_tombstones_unmap(CD_Tombstones *tombstones)
+{
+	if (tombstones->word_view != NULL)
+	{
+		cf_file_view_close(tombstones->word_view);
+		tombstones->word_view = NULL;
+	}
+	if (tombstones->header_view != NULL)
+	{
+		cf_file_view_close(tombstones->header_view);
+		tombstones->header_view = NULL;
+	}
+}
+
+// makes the bitmap hold at least word_count words, new words are zero
+static uint64_t _cd_tombstones_reserve(CD_Tombstones *tombstones, uint64_t word_count)
+{
+	if (word_count <= tombstones->header.word_count)
+	{
+		return 1;
+	}
+
+	uint64_t new_word_count = tombstones->header.word_count * 2;
+	if (new_word_count < word_count)
+	{
+		new_word_count = word_count;
+	}
+
+	_cd_tombstones_unmap(tombstones);
+
+	if (!cf_file_resize(tombstones->file, sizeof(tombstones->header) + new_word_count * sizeof(uint64_t)))
+	{
+		_cd_make_error(CD_ERROR_FILE, "Failed to resize file '%s'", tombstones->file_path.data);
+		return 0;
+	}
+
+	tombstones->words = realloc(tombstones->words, new_word_count * sizeof(uint64_t));
+	memset(tombstones->words + tombstones->header.word_count, 0, (new_word_count - tombstones->header.word_count) * sizeof(uint64_t));
+	tombstones->header.word_count = new_word_count;
+
+	if (!_cd_tombstones_map(tombstones))
+	{
+		return 0;
+	}
+
+	// the file may not hand back zeroed space
+	if (!cf_file_view_write(tombstones->word_view, 0, new_word_count * sizeof(uint64_t), tombstones->words))
+	{
+		_cd_make_error(CD_ERROR_FILE, "Failed to write bitmap of file '%s'", tombstones->file_path.data);
+		return 0;
+	}
+
+	return _cd_tombstones_commit(tombstones);
+}
+
+uint64_t _cd_tombstones_exists(CD_Table *table)
+{
+	CC_String file_path = _cd_tombstones_path(table);
+	uint64_t exists = cf_file_exists(file_path);
+	cc_string_destroy(file_path);
+	return exists;
+}
+
+CD_Tombstones *_cd_tombstones_open(CD_Table *table)
+{
+	CD_Tombstones *tombstones = malloc(sizeof(*tombstones));
+	tombstones->file_path = _cd_tombstones_path(table);
+	tombstones->header.deleted_count = 0;
+	tombstones->header.word_count = 0;
+	tombstones->words = NULL;
+	tombstones->first_word = 0;
+	tombstones->file = NULL;
+	tombstones->header_view = NULL;
+	tombstones->word_view = NULL;
+
+	uint64_t is_new = 0;
+	if (!cf_file_exists(tombstones->file_path))
+	{
+		if (!cf_file_create(tombstones->file_path, sizeof(tombstones->header)))
+		{
+			_cd_make_error(CD_ERROR_FILE, "Failed to create file '%s'", tombstones->file_path.data);
+			goto tombstones_close;
+		}
+		is_new = 1;
+	}
+
+	tombstones->file = cf_file_open(tombstones->file_path);
+	if (tombstones->file == NULL)
+	{
+		_cd_make_error(CD_ERROR_FILE, "Failed to open file '%s'", tombstones->file_path.data);
+		goto tombstones_close;
+	}
+
+	if (is_new)
+	{
+		if (!_cd_tombstones_reserve(tombstones, CD_TOMBSTONE_WORDS_START))
+		{
+			goto tombstones_close;
+		}
+		return tombstones;
+	}
+
+	CF_FileView *header_view = cf_file_view_open(tombstones->file, 0, sizeof(tombstones->header));
+	if (header_view == NULL || !cf_file_view_read(header_view, 0, sizeof(tombstones->header), &tombstones->header))
+	{
+		_cd_make_error(CD_ERROR_FILE, "Failed to read header of file '%s'", tombstones->file_path.data);
+		if (header_view != NULL)
+		{
+			cf_file_view_close(header_view);
+		}
+		goto tombstones_close;
+	}
+	cf_file_view_close(header_view);
+
+	if (!_cd_tombstones_map(tombstones))
+	{
+		goto tombstones_close;
+	}
+
+	tombstones->words = malloc(tombstones->header.word_count * sizeof(uint64_t));
+	if (!cf_file_view_read(tombstones->word_view, 0, tombstones->header.word_count * sizeof(uint64_t), tombstones->words))
+	{
+		_cd_make_error(CD_ERROR_FILE, "Failed to read bitmap of file '%s'", tombstones->file_path.data);
+		goto tombstones_close;
+	}
+
+	// the bits are written before the header, so the count is taken from them; bits past the rows are dropped
+	uint64_t deleted_count = 0;
+	for (uint64_t word = 0; word < tombstones->header.word_count; word++)
+	{
+		uint64_t first_row = word * 64;
+		if (first_row >= table->count.count_c)
+		{
+			tombstones->words[word] = 0;
+		}
+		else if (table->count.count_c - first_row < 64)
+		{
+			tombstones->words[word] &= ((uint64_t)1 << (table->count.count_c - first_row)) - 1;
+		}
+
+		for (uint64_t bits = tombstones->words[word]; bits != 0; bits &= bits - 1)
+		{
+			deleted_count++;
+		}
+	}
+	tombstones->header.deleted_count = deleted_count;
+
+	return tombstones;
+
+tombstones_close:
+	_cd_tombstones_close(tombstones);
+	return NULL;
+}
+
+void _cd_tombstones_close(CD_Tombstones *tombstones)
+{
+	if (tombstones != NULL)
+	{
+		_cd_tombstones_unmap(tombstones);
+		if (tombstones->file != NULL)
+		{
+			cf_file_close(tombstones->file);
+		}
+		free(tombstones->words);
+		cc_string_destroy(tombstones->file_path);
+		free(tombstones);
+	}
+}
+
+uint64_t _cd_tombstones_set(CD_Tombstones *tombstones, uint64_t row, uint64_t is_deleted)
+{
+	uint64_t word = row / 64;
+	uint64_t bit = (uint64_t)1 << (row % 64);
+
+	if (!_cd_tombstones_reserve(tombstones, word + 1))
+	{
+		return 0;
+	}
+
+	if (((tombstones->words[word] & bit) != 0) == (is_deleted != 0))
+	{
+		return 1;
+	}
+
+	if (is_deleted)
+	{
+		tombstones->words[word] |= bit;
+		tombstones->header.deleted_count++;
+		if (word < tombstones->first_word)
+		{
+			tombstones->first_word = word;
+		}
+	}
+	else
+	{
+		tombstones->words[word] &= ~bit;
+		tombstones->header.deleted_count--;
+	}
+
+	if (!cf_file_view_write(tombstones->word_view, word * sizeof(uint64_t), sizeof(uint64_t), tombstones->words + word))
+	{
+		_cd_make_error(CD_ERROR_FILE, "Failed to write bitmap word %llu of file '%s'", word, tombstones->file_path.data);
+		return 0;
+	}
+
+	return 1;
+}
+
+uint64_t _cd_tombstones_commit(CD_Tombstones *tombstones)
+{
+	if (!cf_file_view_write(tombstones->header_view, 0, sizeof(tombstones->header), &tombstones->header))
+	{
+		_cd_make_error(CD_ERROR_FILE, "Failed to write header of file '%s'", tombstones->file_path.data);
+		return 0;
+	}
+	return 1;
+}
+
+uint64_t _cd_tombstones_is_deleted(const CD_Tombstones *tombstones, uint64_t row)
+{
+	uint64_t word = row / 64;
+	return word < tombstones->header.word_count && (tombstones->words[word] >> (row % 64) & 1);
+}
+
+void _cd_tombstones_apply(const CD_Tombstones *tombstones, uint64_t row, uint64_t row_count, uint8_t *selection)
+{
+	uint64_t end_row = row + row_count;
+	uint64_t end_word = (end_row + 63) / 64;
+	if (end_word > tombstones->header.word_count)
+	{
+		end_word = tombstones->header.word_count;
+	}
+
+	// words without deleted rows are skipped whole
+	for (uint64_t word = row / 64; word < end_word; word++)
+	{
+		for (uint64_t bits = tombstones->words[word]; bits != 0; bits &= bits - 1)
+		{
+			uint64_t deleted_row = word * 64 + _cd_lowest_bit64(bits);
+			if (deleted_row >= row && deleted_row < end_row)
+			{
+				selection[deleted_row - row] = 0;
+			}
+		}
+	}
+}
+
+uint64_t _cd_tombstones_next(CD_Tombstones *tombstones, uint64_t row, uint64_t end_row)
+{
+	// words before first_word have no bits, it only moves forward here
+	uint64_t word = row / 64;
+	if (word < tombstones->first_word)
+	{
+		word = tombstones->first_word;
+		row = word * 64;
+	}
+
+	uint64_t is_before_set = word == tombstones->first_word;
+	for (; word < tombstones->header.word_count && word * 64 < end_row; word++)
+	{
+		uint64_t bits = tombstones->words[word];
+		if (word == row / 64)
+		{
+			bits &= ~(uint64_t)0 << (row % 64);
+		}
+
+		if (bits != 0)
+		{
+			uint64_t deleted_row = word * 64 + _cd_lowest_bit64(bits);
+			return deleted_row < end_row ? deleted_row : end_row;
+		}
+
+		if (is_before_set && tombstones->words[word] == 0)
+		{
+			tombstones->first_word = word + 1;
+		}
+		else
+		{
+			is_before_set = 0;
+		}
+	}
+
+	return end_row;
+}
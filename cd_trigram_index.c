@@ -0,0 +1,568 @@
+#include "internal.h"
+
+// every bucket holds the rows that contain a trigram hashing to it, as a list of chunks.
+// rows are appended in order, so the newest chunk is the head and a list is sorted by row
+typedef struct _CD_File_TrigramBucket
+{
+	uint64_t chunk; // head chunk + 1 (0 means the bucket is empty)
+	uint64_t count;
+	uint64_t last_row; // row + 1 of the last append, a row is only added once per bucket
+} _CD_File_TrigramBucket;
+
+typedef struct _CD_File_TrigramChunk
+{
+	uint64_t next; // chunk + 1 of the next older chunk
+	uint64_t rows[CD_TRIGRAM_CHUNK_ROWS];
+} _CD_File_TrigramChunk;
+
+#define CD_TRIGRAM_BUCKET_VIEW_SIZE (CD_TRIGRAM_BUCKETS * sizeof(_CD_File_TrigramBucket))
+
+static uint64_t _cd_trigram_index_map(CD_TrigramIndex *index)
+{
+	index->header_view = cf_file_view_open(index->file, 0, sizeof(index->header));
+	if (index->header_view == NULL)
+	{
+		_cd_make_error(CD_ERROR_FILE, "Failed to open header view of index file '%s'", index->file_path.data);
+		return 0;
+	}
+
+	index->bucket_view = cf_file_view_open(index->file, sizeof(index->header), CD_TRIGRAM_BUCKET_VIEW_SIZE);
+	if (index->bucket_view == NULL)
+	{
+		_cd_make_error(CD_ERROR_FILE, "Failed to open bucket view of index file '%s'", index->file_path.data);
+		return 0;
+	}
+
+	index->chunk_view = cf_file_view_open(index->file, sizeof(index->header) + CD_TRIGRAM_BUCKET_VIEW_SIZE, index->header.chunk_count_m * sizeof(_CD_File_TrigramChunk));
+	if (index->chunk_view == NULL)
+	{
+		_cd_make_error(CD_ERROR_FILE, "Failed to open chunk view of index file '%s'", index->file_path.data);
+		return 0;
+	}
+
+	return 1;
+}
+
+static void _cd_trigram_index_unmap(CD_TrigramIndex *index)
+{
+	if (index->chunk_view != NULL)
+	{
+		cf_file_view_close(index->chunk_view);
+		index->chunk_view = NULL;
+	}
+	if (index->bucket_view != NULL)
+	{
+		cf_file_view_close(index->bucket_view);
+		index->bucket_view = NULL;
+	}
+	if (index->header_view != NULL)
+	{
+		cf_file_view_close(index->header_view);
+		index->header_view = NULL;
+	}
+}
+
+static uint64_t _cd_trigram_index_file_size(uint64_t chunk_count_m)
+{
+	return sizeof(_CD_File_TrigramIndex) + CD_TRIGRAM_BUCKET_VIEW_SIZE + chunk_count_m * sizeof(_CD_File_TrigramChunk);
+}
+
+// empties the index: clears the buckets and drops every chunk
+static uint64_t _cd_trigram_index_reset(CD_TrigramIndex *index)
+{
+	_cd_trigram_index_unmap(index);
+
+	index->header.row_count = 0;
+	index->header.chunk_count_c = 0;
+	index->header.chunk_count_m = CD_TRIGRAM_CHUNKS_START;
+
+	// shrink to the header first so the resize hands back zeroed buckets
+	if (!cf_file_resize(index->file, sizeof(index->header)) || !cf_file_resize(index->file, _cd_trigram_index_file_size(index->header.chunk_count_m)))
+	{
+		_cd_make_error(CD_ERROR_FILE, "Failed to resize index file '%s'", index->file_path.data);
+		return 0;
+	}
+
+	if (!_cd_trigram_index_map(index))
+	{
+		return 0;
+	}
+
+	if (!cf_file_view_write(index->header_view, 0, sizeof(index->header), &index->header))
+	{
+		_cd_make_error(CD_ERROR_FILE, "Failed to write header of index file '%s'", index->file_path.data);
+		return 0;
+	}
+
+	return 1;
+}
+
+static uint64_t _cd_trigram_index_grow(CD_TrigramIndex *index)
+{
+	cf_file_view_close(index->chunk_view);
+	index->chunk_view = NULL;
+
+	uint64_t chunk_count_m = index->header.chunk_count_m * 2;
+	if (!cf_file_resize(index->file, _cd_trigram_index_file_size(chunk_count_m)))
+	{
+		_cd_make_error(CD_ERROR_FILE, "Failed to resize index file '%s'", index->file_path.data);
+		return 0;
+	}
+	index->header.chunk_count_m = chunk_count_m;
+
+	index->chunk_view = cf_file_view_open(index->file, sizeof(index->header) + CD_TRIGRAM_BUCKET_VIEW_SIZE, index->header.chunk_count_m * sizeof(_CD_File_TrigramChunk));
+	if (index->chunk_view == NULL)
+	{
+		_cd_make_error(CD_ERROR_FILE, "Failed to reopen chunk view of index file '%s'", index->file_path.data);
+		return 0;
+	}
+
+	return 1;
+}
+
+static uint64_t _cd_trigram_index_add(CD_TrigramIndex *index, uint64_t slot, uint64_t row)
+{
+	_CD_File_TrigramBucket bucket;
+	if (!cf_file_view_read(index->bucket_view, slot * sizeof(bucket), sizeof(bucket), &bucket))
+	{
+		_cd_make_error(CD_ERROR_FILE, "Failed to read bucket %llu of index file '%s'", slot, index->file_path.data);
+		return 0;
+	}
+
+	if (bucket.last_row == row + 1)
+	{
+		return 1;
+	}
+
+	// the head chunk is full when count is a multiple of the chunk size
+	uint64_t fill = bucket.count % CD_TRIGRAM_CHUNK_ROWS;
+	if (fill == 0)
+	{
+		if (index->header.chunk_count_c == index->header.chunk_count_m && !_cd_trigram_index_grow(index))
+		{
+			return 0;
+		}
+
+		uint64_t chunk = index->header.chunk_count_c++;
+		if (!cf_file_view_write(index->chunk_view, chunk * sizeof(_CD_File_TrigramChunk), sizeof(bucket.chunk), &bucket.chunk))
+		{
+			_cd_make_error(CD_ERROR_FILE, "Failed to write chunk %llu of index file '%s'", chunk, index->file_path.data);
+			return 0;
+		}
+		bucket.chunk = chunk + 1;
+	}
+
+	uint64_t offset = (bucket.chunk - 1) * sizeof(_CD_File_TrigramChunk) + sizeof(uint64_t) + fill * sizeof(uint64_t);
+	if (!cf_file_view_write(index->chunk_view, offset, sizeof(row), &row))
+	{
+		_cd_make_error(CD_ERROR_FILE, "Failed to write chunk %llu of index file '%s'", bucket.chunk - 1, index->file_path.data);
+		return 0;
+	}
+
+	bucket.count++;
+	bucket.last_row = row + 1;
+	if (!cf_file_view_write(index->bucket_view, slot * sizeof(bucket), sizeof(bucket), &bucket))
+	{
+		_cd_make_error(CD_ERROR_FILE, "Failed to write bucket %llu of index file '%s'", slot, index->file_path.data);
+		return 0;
+	}
+
+	return 1;
+}
+
+static uint64_t _cd_trigram_slot(const uint8_t *text, uint64_t unit_size)
+{
+	return _cd_hash(text, 3 * unit_size) & (CD_TRIGRAM_BUCKETS - 1);
+}
+
+uint64_t _cd_trigram_index_insert(CD_TrigramIndex *index, const void *value, uint64_t row)
+{
+	if (value != NULL)
+	{
+		uint64_t unit_size = _cd_text_unit_size(index->type);
+		uint64_t length = _cd_text_length(index->type, value, index->count);
+
+		for (uint64_t unit = 0; unit + 3 <= length; unit++)
+		{
+			if (!_cd_trigram_index_add(index, _cd_trigram_slot((const uint8_t *)value + unit * unit_size, unit_size), row))
+			{
+				return 0;
+			}
+		}
+	}
+
+	// rows freed by a delete are reused, so row can be below the rows already indexed
+	if (row + 1 > index->header.row_count)
+	{
+		index->header.row_count = row + 1;
+	}
+
+	return 1;
+}
+
+uint64_t _cd_trigram_index_commit(CD_TrigramIndex *index)
+{
+	if (!cf_file_view_write(index->header_view, 0, sizeof(index->header), &index->header))
+	{
+		_cd_make_error(CD_ERROR_FILE, "Failed to write header of index file '%s'", index->file_path.data);
+		return 0;
+	}
+	return 1;
+}
+
+uint64_t _cd_trigram_index_rebuild(CD_Table *table, CD_TrigramIndex *index)
+{
+	const CD_AttributeEx *attribute = table->schema->attributes + index->attribute_index;
+
+	if (!_cd_trigram_index_reset(index))
+	{
+		return 0;
+	}
+
+	void *value = malloc(attribute->size);
+
+	for (uint64_t row = 0; row < table->count.count_c; row++)
+	{
+		if (!_cd_table_values_read(table, attribute, row, 1, value))
+		{
+			free(value);
+			return 0;
+		}
+
+		if (!_cd_trigram_index_insert(index, value, row))
+		{
+			free(value);
+			return 0;
+		}
+	}
+
+	free(value);
+
+	return _cd_trigram_index_commit(index);
+}
+
+static int _cd_trigram_row_compare(const void *row1, const void *row2)
+{
+	uint64_t r1 = *(const uint64_t *)row1;
+	uint64_t r2 = *(const uint64_t *)row2;
+	return r1 < r2 ? -1 : r1 > r2;
+}
+
+// reads the rows of bucket into rows in ascending order, *row_count is the rows left once repeated ones are dropped
+static uint64_t _cd_trigram_index_read_rows(CD_TrigramIndex *index, const _CD_File_TrigramBucket *bucket, uint64_t *rows, uint64_t *row_count)
+{
+	uint64_t fill = bucket->count % CD_TRIGRAM_CHUNK_ROWS;
+	if (fill == 0)
+	{
+		fill = CD_TRIGRAM_CHUNK_ROWS;
+	}
+
+	uint64_t end = bucket->count;
+	for (uint64_t chunk = bucket->chunk; chunk != 0;)
+	{
+		_CD_File_TrigramChunk file_chunk;
+		if (!cf_file_view_read(index->chunk_view, (chunk - 1) * sizeof(file_chunk), sizeof(file_chunk), &file_chunk))
+		{
+			_cd_make_error(CD_ERROR_FILE, "Failed to read chunk %llu of index file '%s'", chunk - 1, index->file_path.data);
+			return 0;
+		}
+
+		end -= fill;
+		memcpy(rows + end, file_chunk.rows, fill * sizeof(*rows));
+
+		fill = CD_TRIGRAM_CHUNK_ROWS;
+		chunk = file_chunk.next;
+	}
+
+	*row_count = bucket->count;
+
+	// rows are appended in order unless a row freed by a delete was reused
+	uint64_t is_sorted = 1;
+	for (uint64_t i = 1; i < bucket->count && is_sorted; i++)
+	{
+		is_sorted = rows[i - 1] < rows[i];
+	}
+	if (is_sorted)
+	{
+		return 1;
+	}
+
+	qsort(rows, bucket->count, sizeof(*rows), _cd_trigram_row_compare);
+	uint64_t unique_count = 0;
+	for (uint64_t i = 0; i < bucket->count; i++)
+	{
+		if (unique_count == 0 || rows[unique_count - 1] != rows[i])
+		{
+			rows[unique_count++] = rows[i];
+		}
+	}
+	*row_count = unique_count;
+
+	return 1;
+}
+
+uint64_t _cd_trigram_index_candidates(CD_TrigramIndex *index, const void *needle, uint64_t needle_length, uint64_t **rows, uint64_t *row_count)
+{
+	if (needle_length < 3)
+	{
+		_cd_make_error(CD_ERROR_UNKNOWN_OPERATOR, "A trigram index can only look up text of at least 3 characters. index: '%s'", index->file_path.data);
+		return 0;
+	}
+
+	uint64_t unit_size = _cd_text_unit_size(index->type);
+	uint64_t trigram_count = needle_length - 2;
+
+	_CD_File_TrigramBucket *buckets = malloc(sizeof(*buckets) * trigram_count);
+	uint64_t bucket_count = 0;
+
+	*rows = NULL;
+	*row_count = 0;
+
+	for (uint64_t unit = 0; unit < trigram_count; unit++)
+	{
+		uint64_t slot = _cd_trigram_slot((const uint8_t *)needle + unit * unit_size, unit_size);
+
+		_CD_File_TrigramBucket bucket;
+		if (!cf_file_view_read(index->bucket_view, slot * sizeof(bucket), sizeof(bucket), &bucket))
+		{
+			_cd_make_error(CD_ERROR_FILE, "Failed to read bucket %llu of index file '%s'", slot, index->file_path.data);
+			free(buckets);
+			return 0;
+		}
+
+		// a trigram no row has, nothing can match
+		if (bucket.count == 0)
+		{
+			free(buckets);
+			return 1;
+		}
+
+		// skip repeated trigrams, the head chunk tells buckets apart
+		uint64_t is_repeated = 0;
+		for (uint64_t b = 0; b < bucket_count && !is_repeated; b++)
+		{
+			is_repeated = (buckets[b].chunk == bucket.chunk);
+		}
+		if (is_repeated)
+		{
+			continue;
+		}
+
+		// keep the buckets sorted by count
+		uint64_t position = 0;
+		while (position < bucket_count && buckets[position].count < bucket.count)
+		{
+			position++;
+		}
+		memmove(buckets + position + 1, buckets + position, (bucket_count - position) * sizeof(*buckets));
+		buckets[position] = bucket;
+		bucket_count++;
+	}
+
+	// start from the rarest trigram and intersect with the next rarest ones
+	uint64_t *candidates = malloc(sizeof(*candidates) * buckets[0].count);
+	uint64_t candidate_count = 0;
+	uint64_t *list = NULL;
+
+	if (!_cd_trigram_index_read_rows(index, buckets + 0, candidates, &candidate_count))
+	{
+		goto candidates_free;
+	}
+
+	for (uint64_t b = 1; b < bucket_count && b < CD_TRIGRAM_QUERY_LISTS && candidate_count != 0; b++)
+	{
+		list = realloc(list, sizeof(*list) * buckets[b].count);
+		uint64_t list_count;
+		if (!_cd_trigram_index_read_rows(index, buckets + b, list, &list_count))
+		{
+			goto candidates_free;
+		}
+
+		uint64_t kept = 0;
+		for (uint64_t c = 0, l = 0; c < candidate_count && l < list_count;)
+		{
+			if (candidates[c] < list[l])
+			{
+				c++;
+			}
+			else if (candidates[c] > list[l])
+			{
+				l++;
+			}
+			else
+			{
+				candidates[kept++] = candidates[c];
+				c++;
+				l++;
+			}
+		}
+		candidate_count = kept;
+	}
+
+	free(list);
+	free(buckets);
+
+	*rows = candidates;
+	*row_count = candidate_count;
+
+	return 1;
+
+candidates_free:
+	free(list);
+	free(candidates);
+	free(buckets);
+	return 0;
+}
+
+static CC_String _cd_trigram_index_path(CD_Table *table, uint64_t attribute_index)
+{
+	CC_StringBuffer *buffer = cc_string_buffer_create(CD_NAME_LENGTH);
+	cc_string_buffer_insert_string(buffer, table->db->name);
+	cc_string_buffer_insert_char(buffer, '/');
+	cc_string_buffer_insert_string(buffer, table->name);
+	cc_string_buffer_insert_char(buffer, '.');
+	CC_String attribute_name = cc_string_create(table->schema->attributes[attribute_index].name, 0);
+	cc_string_buffer_insert_string(buffer, attribute_name);
+	cc_string_destroy(attribute_name);
+	CC_String file_extension = cc_string_create(".trigram", 0);
+	cc_string_buffer_insert_string(buffer, file_extension);
+	cc_string_destroy(file_extension);
+
+	return cc_string_buffer_to_string_and_destroy(buffer);
+}
+
+uint64_t _cd_trigram_index_exists(CD_Table *table, uint64_t attribute_index)
+{
+	CC_String file_path = _cd_trigram_index_path(table, attribute_index);
+	uint64_t exists = cf_file_exists(file_path);
+	cc_string_destroy(file_path);
+	return exists;
+}
+
+CD_TrigramIndex *_cd_trigram_index_open(CD_Table *table, uint64_t attribute_index)
+{
+	const CD_AttributeEx *attribute = table->schema->attributes + attribute_index;
+
+	CC_String file_path = _cd_trigram_index_path(table, attribute_index);
+
+	uint64_t rebuild = 0;
+	if (!cf_file_exists(file_path))
+	{
+		if (!cf_file_create(file_path, sizeof(_CD_File_TrigramIndex)))
+		{
+			_cd_make_error(CD_ERROR_FILE, "Failed to create index file '%s'", file_path.data);
+			goto file_path_destroy;
+		}
+		rebuild = 1;
+	}
+
+	CF_File *file = cf_file_open(file_path);
+	if (file == NULL)
+	{
+		_cd_make_error(CD_ERROR_FILE, "Failed to open index file '%s'", file_path.data);
+		goto file_path_destroy;
+	}
+
+	CD_TrigramIndex *index = malloc(sizeof(*index));
+
+	index->file_path = file_path;
+	index->attribute_index = attribute_index;
+	index->type = attribute->type;
+	index->count = attribute->count;
+	index->file = file;
+	index->header_view = NULL;
+	index->bucket_view = NULL;
+	index->chunk_view = NULL;
+	index->header.row_count = 0;
+	index->header.chunk_count_c = 0;
+	index->header.chunk_count_m = 0;
+
+	if (!rebuild)
+	{
+		CF_FileView *header_view = cf_file_view_open(file, 0, sizeof(index->header));
+		if (header_view == NULL || !cf_file_view_read(header_view, 0, sizeof(index->header), &index->header))
+		{
+			_cd_make_error(CD_ERROR_FILE, "Failed to read header of index file '%s'", file_path.data);
+			if (header_view != NULL)
+			{
+				cf_file_view_close(header_view);
+			}
+			goto index_close;
+		}
+		cf_file_view_close(header_view);
+
+		// an index that does not cover exactly the rows of the table is stale (e.g. after a crash)
+		if (index->header.row_count != table->count.count_c || index->header.chunk_count_m == 0 || index->header.chunk_count_c > index->header.chunk_count_m || cf_file_size_get(file) < _cd_trigram_index_file_size(index->header.chunk_count_m))
+		{
+			rebuild = 1;
+		}
+		else if (!_cd_trigram_index_map(index))
+		{
+			goto index_close;
+		}
+	}
+
+	if (rebuild && !_cd_trigram_index_rebuild(table, index))
+	{
+		goto index_close;
+	}
+
+	return index;
+
+index_close:
+	_cd_trigram_index_close(index);
+	return NULL;
+file_path_destroy:
+	cc_string_destroy(file_path);
+	return NULL;
+}
+
+void _cd_trigram_index_close(CD_TrigramIndex *index)
+{
+	if (index != NULL)
+	{
+		_cd_trigram_index_unmap(index);
+		cf_file_close(index->file);
+		cc_string_destroy(index->file_path);
+		free(index);
+	}
+}
+
+uint64_t cd_table_trigram_index_create(CD_Table *table, const char *attribute_name)
+{
+	CC_String cc_attrib_name = cc_string_create(attribute_name, 0);
+	const uint64_t *index_ptr = cc_hash_map_lookup(table->schema->attribute_indices, cc_attrib_name);
+	cc_string_destroy(cc_attrib_name);
+
+	if (index_ptr == NULL)
+	{
+		_cd_make_error(CD_ERROR_ATTRIBUTE_DOES_NOT_EXIST, "Attribute '%s' does not exist in table '%s'", attribute_name, table->name.data);
+		return 0;
+	}
+
+	const CD_AttributeEx *attribute = table->schema->attributes + *index_ptr;
+	if (_cd_text_unit_size(attribute->type) == 0)
+	{
+		_cd_make_error(CD_ERROR_UNKNOWN_TYPE, "Attribute '%s' of table '%s' is not a text attribute and can not have a trigram index", attribute_name, table->name.data);
+		return 0;
+	}
+
+	uint64_t return_value = 1;
+
+	// the index is built next to running selects, they start using it once it is complete
+	_cd_mutex_lock(table->writer_lock);
+	if (table->trigram_indices[*index_ptr] == NULL)
+	{
+		CD_TrigramIndex *index = _cd_trigram_index_open(table, *index_ptr);
+		if (index != NULL)
+		{
+			_cd_rwlock_write_lock(table->lock);
+			table->trigram_indices[*index_ptr] = index;
+			_cd_rwlock_write_unlock(table->lock);
+		}
+		return_value = index != NULL;
+	}
+	_cd_mutex_unlock(table->writer_lock);
+
+	return return_value;
+}
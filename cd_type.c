@@ -130,6 +130,248 @@ uint64_t _cd_equal_WVARCHAR(const void *data1, const void *data2, uint64_t count
 	return 1;
 }
 
+// compare: < 0 if data1 is smaller, 0 if equal, > 0 if data1 is bigger
+
+const _cd_func_compare _cd_funcs_compare[] =
+{
+	_cd_compare_BYTE,
+	_cd_compare_UINT,
+	_cd_compare_SINT,
+	_cd_compare_FLOAT,
+	_cd_compare_CHAR,
+	_cd_compare_WCHAR,
+	_cd_compare_VARCHAR,
+	_cd_compare_WVARCHAR
+};
+
+int64_t _cd_compare_BYTE(const void *data1, const void *data2, uint64_t count)
+{
+	const uint8_t *bytes1 = data1;
+	const uint8_t *bytes2 = data2;
+	for(uint64_t i = 0; i < count; i++)
+	{
+		if(bytes1[i] != bytes2[i])
+		{
+			return bytes1[i] < bytes2[i] ? -1 : 1;
+		}
+	}
+	return 0;
+}
+
+int64_t _cd_compare_UINT(const void *data1, const void *data2, uint64_t count)
+{
+	const uint64_t *nr_ptr1 = data1;
+	const uint64_t *nr_ptr2 = data2;
+	for(uint64_t i = 0; i < count; i++)
+	{
+		if(nr_ptr1[i] != nr_ptr2[i])
+		{
+			return nr_ptr1[i] < nr_ptr2[i] ? -1 : 1;
+		}
+	}
+	return 0;
+}
+
+int64_t _cd_compare_SINT(const void *data1, const void *data2, uint64_t count)
+{
+	const int64_t *nr_ptr1 = data1;
+	const int64_t *nr_ptr2 = data2;
+	for(uint64_t i = 0; i < count; i++)
+	{
+		if(nr_ptr1[i] != nr_ptr2[i])
+		{
+			return nr_ptr1[i] < nr_ptr2[i] ? -1 : 1;
+		}
+	}
+	return 0;
+}
+
+int64_t _cd_compare_FLOAT(const void *data1, const void *data2, uint64_t count)
+{
+	const double *nr_ptr1 = data1;
+	const double *nr_ptr2 = data2;
+	for(uint64_t i = 0; i < count; i++)
+	{
+		if(nr_ptr1[i] < nr_ptr2[i])
+		{
+			return -1;
+		}
+		if(nr_ptr1[i] > nr_ptr2[i])
+		{
+			return 1;
+		}
+	}
+	return 0;
+}
+
+int64_t _cd_compare_CHAR(const void *data1, const void *data2, uint64_t count)
+{
+	return _cd_compare_BYTE(data1, data2, count);
+}
+
+int64_t _cd_compare_WCHAR(const void *data1, const void *data2, uint64_t count)
+{
+	const wchar_t *nr_ptr1 = data1;
+	const wchar_t *nr_ptr2 = data2;
+	for(uint64_t i = 0; i < count; i++)
+	{
+		if(nr_ptr1[i] != nr_ptr2[i])
+		{
+			return nr_ptr1[i] < nr_ptr2[i] ? -1 : 1;
+		}
+	}
+	return 0;
+}
+
+int64_t _cd_compare_VARCHAR(const void *data1, const void *data2, uint64_t count)
+{
+	const uint8_t *iter1 = data1;
+	const uint8_t *iter2 = data2;
+	for(uint64_t i = 0; i < count; i++)
+	{
+		if(iter1[i] != iter2[i])
+		{
+			return iter1[i] < iter2[i] ? -1 : 1;
+		}
+		if(iter1[i] == 0)
+		{
+			break;
+		}
+	}
+	return 0;
+}
+
+int64_t _cd_compare_WVARCHAR(const void *data1, const void *data2, uint64_t count)
+{
+	const wchar_t *iter1 = data1;
+	const wchar_t *iter2 = data2;
+	for(uint64_t i = 0; i < count; i++)
+	{
+		if(iter1[i] != iter2[i])
+		{
+			return iter1[i] < iter2[i] ? -1 : 1;
+		}
+		if(iter1[i] == 0)
+		{
+			break;
+		}
+	}
+	return 0;
+}
+
+// contains: data holds needle (needle_length units) somewhere in its text
+
+const _cd_func_contains _cd_funcs_contains[] =
+{
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	_cd_contains_CHAR,
+	_cd_contains_WCHAR,
+	_cd_contains_VARCHAR,
+	_cd_contains_WVARCHAR
+};
+
+uint64_t _cd_contains_CHAR(const void *data, uint64_t count, const void *needle, uint64_t needle_length)
+{
+	return _cd_find_bytes(data, count, needle, needle_length);
+}
+
+uint64_t _cd_contains_WCHAR(const void *data, uint64_t count, const void *needle, uint64_t needle_length)
+{
+	const wchar_t *text = data;
+	const wchar_t *wneedle = needle;
+	for(uint64_t i = 0; i + needle_length <= count; i++)
+	{
+		if(memcmp(text + i, wneedle, needle_length * sizeof(wchar_t)) == 0)
+		{
+			return 1;
+		}
+	}
+	return 0;
+}
+
+uint64_t _cd_contains_VARCHAR(const void *data, uint64_t count, const void *needle, uint64_t needle_length)
+{
+	return _cd_find_bytes(data, _cd_text_length(CD_TYPE_VARCHAR, data, count), needle, needle_length);
+}
+
+uint64_t _cd_contains_WVARCHAR(const void *data, uint64_t count, const void *needle, uint64_t needle_length)
+{
+	return _cd_contains_WCHAR(data, _cd_text_length(CD_TYPE_WVARCHAR, data, count), needle, needle_length);
+}
+
+uint64_t _cd_text_unit_size(CD_AttributeType type)
+{
+	switch (type)
+	{
+	case CD_TYPE_CHAR:
+	case CD_TYPE_VARCHAR:
+		return sizeof(char);
+	case CD_TYPE_WCHAR:
+	case CD_TYPE_WVARCHAR:
+		return sizeof(wchar_t);
+	default:
+		return 0;
+	}
+}
+
+uint64_t _cd_attribute_stored_size(const CD_AttributeEx *attribute)
+{
+	switch (attribute->encoding)
+	{
+	case CD_ENCODING_DICTIONARY:
+		return sizeof(uint64_t);
+	case CD_ENCODING_HEAP:
+		return sizeof(_CD_HeapValue);
+	default:
+		return attribute->size;
+	}
+}
+
+uint64_t _cd_text_length(CD_AttributeType type, const void *data, uint64_t count)
+{
+	switch (type)
+	{
+	case CD_TYPE_VARCHAR:
+	{
+		const char *end = memchr(data, 0, count);
+		return end == NULL ? count : (uint64_t)(end - (const char *)data);
+	}
+	case CD_TYPE_WVARCHAR:
+	{
+		const wchar_t *text = data;
+		uint64_t length = 0;
+		while(length < count && text[length] != 0)
+		{
+			length++;
+		}
+		return length;
+	}
+	default:
+		return count;
+	}
+}
+
+uint64_t _cd_text_size(CD_AttributeType type, const void *data, uint64_t size)
+{
+	if (type != CD_TYPE_VARCHAR && type != CD_TYPE_WVARCHAR)
+	{
+		return size;
+	}
+
+	static const uint8_t zero[sizeof(wchar_t)] = { 0 };
+	uint64_t unit_size = _cd_text_unit_size(type);
+
+	uint64_t length = 0;
+	while (length + unit_size <= size && memcmp((const uint8_t *)data + length, zero, unit_size) != 0)
+	{
+		length += unit_size;
+	}
+	return length;
+}
+
 uint64_t cd_attribute_type_size(CD_AttributeType type)
 {
 	switch (type)
@@ -0,0 +1,763 @@
+#include "internal.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// the log holds whole records back to back. an insert is logged with the rows it writes and where, a batch of vacuum
+// moves with the rows it moves and the count it leaves, so replaying them again and again gives the same table. a
+// checkpoint syncs the tables and empties the log
+
+static CC_String _cd_wal_path(CD_Database *db)
+{
+	CC_StringBuffer *buffer = cc_string_buffer_create(CD_NAME_LENGTH);
+	cc_string_buffer_insert_string(buffer, db->name);
+	cc_string_buffer_insert_char(buffer, '/');
+	cc_string_buffer_insert_string(buffer, db->name);
+	CC_String file_extension = cc_string_create(".wal", 0);
+	cc_string_buffer_insert_string(buffer, file_extension);
+	cc_string_destroy(file_extension);
+
+	return cc_string_buffer_to_string_and_destroy(buffer);
+}
+
+static uint64_t _cd_stream_sync(FILE *file)
+{
+	if (fflush(file) != 0)
+	{
+		return 0;
+	}
+#ifdef _WIN32
+	return _commit(_fileno(file)) == 0;
+#else
+	return fsync(fileno(file)) == 0;
+#endif
+}
+
+// writes the changes of the file at path, made through any mapping of it, to disk
+static uint64_t _cd_file_sync(CC_String path)
+{
+#ifdef _WIN32
+	HANDLE handle = CreateFileA(path.data, GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (handle == INVALID_HANDLE_VALUE)
+	{
+		return 0;
+	}
+	uint64_t is_synced = FlushFileBuffers(handle) != 0;
+	CloseHandle(handle);
+	return is_synced;
+#else
+	int descriptor = open(path.data, O_RDWR);
+	if (descriptor < 0)
+	{
+		return 0;
+	}
+	uint64_t is_synced = fsync(descriptor) == 0;
+	close(descriptor);
+	return is_synced;
+#endif
+}
+
+// mutex must be locked
+static void _cd_wal_sync_path_add(CD_Wal *wal, CC_String path)
+{
+	for (uint64_t i = 0; i < wal->sync_path_count; i++)
+	{
+		if (strcmp(wal->sync_paths[i].data, path.data) == 0)
+		{
+			return;
+		}
+	}
+
+	wal->sync_paths = realloc(wal->sync_paths, sizeof(*wal->sync_paths) * (wal->sync_path_count + 1));
+	wal->sync_paths[wal->sync_path_count++] = cc_string_create(path.data, 0);
+}
+
+static void _cd_wal_table_sync_paths_add(CD_Wal *wal, CD_Table *table)
+{
+	_cd_wal_sync_path_add(wal, table->file_path);
+	if (table->tombstones != NULL)
+	{
+		_cd_wal_sync_path_add(wal, table->tombstones->file_path);
+	}
+	// rows that are synced need the values of their codes and the heap values they refer to
+	for (uint64_t attrib_index = 0; attrib_index < cc_hash_map_count(table->schema->attribute_indices); attrib_index++)
+	{
+		if (table->dictionaries[attrib_index] != NULL)
+		{
+			_cd_wal_sync_path_add(wal, table->dictionaries[attrib_index]->file_path);
+		}
+	}
+	if (table->heap != NULL)
+	{
+		_cd_wal_sync_path_add(wal, table->heap->file_path);
+	}
+}
+
+// writes the records logged before lsn to the file and syncs it. the first thread to get here writes the records
+// of every thread, threads that come while it writes wait for it and then write what was logged meanwhile together.
+// mutex must be locked
+static uint64_t _cd_wal_sync_locked(CD_Wal *wal, uint64_t lsn)
+{
+	while (wal->synced_lsn < lsn)
+	{
+		if (wal->is_failed)
+		{
+			_cd_make_error(CD_ERROR_FILE, "An earlier write to log file '%s' failed", wal->file_path.data);
+			return 0;
+		}
+
+		if (wal->is_syncing)
+		{
+			_cd_condition_wait(wal->synced, wal->mutex);
+			continue;
+		}
+
+		uint8_t *buffer = wal->buffer;
+		uint64_t buffer_capacity = wal->buffer_capacity;
+		uint64_t size = wal->buffer_size;
+		uint64_t end_lsn = wal->next_lsn;
+
+		wal->buffer = wal->write_buffer;
+		wal->buffer_capacity = wal->write_buffer_capacity;
+		wal->buffer_size = 0;
+		wal->is_syncing = 1;
+
+		_cd_mutex_unlock(wal->mutex);
+		uint64_t is_written = fwrite(buffer, 1, size, wal->file) == size && _cd_stream_sync(wal->file);
+		_cd_mutex_lock(wal->mutex);
+
+		wal->write_buffer = buffer;
+		wal->write_buffer_capacity = buffer_capacity;
+		wal->is_syncing = 0;
+		_cd_condition_broadcast(wal->synced);
+
+		if (!is_written)
+		{
+			wal->is_failed = 1;
+			_cd_make_error(CD_ERROR_FILE, "Failed to write %llu bytes to log file '%s'", size, wal->file_path.data);
+			return 0;
+		}
+
+		wal->file_size += size;
+		wal->synced_lsn = end_lsn;
+	}
+
+	return 1;
+}
+
+// the rows counted by count_c were published after their records were logged, so they are in the synced records once
+// the log is synced. mutex must be locked
+static uint64_t _cd_wal_table_count_write(CD_Wal *wal, CD_Table *table)
+{
+	_cd_rwlock_read_lock(table->lock);
+	uint64_t is_written = cf_file_view_write(table->count_view, offsetof(_CD_File_RowCount, count_c), sizeof(table->count.count_c), &table->count.count_c);
+	_cd_rwlock_read_unlock(table->lock);
+	if (!is_written)
+	{
+		_cd_make_error(CD_ERROR_FILE, "Failed to write count_c %llu for table %s", table->count.count_c, table->name.data);
+		return 0;
+	}
+	return 1;
+}
+
+// index of table in count_tables, count_table_count if it is not there. mutex must be locked
+static uint64_t _cd_wal_count_table_find(CD_Wal *wal, CD_Table *table)
+{
+	uint64_t t = 0;
+	while (t < wal->count_table_count && wal->count_tables[t] != table)
+	{
+		t++;
+	}
+	return t;
+}
+
+// mutex must be locked
+static uint64_t _cd_wal_checkpoint_locked(CD_Wal *wal)
+{
+	// rows of a logged insert that are not written yet would be missing from the synced tables, and every record
+	// has to be on disk. the mutex is let go while waiting or syncing, so all of it is checked again afterwards
+	for (;;)
+	{
+		if (wal->writing_count != 0)
+		{
+			_cd_condition_wait(wal->written, wal->mutex);
+		}
+		else if (wal->is_syncing)
+		{
+			_cd_condition_wait(wal->synced, wal->mutex);
+		}
+		else if (wal->file != NULL && wal->synced_lsn < wal->next_lsn)
+		{
+			if (!_cd_wal_sync_locked(wal, wal->next_lsn))
+			{
+				return 0;
+			}
+		}
+		else
+		{
+			break;
+		}
+	}
+
+	// the counts are synced with the rows of their tables
+	for (uint64_t t = 0; t < wal->count_table_count; t++)
+	{
+		if (!_cd_wal_table_count_write(wal, wal->count_tables[t]))
+		{
+			return 0;
+		}
+	}
+	free(wal->count_tables);
+	wal->count_tables = NULL;
+	wal->count_table_count = 0;
+
+	for (uint64_t i = 0; i < wal->sync_path_count; i++)
+	{
+		if (!_cd_file_sync(wal->sync_paths[i]))
+		{
+			_cd_make_error(CD_ERROR_FILE, "Failed to sync file '%s' for a checkpoint of log file '%s'", wal->sync_paths[i].data, wal->file_path.data);
+			return 0;
+		}
+		cc_string_destroy(wal->sync_paths[i]);
+	}
+	free(wal->sync_paths);
+	wal->sync_paths = NULL;
+	wal->sync_path_count = 0;
+
+	// every logged insert is in the synced tables now
+	if (wal->file != NULL)
+	{
+		fclose(wal->file);
+	}
+	wal->file = fopen(wal->file_path.data, "wb");
+	if (wal->file == NULL || !_cd_stream_sync(wal->file))
+	{
+		wal->is_failed = 1;
+		_cd_make_error(CD_ERROR_FILE, "Failed to empty log file '%s'", wal->file_path.data);
+		return 0;
+	}
+	wal->file_size = 0;
+
+	return 1;
+}
+
+// rebuilds every index of a table that had rows replayed, they may not have been synced with the rows
+static uint64_t _cd_wal_table_reindex(CD_Table *table)
+{
+	uint64_t attribute_count = cc_hash_map_count(table->schema->attribute_indices);
+	for (uint64_t attrib_index = 0; attrib_index < attribute_count; attrib_index++)
+	{
+		if (table->unique_indices[attrib_index] != NULL && !_cd_hash_index_rebuild(table, table->unique_indices[attrib_index]))
+		{
+			return 0;
+		}
+		if (table->trigram_indices[attrib_index] != NULL && !_cd_trigram_index_rebuild(table, table->trigram_indices[attrib_index]))
+		{
+			return 0;
+		}
+		if (table->btree_indices[attrib_index] != NULL && !_cd_btree_index_rebuild(table, table->btree_indices[attrib_index]))
+		{
+			return 0;
+		}
+		if (table->bloom_filters[attrib_index] != NULL && !_cd_bloom_filter_rebuild(table, table->bloom_filters[attrib_index], table->count.count_c))
+		{
+			return 0;
+		}
+	}
+	if (table->zone_map != NULL && !_cd_zone_map_rebuild(table, table->zone_map))
+	{
+		return 0;
+	}
+	return 1;
+}
+
+// the table a record was logged for, opened once for the whole replay
+static CD_Table *_cd_wal_replay_table(CD_Database *db, const char *table_name, CD_Table ***tables, uint64_t *table_count)
+{
+	for (uint64_t t = 0; t < *table_count; t++)
+	{
+		if (strcmp((*tables)[t]->name.data, table_name) == 0)
+		{
+			return (*tables)[t];
+		}
+	}
+
+	CD_Table *table = cd_table_open(db, table_name);
+	if (table != NULL)
+	{
+		*tables = realloc(*tables, sizeof(**tables) * (*table_count + 1));
+		(*tables)[(*table_count)++] = table;
+	}
+	return table;
+}
+
+static uint64_t _cd_wal_replay_insert(CD_Wal *wal, CD_Database *db, const uint8_t *payload, uint64_t size, CD_Table ***tables, uint64_t *table_count)
+{
+	_CD_File_WalInsert header;
+	if (size < sizeof(header))
+	{
+		_cd_make_error(CD_ERROR_FILE, "Insert record of %llu bytes is too short in log file '%s'", size, wal->file_path.data);
+		return 0;
+	}
+	memcpy(&header, payload, sizeof(header));
+	header.table_name[CD_NAME_LENGTH - 1] = '\0';
+
+	if (size != sizeof(header) + header.attribute_count * sizeof(uint64_t) + header.row_count * header.data_stride)
+	{
+		_cd_make_error(CD_ERROR_FILE, "Insert record into table '%s' has the wrong size in log file '%s'", header.table_name, wal->file_path.data);
+		return 0;
+	}
+
+	CD_Table *table = _cd_wal_replay_table(db, header.table_name, tables, table_count);
+	if (table == NULL)
+	{
+		return 0;
+	}
+
+	uint64_t table_attribute_count = cc_hash_map_count(table->schema->attribute_indices);
+	const char **attribute_names = malloc(sizeof(*attribute_names) * header.attribute_count);
+	for (uint64_t i = 0; i < header.attribute_count; i++)
+	{
+		uint64_t table_attrib_index;
+		memcpy(&table_attrib_index, payload + sizeof(header) + i * sizeof(uint64_t), sizeof(table_attrib_index));
+		if (table_attrib_index >= table_attribute_count)
+		{
+			_cd_make_error(CD_ERROR_ATTRIBUTE_DOES_NOT_EXIST, "Insert record into table '%s' has attribute %llu which does not exist. log file: '%s'", header.table_name, table_attrib_index, wal->file_path.data);
+			free(attribute_names);
+			return 0;
+		}
+		attribute_names[i] = table->schema->attributes[table_attrib_index].name;
+	}
+
+	CD_PreparedInsert *insert = cd_table_insert_prepare(table, header.attribute_count, attribute_names);
+	free(attribute_names);
+	if (insert == NULL)
+	{
+		return 0;
+	}
+
+	const uint8_t *data = payload + sizeof(header) + header.attribute_count * sizeof(uint64_t);
+	uint64_t is_replayed = _cd_prepared_insert_redo(insert, header.first_row, header.row_count, data);
+
+	cd_prepared_insert_destroy(insert);
+
+	_cd_wal_table_sync_paths_add(wal, table);
+
+	return is_replayed;
+}
+
+static uint64_t _cd_wal_replay_vacuum(CD_Wal *wal, CD_Database *db, const uint8_t *payload, uint64_t size, CD_Table ***tables, uint64_t *table_count)
+{
+	_CD_File_WalVacuum header;
+	if (size < sizeof(header))
+	{
+		_cd_make_error(CD_ERROR_FILE, "Vacuum record of %llu bytes is too short in log file '%s'", size, wal->file_path.data);
+		return 0;
+	}
+	memcpy(&header, payload, sizeof(header));
+	header.table_name[CD_NAME_LENGTH - 1] = '\0';
+
+	if (size != sizeof(header) + header.move_count * (sizeof(uint64_t) + header.row_size))
+	{
+		_cd_make_error(CD_ERROR_FILE, "Vacuum record of table '%s' has the wrong size in log file '%s'", header.table_name, wal->file_path.data);
+		return 0;
+	}
+
+	CD_Table *table = _cd_wal_replay_table(db, header.table_name, tables, table_count);
+	if (table == NULL)
+	{
+		return 0;
+	}
+	if (header.row_size != table->schema->stride)
+	{
+		_cd_make_error(CD_ERROR_FILE, "Vacuum record of table '%s' has rows of %llu bytes instead of %llu in log file '%s'", header.table_name, header.row_size, table->schema->stride, wal->file_path.data);
+		return 0;
+	}
+
+	// the holes are copied out, the payload need not be aligned for them
+	uint64_t *holes = malloc(sizeof(*holes) * header.move_count);
+	memcpy(holes, payload + sizeof(header), sizeof(*holes) * header.move_count);
+	const uint8_t *rows = payload + sizeof(header) + sizeof(*holes) * header.move_count;
+	uint64_t is_replayed = _cd_table_vacuum_redo(table, header.move_count, holes, rows, header.count_c);
+	free(holes);
+
+	_cd_wal_table_sync_paths_add(wal, table);
+
+	return is_replayed;
+}
+
+// applies the records of the log file, up to the first one that was not written whole
+static uint64_t _cd_wal_replay(CD_Wal *wal, CD_Database *db)
+{
+	FILE *file = fopen(wal->file_path.data, "rb");
+	if (file == NULL)
+	{
+		return 1;
+	}
+
+	uint64_t return_value = 0;
+
+	fseek(file, 0, SEEK_END);
+	uint64_t file_size = (uint64_t)ftell(file);
+	fseek(file, 0, SEEK_SET);
+
+	CD_Table **tables = NULL;
+	uint64_t table_count = 0;
+	uint8_t *record_data = NULL;
+
+	for (uint64_t offset = 0;;)
+	{
+		_CD_File_WalRecord record;
+		if (file_size - offset < sizeof(record) || fread(&record, sizeof(record), 1, file) != 1)
+		{
+			break;
+		}
+		if (record.size > file_size - offset - sizeof(record) || (offset != 0 && record.lsn != wal->next_lsn))
+		{
+			break;
+		}
+
+		record_data = realloc(record_data, sizeof(record) + record.size);
+		memcpy(record_data, &record, sizeof(record));
+		if (fread(record_data + sizeof(record), 1, record.size, file) != record.size)
+		{
+			break;
+		}
+		if (_cd_hash(record_data + sizeof(record.checksum), sizeof(record) - sizeof(record.checksum) + record.size) != record.checksum)
+		{
+			break;
+		}
+
+		if (record.type == CD_WAL_RECORD_INSERT && !_cd_wal_replay_insert(wal, db, record_data + sizeof(record), record.size, &tables, &table_count))
+		{
+			goto tables_close;
+		}
+		if (record.type == CD_WAL_RECORD_VACUUM && !_cd_wal_replay_vacuum(wal, db, record_data + sizeof(record), record.size, &tables, &table_count))
+		{
+			goto tables_close;
+		}
+
+		offset += sizeof(record) + record.size;
+		wal->next_lsn = record.lsn + 1;
+	}
+	wal->synced_lsn = wal->next_lsn;
+
+	for (uint64_t t = 0; t < table_count; t++)
+	{
+		if (!_cd_wal_table_reindex(tables[t]))
+		{
+			goto tables_close;
+		}
+	}
+
+	return_value = 1;
+
+tables_close:
+	for (uint64_t t = 0; t < table_count; t++)
+	{
+		cd_table_close(tables[t]);
+	}
+	free(tables);
+	free(record_data);
+	fclose(file);
+	return return_value;
+}
+
+CD_Wal *_cd_wal_open(CD_Database *db)
+{
+	CD_Wal *wal = malloc(sizeof(*wal));
+
+	wal->file_path = _cd_wal_path(db);
+	wal->file = NULL;
+	wal->durability = CD_DURABILITY_BATCHED;
+	wal->mutex = _cd_mutex_create();
+	wal->synced = _cd_condition_create();
+	wal->written = _cd_condition_create();
+	wal->buffer = NULL;
+	wal->buffer_size = 0;
+	wal->buffer_capacity = 0;
+	wal->write_buffer = NULL;
+	wal->write_buffer_capacity = 0;
+	wal->next_lsn = 0;
+	wal->synced_lsn = 0;
+	wal->is_syncing = 0;
+	wal->is_failed = 0;
+	wal->file_size = 0;
+	wal->writing_count = 0;
+	wal->sync_path_count = 0;
+	wal->sync_paths = NULL;
+	wal->count_table_count = 0;
+	wal->count_tables = NULL;
+
+	if (!_cd_wal_replay(wal, db))
+	{
+		goto wal_close;
+	}
+
+	// the replayed rows are synced before the log is emptied
+	_cd_mutex_lock(wal->mutex);
+	uint64_t is_checkpointed = _cd_wal_checkpoint_locked(wal);
+	_cd_mutex_unlock(wal->mutex);
+	if (!is_checkpointed)
+	{
+		goto wal_close;
+	}
+
+	return wal;
+
+wal_close:
+	// leave the log for the next open
+	wal->is_failed = 1;
+	_cd_wal_close(wal);
+	return NULL;
+}
+
+void _cd_wal_close(CD_Wal *wal)
+{
+	if (wal != NULL)
+	{
+		if (!wal->is_failed)
+		{
+			_cd_wal_checkpoint(wal);
+		}
+		if (wal->file != NULL)
+		{
+			fclose(wal->file);
+		}
+		for (uint64_t i = 0; i < wal->sync_path_count; i++)
+		{
+			cc_string_destroy(wal->sync_paths[i]);
+		}
+		free(wal->sync_paths);
+		free(wal->count_tables);
+		free(wal->write_buffer);
+		free(wal->buffer);
+		_cd_condition_destroy(wal->written);
+		_cd_condition_destroy(wal->synced);
+		_cd_mutex_destroy(wal->mutex);
+		cc_string_destroy(wal->file_path);
+		free(wal);
+	}
+}
+
+uint64_t _cd_wal_durability_set(CD_Wal *wal, uint64_t durability)
+{
+	if (durability > CD_DURABILITY_COMMIT)
+	{
+		_cd_make_error(CD_ERROR_UNKNOWN_TYPE, "Durability %llu is not recognized. log file: '%s'", durability, wal->file_path.data);
+		return 0;
+	}
+
+	_cd_mutex_lock(wal->mutex);
+
+	// inserts that are not logged can not have logged inserts replayed over them
+	uint64_t return_value = 1;
+	if (durability == CD_DURABILITY_NONE && wal->durability != CD_DURABILITY_NONE)
+	{
+		return_value = _cd_wal_checkpoint_locked(wal);
+	}
+	if (return_value)
+	{
+		wal->durability = durability;
+	}
+
+	_cd_mutex_unlock(wal->mutex);
+
+	return return_value;
+}
+
+// appends a record of type with a payload of size bytes to the buffer and returns where the payload goes, NULL when
+// nothing is logged. the mutex is left locked for _cd_wal_record_end
+static uint8_t *_cd_wal_record_begin(CD_Wal *wal, uint64_t type, uint64_t size)
+{
+	_cd_mutex_lock(wal->mutex);
+
+	wal->writing_count++;
+
+	if (wal->durability == CD_DURABILITY_NONE)
+	{
+		return NULL;
+	}
+
+	_CD_File_WalRecord record;
+	record.checksum = 0;
+	record.size = size;
+	record.lsn = wal->next_lsn++;
+	record.type = type;
+
+	uint64_t record_size = sizeof(record) + size;
+	if (wal->buffer_size + record_size > wal->buffer_capacity)
+	{
+		wal->buffer_capacity = wal->buffer_capacity * 2 > wal->buffer_size + record_size ? wal->buffer_capacity * 2 : wal->buffer_size + record_size;
+		wal->buffer = realloc(wal->buffer, wal->buffer_capacity);
+	}
+
+	uint8_t *record_data = wal->buffer + wal->buffer_size;
+	memcpy(record_data, &record, sizeof(record));
+	return record_data + sizeof(record);
+}
+
+// checksums the record begun last once its payload is filled in and lets go of the mutex
+static void _cd_wal_record_end(CD_Wal *wal, CD_Table *table, const uint8_t *payload)
+{
+	if (payload != NULL)
+	{
+		_CD_File_WalRecord record;
+		uint8_t *record_data = wal->buffer + wal->buffer_size;
+		memcpy(&record, record_data, sizeof(record));
+
+		uint64_t record_size = sizeof(record) + record.size;
+		record.checksum = _cd_hash(record_data + sizeof(record.checksum), record_size - sizeof(record.checksum));
+		memcpy(record_data, &record.checksum, sizeof(record.checksum));
+
+		wal->buffer_size += record_size;
+
+		_cd_wal_table_sync_paths_add(wal, table);
+	}
+
+	_cd_mutex_unlock(wal->mutex);
+}
+
+uint64_t _cd_wal_log_insert(CD_Wal *wal, CD_Table *table, uint64_t attribute_count, const _CD_ProjectedAttribute *attributes, uint64_t data_stride, uint64_t first_row, uint64_t row_count, const void *data)
+{
+	_CD_File_WalInsert header;
+	memset(header.table_name, 0, CD_NAME_LENGTH);
+	strcpy_s(header.table_name, CD_NAME_LENGTH, table->name.data);
+	header.first_row = first_row;
+	header.row_count = row_count;
+	header.attribute_count = attribute_count;
+	header.data_stride = data_stride;
+
+	uint8_t *payload = _cd_wal_record_begin(wal, CD_WAL_RECORD_INSERT, sizeof(header) + attribute_count * sizeof(uint64_t) + row_count * data_stride);
+	if (payload != NULL)
+	{
+		uint8_t *next = payload;
+		memcpy(next, &header, sizeof(header));
+		next += sizeof(header);
+		for (uint64_t i = 0; i < attribute_count; i++, next += sizeof(uint64_t))
+		{
+			memcpy(next, &attributes[i].table_index, sizeof(uint64_t));
+		}
+		memcpy(next, data, row_count * data_stride);
+	}
+	_cd_wal_record_end(wal, table, payload);
+
+	return 1;
+}
+
+uint64_t _cd_wal_log_vacuum(CD_Wal *wal, CD_Table *table, uint64_t move_count, const uint64_t *holes, const void *rows, uint64_t count_c)
+{
+	_CD_File_WalVacuum header;
+	memset(header.table_name, 0, CD_NAME_LENGTH);
+	strcpy_s(header.table_name, CD_NAME_LENGTH, table->name.data);
+	header.move_count = move_count;
+	header.row_size = table->schema->stride;
+	header.count_c = count_c;
+
+	uint8_t *payload = _cd_wal_record_begin(wal, CD_WAL_RECORD_VACUUM, sizeof(header) + move_count * (sizeof(uint64_t) + header.row_size));
+	if (payload != NULL)
+	{
+		memcpy(payload, &header, sizeof(header));
+		memcpy(payload + sizeof(header), holes, move_count * sizeof(uint64_t));
+		memcpy(payload + sizeof(header) + move_count * sizeof(uint64_t), rows, move_count * header.row_size);
+	}
+	_cd_wal_record_end(wal, table, payload);
+
+	return 1;
+}
+
+uint64_t _cd_wal_commit(CD_Wal *wal)
+{
+	_cd_mutex_lock(wal->mutex);
+
+	if (--wal->writing_count == 0)
+	{
+		_cd_condition_broadcast(wal->written);
+	}
+
+	uint64_t return_value = 1;
+	if (wal->durability == CD_DURABILITY_COMMIT || (wal->durability == CD_DURABILITY_BATCHED && wal->buffer_size >= CD_WAL_BATCH_SIZE))
+	{
+		return_value = _cd_wal_sync_locked(wal, wal->next_lsn);
+	}
+
+	_cd_mutex_unlock(wal->mutex);
+
+	return return_value;
+}
+
+uint64_t _cd_wal_count_write(CD_Wal *wal, CD_Table *table)
+{
+	_cd_mutex_lock(wal->mutex);
+
+	// a count written before the records of its rows are synced would count rows a crash loses
+	uint64_t return_value = 1;
+	if (wal->durability == CD_DURABILITY_NONE || wal->synced_lsn == wal->next_lsn)
+	{
+		return_value = _cd_wal_table_count_write(wal, table);
+	}
+	else if (_cd_wal_count_table_find(wal, table) == wal->count_table_count)
+	{
+		wal->count_tables = realloc(wal->count_tables, sizeof(*wal->count_tables) * (wal->count_table_count + 1));
+		wal->count_tables[wal->count_table_count++] = table;
+	}
+
+	_cd_mutex_unlock(wal->mutex);
+
+	return return_value;
+}
+
+void _cd_wal_table_release(CD_Wal *wal, CD_Table *table)
+{
+	_cd_mutex_lock(wal->mutex);
+
+	if (_cd_wal_count_table_find(wal, table) < wal->count_table_count)
+	{
+		// the count is left as it is when the log can not be synced; a checkpoint may write it while the log is synced
+		uint64_t is_synced = _cd_wal_sync_locked(wal, wal->next_lsn);
+		uint64_t t = _cd_wal_count_table_find(wal, table);
+		if (t < wal->count_table_count)
+		{
+			if (is_synced)
+			{
+				_cd_wal_table_count_write(wal, table);
+			}
+			wal->count_tables[t] = wal->count_tables[--wal->count_table_count];
+		}
+	}
+
+	_cd_mutex_unlock(wal->mutex);
+}
+
+uint64_t _cd_wal_sync(CD_Wal *wal)
+{
+	_cd_mutex_lock(wal->mutex);
+	uint64_t return_value = _cd_wal_sync_locked(wal, wal->next_lsn);
+	_cd_mutex_unlock(wal->mutex);
+	return return_value;
+}
+
+uint64_t _cd_wal_checkpoint(CD_Wal *wal)
+{
+	_cd_mutex_lock(wal->mutex);
+	uint64_t return_value = _cd_wal_checkpoint_locked(wal);
+	_cd_mutex_unlock(wal->mutex);
+	return return_value;
+}
+
+uint64_t _cd_wal_checkpoint_if_full(CD_Wal *wal)
+{
+	_cd_mutex_lock(wal->mutex);
+	uint64_t return_value = 1;
+	if (wal->file_size + wal->buffer_size >= CD_WAL_CHECKPOINT_SIZE)
+	{
+		return_value = _cd_wal_checkpoint_locked(wal);
+	}
+	_cd_mutex_unlock(wal->mutex);
+	return return_value;
+}
@@ -0,0 +1,495 @@
+#include "internal.h"
+
+// the file holds the header followed by one entry per block of CD_ZONE_BLOCK_ROWS rows. an entry holds, for every zoned
+// attribute, a flag set once the block has a value, the smallest and the largest value. the entries are kept in memory
+// and the changed ones are written through. zones only ever widen until a vacuum drops whole blocks, so they may be
+// wider than the values left but never narrower
+
+// the zone of an attribute: the flag, then min and max, each padded to 8 bytes so numbers can be compared in place
+#define CD_ZONE_VALUE_SIZE(size) (((size) + 7) / 8 * 8)
+#define CD_ZONE_SIZE(size) (sizeof(uint64_t) + 2 * CD_ZONE_VALUE_SIZE(size))
+
+static CC_String _cd_zone_map_path(CD_Table *table)
+{
+	CC_StringBuffer *buffer = cc_string_buffer_create(CD_NAME_LENGTH);
+	cc_string_buffer_insert_string(buffer, table->db->name);
+	cc_string_buffer_insert_char(buffer, '/');
+	cc_string_buffer_insert_string(buffer, table->name);
+	CC_String file_extension = cc_string_create(".zones", 0);
+	cc_string_buffer_insert_string(buffer, file_extension);
+	cc_string_destroy(file_extension);
+
+	return cc_string_buffer_to_string_and_destroy(buffer);
+}
+
+// the order of these types is total, so min and max bound every value. FLOAT arrays are left out, a NaN inside one
+// makes the order of the arrays depend on the elements after it
+static uint64_t _cd_zone_map_is_zoned(const CD_AttributeEx *attribute)
+{
+	switch (attribute->type)
+	{
+	case CD_TYPE_BYTE:
+	case CD_TYPE_UINT:
+	case CD_TYPE_SINT:
+	case CD_TYPE_CHAR:
+		return 1;
+	case CD_TYPE_FLOAT:
+		return attribute->count == 1;
+	default:
+		return 0;
+	}
+}
+
+uint64_t _cd_zone_map_has_attributes(const CD_TableSchema *schema)
+{
+	uint64_t attribute_count = cc_hash_map_count(schema->attribute_indices);
+	for (uint64_t attrib_index = 0; attrib_index < attribute_count; attrib_index++)
+	{
+		if (_cd_zone_map_is_zoned(schema->attributes + attrib_index))
+		{
+			return 1;
+		}
+	}
+	return 0;
+}
+
+static uint64_t _cd_zone_map_map(CD_ZoneMap *zone_map)
+{
+	zone_map->header_view = cf_file_view_open(zone_map->file, 0, sizeof(zone_map->header));
+	if (zone_map->header_view == NULL)
+	{
+		_cd_make_error(CD_ERROR_FILE, "Failed to open header view of file '%s'", zone_map->file_path.data);
+		return 0;
+	}
+
+	zone_map->entry_view = cf_file_view_open(zone_map->file, sizeof(zone_map->header), zone_map->header.block_count_m * zone_map->header.entry_size);
+	if (zone_map->entry_view == NULL)
+	{
+		_cd_make_error(CD_ERROR_FILE, "Failed to open entry view of file '%s'", zone_map->file_path.data);
+		return 0;
+	}
+
+	return 1;
+}
+
+static void _cd_zone_map_unmap(CD_ZoneMap *zone_map)
+{
+	if (zone_map->entry_view != NULL)
+	{
+		cf_file_view_close(zone_map->entry_view);
+		zone_map->entry_view = NULL;
+	}
+	if (zone_map->header_view != NULL)
+	{
+		cf_file_view_close(zone_map->header_view);
+		zone_map->header_view = NULL;
+	}
+}
+
+// makes the file hold at least block_count entries, new entries are empty
+static uint64_t _cd_zone_map_reserve(CD_ZoneMap *zone_map, uint64_t block_count)
+{
+	if (block_count <= zone_map->header.block_count_m)
+	{
+		return 1;
+	}
+
+	uint64_t old_block_count = zone_map->header.block_count_m;
+	uint64_t new_block_count = old_block_count * 2;
+	if (new_block_count < block_count)
+	{
+		new_block_count = block_count;
+	}
+
+	_cd_zone_map_unmap(zone_map);
+
+	uint64_t entry_size = zone_map->header.entry_size;
+	if (!cf_file_resize(zone_map->file, sizeof(zone_map->header) + new_block_count * entry_size))
+	{
+		_cd_make_error(CD_ERROR_FILE, "Failed to resize file '%s'", zone_map->file_path.data);
+		return 0;
+	}
+
+	zone_map->entries = realloc(zone_map->entries, new_block_count * entry_size);
+	memset(zone_map->entries + old_block_count * entry_size, 0, (new_block_count - old_block_count) * entry_size);
+	zone_map->header.block_count_m = new_block_count;
+
+	if (!_cd_zone_map_map(zone_map))
+	{
+		return 0;
+	}
+
+	// the file may not hand back zeroed space
+	if (!cf_file_view_write(zone_map->entry_view, old_block_count * entry_size, (new_block_count - old_block_count) * entry_size, zone_map->entries + old_block_count * entry_size))
+	{
+		_cd_make_error(CD_ERROR_FILE, "Failed to write entries of file '%s'", zone_map->file_path.data);
+		return 0;
+	}
+
+	return _cd_zone_map_commit(zone_map);
+}
+
+static void _cd_zone_map_dirty(CD_ZoneMap *zone_map, uint64_t block)
+{
+	if (block < zone_map->dirty_begin)
+	{
+		zone_map->dirty_begin = block;
+	}
+	if (block + 1 > zone_map->dirty_end)
+	{
+		zone_map->dirty_end = block + 1;
+	}
+}
+
+// widens the zone of the attribute at table index attribute_index in block by row_count values stride bytes apart
+static void _cd_zone_map_widen(CD_ZoneMap *zone_map, uint64_t attribute_index, uint64_t block, const uint8_t *values, uint64_t stride, uint64_t row_count)
+{
+	const CD_AttributeEx *attribute = zone_map->attributes + attribute_index;
+	_cd_func_compare func_compare = _cd_funcs_compare[attribute->type];
+
+	uint8_t *zone = zone_map->entries + block * zone_map->header.entry_size + zone_map->zone_offsets[attribute_index];
+	uint64_t *is_set = (uint64_t *)zone;
+	uint8_t *min = zone + sizeof(uint64_t);
+	uint8_t *max = min + CD_ZONE_VALUE_SIZE(attribute->size);
+
+	uint64_t is_changed = 0;
+	for (uint64_t row = 0; row < row_count; row++, values += stride)
+	{
+		// a NaN matches no EQUALS, BIGGER or SMALLER condition, so it has no place in the zone. values of the caller are
+		// packed, they are copied before they are read
+		if (attribute->type == CD_TYPE_FLOAT)
+		{
+			CD_float_t value;
+			memcpy(&value, values, sizeof(value));
+			if (value != value)
+			{
+				continue;
+			}
+		}
+
+		if (!*is_set)
+		{
+			memcpy(min, values, attribute->size);
+			memcpy(max, values, attribute->size);
+			*is_set = 1;
+			is_changed = 1;
+		}
+		else if (func_compare(values, min, attribute->count) < 0)
+		{
+			memcpy(min, values, attribute->size);
+			is_changed = 1;
+		}
+		else if (func_compare(values, max, attribute->count) > 0)
+		{
+			memcpy(max, values, attribute->size);
+			is_changed = 1;
+		}
+	}
+
+	if (is_changed)
+	{
+		_cd_zone_map_dirty(zone_map, block);
+	}
+}
+
+uint64_t _cd_zone_map_insert(CD_ZoneMap *zone_map, uint64_t attribute_index, const void *values, uint64_t stride, uint64_t row, uint64_t row_count)
+{
+	if (zone_map->zone_offsets[attribute_index] == UINT64_MAX || row_count == 0)
+	{
+		return 1;
+	}
+
+	uint64_t end_row = row + row_count;
+	if (!_cd_zone_map_reserve(zone_map, (end_row + CD_ZONE_BLOCK_ROWS - 1) / CD_ZONE_BLOCK_ROWS))
+	{
+		return 0;
+	}
+
+	const uint8_t *block_values = values;
+	while (row < end_row)
+	{
+		uint64_t block = row / CD_ZONE_BLOCK_ROWS;
+		uint64_t block_end_row = (block + 1) * CD_ZONE_BLOCK_ROWS;
+		uint64_t rows = (block_end_row < end_row ? block_end_row : end_row) - row;
+
+		_cd_zone_map_widen(zone_map, attribute_index, block, block_values, stride, rows);
+
+		block_values += rows * stride;
+		row += rows;
+	}
+
+	if (end_row > zone_map->header.row_count)
+	{
+		zone_map->header.row_count = end_row;
+	}
+	return 1;
+}
+
+void _cd_zone_map_truncate(CD_ZoneMap *zone_map, uint64_t row_count)
+{
+	uint64_t entry_size = zone_map->header.entry_size;
+
+	// blocks that only held rows past the end start empty when rows come back, the block at the end keeps its zones
+	uint64_t first_block = (row_count + CD_ZONE_BLOCK_ROWS - 1) / CD_ZONE_BLOCK_ROWS;
+	uint64_t end_block = (zone_map->header.row_count + CD_ZONE_BLOCK_ROWS - 1) / CD_ZONE_BLOCK_ROWS;
+	if (end_block > zone_map->header.block_count_m)
+	{
+		end_block = zone_map->header.block_count_m;
+	}
+	if (first_block < end_block)
+	{
+		memset(zone_map->entries + first_block * entry_size, 0, (end_block - first_block) * entry_size);
+		_cd_zone_map_dirty(zone_map, first_block);
+		_cd_zone_map_dirty(zone_map, end_block - 1);
+	}
+
+	zone_map->header.row_count = row_count;
+}
+
+uint64_t _cd_zone_map_commit(CD_ZoneMap *zone_map)
+{
+	uint64_t entry_size = zone_map->header.entry_size;
+	if (zone_map->dirty_begin < zone_map->dirty_end)
+	{
+		uint64_t offset = zone_map->dirty_begin * entry_size;
+		if (!cf_file_view_write(zone_map->entry_view, offset, (zone_map->dirty_end - zone_map->dirty_begin) * entry_size, zone_map->entries + offset))
+		{
+			_cd_make_error(CD_ERROR_FILE, "Failed to write entries of file '%s'", zone_map->file_path.data);
+			return 0;
+		}
+		zone_map->dirty_begin = UINT64_MAX;
+		zone_map->dirty_end = 0;
+	}
+
+	if (!cf_file_view_write(zone_map->header_view, 0, sizeof(zone_map->header), &zone_map->header))
+	{
+		_cd_make_error(CD_ERROR_FILE, "Failed to write header of file '%s'", zone_map->file_path.data);
+		return 0;
+	}
+	return 1;
+}
+
+uint64_t _cd_zone_map_rebuild(CD_Table *table, CD_ZoneMap *zone_map)
+{
+	uint64_t return_value = 0;
+
+	uint64_t entry_size = zone_map->header.entry_size;
+	memset(zone_map->entries, 0, zone_map->header.block_count_m * entry_size);
+	zone_map->header.row_count = 0;
+	zone_map->dirty_begin = 0;
+	zone_map->dirty_end = zone_map->header.block_count_m;
+
+	uint64_t count_c = table->count.count_c;
+	uint64_t attribute_count = cc_hash_map_count(table->schema->attribute_indices);
+
+	// one block of one attribute at a time
+	uint64_t column_size = 0;
+	for (uint64_t attrib_index = 0; attrib_index < attribute_count; attrib_index++)
+	{
+		if (zone_map->zone_offsets[attrib_index] != UINT64_MAX && zone_map->attributes[attrib_index].size > column_size)
+		{
+			column_size = zone_map->attributes[attrib_index].size;
+		}
+	}
+	uint8_t *column = malloc(CD_ZONE_BLOCK_ROWS * column_size);
+
+	for (uint64_t row = 0; row < count_c; row += CD_ZONE_BLOCK_ROWS)
+	{
+		uint64_t rows = count_c - row < CD_ZONE_BLOCK_ROWS ? count_c - row : CD_ZONE_BLOCK_ROWS;
+		for (uint64_t attrib_index = 0; attrib_index < attribute_count; attrib_index++)
+		{
+			const CD_AttributeEx *attribute = zone_map->attributes + attrib_index;
+			if (zone_map->zone_offsets[attrib_index] == UINT64_MAX)
+			{
+				continue;
+			}
+
+			if (!_cd_table_values_read(table, attribute, row, rows, column) || !_cd_zone_map_insert(zone_map, attrib_index, column, attribute->size, row, rows))
+			{
+				goto column_free;
+			}
+		}
+	}
+
+	zone_map->header.row_count = count_c;
+	return_value = _cd_zone_map_commit(zone_map);
+
+column_free:
+	free(column);
+	return return_value;
+}
+
+CD_ZoneMap *_cd_zone_map_open(CD_Table *table)
+{
+	uint64_t attribute_count = cc_hash_map_count(table->schema->attribute_indices);
+
+	CD_ZoneMap *zone_map = malloc(sizeof(*zone_map));
+	zone_map->file_path = _cd_zone_map_path(table);
+	zone_map->attributes = table->schema->attributes;
+	zone_map->zone_offsets = malloc(sizeof(*zone_map->zone_offsets) * attribute_count);
+	zone_map->entries = NULL;
+	zone_map->dirty_begin = UINT64_MAX;
+	zone_map->dirty_end = 0;
+	zone_map->file = NULL;
+	zone_map->header_view = NULL;
+	zone_map->entry_view = NULL;
+
+	uint64_t entry_size = 0;
+	for (uint64_t attrib_index = 0; attrib_index < attribute_count; attrib_index++)
+	{
+		zone_map->zone_offsets[attrib_index] = UINT64_MAX;
+		if (_cd_zone_map_is_zoned(table->schema->attributes + attrib_index))
+		{
+			zone_map->zone_offsets[attrib_index] = entry_size;
+			entry_size += CD_ZONE_SIZE(table->schema->attributes[attrib_index].size);
+		}
+	}
+
+	zone_map->header.row_count = 0;
+	zone_map->header.block_rows = CD_ZONE_BLOCK_ROWS;
+	zone_map->header.block_count_m = 0;
+	zone_map->header.entry_size = entry_size;
+
+	uint64_t is_new = 0;
+	if (!cf_file_exists(zone_map->file_path))
+	{
+		if (!cf_file_create(zone_map->file_path, sizeof(zone_map->header)))
+		{
+			_cd_make_error(CD_ERROR_FILE, "Failed to create file '%s'", zone_map->file_path.data);
+			goto zone_map_close;
+		}
+		is_new = 1;
+	}
+
+	zone_map->file = cf_file_open(zone_map->file_path);
+	if (zone_map->file == NULL)
+	{
+		_cd_make_error(CD_ERROR_FILE, "Failed to open file '%s'", zone_map->file_path.data);
+		goto zone_map_close;
+	}
+
+	uint64_t rebuild = is_new;
+	if (!is_new)
+	{
+		_CD_File_ZoneMap header;
+		CF_FileView *header_view = cf_file_view_open(zone_map->file, 0, sizeof(header));
+		if (header_view == NULL || !cf_file_view_read(header_view, 0, sizeof(header), &header))
+		{
+			_cd_make_error(CD_ERROR_FILE, "Failed to read header of file '%s'", zone_map->file_path.data);
+			if (header_view != NULL)
+			{
+				cf_file_view_close(header_view);
+			}
+			goto zone_map_close;
+		}
+		cf_file_view_close(header_view);
+
+		// zones that may not cover the rows of the table are built again
+		if (header.row_count != table->count.count_c || header.block_rows != CD_ZONE_BLOCK_ROWS || header.entry_size != entry_size || cf_file_size_get(zone_map->file) < sizeof(header) + header.block_count_m * entry_size)
+		{
+			rebuild = 1;
+		}
+		else
+		{
+			zone_map->header = header;
+		}
+	}
+
+	if (rebuild)
+	{
+		// the file keeps its size, only the header says how much of it is used
+		if (!_cd_zone_map_reserve(zone_map, CD_ZONE_BLOCKS_START) || !_cd_zone_map_rebuild(table, zone_map))
+		{
+			goto zone_map_close;
+		}
+		return zone_map;
+	}
+
+	if (!_cd_zone_map_map(zone_map))
+	{
+		goto zone_map_close;
+	}
+
+	zone_map->entries = malloc(zone_map->header.block_count_m * entry_size);
+	if (!cf_file_view_read(zone_map->entry_view, 0, zone_map->header.block_count_m * entry_size, zone_map->entries))
+	{
+		_cd_make_error(CD_ERROR_FILE, "Failed to read entries of file '%s'", zone_map->file_path.data);
+		goto zone_map_close;
+	}
+
+	return zone_map;
+
+zone_map_close:
+	_cd_zone_map_close(zone_map);
+	return NULL;
+}
+
+void _cd_zone_map_close(CD_ZoneMap *zone_map)
+{
+	if (zone_map != NULL)
+	{
+		_cd_zone_map_unmap(zone_map);
+		if (zone_map->file != NULL)
+		{
+			cf_file_close(zone_map->file);
+		}
+		free(zone_map->entries);
+		free(zone_map->zone_offsets);
+		cc_string_destroy(zone_map->file_path);
+		free(zone_map);
+	}
+}
+
+uint64_t _cd_zone_map_rules_out(const CD_ZoneMap *zone_map, uint64_t attribute_index, uint64_t operator, const void *value, uint64_t row, uint64_t row_count)
+{
+	if (zone_map->zone_offsets[attribute_index] == UINT64_MAX)
+	{
+		return 0;
+	}
+	if (operator != CD_CONDITION_OPERATOR_EQUALS && operator != CD_CONDITION_OPERATOR_BIGGER && operator != CD_CONDITION_OPERATOR_SMALLER)
+	{
+		return 0;
+	}
+
+	const CD_AttributeEx *attribute = zone_map->attributes + attribute_index;
+	_cd_func_compare func_compare = _cd_funcs_compare[attribute->type];
+
+	uint64_t end_block = (row + row_count + CD_ZONE_BLOCK_ROWS - 1) / CD_ZONE_BLOCK_ROWS;
+	if (row + row_count > zone_map->header.row_count || end_block > zone_map->header.block_count_m)
+	{
+		return 0;
+	}
+
+	// every block the rows touch has to be ruled out
+	for (uint64_t block = row / CD_ZONE_BLOCK_ROWS; block < end_block; block++)
+	{
+		const uint8_t *zone = zone_map->entries + block * zone_map->header.entry_size + zone_map->zone_offsets[attribute_index];
+		const uint8_t *min = zone + sizeof(uint64_t);
+		const uint8_t *max = min + CD_ZONE_VALUE_SIZE(attribute->size);
+
+		// a block without values may still hold NaNs, which match nothing either; it is read anyway
+		if (!*(const uint64_t *)zone)
+		{
+			return 0;
+		}
+
+		uint64_t is_ruled_out;
+		switch (operator)
+		{
+		case CD_CONDITION_OPERATOR_EQUALS:
+			is_ruled_out = func_compare(value, min, attribute->count) < 0 || func_compare(value, max, attribute->count) > 0;
+			break;
+		case CD_CONDITION_OPERATOR_BIGGER:
+			is_ruled_out = func_compare(max, value, attribute->count) <= 0;
+			break;
+		default:
+			is_ruled_out = func_compare(min, value, attribute->count) >= 0;
+			break;
+		}
+		if (!is_ruled_out)
+		{
+			return 0;
+		}
+	}
+	return 1;
+}
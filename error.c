@@ -1,9 +1,14 @@
 #include "internal.h"
 
-#define ERROR_STRING_SIZE ((uint64_t)1024)
+#ifdef _MSC_VER
+#define CD_THREAD_LOCAL __declspec(thread)
+#else
+#define CD_THREAD_LOCAL _Thread_local
+#endif
 
-uint64_t _cd_error_type = 0;
-char _cd_error_message[ERROR_STRING_SIZE];
+// every thread has its own last error
+static CD_THREAD_LOCAL uint64_t _cd_error_type = 0;
+static CD_THREAD_LOCAL char _cd_error_message[CD_ERROR_MESSAGE_SIZE];
 
 CD_Error cd_get_last_error()
 {
@@ -25,7 +30,19 @@ void _cd_make_error(uint64_t error_type, const char *format, ...)
 	va_list args;
 	va_start(args, format);
 
-	vsprintf_s(_cd_error_message, ERROR_STRING_SIZE, format, args);
+	vsprintf_s(_cd_error_message, CD_ERROR_MESSAGE_SIZE, format, args);
 
 	va_end(args);
-}
\ No newline at end of file
+}
+
+void _cd_error_save(_CD_ErrorState *state)
+{
+	state->error_type = _cd_error_type;
+	memcpy(state->message, _cd_error_message, CD_ERROR_MESSAGE_SIZE);
+}
+
+void _cd_error_restore(const _CD_ErrorState *state)
+{
+	_cd_error_type = state->error_type;
+	memcpy(_cd_error_message, state->message, CD_ERROR_MESSAGE_SIZE);
+}
@@ -4,6 +4,8 @@
 #include "c_db.h"
 
 #include <stdarg.h>
+#include <stddef.h>
+#include <wchar.h>
 
 // file data structs
 typedef struct _CD_File_TableSchema
@@ -11,10 +13,43 @@ typedef struct _CD_File_TableSchema
 	char name[CD_NAME_LENGTH];
 	uint64_t attrib_count_c;
 	uint64_t attrib_count_m;
+	uint64_t storage;
+	uint64_t page_rows; // rows of one page of a PAX table, 0 for row storage
 } _CD_File_TableSchema;
 
 #define CD_ROW_COUNT_START 32
 
+#define CD_GROWTH_FACTOR_DEFAULT 2.0
+#define CD_GROWTH_MAX_STEP_DEFAULT (1 << 20)
+
+// bytes of rows assembled in memory before they are written to the table file
+#define CD_INSERT_CHUNK_SIZE (64 * 1024)
+// bytes of rows read from the table file at once while scanning
+#define CD_SCAN_CHUNK_SIZE (64 * 1024)
+// rows of a cursor batch when none are given
+#define CD_CURSOR_BATCH_ROWS_DEFAULT 1024
+// chunks a scan thread takes at once
+#define CD_MORSEL_CHUNKS 16
+// rows a vacuum moves each time it holds the lock of the table
+#define CD_VACUUM_BATCH_MOVES 256
+// bytes of one page of a PAX table; a page holds the values of each attribute for its rows back to back
+#define CD_PAX_PAGE_SIZE (64 * 1024)
+// bytes the hash table of a GROUP BY may use when none are given
+#define CD_GROUP_BY_MEMORY_BUDGET_DEFAULT (64 * 1024 * 1024)
+// groups the hash table of a GROUP BY starts with before it grows towards its budget
+#define CD_GROUP_BY_GROUPS_INITIAL 1024
+// rows of groups that do not fit the budget are split in spill files by the next CD_GROUP_BY_PARTITION_BITS bits of their hash
+#define CD_GROUP_BY_PARTITION_BITS 4
+#define CD_GROUP_BY_PARTITIONS (1 << CD_GROUP_BY_PARTITION_BITS)
+// levels of spilling; the groups of the rows spilled at the last level are kept in memory whatever the budget
+#define CD_GROUP_BY_SPILL_LEVELS 8
+// bytes of rows buffered per spill file before they are written
+#define CD_GROUP_BY_SPILL_BUFFER_SIZE (16 * 1024)
+// bytes of an error message, including the terminator
+#define CD_ERROR_MESSAGE_SIZE 1024
+// tables a database keeps open when none is given
+#define CD_TABLE_CACHE_SIZE_DEFAULT 64
+
 typedef struct _CD_File_RowCount
 {
 	uint64_t count_c;
@@ -27,18 +62,347 @@ typedef struct _CD_File_Attribute
 	uint64_t type;
 	uint64_t count;
 	uint64_t constraints;
+	uint64_t indices; // CD_INDEX_* of the indices registered for the attribute
+	uint64_t encoding;
 } _CD_File_Attribute;
 
+#define CD_INDEX_BTREE 0b1
+
+typedef struct _CD_File_HashIndex
+{
+	uint64_t bucket_count;
+	uint64_t entry_count; // also counts the entries left behind by deleted and updated rows
+	uint64_t row_count; // rows of the table covered by the index
+} _CD_File_HashIndex;
+
+#define CD_HASH_INDEX_BUCKETS_START 64
+
+typedef struct _CD_File_TrigramIndex
+{
+	uint64_t row_count; // rows of the table covered by the index
+	uint64_t chunk_count_c;
+	uint64_t chunk_count_m;
+} _CD_File_TrigramIndex;
+
+#define CD_TRIGRAM_BUCKETS (1 << 16)
+#define CD_TRIGRAM_CHUNK_ROWS 15
+#define CD_TRIGRAM_CHUNKS_START 1024
+// posting lists intersected per query, the rest is left to the verification of the rows
+#define CD_TRIGRAM_QUERY_LISTS 4
+
+typedef struct _CD_File_BTreeIndex
+{
+	uint64_t row_count; // rows of the table covered by the index
+	uint64_t root;
+	uint64_t height; // levels including the leaves
+	uint64_t page_count_c;
+	uint64_t page_count_m;
+} _CD_File_BTreeIndex;
+
+#define CD_BTREE_PAGE_SIZE 4096
+#define CD_BTREE_PAGES_START 64
+#define CD_BTREE_HEIGHT_MAX 32
+// conditions matching more than 1 / CD_BTREE_SCAN_FRACTION of the rows are left to the scan
+#define CD_BTREE_SCAN_FRACTION 4
+
+typedef struct _CD_File_BloomFilter
+{
+	uint64_t row_count; // rows of the table covered by the filter
+	uint64_t capacity; // rows the filter is sized for, it is built again larger once the table has more
+	uint64_t block_count;
+	uint64_t hash_count; // bits set per value
+	CD_float_t false_positive_rate;
+} _CD_File_BloomFilter;
+
+#define CD_BLOOM_BLOCK_WORDS 8 // a block is one cache line
+#define CD_BLOOM_ROWS_START 4096
+#define CD_BLOOM_FALSE_POSITIVE_RATE 0.01
+#define CD_BLOOM_FALSE_POSITIVE_RATE_MIN 0.00001
+#define CD_BLOOM_FALSE_POSITIVE_RATE_MAX 0.5
+
+typedef struct _CD_File_Dictionary
+{
+	uint64_t value_count;
+	uint64_t value_size;
+} _CD_File_Dictionary;
+
+#define CD_DICTIONARY_VALUES_START 64
+
+typedef struct _CD_File_Heap
+{
+	uint64_t size; // bytes of values after the header
+} _CD_File_Heap;
+
+#define CD_HEAP_START (64 * 1024)
+#define CD_HEAP_INLINE_SIZE 15
+
+// a value of a heap encoded attribute as its row holds it: values of up to CD_HEAP_INLINE_SIZE bytes before the null
+// termination are held in place, null padded, longer ones are where they are in the heap. the zero value is held in place
+typedef struct _CD_HeapValue
+{
+	uint8_t bytes[CD_HEAP_INLINE_SIZE]; // the value, or the offset (a uint64_t) and the length (a uint32_t) of it in the heap
+	uint8_t is_reference;
+} _CD_HeapValue;
+
 // structs
+typedef uint64_t (*_cd_func_equal)(const void *data1, const void *data2, uint64_t count);
+typedef int64_t (*_cd_func_compare)(const void *data1, const void *data2, uint64_t count);
+typedef uint64_t (*_cd_func_contains)(const void *data, uint64_t count, const void *needle, uint64_t needle_length);
+// selection[row] &= (column[row] <operator> value) for row_count values of one attribute stored back to back
+typedef void (*_cd_func_kernel)(const void *column, uint64_t row_count, const void *value, uint8_t *selection);
+// *accumulator = *accumulator <function> column[row] for the row_count values of one attribute with selection[row] set
+typedef void (*_cd_func_reduce)(const void *column, uint64_t row_count, const uint8_t *selection, void *accumulator);
+
+typedef struct CD_HashIndex
+{
+	CC_String file_path;
+	uint64_t attribute_index;
+	void *buffer; // holds one attribute value read back from the table
+
+	_CD_File_HashIndex header;
+
+	CF_File *file;
+	CF_FileView *header_view;
+	CF_FileView *bucket_view;
+} CD_HashIndex;
+
+// buckets of a hash index built in memory from the rows of its table, swapped into the index file afterwards
+typedef struct _CD_HashIndexBuild
+{
+	_CD_File_HashIndex header;
+	void *buckets; // header.bucket_count buckets laid out as in the index file
+} _CD_HashIndexBuild;
+
+typedef struct CD_TrigramIndex
+{
+	CC_String file_path;
+	uint64_t attribute_index;
+	uint64_t type;
+	uint64_t count;
+
+	_CD_File_TrigramIndex header;
+
+	CF_File *file;
+	CF_FileView *header_view;
+	CF_FileView *bucket_view;
+	CF_FileView *chunk_view;
+} CD_TrigramIndex;
+
+typedef struct CD_BloomFilter
+{
+	CC_String file_path;
+	uint64_t attribute_index;
+	uint64_t type;
+	uint64_t count;
+	uint64_t size;
+
+	_CD_File_BloomFilter header;
+	uint64_t *words; // the blocks, kept in memory and written through
+	// blocks changed since the last commit
+	uint64_t dirty_begin;
+	uint64_t dirty_end;
+
+	CF_File *file;
+	CF_FileView *header_view;
+	CF_FileView *block_view;
+} CD_BloomFilter;
+
+// the distinct values of a dictionary encoded attribute; a row holds the code (a uint64_t) of its value. code 0 is the
+// zero value, so rows whose attribute was never written decode to it
+typedef struct CD_Dictionary
+{
+	CC_String file_path;
+	uint64_t attribute_index;
+	uint64_t type;
+	uint64_t count;
+	uint64_t size;
+
+	_CD_File_Dictionary header; // value_count is stored with release once a value is in values and in the file
+	uint64_t value_capacity;
+	uint8_t *values; // only reallocated while the writer holds the lock of the table exclusive
+	// code + 1 of the values by hash, 0 for an empty slot; only the writer uses them
+	uint64_t slot_count;
+	uint64_t *slots;
+	uint8_t *scratch; // one value made canonical
+
+	CF_File *file;
+	CF_FileView *header_view;
+	CF_FileView *value_view;
+} CD_Dictionary;
+
+// the values of the heap encoded attributes of a table that do not fit in their rows
+typedef struct CD_Heap
+{
+	CC_String file_path;
+
+	_CD_File_Heap header; // size is stored with release once a value is in the file
+	uint64_t capacity; // bytes of values the file has room for
+
+	CF_File *file;
+	CF_FileView *header_view;
+	CF_FileView *value_view; // only remapped while the writer holds the lock of the table exclusive
+} CD_Heap;
+
+typedef struct CD_BTreeIndex
+{
+	CC_String file_path;
+	uint64_t attribute_index;
+	uint64_t type;
+	uint64_t count;
+	uint64_t size;
+	uint64_t leaf_entry; // value and row
+	uint64_t node_entry; // value, row and child
+	uint64_t leaf_capacity;
+	uint64_t node_capacity;
+
+	_CD_File_BTreeIndex header;
+
+	CF_File *file;
+	CF_FileView *page_view;
+
+	// buffers of the writer, lookups of selects use their own
+	uint8_t *node;
+	uint8_t *split;
+	uint8_t *separator;
+} CD_BTreeIndex;
+
 typedef struct CD_TableSchema
 {
 	uint64_t stride;
+	uint64_t storage;
+	uint64_t page_rows; // 0 for row storage
+	uint64_t file_offset; // of the table in the schema file
+	uint64_t attribute_count;
+	// built by _cd_table_schema_materialize when the table is first opened, NULL until then
 	CC_HashMap *attribute_indices; // type(uint64_t)
 	CD_AttributeEx *attributes;
+	uint64_t *indices; // CD_INDEX_* for every attribute
 } CD_TableSchema;
 
+typedef struct _CD_File_Tombstones
+{
+	uint64_t deleted_count;
+	uint64_t word_count;
+} _CD_File_Tombstones;
+
+// deleted rows of a table, one bit per row
+typedef struct CD_Tombstones
+{
+	CC_String file_path;
+	_CD_File_Tombstones header;
+	uint64_t *words; // the bitmap, kept in memory and written through
+	uint64_t first_word; // no word before it has a bit set
+
+	CF_File *file;
+	CF_FileView *header_view;
+	CF_FileView *word_view;
+} CD_Tombstones;
+
+// zone maps
+#define CD_ZONE_BLOCK_ROWS 4096
+#define CD_ZONE_BLOCKS_START 64
+
+typedef struct _CD_File_ZoneMap
+{
+	uint64_t row_count; // rows the zones cover
+	uint64_t block_rows;
+	uint64_t block_count_m;
+	uint64_t entry_size;
+} _CD_File_ZoneMap;
+
+// smallest and largest value of every numeric and CHAR attribute per block of CD_ZONE_BLOCK_ROWS rows
+typedef struct CD_ZoneMap
+{
+	CC_String file_path;
+	_CD_File_ZoneMap header;
+	const CD_AttributeEx *attributes; // of the table
+	uint64_t *zone_offsets; // indexed by table attribute, in an entry; UINT64_MAX for attributes without a zone
+	uint8_t *entries; // kept in memory and written through
+	// blocks changed since the last commit
+	uint64_t dirty_begin;
+	uint64_t dirty_end;
+
+	CF_File *file;
+	CF_FileView *header_view;
+	CF_FileView *entry_view;
+} CD_ZoneMap;
+
+// write-ahead log
+#define CD_WAL_RECORD_INSERT 1
+#define CD_WAL_RECORD_VACUUM 2
+// with CD_DURABILITY_BATCHED the records are written and synced once this many bytes wait
+#define CD_WAL_BATCH_SIZE (1024 * 1024)
+// the log is checkpointed once it holds this many bytes
+#define CD_WAL_CHECKPOINT_SIZE (64 * 1024 * 1024)
+
+typedef struct _CD_File_WalRecord
+{
+	uint64_t checksum; // of the rest of the record, a record that does not match ends the log
+	uint64_t size; // bytes of the payload that follows
+	uint64_t lsn;
+	uint64_t type;
+} _CD_File_WalRecord;
+
+// payload of an insert: this header, attribute_count table attribute indices, then row_count rows of data_stride bytes
+typedef struct _CD_File_WalInsert
+{
+	char table_name[CD_NAME_LENGTH];
+	uint64_t first_row;
+	uint64_t row_count;
+	uint64_t attribute_count;
+	uint64_t data_stride;
+} _CD_File_WalInsert;
+
+// payload of a batch of vacuum moves: this header, move_count rows that are filled, then the move_count rows of
+// row_size bytes written to them, laid out as rows of the table
+typedef struct _CD_File_WalVacuum
+{
+	char table_name[CD_NAME_LENGTH];
+	uint64_t move_count;
+	uint64_t row_size;
+	uint64_t count_c; // rows of the table once the moved rows and the deleted rows at its end are dropped
+} _CD_File_WalVacuum;
+
+typedef struct CD_Mutex CD_Mutex;
+typedef struct CD_ConditionVariable CD_ConditionVariable;
+typedef struct CD_RwLock CD_RwLock;
+
+typedef struct CD_Wal
+{
+	CC_String file_path;
+	FILE *file;
+	uint64_t durability;
+
+	CD_Mutex *mutex;
+	CD_ConditionVariable *synced; // broadcast when a sync is done
+	CD_ConditionVariable *written; // broadcast when writing_count drops to 0
+
+	// records are appended to buffer, a sync swaps it with write_buffer so records can be appended while it writes
+	uint8_t *buffer;
+	uint64_t buffer_size;
+	uint64_t buffer_capacity;
+	uint8_t *write_buffer;
+	uint64_t write_buffer_capacity;
+
+	uint64_t next_lsn;
+	uint64_t synced_lsn; // records before it are on disk
+	uint64_t is_syncing;
+	uint64_t is_failed; // a write failed, the records of the buffer are lost
+	uint64_t file_size;
+	uint64_t writing_count; // inserts logged whose rows are not written yet, a checkpoint waits for them
+
+	// data files written by the logged inserts, synced by the next checkpoint
+	uint64_t sync_path_count;
+	CC_String *sync_paths;
+
+	// tables whose count_c in the file lags behind rows not synced yet, the next checkpoint writes it
+	uint64_t count_table_count;
+	CD_Table **count_tables;
+} CD_Wal;
+
 typedef struct CD_Table
 {
+	CD_Database *db;
 	CC_String name;
 	CC_String file_path;
 
@@ -51,8 +415,214 @@ typedef struct CD_Table
 	CF_File *file;
 	CF_FileView *count_view;
 	CF_FileView *data_view;
+
+	CD_GrowthPolicy growth;
+
+	// indexed by table attribute; NULL for attributes that are not UNIQUE
+	CD_HashIndex **unique_indices;
+	// indexed by table attribute; NULL for attributes without a trigram index
+	CD_TrigramIndex **trigram_indices;
+	// indexed by table attribute; NULL for attributes without a B+tree index
+	CD_BTreeIndex **btree_indices;
+
+	// indexed by table attribute; NULL for attributes without a Bloom filter
+	CD_BloomFilter **bloom_filters;
+	// indexed by table attribute; NULL for attributes that are not dictionary encoded
+	CD_Dictionary **dictionaries;
+	// NULL when no attribute is heap encoded
+	CD_Heap *heap;
+
+	// NULL until the first row is deleted; scans skip deleted rows and inserts reuse them
+	CD_Tombstones *tombstones;
+
+	// NULL when no attribute has a zone; scans skip blocks whose zones rule out a condition
+	CD_ZoneMap *zone_map;
+
+	// selects hold lock shared; the writer holds it exclusive while it remaps the data or changes indices, tombstones
+	// or count_c. writer_lock lets one writer in at a time, rows past count_c are written holding only it
+	CD_RwLock *lock;
+	CD_Mutex *writer_lock;
+	// changed with the lock held exclusive whenever rows below count_c change: deletes, updates, vacuums and inserts
+	// into deleted rows. open cursors check it between batches
+	uint64_t modification_count;
+
+	CD_Stats stats; // added to with relaxed atomics
+
+	// handle cache of the database, guarded by its table_lock
+	uint64_t reference_count; // cd_table_open calls not closed yet
+	CD_Table *idle_previous;
+	CD_Table *idle_next;
 } CD_Table;
 
+// attribute of a projection: where it is in the packed caller data and in a table row
+typedef struct _CD_ProjectedAttribute
+{
+	uint64_t data_offset;
+	uint64_t file_offset;
+	uint64_t size;
+	uint64_t table_index;
+	CD_Dictionary *dictionary; // NULL unless the attribute is dictionary encoded, the row then holds its code
+	CD_Heap *heap; // NULL unless the attribute is heap encoded, the row then holds a _CD_HeapValue
+} _CD_ProjectedAttribute;
+
+// rows of a batch written to deleted rows of a table
+typedef struct _CD_InsertRun
+{
+	uint64_t first_row;
+	uint64_t row_count;
+} _CD_InsertRun;
+
+typedef struct CD_PreparedInsert
+{
+	CD_Table *table;
+
+	uint64_t attribute_count;
+	_CD_ProjectedAttribute *attributes;
+	uint64_t data_stride;
+	uint64_t is_full_row; // the caller data has the layout of a table row
+
+	uint64_t unique_count;
+	uint64_t *unique_attributes; // indices into attributes of the UNIQUE attributes
+	uint64_t missing_unique_count;
+	uint64_t *missing_unique; // table indices of UNIQUE attributes that are stored zeroed
+	void *zero;
+
+	uint64_t *projection; // for every table attribute: index into attributes or attribute_count if it is not inserted
+
+	uint64_t chunk_rows;
+	uint8_t *chunk; // rows assembled before they are written, NULL when is_full_row; values of one attribute for PAX tables
+} CD_PreparedInsert;
+
+typedef struct _CD_PreparedCondition
+{
+	const CD_AttributeEx *attribute;
+	uint64_t operator;
+	_cd_func_equal func_equal;
+	_cd_func_compare func_compare;
+	_cd_func_contains func_contains;
+	_cd_func_kernel kernel; // NULL when the attribute has no kernel, rows are then compared one by one
+	const CD_Heap *heap; // NULL unless the attribute is heap encoded, values are then read one by one before they are compared
+	const void *data; // used when no data is passed on execution
+} _CD_PreparedCondition;
+
+// per execution state of a condition
+typedef struct _CD_ConditionScan
+{
+	const void *data;
+	uint64_t needle_length;
+	uint64_t *candidates; // sorted rows from the trigram index, NULL when every row is a candidate
+	uint64_t candidate_count;
+	uint64_t has_candidates; // candidates come from an index and rows outside of them are skipped
+	// dictionary encoded attributes: the code EQUALS compares to, or for the other operators whether the value of
+	// every code below code_count matches
+	uint64_t code;
+	uint8_t *code_matches;
+	uint64_t code_count;
+} _CD_ConditionScan;
+
+typedef struct _CD_PreparedAggregate
+{
+	const CD_AttributeEx *attribute; // NULL for COUNT
+	uint64_t function;
+	_cd_func_reduce func_reduce;
+} _CD_PreparedAggregate;
+
+// rows of groups that did not fit the hash table, written to a file of the database
+typedef struct _CD_SpillPartition
+{
+	CC_String file_path;
+	CF_File *file; // NULL until the first row is spilled
+	uint64_t row_count; // rows in the file
+	uint64_t buffered_count; // rows in buffer
+	uint8_t *buffer;
+} _CD_SpillPartition;
+
+// hash GROUP BY over the rows a select stages: the key attributes packed, then the values of the aggregates
+typedef struct _CD_GroupBy
+{
+	CD_Table *table;
+	uint64_t id; // names the spill files apart from those of other GROUP BYs running at the same time
+
+	uint64_t key_size; // bytes of the keys at the start of a staged row
+	uint64_t stride; // bytes of a staged row
+	uint64_t aggregate_count;
+	_CD_PreparedAggregate *aggregates;
+	uint64_t *value_offsets; // for every aggregate: offset of its value in a staged row
+
+	// open addressing table with linear probing; an entry is the row count (0 when empty), the hash, the accumulators and the keys
+	uint64_t entry_words; // uint64_t words of an entry
+	uint64_t capacity; // power of two, at most twice the groups
+	uint64_t capacity_max; // largest capacity in the budget
+	uint64_t group_count;
+	uint64_t *entries;
+
+	uint64_t level; // spill level of the rows grouped now, they spill to the partitions of this level
+	_CD_SpillPartition *partitions[CD_GROUP_BY_SPILL_LEVELS];
+	uint64_t spill_rows; // rows a spill buffer holds
+	uint8_t *spill_read; // spill_rows rows read back from a partition
+
+	CD_TableView *view; // one row per group
+} _CD_GroupBy;
+
+// buffers of one thread of a scan
+typedef struct _CD_ScanWorker
+{
+	uint8_t *chunk; // NULL for PAX tables, their attributes are read one at a time into column
+	uint8_t *column; // values of one attribute of a chunk back to back
+	uint8_t *value; // one value of a heap encoded condition attribute
+	uint8_t *selection; // one flag per row of the current chunk
+	uint64_t *cursors; // for every condition: first candidate not behind the current chunk
+	CD_TableView *view; // rows selected by this worker
+	uint64_t aggregate_rows; // rows this worker aggregated
+	uint64_t *accumulators; // for every aggregate: the value this worker reduced so far, a uint64_t/int64_t/double by type
+	CD_QueryTrace trace; // counters of this worker, moved to the trace of the select once the scan is done
+} _CD_ScanWorker;
+
+typedef struct CD_PreparedSelect
+{
+	CD_Table *table;
+
+	uint64_t attribute_count;
+	_CD_ProjectedAttribute *attributes;
+	CD_AttributeEx *view_attributes;
+	uint64_t data_stride;
+	uint64_t is_full_row;
+
+	uint64_t condition_count;
+	_CD_PreparedCondition *conditions;
+	_CD_ConditionScan *scans;
+
+	uint64_t chunk_rows; // a whole page for PAX tables
+	uint64_t column_size; // bytes per row of the column buffer of a worker
+	uint64_t value_size; // bytes of the value buffer of a worker
+
+	// when there are aggregates the selected rows are reduced into the accumulators of the workers instead of copied out
+	uint64_t aggregate_count;
+	_CD_PreparedAggregate *aggregates;
+	// when set the rows of every chunk are grouped and then dropped from the view
+	_CD_GroupBy *group_by;
+	// when set the view holds the table row (a uint64_t) of every selected row instead of its attributes
+	uint64_t is_row_numbers;
+
+	uint64_t thread_count; // 0 uses the thread count of the database
+	uint64_t worker_count;
+	_CD_ScanWorker *workers; // worker 0 runs on the calling thread
+
+	CD_QueryTrace trace; // of the last execution
+} CD_PreparedSelect;
+
+typedef struct CD_Cursor
+{
+	CD_PreparedSelect *select;
+	uint64_t is_select_owned; // opened by cd_table_cursor_open, destroyed with the cursor
+	uint64_t count_c; // rows of the table when the cursor was opened
+	uint64_t modification_count; // of the table when the cursor was opened
+	uint64_t row; // first row that was not scanned yet
+	uint64_t batch_rows;
+	uint64_t pending; // rows after the current batch that were already filtered
+	CD_TableView *view;
+} CD_Cursor;
+
 typedef struct CD_Database
 {
 	CC_String name;
@@ -60,12 +630,26 @@ typedef struct CD_Database
 
 	CC_HashMap *table_schemas; // type(CD_TableSchema)
 
+	// one handle per open table. handles nobody holds are idle, in the order they were closed; the first ones are
+	// closed while more than table_cache_size tables are open. table_lock guards them and the schemas
+	CD_Mutex *table_lock;
+	CC_HashMap *open_tables; // type(CD_Table *)
+	CD_Table *idle_first;
+	CD_Table *idle_last;
+	uint64_t table_cache_size;
+
 	CF_File *schema_file;
 	CF_FileView *schema_count_view;
+	uint8_t *schema_data; // the schema file as read on open, schemas of the tables are materialized from it
+
+	uint64_t thread_count; // threads of a scan
+
+	CD_Wal *wal;
+
+	CD_Stats stats; // the tables add to it with relaxed atomics
 } CD_Database;
 
 // type comparison
-typedef uint64_t (*_cd_func_equal)(const void *data1, const void *data2, uint64_t count);
 extern const _cd_func_equal _cd_funcs_equal[];
 
 uint64_t _cd_equal_BYTE(const void *data1, const void *data2, uint64_t count);
@@ -77,7 +661,290 @@ uint64_t _cd_equal_WCHAR(const void *data1, const void *data2, uint64_t count);
 uint64_t _cd_equal_VARCHAR(const void *data1, const void *data2, uint64_t count);
 uint64_t _cd_equal_WVARCHAR(const void *data1, const void *data2, uint64_t count);
 
+int64_t _cd_compare_BYTE(const void *data1, const void *data2, uint64_t count);
+int64_t _cd_compare_UINT(const void *data1, const void *data2, uint64_t count);
+int64_t _cd_compare_SINT(const void *data1, const void *data2, uint64_t count);
+int64_t _cd_compare_FLOAT(const void *data1, const void *data2, uint64_t count);
+int64_t _cd_compare_CHAR(const void *data1, const void *data2, uint64_t count);
+int64_t _cd_compare_WCHAR(const void *data1, const void *data2, uint64_t count);
+int64_t _cd_compare_VARCHAR(const void *data1, const void *data2, uint64_t count);
+int64_t _cd_compare_WVARCHAR(const void *data1, const void *data2, uint64_t count);
+
+extern const _cd_func_compare _cd_funcs_compare[];
+
+uint64_t _cd_contains_CHAR(const void *data, uint64_t count, const void *needle, uint64_t needle_length);
+uint64_t _cd_contains_WCHAR(const void *data, uint64_t count, const void *needle, uint64_t needle_length);
+uint64_t _cd_contains_VARCHAR(const void *data, uint64_t count, const void *needle, uint64_t needle_length);
+uint64_t _cd_contains_WVARCHAR(const void *data, uint64_t count, const void *needle, uint64_t needle_length);
+
+// NULL for types that are not text
+extern const _cd_func_contains _cd_funcs_contains[];
+
+// bytes of one character, 0 if type is not text
+uint64_t _cd_text_unit_size(CD_AttributeType type);
+// bytes a value of attribute takes in the table file
+uint64_t _cd_attribute_stored_size(const CD_AttributeEx *attribute);
+// characters before the null termination of VARCHAR/WVARCHAR, count for the other types
+uint64_t _cd_text_length(CD_AttributeType type, const void *data, uint64_t count);
+// bytes before the null termination of a VARCHAR/WVARCHAR value of size bytes, size for the other types
+uint64_t _cd_text_size(CD_AttributeType type, const void *data, uint64_t size);
+
+// predicate kernels
+#define CD_KERNEL_LEVEL_SCALAR 0
+#define CD_KERNEL_LEVEL_SSE2 1
+#define CD_KERNEL_LEVEL_AVX2 2
+
+// picks the kernels of level or of the best level the cpu supports below it; returns the level used
+uint64_t _cd_kernel_dispatch(uint64_t level);
+// picks the best kernels unless some were picked already
+void _cd_kernel_init();
+// NULL if there is no kernel for the attribute and operator
+_cd_func_kernel _cd_kernel_get(const CD_AttributeEx *attribute, uint64_t operator);
+// NULL if values of type have no reduction for the aggregate function; AVG uses the SUM reduction
+_cd_func_reduce _cd_reduce_get(uint64_t type, uint64_t function);
+void _cd_column_gather(const uint8_t *rows, uint64_t row_count, uint64_t stride, uint64_t size, uint8_t *column);
+uint64_t _cd_find_bytes(const uint8_t *text, uint64_t text_length, const uint8_t *needle, uint64_t needle_length);
+
+// threads
+typedef void (*_cd_func_thread)(void *argument);
+typedef struct CD_Thread CD_Thread;
+
+// NULL if the thread could not be started
+CD_Thread *_cd_thread_start(_cd_func_thread function, void *argument);
+// waits for the thread to finish and frees it
+void _cd_thread_join(CD_Thread *thread);
+CD_Mutex *_cd_mutex_create();
+void _cd_mutex_destroy(CD_Mutex *mutex);
+void _cd_mutex_lock(CD_Mutex *mutex);
+void _cd_mutex_unlock(CD_Mutex *mutex);
+CD_ConditionVariable *_cd_condition_create();
+void _cd_condition_destroy(CD_ConditionVariable *condition);
+// mutex must be locked, it is released while waiting
+void _cd_condition_wait(CD_ConditionVariable *condition, CD_Mutex *mutex);
+void _cd_condition_broadcast(CD_ConditionVariable *condition);
+CD_RwLock *_cd_rwlock_create();
+void _cd_rwlock_destroy(CD_RwLock *lock);
+void _cd_rwlock_read_lock(CD_RwLock *lock);
+void _cd_rwlock_read_unlock(CD_RwLock *lock);
+void _cd_rwlock_write_lock(CD_RwLock *lock);
+void _cd_rwlock_write_unlock(CD_RwLock *lock);
+// returns the value before the add
+uint64_t _cd_atomic_fetch_add(volatile uint64_t *value, uint64_t add);
+uint64_t _cd_atomic_load_acquire(const volatile uint64_t *value);
+void _cd_atomic_store_release(volatile uint64_t *value, uint64_t new_value);
+uint64_t _cd_cpu_count();
+// monotonic clock
+uint64_t _cd_time_ns();
+
+// table
+// offset in the data view of attribute of row
+uint64_t _cd_table_value_offset(const CD_TableSchema *schema, uint64_t row, const CD_AttributeEx *attribute);
+// values of attribute for rows [row, row + row_count) back to back, as stored: codes for dictionary encoded attributes,
+// _CD_HeapValues for heap encoded ones
+uint64_t _cd_table_column_read(CD_Table *table, const CD_AttributeEx *attribute, uint64_t row, uint64_t row_count, void *column);
+uint64_t _cd_table_column_write(CD_Table *table, const CD_AttributeEx *attribute, uint64_t row, uint64_t row_count, const void *column);
+// _cd_table_column_read with the values decoded, attribute must be one of the schema of the table
+uint64_t _cd_table_values_read(CD_Table *table, const CD_AttributeEx *attribute, uint64_t row, uint64_t row_count, void *values);
+// writes the value of attribute the stored value in a row stands for to value; the lock of the table must be held or the
+// caller must be the writer
+uint64_t _cd_table_value_decode(const CD_Table *table, const CD_AttributeEx *attribute, const void *stored_value, void *value);
+uint64_t _cd_table_capacity_next(CD_Table *table, uint64_t required);
+// writes the CD_INDEX_* flags of an attribute to the schema file
+uint64_t _cd_table_schema_indices_set(CD_Table *table, uint64_t attribute_index, uint64_t indices);
+// closes the files of a table and frees its handle
+void _cd_table_destroy(CD_Table *table);
+// closes the least recently closed idle tables while more tables than table_cache_size are open; db->table_lock must
+// be held
+void _cd_table_cache_trim(CD_Database *db);
+// builds the attributes of a schema read on open from db->schema_data, once; db->table_lock must be held
+void _cd_table_schema_materialize(CD_Database *db, CD_TableSchema *schema);
+// resizes the file to hold exactly count_m rows and remaps the data view; the lock of the table must be held exclusive
+uint64_t _cd_table_capacity_set(CD_Table *table, uint64_t count_m);
+// writes zeros to the rows from first_row to count_m when the growth policy preallocates, so later inserts do not fault
+// into holes of a sparse file. the rows are past count_c, only writer_lock has to be held
+uint64_t _cd_table_preallocate(CD_Table *table, uint64_t first_row);
+// 1 if the table has a tombstone for row
+uint64_t _cd_table_row_is_deleted(const CD_Table *table, uint64_t row);
+// adds every counter of add to the stats of the table and of its database
+void _cd_table_stats_add(CD_Table *table, const CD_Stats *add);
+// every field of CD_Stats is a uint64_t counter; these read, clear and add to them atomically one at a time
+CD_Stats _cd_stats_load(const CD_Stats *stats);
+void _cd_stats_clear(CD_Stats *stats);
+void _cd_stats_add(CD_Stats *stats, const CD_Stats *add);
+
+// table view
+CD_TableView *_cd_table_view_create_from(uint64_t attribute_count, const CD_AttributeEx *attributes, uint64_t stride);
+void *_cd_table_view_get_next_rows(CD_TableView *view, uint64_t row_count);
+
+// hash index
+uint64_t _cd_hash(const void *data, uint64_t size);
+
+CD_HashIndex *_cd_hash_index_open(CD_Table *table, uint64_t attribute_index);
+void _cd_hash_index_close(CD_HashIndex *index);
+uint64_t _cd_hash_index_rebuild(CD_Table *table, CD_HashIndex *index);
+// builds buckets for every row of the table without touching the index, so selects can use it meanwhile; the rows must
+// not change until the buckets are swapped in
+uint64_t _cd_hash_index_build(CD_Table *table, const CD_HashIndex *index, _CD_HashIndexBuild *build);
+// replaces the buckets of index with the built ones and frees them; selects must not use the index meanwhile
+uint64_t _cd_hash_index_swap(CD_HashIndex *index, _CD_HashIndexBuild *build);
+// adds the values of the table it compared to *compare_count
+uint64_t _cd_hash_index_find(CD_Table *table, CD_HashIndex *index, const void *value, uint64_t *row, uint64_t *compare_count);
+uint64_t _cd_hash_index_insert(CD_HashIndex *index, const void *value, uint64_t size, uint64_t row);
+// writes the header, call after changing the rows the index covers
+uint64_t _cd_hash_index_commit(CD_HashIndex *index);
+
+// trigram index
+uint64_t _cd_trigram_index_exists(CD_Table *table, uint64_t attribute_index);
+CD_TrigramIndex *_cd_trigram_index_open(CD_Table *table, uint64_t attribute_index);
+void _cd_trigram_index_close(CD_TrigramIndex *index);
+uint64_t _cd_trigram_index_rebuild(CD_Table *table, CD_TrigramIndex *index);
+// value NULL only moves the index past row
+uint64_t _cd_trigram_index_insert(CD_TrigramIndex *index, const void *value, uint64_t row);
+// writes the header, call after inserting so the index is known to cover the new rows
+uint64_t _cd_trigram_index_commit(CD_TrigramIndex *index);
+// rows (ascending, allocated) that may contain needle; needle_length must be at least 3
+uint64_t _cd_trigram_index_candidates(CD_TrigramIndex *index, const void *needle, uint64_t needle_length, uint64_t **rows, uint64_t *row_count);
+
+// B+tree index
+CD_BTreeIndex *_cd_btree_index_open(CD_Table *table, uint64_t attribute_index);
+void _cd_btree_index_close(CD_BTreeIndex *index);
+uint64_t _cd_btree_index_rebuild(CD_Table *table, CD_BTreeIndex *index);
+uint64_t _cd_btree_index_insert(CD_BTreeIndex *index, const void *value, uint64_t row);
+// writes the header, call after inserting so the index is known to cover the new rows
+uint64_t _cd_btree_index_commit(CD_BTreeIndex *index);
+// rows (ascending, allocated) whose value matches operator (EQUALS, BIGGER or SMALLER) and value;
+// is_over_limit is set and no rows are returned when more than limit rows match
+uint64_t _cd_btree_index_candidates(CD_BTreeIndex *index, uint64_t operator, const void *value, uint64_t limit, uint64_t **rows, uint64_t *row_count, uint64_t *is_over_limit);
+
+// Bloom filters
+uint64_t _cd_bloom_filter_exists(CD_Table *table, uint64_t attribute_index);
+// creates the file with false_positive_rate when it does not exist, builds the filter again when it does not cover the rows of the table
+CD_BloomFilter *_cd_bloom_filter_open(CD_Table *table, uint64_t attribute_index, CD_float_t false_positive_rate);
+void _cd_bloom_filter_close(CD_BloomFilter *filter);
+// adds the value of row, building the filter again larger once row is past its capacity
+uint64_t _cd_bloom_filter_insert(CD_Table *table, CD_BloomFilter *filter, const void *value, uint64_t row);
+// writes the changed blocks and the header, call after inserting so the filter is known to cover the new rows
+uint64_t _cd_bloom_filter_commit(CD_BloomFilter *filter);
+// sized for row_count rows and the growth after them, from the first row_count rows of the table
+uint64_t _cd_bloom_filter_rebuild(CD_Table *table, CD_BloomFilter *filter, uint64_t row_count);
+// 0 when no row has value, 1 when one may have it
+uint64_t _cd_bloom_filter_may_contain(const CD_BloomFilter *filter, const void *value);
+// _cd_bloom_filter_may_contain counting the probe and a negative answer into add
+uint64_t _cd_bloom_filter_probe(const CD_BloomFilter *filter, const void *value, CD_Stats *add);
+
+// dictionaries
+// creates the file when it does not exist
+CD_Dictionary *_cd_dictionary_open(CD_Table *table, uint64_t attribute_index);
+void _cd_dictionary_close(CD_Dictionary *dictionary);
+// code of value, adding it to the dictionary and its file when it is new. only the writer encodes, without holding
+// the lock of the table, which is taken to grow the values
+uint64_t _cd_dictionary_encode(CD_Table *table, CD_Dictionary *dictionary, const void *value, uint64_t *code);
+// value of code, the zero value for a code the dictionary does not have; the lock of the table must be held or the
+// caller must be the writer
+const void *_cd_dictionary_decode(const CD_Dictionary *dictionary, uint64_t code);
+// code of the value equal to value, UINT64_MAX if there is none
+uint64_t _cd_dictionary_find(const CD_Dictionary *dictionary, const void *value);
+// values of the dictionary, codes past it were added after it was loaded
+uint64_t _cd_dictionary_count(const CD_Dictionary *dictionary);
+
+// heap
+// creates the file when it does not exist
+CD_Heap *_cd_heap_open(CD_Table *table);
+void _cd_heap_close(CD_Heap *heap);
+// writes the _CD_HeapValue of value of attribute to stored_value, adding value to the heap and its file when it is not held
+// in place. only the writer encodes, without holding the lock of the table, which is taken to grow the file
+uint64_t _cd_heap_encode(CD_Table *table, CD_Heap *heap, const CD_AttributeEx *attribute, const void *value, void *stored_value);
+// writes the size bytes of the value of the _CD_HeapValue stored_value to value; the lock of the table must be held or
+// the caller must be the writer
+uint64_t _cd_heap_decode(const CD_Heap *heap, uint64_t size, const void *stored_value, void *value);
+// bytes of the value of the _CD_HeapValue stored_value in the heap, 0 when it is held in place
+uint64_t _cd_heap_value_length(const void *stored_value);
+
+// tombstones
+uint64_t _cd_tombstones_exists(CD_Table *table);
+// creates the file when it does not exist
+CD_Tombstones *_cd_tombstones_open(CD_Table *table);
+void _cd_tombstones_close(CD_Tombstones *tombstones);
+uint64_t _cd_tombstones_set(CD_Tombstones *tombstones, uint64_t row, uint64_t is_deleted);
+// writes the header, call after setting rows
+uint64_t _cd_tombstones_commit(CD_Tombstones *tombstones);
+uint64_t _cd_tombstones_is_deleted(const CD_Tombstones *tombstones, uint64_t row);
+// clears the flags of the deleted rows among [row, row + row_count)
+void _cd_tombstones_apply(const CD_Tombstones *tombstones, uint64_t row, uint64_t row_count, uint8_t *selection);
+// first deleted row in [row, end_row), end_row if there is none
+uint64_t _cd_tombstones_next(CD_Tombstones *tombstones, uint64_t row, uint64_t end_row);
+
+// zone maps
+uint64_t _cd_zone_map_has_attributes(const CD_TableSchema *schema);
+// creates the file when it does not exist, builds the zones again when they do not cover the rows of the table
+CD_ZoneMap *_cd_zone_map_open(CD_Table *table);
+void _cd_zone_map_close(CD_ZoneMap *zone_map);
+// widens the zones of the attribute at table index attribute_index by row_count values stride bytes apart, from row on
+uint64_t _cd_zone_map_insert(CD_ZoneMap *zone_map, uint64_t attribute_index, const void *values, uint64_t stride, uint64_t row, uint64_t row_count);
+// forgets the blocks past row_count
+void _cd_zone_map_truncate(CD_ZoneMap *zone_map, uint64_t row_count);
+// writes the changed blocks and the header, call after inserting
+uint64_t _cd_zone_map_commit(CD_ZoneMap *zone_map);
+uint64_t _cd_zone_map_rebuild(CD_Table *table, CD_ZoneMap *zone_map);
+// 1 when no row in [row, row + row_count) can match operator and value
+uint64_t _cd_zone_map_rules_out(const CD_ZoneMap *zone_map, uint64_t attribute_index, uint64_t operator, const void *value, uint64_t row, uint64_t row_count);
+
+// prepared
+// resolves attribute names to their place in the table and in the packed caller data
+uint64_t _cd_projection_resolve(CD_Table *table, uint64_t attribute_count, const char *attribute_names[], _CD_ProjectedAttribute *attributes, uint64_t *data_stride);
+
+// writes rows of a replayed insert to their place, growing the table and clearing their tombstones; indices are not updated
+uint64_t _cd_prepared_insert_redo(CD_PreparedInsert *insert, uint64_t first_row, uint64_t row_count, const void *data);
+// writes the rows of a replayed batch of vacuum moves to their holes and drops the rows from count_c on; indices are not
+// updated
+uint64_t _cd_table_vacuum_redo(CD_Table *table, uint64_t move_count, const uint64_t *holes, const uint8_t *rows, uint64_t count_c);
+
+// write-ahead log
+// opens the log of db, replays the inserts it holds and checkpoints them
+CD_Wal *_cd_wal_open(CD_Database *db);
+// checkpoints and closes
+void _cd_wal_close(CD_Wal *wal);
+uint64_t _cd_wal_durability_set(CD_Wal *wal, uint64_t durability);
+// logs that rows [first_row, first_row + row_count) of table are written from data; durable after _cd_wal_commit
+uint64_t _cd_wal_log_insert(CD_Wal *wal, CD_Table *table, uint64_t attribute_count, const _CD_ProjectedAttribute *attributes, uint64_t data_stride, uint64_t first_row, uint64_t row_count, const void *data);
+// logs that rows of table were moved into the deleted rows at holes and that it keeps count_c rows; durable after
+// _cd_wal_sync, ended with _cd_wal_commit like an insert
+uint64_t _cd_wal_log_vacuum(CD_Wal *wal, CD_Table *table, uint64_t move_count, const uint64_t *holes, const void *rows, uint64_t count_c);
+// ends a logged insert once its rows are written, also when writing them failed, and makes the logged records as
+// durable as the durability level asks; call before the rows are published
+uint64_t _cd_wal_commit(CD_Wal *wal);
+// writes the published count_c of table to its file once the records of its rows are synced: now when they are,
+// otherwise by the next checkpoint; call after publishing it without holding table->lock
+uint64_t _cd_wal_count_write(CD_Wal *wal, CD_Table *table);
+// syncs the log and writes the count_c of table if a checkpoint was left to write it; call before its handle is closed
+void _cd_wal_table_release(CD_Wal *wal, CD_Table *table);
+// writes and syncs every logged record
+uint64_t _cd_wal_sync(CD_Wal *wal);
+// syncs the data files of the logged inserts and empties the log; call before a table is changed in a way that is not logged
+uint64_t _cd_wal_checkpoint(CD_Wal *wal);
+// checkpoints once the log holds CD_WAL_CHECKPOINT_SIZE bytes; call when no insert is half done
+uint64_t _cd_wal_checkpoint_if_full(CD_Wal *wal);
+
+// aggregate
+// resolves the attribute of aggregate and checks that its function can be computed over it
+uint64_t _cd_aggregate_prepare(CD_Table *table, const CD_Aggregate *aggregate, _CD_PreparedAggregate *prepared);
+// turns the accumulator of an aggregate over row_count rows into its result
+void _cd_aggregate_result(const _CD_PreparedAggregate *aggregate, uint64_t accumulator, uint64_t row_count, CD_AggregateResult *result);
+
+// group by
+// groups row_count staged rows of group_by->stride bytes, rows of groups that do not fit the budget are spilled
+uint64_t _cd_group_by_rows(_CD_GroupBy *group_by, const uint8_t *rows, uint64_t row_count);
+
 // error
+// the error state is per thread, a thread working for another one hands its error over with these
+typedef struct _CD_ErrorState
+{
+	uint64_t error_type;
+	char message[CD_ERROR_MESSAGE_SIZE];
+} _CD_ErrorState;
+
 void _cd_make_error(uint64_t error_type, const char *format, ...);
+void _cd_error_save(_CD_ErrorState *state);
+void _cd_error_restore(const _CD_ErrorState *state);
 
 #endif
\ No newline at end of file
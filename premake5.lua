@@ -2,15 +2,30 @@ project "c_db"
 	location "."
 	kind "StaticLib"
 	language "C"
-	
 	files { "**.c", "**.h" }
+	removefiles { "bench/**" }
 	includedirs { "../_vendor", "../", "." }
-
 	links { "c_core", "c_file" }
-
 	filter "configurations:Debug"
 		defines "CC_DEBUG"
+	filter "system:linux"
+		links { "m", "pthread" }
+		buildoptions "-g"
+	filter {}
 
+-- synthetic workloads printing rows/sec, ns/row and peak RSS as json or csv; run with --help for the options
+project "c_db_bench"
+	location "."
+	kind "ConsoleApp"
+	language "C"
+	files { "bench/**.c" }
+	includedirs { "../_vendor", "../", "." }
+	links { "c_db", "c_core", "c_file" }
+	filter "configurations:Debug"
+		defines "CC_DEBUG"
 	filter "system:linux"
-		links { "m" }
+		links { "m", "pthread" }
 		buildoptions "-g"
+	filter "system:windows"
+		links { "psapi" }
+	filter {}